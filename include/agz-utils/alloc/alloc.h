@@ -41,7 +41,7 @@ namespace impl
 template<typename T>
 void call_destructor(T &obj) noexcept
 {
-    impl::call_destructor_aux<T, std::is_trivially_destructible_v<T>>::call(obj);
+    impl::call_destructor_aux<T, !std::is_trivially_destructible_v<T>>::call(obj);
 }
 
 /**
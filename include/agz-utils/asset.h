@@ -0,0 +1,3 @@
+﻿#pragma once
+
+#include "asset/asset_loader.h"
@@ -0,0 +1,147 @@
+﻿#pragma once
+
+#include <any>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../math/math.h"
+#include "../mesh/load_mesh.h"
+#include "../misc/uncopyable.h"
+
+namespace agz::asset
+{
+
+/**
+ * @brief 一次批量加载的统计数据
+ *
+ * 各阶段耗时为所有资源在该阶段耗时的总和，可能大于wall_us
+ */
+struct load_stats_t
+{
+    size_t asset_count = 0;
+
+    size_t bytes_read = 0;
+
+    // 在途（读取中或解码中）文件字节数的峰值
+    size_t peak_inflight_bytes = 0;
+
+    uint64_t read_us   = 0;
+    uint64_t decode_us = 0;
+    uint64_t wall_us   = 0;
+};
+
+/**
+ * @brief 并行批量加载图像和网格
+ *
+ * 读取通过file::async_reader_t进行，解码在其工作线程上执行，
+ * 从而和其他资源的读取重叠
+ *
+ * 使用流程：
+ *      asset_loader_t loader;
+ *      auto tex  = loader.add_rgb("a.png");
+ *      auto mesh = loader.add_mesh("b.obj");
+ *      loader.load();
+ *      auto tex_data  = loader.take(tex);
+ *      auto mesh_data = loader.take(mesh);
+ */
+class asset_loader_t : public misc::uncopyable_t
+{
+public:
+
+    template<typename T>
+    struct handle_t
+    {
+        size_t index;
+    };
+
+    /**
+     * @param worker_count 解码线程数，含义同thread::actual_worker_count
+     * @param memory_budget 同时在途（读取中或解码中）的文件字节数上限，0表示不限；
+     *  单个超过预算的资源仍会被加载，但此时不会与其他资源同时在途
+     */
+    explicit asset_loader_t(int worker_count = 0, size_t memory_budget = 0);
+
+    handle_t<math::tensor_t<math::byte, 2>> add_gray(std::string filename);
+
+    handle_t<math::tensor_t<math::color2b, 2>> add_gray_alpha(
+        std::string filename);
+
+    handle_t<math::tensor_t<math::color3b, 2>> add_rgb(std::string filename);
+
+    handle_t<math::tensor_t<math::color4b, 2>> add_rgba(std::string filename);
+
+    handle_t<math::tensor_t<math::color3f, 2>> add_rgb_hdr(
+        std::string filename);
+
+    /**
+     * @brief 添加一个.obj/.stl/.ply/.agzmesh网格
+     */
+    handle_t<std::vector<mesh::triangle_t>> add_mesh(std::string filename);
+
+    /**
+     * @brief 加载所有已添加但尚未加载的资源
+     *
+     * @exception 任一资源加载失败时，等所有在途资源完成后抛出第一个异常
+     */
+    void load();
+
+    /**
+     * @brief 取出一个已加载的资源，每个资源只能被取出一次
+     */
+    template<typename T>
+    T take(handle_t<T> handle);
+
+    /**
+     * @brief 最近一次load的统计数据
+     */
+    const load_stats_t &stats() const noexcept;
+
+private:
+
+    enum class kind_t
+    {
+        gray, gray_alpha, rgb, rgba, rgb_hdr, mesh
+    };
+
+    struct request_t
+    {
+        std::string filename;
+        kind_t kind;
+        bool loaded = false;
+    };
+
+    template<typename T>
+    handle_t<T> add(std::string filename, kind_t kind);
+
+    int worker_count_;
+    size_t memory_budget_;
+
+    std::vector<request_t> requests_;
+    std::vector<std::any>  results_;
+
+    load_stats_t stats_;
+};
+
+template<typename T>
+asset_loader_t::handle_t<T> asset_loader_t::add(
+    std::string filename, kind_t kind)
+{
+    requests_.push_back({ std::move(filename), kind });
+    results_.emplace_back();
+    return { requests_.size() - 1 };
+}
+
+template<typename T>
+T asset_loader_t::take(handle_t<T> handle)
+{
+    auto &result = results_.at(handle.index);
+    if(!result.has_value())
+        throw std::runtime_error(
+            "asset not loaded: " + requests_[handle.index].filename);
+    T ret = std::move(*std::any_cast<T>(&result));
+    result.reset();
+    return ret;
+}
+
+} // namespace agz::asset
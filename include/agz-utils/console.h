@@ -1,3 +1,4 @@
 ﻿#pragma once
 
 #include "./console/pbar.h"
+#include "./console/progress.h"
@@ -13,6 +13,8 @@ namespace agz::console
  * 使用display来刷新进度条
  * 使用done来关闭进度条
  * 使用operator++使已完成的任务数+1
+ *
+ * 不可在多个线程中同时使用，此时应使用./progress.h中的progress_tracker_t
  */
 class progress_bar_t
 {
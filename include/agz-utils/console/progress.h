@@ -0,0 +1,143 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "../misc/uncopyable.h"
+#include "../profile/metrics.h"
+
+namespace agz::console
+{
+
+/**
+ * @brief 可在多个线程中同时推进的进度条
+ *
+ * 任意线程都可调用add/operator++，计数按线程分片，不会争用同一缓存行；
+ * 后台线程按固定间隔刷新显示，因此推进频率再高也不会刷屏。
+ * 剩余时间由指数平滑后的完成速率估计。
+ *
+ * 配合parallel_forrange使用时，可以用wrap包装任务函数：
+ *
+ *  progress_tracker_t progress(n);
+ *  thread::parallel_forrange(0, n, progress.wrap(func));
+ *  progress.done();
+ */
+class progress_tracker_t : public misc::uncopyable_t
+{
+public:
+
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * @param total 总任务数
+     * @param width 进度条长度
+     * @param refresh_interval 后台刷新间隔，为0时不启动后台刷新，只在调用display时显示
+     * @param out 输出流，后台线程在done前都会写入，须在此之前保持有效
+     */
+    explicit progress_tracker_t(
+        uint64_t                  total,
+        int                       width            = 50,
+        std::chrono::milliseconds refresh_interval = std::chrono::milliseconds(100),
+        std::ostream             &out              = std::cout);
+
+    /**
+     * @brief 未调用done时停止后台刷新，但不输出最终进度
+     */
+    ~progress_tracker_t();
+
+    void add(uint64_t count = 1) noexcept
+    {
+        finished_.add(static_cast<int64_t>(count));
+    }
+
+    progress_tracker_t &operator++() noexcept
+    {
+        add(1);
+        return *this;
+    }
+
+    uint64_t finished() const noexcept;
+
+    uint64_t total() const noexcept
+    {
+        return total_;
+    }
+
+    /**
+     * @brief 估计的剩余秒数，尚无法估计时返回负数
+     */
+    double eta_seconds() const;
+
+    /**
+     * @brief 立即刷新显示
+     */
+    void display();
+
+    /**
+     * @brief 停止后台刷新，输出最终进度并换行
+     *
+     * 只有第一次调用有效
+     */
+    void done();
+
+    /**
+     * @brief 包装任务函数，使其每正常返回一次就使进度+1
+     *
+     * 返回的函数对象以引用方式使用*this，抛出异常的调用不计入进度
+     */
+    template<typename Func>
+    auto wrap(Func &&func)
+    {
+        return [tracker = this, f = std::forward<Func>(func)]
+               (auto &&...args)
+        {
+            f(std::forward<decltype(args)>(args)...);
+            tracker->add(1);
+        };
+    }
+
+private:
+
+    // 速率平滑的时间常数，越大估计越稳定，但对速率变化的反应越慢
+    static constexpr double RATE_TIME_CONSTANT = 3.0;
+
+    void refresh_loop();
+
+    // 以下须持有state_mutex_
+
+    void update_rate(uint64_t finished, clock_t::time_point now);
+
+    std::string render(uint64_t finished, clock_t::time_point now) const;
+
+    void write(const std::string &line);
+
+    profile::counter_t finished_;
+
+    uint64_t total_;
+    int      width_;
+
+    std::ostream &out_;
+
+    mutable std::mutex state_mutex_;
+
+    clock_t::time_point start_;
+    clock_t::time_point last_sample_time_;
+    uint64_t            last_sample_finished_;
+    double              smoothed_rate_;
+    bool                has_rate_;
+    bool                done_;
+
+    std::chrono::milliseconds refresh_interval_;
+    std::mutex                refresh_mutex_;
+    std::condition_variable   refresh_cond_;
+    bool                      stop_refresh_;
+    std::thread               refresh_thread_;
+};
+
+} // namespace agz::console
@@ -1,4 +1,6 @@
 #pragma once
 
+#include "./event/delegate.h"
 #include "./event/event.h"
 #include "./event/keycode.h"
+#include "./event/queued_sender.h"
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <type_traits>
+
+namespace agz::event
+{
+
+/**
+ * @brief 不持有对象、不经过虚函数表的事件处理函数
+ *
+ * 由对象指针和一个静态桩函数组成，调用时只有一次间接跳转。
+ * 两个delegate_t在对象指针和桩函数都相同时相等，可以据此从receiver_set_t中移除
+ */
+template<typename Event>
+class delegate_t
+{
+public:
+
+    using stub_t = void(*)(void *, const Event &);
+
+    delegate_t() noexcept : object_(nullptr), stub_(nullptr) { }
+
+    /**
+     * @brief 绑定对象obj的成员函数MemFunc
+     *
+     * 例：delegate_t<E>::from_method<&C::on_event>(&c)
+     */
+    template<auto MemFunc, typename Class>
+    static delegate_t from_method(Class *obj) noexcept
+    {
+        static_assert(std::is_member_function_pointer_v<decltype(MemFunc)>);
+        return delegate_t(
+            const_cast<void *>(static_cast<const void *>(obj)),
+            [](void *o, const Event &e) { (static_cast<Class *>(o)->*MemFunc)(e); });
+    }
+
+    /**
+     * @brief 绑定自由函数Func
+     */
+    template<void(*Func)(const Event &)>
+    static delegate_t from_function() noexcept
+    {
+        return delegate_t(nullptr, [](void *, const Event &e) { Func(e); });
+    }
+
+    /**
+     * @brief 绑定可调用对象*f，delegate_t不持有该对象
+     */
+    template<typename Func>
+    static delegate_t from_callable(Func *f) noexcept
+    {
+        return delegate_t(
+            const_cast<void *>(static_cast<const void *>(f)),
+            [](void *o, const Event &e) { (*static_cast<Func *>(o))(e); });
+    }
+
+    void operator()(const Event &e) const { stub_(object_, e); }
+
+    explicit operator bool() const noexcept { return stub_ != nullptr; }
+
+    void *object() const noexcept { return object_; }
+
+    stub_t stub() const noexcept { return stub_; }
+
+    bool operator==(const delegate_t &rhs) const noexcept
+    {
+        return object_ == rhs.object_ && stub_ == rhs.stub_;
+    }
+
+    bool operator!=(const delegate_t &rhs) const noexcept
+    {
+        return !(*this == rhs);
+    }
+
+private:
+
+    delegate_t(void *object, stub_t stub) noexcept
+        : object_(object), stub_(stub)
+    {
+        
+    }
+
+    void  *object_;
+    stub_t stub_;
+};
+
+} // namespace agz::event
@@ -1,14 +1,19 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <type_traits>
 #include <tuple>
-#include <unordered_set>
+#include <vector>
 
+#include "../misc/scope_guard.h"
 #include "../misc/uncopyable.h"
+#include "./delegate.h"
 
 namespace agz::event
 {
@@ -16,6 +21,13 @@ namespace agz::event
 template<typename Event>
 class receiver_set_t;
 
+/**
+ * @brief 事件处理器
+ *
+ * 析构时自动从包含它的集合中移除，但不等待这些集合中已经开始的send。
+ * 若其他线程可能正在send，应在销毁前手动detach并对这些集合调用
+ * receiver_set_t::synchronize
+ */
 template<typename Event>
 class receiver_t :
     public std::enable_shared_from_this<receiver_t<Event>>,
@@ -23,6 +35,7 @@ class receiver_t :
 {
     friend class receiver_set_t<Event>;
 
+    std::mutex sets_mutex_;
     std::set<receiver_set_t<Event> *> contained_sets_;
     std::set<receiver_set_t<Event> *> owned_contained_sets_;
 
@@ -33,14 +46,26 @@ public:
     virtual void handle(const Event &event) = 0;
 };
 
+/**
+ * @brief 一组事件处理器
+ *
+ * 处理器以连续数组的形式存放在不可变的快照中。attach/detach互斥地复制当前快照、
+ * 修改后原子地发布新快照（copy-on-write）；send只读取当前快照，不加锁、不等待、
+ * 不分配内存，可以与attach/detach以及其他send并发进行。
+ *
+ * 被替换的快照在没有进行中的send时才被释放，检查发生在attach/detach发布新快照时
+ * 以及最后一个进行中的send结束时。因此detach返回后，已经开始的send仍可能调用
+ * 被移除的处理器；若要在其他线程可能正在send时销毁非持有的处理器，应在detach后
+ * 调用synchronize。若各线程的send始终相互重叠，被替换的快照及其持有的处理器会
+ * 一直累积到调用synchronize为止
+ */
 template<typename Event>
 class receiver_set_t : public misc::uncopyable_t
 {
-    std::unordered_set<receiver_t<Event> *>                handlers_;
-    std::unordered_set<std::shared_ptr<receiver_t<Event>>> owned_handlers_;
-
 public:
 
+    receiver_set_t() = default;
+
     ~receiver_set_t();
 
     void send(const Event &e) const;
@@ -49,11 +74,77 @@ public:
 
     void attach(std::shared_ptr<receiver_t<Event>> owned_handler);
 
+    void attach(const delegate_t<Event> &handler);
+
     void detach(receiver_t<Event> *handler);
 
     void detach(const std::shared_ptr<receiver_t<Event>> &owned_handler);
 
+    void detach(const delegate_t<Event> &handler);
+
     void detach_all();
+
+    /**
+     * @brief 处理器数量
+     */
+    size_t size() const noexcept;
+
+    /**
+     * @brief 等待调用前已经开始的send结束，并释放调用前被替换的快照
+     *
+     * 之后开始的send不会被等待，因此即使其他线程持续地send也能返回。
+     * 不能在本集合的处理器中调用
+     */
+    void synchronize();
+
+private:
+
+    struct entry_t
+    {
+        void *object;
+        typename delegate_t<Event>::stub_t stub;
+
+        // 持有的处理器，同时用于区分以指针和以shared_ptr添加的同一个处理器
+        std::shared_ptr<receiver_t<Event>> owner;
+    };
+
+    struct snapshot_t
+    {
+        std::vector<entry_t> entries;
+    };
+
+    using snapshot_ptr_t = std::unique_ptr<const snapshot_t>;
+
+    static void receiver_stub(void *handler, const Event &e);
+
+    /**
+     * @brief 在写锁内以modify(entries)修改当前处理器列表的副本，
+     *        modify返回true时发布副本
+     */
+    template<typename Modify>
+    void update(Modify &&modify);
+
+    bool no_active_sender() const noexcept;
+
+    /**
+     * @brief 若能立即取得写锁且没有进行中的send，释放被替换的快照
+     */
+    void reclaim_retired() const noexcept;
+
+    std::atomic<const snapshot_t *> snapshot_ = { nullptr };
+
+    // send按epoch_的奇偶性登记到两个计数器之一，synchronize翻转epoch_后
+    // 只需等待旧计数器归零
+    mutable std::atomic<size_t> active_senders_[2] = { { 0 }, { 0 } };
+    std::atomic<size_t>         epoch_ = { 0 };
+
+    // send结束时可能释放被替换的快照，因此以下成员为mutable
+
+    mutable std::mutex                  write_mutex_;
+    mutable std::vector<snapshot_ptr_t> retired_;
+    mutable std::atomic<bool>           has_retired_ = { false };
+
+    std::mutex sync_mutex_;
 };
 
 template<typename...Events>
@@ -72,16 +163,27 @@ public:
     template<typename Event>
     void attach(std::shared_ptr<receiver_t<Event>> owned_handler);
 
+    template<typename Event>
+    void attach(const delegate_t<Event> &handler);
+
     template<typename Event>
     void detach(receiver_t<Event> *handler);
 
     template<typename Event>
     void detach(const std::shared_ptr<receiver_t<Event>> &owned_handler);
 
+    template<typename Event>
+    void detach(const delegate_t<Event> &handler);
+
     template<typename Event>
     void detach_all();
 
     void detach_all_types();
+
+    /**
+     * @brief 对所有事件类型调用receiver_set_t::synchronize
+     */
+    void synchronize();
 };
 
 template<typename Event>
@@ -146,14 +248,18 @@ private:
 template<typename Event>
 receiver_t<Event>::~receiver_t()
 {
-    while(!contained_sets_.empty())
-        (*contained_sets_.begin())->detach(this);
+    // 以shared_ptr添加的处理器被集合持有，不会在仍被包含时析构
 
-    if(!owned_contained_sets_.empty())
+    for(;;)
     {
-        auto shared_this = this->shared_from_this();
-        while(!owned_contained_sets_.empty())
-            (*owned_contained_sets_.begin())->detach(this);
+        receiver_set_t<Event> *set;
+        {
+            std::lock_guard lk(sets_mutex_);
+            if(contained_sets_.empty())
+                break;
+            set = *contained_sets_.begin();
+        }
+        set->detach(this);
     }
 }
 
@@ -161,24 +267,49 @@ template<typename Event>
 receiver_set_t<Event>::~receiver_set_t()
 {
     detach_all();
+    delete snapshot_.load();
 }
 
 template<typename Event>
 void receiver_set_t<Event>::send(const Event &e) const
 {
-    for(auto h : handlers_)
-        h->handle(e);
+    // 先登记再读取快照，与update中先发布再检查计数器相对应
+
+    auto &counter = active_senders_[epoch_.load() & 1];
+    counter.fetch_add(1);
+    AGZ_SCOPE_EXIT
+    {
+        if(counter.fetch_sub(1) == 1 && has_retired_.load())
+            reclaim_retired();
+    };
 
-    for(auto &owned_h : owned_handlers_)
-        owned_h->handle(e);
+    if(const snapshot_t *snapshot = snapshot_.load())
+    {
+        for(auto &entry : snapshot->entries)
+            entry.stub(entry.object, e);
+    }
 }
 
 template<typename Event>
 void receiver_set_t<Event>::attach(receiver_t<Event> *handler)
 {
     assert(handler);
-    handler->contained_sets_.insert(this);
-    handlers_.insert(handler);
+    update([&](std::vector<entry_t> &entries)
+    {
+        for(auto &entry : entries)
+        {
+            if(entry.object == handler && entry.stub == &receiver_stub &&
+               !entry.owner)
+                return false;
+        }
+
+        {
+            std::lock_guard lk(handler->sets_mutex_);
+            handler->contained_sets_.insert(this);
+        }
+        entries.push_back({ handler, &receiver_stub, nullptr });
+        return true;
+    });
 }
 
 template<typename Event>
@@ -186,16 +317,62 @@ void receiver_set_t<Event>::attach(
     std::shared_ptr<receiver_t<Event>> owned_handler)
 {
     assert(owned_handler);
-    owned_handler->owned_contained_sets_.insert(this);
-    owned_handlers_.insert(std::move(owned_handler));
+    update([&](std::vector<entry_t> &entries)
+    {
+        for(auto &entry : entries)
+        {
+            if(entry.owner == owned_handler)
+                return false;
+        }
+
+        {
+            std::lock_guard lk(owned_handler->sets_mutex_);
+            owned_handler->owned_contained_sets_.insert(this);
+        }
+        receiver_t<Event> *object = owned_handler.get();
+        entries.push_back({ object, &receiver_stub, std::move(owned_handler) });
+        return true;
+    });
+}
+
+template<typename Event>
+void receiver_set_t<Event>::attach(const delegate_t<Event> &handler)
+{
+    assert(handler);
+    update([&](std::vector<entry_t> &entries)
+    {
+        for(auto &entry : entries)
+        {
+            if(entry.object == handler.object() && entry.stub == handler.stub())
+                return false;
+        }
+
+        entries.push_back({ handler.object(), handler.stub(), nullptr });
+        return true;
+    });
 }
 
 template<typename Event>
 void receiver_set_t<Event>::detach(receiver_t<Event> *handler)
 {
     assert(handler);
-    handler->contained_sets_.erase(this);
-    handlers_.erase(handler);
+    update([&](std::vector<entry_t> &entries)
+    {
+        for(auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if(it->object == handler && it->stub == &receiver_stub &&
+               !it->owner)
+            {
+                {
+                    std::lock_guard lk(handler->sets_mutex_);
+                    handler->contained_sets_.erase(this);
+                }
+                entries.erase(it);
+                return true;
+            }
+        }
+        return false;
+    });
 }
 
 template<typename Event>
@@ -203,18 +380,157 @@ void receiver_set_t<Event>::detach(
     const std::shared_ptr<receiver_t<Event>> &owned_handler)
 {
     assert(owned_handler);
-    owned_handler->owned_contained_sets_.erase(this);
-    owned_handlers_.erase(owned_handler);
+    update([&](std::vector<entry_t> &entries)
+    {
+        for(auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if(it->owner == owned_handler)
+            {
+                {
+                    std::lock_guard lk(owned_handler->sets_mutex_);
+                    owned_handler->owned_contained_sets_.erase(this);
+                }
+                entries.erase(it);
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+template<typename Event>
+void receiver_set_t<Event>::detach(const delegate_t<Event> &handler)
+{
+    update([&](std::vector<entry_t> &entries)
+    {
+        for(auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if(it->object == handler.object() && it->stub == handler.stub() &&
+               !it->owner)
+            {
+                entries.erase(it);
+                return true;
+            }
+        }
+        return false;
+    });
 }
 
 template<typename Event>
 void receiver_set_t<Event>::detach_all()
 {
-    while(!handlers_.empty())
-        this->detach(*handlers_.begin());
+    update([&](std::vector<entry_t> &entries)
+    {
+        if(entries.empty())
+            return false;
+
+        for(auto &entry : entries)
+        {
+            if(entry.stub != &receiver_stub)
+                continue;
+
+            auto handler = static_cast<receiver_t<Event> *>(entry.object);
+            std::lock_guard lk(handler->sets_mutex_);
+            if(entry.owner)
+                handler->owned_contained_sets_.erase(this);
+            else
+                handler->contained_sets_.erase(this);
+        }
+
+        entries.clear();
+        return true;
+    });
+}
 
-    while(!owned_handlers_.empty())
-        this->detach(*owned_handlers_.begin());
+template<typename Event>
+size_t receiver_set_t<Event>::size() const noexcept
+{
+    const snapshot_t *snapshot = snapshot_.load();
+    return snapshot ? snapshot->entries.size() : 0;
+}
+
+template<typename Event>
+void receiver_set_t<Event>::synchronize()
+{
+    std::vector<snapshot_ptr_t> garbage;
+    {
+        std::lock_guard lk(write_mutex_);
+        garbage.swap(retired_);
+        has_retired_ = false;
+    }
+
+    // 翻转两次：第一次翻转前读到旧epoch_但尚未登记的send可能在第一次等待后
+    // 才登记到旧计数器，第二次等待覆盖这种情况
+
+    std::lock_guard lk(sync_mutex_);
+    for(int i = 0; i < 2; ++i)
+    {
+        const size_t old_epoch = epoch_.fetch_add(1);
+        while(active_senders_[old_epoch & 1].load() != 0)
+            std::this_thread::yield();
+    }
+}
+
+template<typename Event>
+bool receiver_set_t<Event>::no_active_sender() const noexcept
+{
+    return active_senders_[0].load() == 0 && active_senders_[1].load() == 0;
+}
+
+template<typename Event>
+void receiver_set_t<Event>::reclaim_retired() const noexcept
+{
+    // garbage在锁之前声明，因此在释放锁之后才析构
+
+    std::vector<snapshot_ptr_t> garbage;
+    std::unique_lock lk(write_mutex_, std::try_to_lock);
+    if(lk.owns_lock() && no_active_sender())
+    {
+        garbage.swap(retired_);
+        has_retired_ = false;
+    }
+}
+
+template<typename Event>
+void receiver_set_t<Event>::receiver_stub(void *handler, const Event &e)
+{
+    static_cast<receiver_t<Event> *>(handler)->handle(e);
+}
+
+template<typename Event>
+template<typename Modify>
+void receiver_set_t<Event>::update(Modify &&modify)
+{
+    // 被释放的快照可能持有处理器，在写锁外析构以免处理器的析构函数重入
+
+    std::vector<snapshot_ptr_t> garbage;
+    {
+        std::lock_guard lk(write_mutex_);
+
+        const snapshot_t *old_snapshot = snapshot_.load();
+
+        auto new_snapshot = std::make_unique<snapshot_t>();
+        if(old_snapshot)
+            new_snapshot->entries = old_snapshot->entries;
+
+        if(!modify(new_snapshot->entries))
+            return;
+
+        snapshot_.store(new_snapshot.release());
+        if(old_snapshot)
+        {
+            retired_.emplace_back(old_snapshot);
+            has_retired_ = true;
+        }
+
+        // 新快照已发布，此时若没有进行中的send，之后开始的send都只会读到新快照
+
+        if(no_active_sender())
+        {
+            garbage.swap(retired_);
+            has_retired_ = false;
+        }
+    }
 }
 
 template<typename...Events>
@@ -239,6 +555,13 @@ void sender_t<Events...>::attach(
     std::get<receiver_set_t<Event>>(sets_).attach(std::move(owned_handler));
 }
 
+template<typename...Events>
+template<typename Event>
+void sender_t<Events...>::attach(const delegate_t<Event> &handler)
+{
+    std::get<receiver_set_t<Event>>(sets_).attach(handler);
+}
+
 template<typename...Events>
 template<typename Event>
 void sender_t<Events...>::detach(receiver_t<Event> *handler)
@@ -254,6 +577,13 @@ void sender_t<Events...>::detach(
     std::get<receiver_set_t<Event>>(sets_).detach(std::move(owned_handler));
 }
 
+template<typename...Events>
+template<typename Event>
+void sender_t<Events...>::detach(const delegate_t<Event> &handler)
+{
+    std::get<receiver_set_t<Event>>(sets_).detach(handler);
+}
+
 template<typename...Events>
 template<typename Event>
 void sender_t<Events...>::detach_all()
@@ -269,6 +599,14 @@ void sender_t<Events...>::detach_all_types()
         sets_);
 }
 
+template<typename...Events>
+void sender_t<Events...>::synchronize()
+{
+    std::apply(
+        [](auto &&...s) { ((s.synchronize()), ...); },
+        sets_);
+}
+
 template<typename Event>
 functional_receiver_t<Event>::functional_receiver_t(std::function<void()> f)
 {
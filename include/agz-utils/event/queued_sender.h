@@ -0,0 +1,478 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "../misc/scope_guard.h"
+#include "../misc/span.h"
+#include "./event.h"
+
+namespace agz::event
+{
+
+/**
+ * @brief 有界的多生产者单消费者环形队列
+ *
+ * 使用每格一个序号的Vyukov算法：push只通过CAS竞争写位置，不加锁；
+ * pop只能在单个线程上调用
+ */
+template<typename T>
+class event_ring_t : public misc::uncopyable_t
+{
+public:
+
+    /**
+     * @param capacity 容量，向上取整为2的幂
+     *
+     * @exception std::runtime_error capacity为0
+     */
+    explicit event_ring_t(size_t capacity);
+
+    ~event_ring_t();
+
+    size_t capacity() const noexcept;
+
+    /**
+     * @brief 在队尾以args构造一个元素
+     *
+     * @return 队列已满时返回false
+     */
+    template<typename...Args>
+    bool push(Args &&...args);
+
+    /**
+     * @brief 将当前已完成写入的元素依次移动到output的末尾
+     *
+     * @return 取出的元素数量
+     */
+    size_t pop_all(std::vector<T> &output);
+
+private:
+
+    struct cell_t
+    {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T *object() noexcept
+        {
+            return std::launder(reinterpret_cast<T *>(storage));
+        }
+    };
+
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    size_t mask_;
+    std::unique_ptr<cell_t[]> cells_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> push_pos_;
+    alignas(CACHE_LINE_SIZE) size_t pop_pos_;
+};
+
+/**
+ * @brief 合并一种事件时使用的函数
+ *
+ * merge(last, next)返回true表示next已被合并到上一个保留的事件last中，
+ * 返回false表示next被单独保留
+ */
+template<typename Event>
+using coalesce_func_t = std::function<bool(Event &last, const Event &next)>;
+
+/**
+ * @brief 延迟分发的事件发送器
+ *
+ * enqueue把事件写入该类型的环形队列，可以在任意线程上无锁地调用；
+ * dispatch_all在单个线程（通常是主线程）上先取出所有类型的已入队事件，
+ * 按类型合并后依次分发：每种类型先以misc::span<const Event>的形式交给批处理器，
+ * 再逐个交给普通处理器。
+ *
+ * 同一生产者的同类型事件保持入队顺序，不同类型之间的顺序不保证。
+ * 处理器在dispatch_all中入队的事件在下一次dispatch_all中分发
+ */
+template<typename...Events>
+class queued_sender_t : public misc::uncopyable_t
+{
+public:
+
+    /**
+     * @param capacity 每种事件的环形队列容量
+     */
+    explicit queued_sender_t(size_t capacity = 1024);
+
+    /**
+     * @brief 以args构造一个Event并入队
+     *
+     * @return 该类型的队列已满时丢弃事件并返回false
+     */
+    template<typename Event, typename...Args>
+    bool enqueue(Args &&...args);
+
+    /**
+     * @brief 取出并分发所有已入队的事件
+     *
+     * @return 合并后分发的事件数量
+     */
+    size_t dispatch_all();
+
+    /**
+     * @brief 设置Event的合并函数，空函数表示不合并
+     */
+    template<typename Event>
+    void set_coalesce(coalesce_func_t<Event> merge);
+
+    /**
+     * @brief 每次dispatch_all只保留最后一个Event，例如鼠标移动事件
+     */
+    template<typename Event>
+    void coalesce_latest();
+
+    template<typename Event>
+    void attach(receiver_t<Event> *handler);
+
+    template<typename Event>
+    void attach(std::shared_ptr<receiver_t<Event>> owned_handler);
+
+    template<typename Event>
+    void attach(const delegate_t<Event> &handler);
+
+    template<typename Event>
+    void detach(receiver_t<Event> *handler);
+
+    template<typename Event>
+    void detach(const std::shared_ptr<receiver_t<Event>> &owned_handler);
+
+    template<typename Event>
+    void detach(const delegate_t<Event> &handler);
+
+    /**
+     * @brief 批处理器集合，每次dispatch_all中以该类型的全部事件调用一次
+     */
+    template<typename Event>
+    receiver_set_t<misc::span<const Event>> &batch_receivers() noexcept;
+
+    void detach_all_types();
+
+private:
+
+    template<typename Event>
+    struct channel_t
+    {
+        explicit channel_t(size_t capacity) : ring(capacity) { }
+
+        event_ring_t<Event> ring;
+        std::vector<Event>  pending;
+
+        coalesce_func_t<Event> merge;
+
+        receiver_set_t<Event>                   receivers;
+        receiver_set_t<misc::span<const Event>> batch_receivers;
+    };
+
+    template<typename Event>
+    channel_t<Event> &channel() noexcept;
+
+    template<typename Event>
+    static void collect(channel_t<Event> &c);
+
+    template<typename Event>
+    static size_t deliver(channel_t<Event> &c);
+
+    std::tuple<std::unique_ptr<channel_t<Events>>...> channels_;
+};
+
+template<typename T>
+event_ring_t<T>::event_ring_t(size_t capacity)
+    : push_pos_(0), pop_pos_(0)
+{
+    if(!capacity)
+        throw std::runtime_error("event ring capacity must be positive");
+
+    size_t actual_capacity = 1;
+    while(actual_capacity < capacity)
+        actual_capacity <<= 1;
+
+    mask_ = actual_capacity - 1;
+    cells_ = std::make_unique<cell_t[]>(actual_capacity);
+    for(size_t i = 0; i < actual_capacity; ++i)
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template<typename T>
+event_ring_t<T>::~event_ring_t()
+{
+    for(;;)
+    {
+        cell_t &cell = cells_[pop_pos_ & mask_];
+        if(cell.sequence.load(std::memory_order_acquire) != pop_pos_ + 1)
+            break;
+        cell.object()->~T();
+        ++pop_pos_;
+    }
+}
+
+template<typename T>
+size_t event_ring_t<T>::capacity() const noexcept
+{
+    return mask_ + 1;
+}
+
+namespace queue_impl
+{
+
+    template<typename T, typename...Args>
+    constexpr bool is_nothrow_emplaceable_v =
+        std::is_constructible_v<T, Args&&...> ?
+        std::is_nothrow_constructible_v<T, Args&&...> :
+        noexcept(T{ std::declval<Args>()... });
+
+    template<typename T, typename...Args>
+    void emplace(void *storage, Args &&...args)
+    {
+        if constexpr(std::is_constructible_v<T, Args&&...>)
+            new(storage) T(std::forward<Args>(args)...);
+        else
+            new(storage) T{ std::forward<Args>(args)... };
+    }
+
+} // namespace queue_impl
+
+template<typename T>
+template<typename...Args>
+bool event_ring_t<T>::push(Args &&...args)
+{
+    // 已占用的格必须被发布，因此可能抛出异常的构造在占用之前完成
+
+    if constexpr(!queue_impl::is_nothrow_emplaceable_v<T, Args...>)
+    {
+        static_assert(std::is_nothrow_move_constructible_v<T>,
+                      "queued events must be nothrow move constructible");
+
+        alignas(T) unsigned char buffer[sizeof(T)];
+        queue_impl::emplace<T>(buffer, std::forward<Args>(args)...);
+        T *value = std::launder(reinterpret_cast<T *>(buffer));
+        AGZ_SCOPE_EXIT{ value->~T(); };
+        return push(std::move(*value));
+    }
+
+    size_t pos = push_pos_.load(std::memory_order_relaxed);
+    cell_t *cell;
+
+    for(;;)
+    {
+        cell = &cells_[pos & mask_];
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const intptr_t diff =
+            static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+        if(diff == 0)
+        {
+            if(push_pos_.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+            return false;
+        else
+            pos = push_pos_.load(std::memory_order_relaxed);
+    }
+
+    queue_impl::emplace<T>(cell->storage, std::forward<Args>(args)...);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+size_t event_ring_t<T>::pop_all(std::vector<T> &output)
+{
+    size_t count = 0;
+    for(;;)
+    {
+        cell_t &cell = cells_[pop_pos_ & mask_];
+        if(cell.sequence.load(std::memory_order_acquire) != pop_pos_ + 1)
+            break;
+
+        T *object = cell.object();
+        output.push_back(std::move(*object));
+        object->~T();
+
+        cell.sequence.store(pop_pos_ + mask_ + 1, std::memory_order_release);
+        ++pop_pos_;
+        ++count;
+    }
+    return count;
+}
+
+template<typename...Events>
+queued_sender_t<Events...>::queued_sender_t(size_t capacity)
+    : channels_(std::make_unique<channel_t<Events>>(capacity)...)
+{
+    
+}
+
+template<typename...Events>
+template<typename Event, typename...Args>
+bool queued_sender_t<Events...>::enqueue(Args &&...args)
+{
+    return channel<Event>().ring.push(std::forward<Args>(args)...);
+}
+
+template<typename...Events>
+size_t queued_sender_t<Events...>::dispatch_all()
+{
+    // 先取出所有类型的事件，使分发中新入队的事件留到下一次
+
+    std::apply([](auto &...c) { ((collect(*c)), ...); }, channels_);
+
+    size_t count = 0;
+    std::apply([&](auto &...c) { ((count += deliver(*c)), ...); }, channels_);
+    return count;
+}
+
+template<typename...Events>
+template<typename Event>
+void queued_sender_t<Events...>::set_coalesce(coalesce_func_t<Event> merge)
+{
+    channel<Event>().merge = std::move(merge);
+}
+
+template<typename...Events>
+template<typename Event>
+void queued_sender_t<Events...>::coalesce_latest()
+{
+    set_coalesce<Event>([](Event &last, const Event &next)
+    {
+        last = next;
+        return true;
+    });
+}
+
+template<typename...Events>
+template<typename Event>
+void queued_sender_t<Events...>::attach(receiver_t<Event> *handler)
+{
+    channel<Event>().receivers.attach(handler);
+}
+
+template<typename...Events>
+template<typename Event>
+void queued_sender_t<Events...>::attach(
+    std::shared_ptr<receiver_t<Event>> owned_handler)
+{
+    channel<Event>().receivers.attach(std::move(owned_handler));
+}
+
+template<typename...Events>
+template<typename Event>
+void queued_sender_t<Events...>::attach(const delegate_t<Event> &handler)
+{
+    channel<Event>().receivers.attach(handler);
+}
+
+template<typename...Events>
+template<typename Event>
+void queued_sender_t<Events...>::detach(receiver_t<Event> *handler)
+{
+    channel<Event>().receivers.detach(handler);
+}
+
+template<typename...Events>
+template<typename Event>
+void queued_sender_t<Events...>::detach(
+    const std::shared_ptr<receiver_t<Event>> &owned_handler)
+{
+    channel<Event>().receivers.detach(owned_handler);
+}
+
+template<typename...Events>
+template<typename Event>
+void queued_sender_t<Events...>::detach(const delegate_t<Event> &handler)
+{
+    channel<Event>().receivers.detach(handler);
+}
+
+template<typename...Events>
+template<typename Event>
+receiver_set_t<misc::span<const Event>> &
+    queued_sender_t<Events...>::batch_receivers() noexcept
+{
+    return channel<Event>().batch_receivers;
+}
+
+template<typename...Events>
+void queued_sender_t<Events...>::detach_all_types()
+{
+    std::apply(
+        [](auto &...c)
+    {
+        ((c->receivers.detach_all(), c->batch_receivers.detach_all()), ...);
+    }, channels_);
+}
+
+template<typename...Events>
+template<typename Event>
+typename queued_sender_t<Events...>::template channel_t<Event> &
+    queued_sender_t<Events...>::channel() noexcept
+{
+    return *std::get<std::unique_ptr<channel_t<Event>>>(channels_);
+}
+
+template<typename...Events>
+template<typename Event>
+void queued_sender_t<Events...>::collect(channel_t<Event> &c)
+{
+    const size_t beg = c.pending.size();
+    c.ring.pop_all(c.pending);
+
+    if(!c.merge || c.pending.size() == beg)
+        return;
+
+    // 原地压缩：每个新事件要么合并到最后保留的事件中，要么追加到其后
+
+    size_t kept = beg;
+    for(size_t i = beg; i < c.pending.size(); ++i)
+    {
+        if(kept > beg && c.merge(c.pending[kept - 1], c.pending[i]))
+            continue;
+        if(kept != i)
+            c.pending[kept] = std::move(c.pending[i]);
+        ++kept;
+    }
+    c.pending.erase(c.pending.begin() + kept, c.pending.end());
+}
+
+template<typename...Events>
+template<typename Event>
+size_t queued_sender_t<Events...>::deliver(channel_t<Event> &c)
+{
+    if(c.pending.empty())
+        return 0;
+
+    // 处理器中可能再次调用dispatch_all，因此先换出待分发的事件
+
+    std::vector<Event> events;
+    events.swap(c.pending);
+
+    c.batch_receivers.send(
+        misc::span<const Event>(events.data(), events.size()));
+
+    for(auto &e : events)
+        c.receivers.send(e);
+
+    const size_t count = events.size();
+
+    // 保留容量以便下次复用
+    events.clear();
+    if(c.pending.empty())
+        c.pending.swap(events);
+
+    return count;
+}
+
+} // namespace agz::event
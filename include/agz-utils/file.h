@@ -1,4 +1,6 @@
 ﻿#pragma once
 
+#include "file/async_reader.h"
 #include "file/dir.h"
 #include "file/file_raw.h"
+#include "file/mapped_file.h"
@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../misc/uncopyable.h"
+
+namespace agz::file
+{
+
+/**
+ * @brief 批量异步读取二进制文件
+ *
+ * Linux下优先使用io_uring提交读请求，不可用时（内核过旧、被禁用等）
+ * 退化为在thread::thread_group_t上执行的阻塞读取
+ *
+ * 读取完成后的回调在内部的工作线程上执行，因此解码等后续工作可以和
+ * 尚未完成的读请求重叠进行
+ *
+ * 回调函数或读取过程中抛出的异常会被记录下来，在wait_all中抛出第一个；
+ * 通过future提交的请求的异常则存入对应的future中
+ */
+class async_reader_t : public misc::uncopyable_t
+{
+public:
+
+    using callback_t = std::function<void(std::vector<unsigned char> &&)>;
+
+    /**
+     * @param worker_count 执行回调（以及退化模式下执行读取）的线程数，
+     *  含义同thread::actual_worker_count
+     * @param queue_depth 同时在途的最大读请求数
+     */
+    explicit async_reader_t(int worker_count = 0, int queue_depth = 64);
+
+    /**
+     * @brief 等待所有请求完成后销毁，此时不再抛出记录下的异常
+     */
+    ~async_reader_t();
+
+    /**
+     * @brief 是否正在使用io_uring后端
+     */
+    bool is_io_uring_enabled() const noexcept;
+
+    /**
+     * @brief 提交一个读请求，读取完成后在工作线程上调用callback
+     */
+    void read(std::string filename, callback_t callback);
+
+    /**
+     * @brief 提交一个读请求，读取失败时在工作线程上调用on_error，
+     *  此时该异常不会在wait_all中抛出
+     */
+    void read(
+        std::string filename, callback_t callback,
+        std::function<void(std::exception_ptr)> on_error);
+
+    /**
+     * @brief 提交一个读请求，通过future取得文件内容
+     */
+    std::future<std::vector<unsigned char>> read(std::string filename);
+
+    /**
+     * @brief 批量提交读请求，callback(i, content)中的i为文件在filenames中的下标
+     */
+    void read_batch(
+        const std::vector<std::string> &filenames,
+        std::function<void(size_t, std::vector<unsigned char> &&)> callback);
+
+    /**
+     * @brief 批量提交读请求，返回与filenames一一对应的future
+     */
+    std::vector<std::future<std::vector<unsigned char>>> read_batch(
+        const std::vector<std::string> &filenames);
+
+    /**
+     * @brief 阻塞直到所有已提交的请求及其回调都执行完毕
+     *
+     * @exception 若有回调或读取失败，抛出其中的第一个异常
+     */
+    void wait_all();
+
+private:
+
+    class impl_t;
+
+    std::unique_ptr<impl_t> impl_;
+};
+
+} // namespace agz::file
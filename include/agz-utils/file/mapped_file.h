@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <string>
+
+#include "../misc/span.h"
+#include "../misc/uncopyable.h"
+
+namespace agz::file
+{
+
+/**
+ * @brief 只读的内存映射文件
+ *
+ * 文件内容按需由操作系统换入，适合零拷贝地读取大文件
+ */
+class mapped_file_t : public misc::uncopyable_t
+{
+public:
+
+    mapped_file_t() noexcept;
+
+    /**
+     * @exception std::runtime_error 打开或映射失败时抛出
+     */
+    explicit mapped_file_t(const std::string &filename);
+
+    mapped_file_t(mapped_file_t &&move_from) noexcept;
+
+    mapped_file_t &operator=(mapped_file_t &&move_from) noexcept;
+
+    ~mapped_file_t();
+
+    /**
+     * @brief 映射一个文件，之前映射的文件会被关闭
+     *
+     * @exception std::runtime_error 打开或映射失败时抛出
+     */
+    void open(const std::string &filename);
+
+    void close() noexcept;
+
+    void swap(mapped_file_t &swap_with) noexcept;
+
+    bool is_open() const noexcept;
+
+    /**
+     * @brief 映射得到的文件内容，空文件返回nullptr
+     */
+    const unsigned char *data() const noexcept;
+
+    size_t size() const noexcept;
+
+    misc::span<const unsigned char> bytes() const noexcept;
+
+private:
+
+    bool is_open_ = false;
+
+    const unsigned char *data_ = nullptr;
+    size_t size_ = 0;
+
+    // 平台相关的句柄（windows下为文件与映射对象）
+    void *file_handle_    = nullptr;
+    void *mapping_handle_ = nullptr;
+};
+
+} // namespace agz::file
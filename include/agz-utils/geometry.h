@@ -0,0 +1,5 @@
+﻿#pragma once
+
+#include "./geometry/bvh.h"
+#include "./geometry/ray.h"
+#include "./geometry/ray_packet.h"
@@ -0,0 +1,236 @@
+﻿#pragma once
+
+#include <cstdint>
+
+#include "../mesh/load_mesh.h"
+#include "../thread/thread_pool.h"
+#include "./ray_packet.h"
+
+namespace agz::geometry
+{
+
+/**
+ * @brief bvh的构建参数
+ */
+struct bvh_build_options_t
+{
+    // 每个轴上用于估计SAH的桶数
+    int bin_count = 16;
+
+    // 叶节点的最大图元数，图元数不超过该值且不划分更优时生成叶节点
+    int max_leaf_size = 4;
+
+    // SAH中遍历一个内部节点和求交一个图元的相对代价
+    float traversal_cost    = 1;
+    float intersection_cost = 1;
+
+    // 图元数少于该值的子树在单个线程上构建
+    size_t parallel_threshold = 1 << 14;
+};
+
+/**
+ * @brief 32字节的二叉bvh节点，按深度优先顺序展平存储
+ *
+ * 内部节点的第一个子节点紧随其后，第二个子节点的下标为offset；
+ * 叶节点包含图元[offset, offset + primitive_count)
+ */
+struct bvh_node_t
+{
+    float    low[3];
+    uint32_t offset;
+    float    high[3];
+    uint16_t primitive_count;
+    uint8_t  axis;
+    uint8_t  _pad;
+
+    bool is_leaf() const noexcept { return primitive_count != 0; }
+};
+
+static_assert(sizeof(bvh_node_t) == 32);
+
+/**
+ * @brief 由二叉bvh合并得到的4叉节点，包围盒以SoA形式存储以便同时测试4个子节点
+ *
+ * counts[i] > 0时第i个子节点为含counts[i]个三角形的叶节点，三角形依次存放在
+ * 从children[i]开始的(counts[i] + 3) / 4个triangle4_t中；
+ * counts[i] == 0时children[i]为子节点下标，或为EMPTY表示空位
+ */
+struct alignas(16) bvh4_node_t
+{
+    static constexpr uint32_t EMPTY = 0xffffffff;
+
+    aabb4_t bounds;
+
+    uint32_t children[4];
+    uint32_t counts[4];
+};
+
+static_assert(sizeof(bvh4_node_t) == 128);
+
+/**
+ * @brief 射线与三角形的求交方式
+ */
+enum class intersection_mode_t
+{
+    fast,      // Möller–Trumbore
+    watertight // 参见intersect_ray_triangle_watertight
+};
+
+/**
+ * @brief 射线求交的结果
+ */
+struct ray_hit_t
+{
+    // 命中的三角形在构建时传入的三角形数组中的下标
+    uint32_t primitive = 0;
+
+    float t = 0;
+
+    // 交点的重心坐标，参见intersect_ray_triangle
+    float u = 0, v = 0;
+};
+
+/**
+ * @brief 最近点查询的结果
+ */
+struct nearest_point_t
+{
+    uint32_t primitive = 0;
+
+    math::vec3f point;
+
+    float distance_square = 0;
+};
+
+/**
+ * @brief 三角网格上的bvh
+ *
+ * 使用分桶SAH自顶向下构建：图元较多的节点并行地分桶，
+ * 规模小于parallel_threshold的子树作为独立任务在线程组上并行构建。
+ * 构建后同时保存二叉节点和合并得到的4叉节点，查询使用4叉节点，
+ * 叶节点中的三角形以triangle4_t打包，与ray_packet.h中的4路求交函数配合使用
+ */
+class bvh_t
+{
+public:
+
+    bvh_t() = default;
+
+    /**
+     * @brief 在临时创建的线程组上构建
+     *
+     * @param worker_count 线程数，含义同thread::actual_worker_count
+     */
+    void build(
+        const std::vector<mesh::triangle_t> &triangles,
+        const bvh_build_options_t &options = {},
+        int worker_count = 0);
+
+    void build(
+        const std::vector<mesh::triangle_t> &triangles,
+        const bvh_build_options_t &options,
+        thread::thread_group_t &threads,
+        int worker_count = 0);
+
+    void clear() noexcept;
+
+    bool empty() const noexcept;
+
+    size_t primitive_count() const noexcept;
+
+    /**
+     * @brief 所有图元的包围盒
+     */
+    math::aabb3f bounds() const noexcept;
+
+    /**
+     * @brief 展平的二叉节点，下标0为根节点
+     */
+    const std::vector<bvh_node_t> &nodes() const noexcept;
+
+    /**
+     * @brief 4叉节点，下标0为根节点
+     */
+    const std::vector<bvh4_node_t> &wide_nodes() const noexcept;
+
+    /**
+     * @brief 4叉节点的叶节点引用的打包三角形
+     */
+    const std::vector<triangle4_t> &triangle_packs() const noexcept;
+
+    /**
+     * @brief 第i个打包三角形的第j个通道对应的原三角形下标为第4 * i + j个元素，
+     *        空通道为bvh4_node_t::EMPTY
+     */
+    const std::vector<uint32_t> &pack_primitive_indices() const noexcept;
+
+    /**
+     * @brief 二叉节点中的图元下标到原三角形下标的映射
+     */
+    const std::vector<uint32_t> &primitive_indices() const noexcept;
+
+    /**
+     * @brief 求射线与网格的最近交点
+     */
+    bool closest_hit(
+        const ray_t &ray, ray_hit_t &hit,
+        intersection_mode_t mode = intersection_mode_t::fast) const noexcept;
+
+    /**
+     * @brief 射线与网格是否有交点
+     */
+    bool any_hit(
+        const ray_t &ray,
+        intersection_mode_t mode = intersection_mode_t::fast) const noexcept;
+
+    /**
+     * @brief 以射线包的形式同时求4条射线的最近交点
+     *
+     * @return 第i位表示第i条射线有交点，此时结果存放在hits[i]中
+     */
+    int closest_hit4(
+        const ray4_t &rays, ray_hit_t hits[4],
+        intersection_mode_t mode = intersection_mode_t::fast) const noexcept;
+
+    /**
+     * @brief 以射线包的形式同时判断4条射线是否有交点
+     *
+     * @return 第i位表示第i条射线有交点
+     */
+    int any_hit4(
+        const ray4_t &rays,
+        intersection_mode_t mode = intersection_mode_t::fast) const noexcept;
+
+    /**
+     * @brief 将包围盒与box相交的所有三角形的下标追加到output中
+     */
+    void query_aabb(
+        const math::aabb3f &box, std::vector<uint32_t> &output) const;
+
+    std::vector<uint32_t> query_aabb(const math::aabb3f &box) const;
+
+    /**
+     * @brief 查找距离p不超过max_distance的最近点
+     */
+    bool nearest_point(
+        const math::vec3f &p, nearest_point_t &result,
+        float max_distance = std::numeric_limits<float>::infinity()) const noexcept;
+
+private:
+
+    template<bool ANY_HIT, bool WATERTIGHT>
+    bool traverse_ray(const ray_t &ray, ray_hit_t *hit) const noexcept;
+
+    template<bool ANY_HIT, bool WATERTIGHT>
+    int traverse_ray4(const ray4_t &rays, ray_hit_t *hits) const noexcept;
+
+    std::vector<bvh_node_t>  nodes_;
+    std::vector<bvh4_node_t> wide_nodes_;
+
+    std::vector<triangle4_t> packs_;
+    std::vector<uint32_t>    pack_primitive_indices_;
+
+    std::vector<uint32_t> primitive_indices_;
+};
+
+} // namespace agz::geometry
@@ -0,0 +1,255 @@
+﻿#pragma once
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "../math/math.h"
+
+namespace agz::geometry
+{
+
+/**
+ * @brief 射线 o + t * d，t位于[t_min, t_max]中
+ */
+struct ray_t
+{
+    math::vec3f o;
+    math::vec3f d;
+    float t_min = 0;
+    float t_max = std::numeric_limits<float>::infinity();
+
+    ray_t() = default;
+
+    ray_t(
+        const math::vec3f &o, const math::vec3f &d,
+        float t_min = 0,
+        float t_max = std::numeric_limits<float>::infinity()) noexcept
+        : o(o), d(d), t_min(t_min), t_max(t_max)
+    {
+
+    }
+};
+
+/**
+ * @brief 射线与三角形求交（Möller–Trumbore）
+ *
+ * 命中时返回true，并输出射线参数t和重心坐标(u, v)，交点为
+ * (1 - u - v) * a + u * b + v * c
+ */
+inline bool intersect_ray_triangle(
+    const ray_t &r,
+    const math::vec3f &a, const math::vec3f &b, const math::vec3f &c,
+    float &t, float &u, float &v) noexcept
+{
+    const math::vec3f e1 = b - a;
+    const math::vec3f e2 = c - a;
+
+    const math::vec3f p = cross(r.d, e2);
+    const float det = dot(e1, p);
+    if(det == 0)
+        return false;
+    const float inv_det = 1 / det;
+
+    const math::vec3f s = r.o - a;
+    const float bu = dot(s, p) * inv_det;
+    if(bu < 0 || bu > 1)
+        return false;
+
+    const math::vec3f q = cross(s, e1);
+    const float bv = dot(r.d, q) * inv_det;
+    if(bv < 0 || bu + bv > 1)
+        return false;
+
+    const float bt = dot(e2, q) * inv_det;
+    if(bt < r.t_min || bt > r.t_max)
+        return false;
+
+    t = bt;
+    u = bu;
+    v = bv;
+    return true;
+}
+
+/**
+ * @brief 为水密三角形求交预处理的射线
+ *
+ * 参见 Woop et al., Watertight Ray/Triangle Intersection, JCGT 2013
+ */
+struct watertight_ray_t
+{
+    math::vec3f o;
+
+    // 按方向分量绝对值最大的轴kz重排坐标轴
+    int kx = 0, ky = 1, kz = 2;
+
+    // 剪切变换系数
+    float sx = 0, sy = 0, sz = 1;
+
+    float t_min = 0;
+    float t_max = std::numeric_limits<float>::infinity();
+
+    watertight_ray_t() = default;
+
+    explicit watertight_ray_t(const ray_t &r) noexcept
+        : o(r.o), t_min(r.t_min), t_max(r.t_max)
+    {
+        const float abs_x = std::abs(r.d.x);
+        const float abs_y = std::abs(r.d.y);
+        const float abs_z = std::abs(r.d.z);
+        kz = abs_x > abs_y ? (abs_x > abs_z ? 0 : 2) : (abs_y > abs_z ? 1 : 2);
+        kx = kz == 2 ? 0 : kz + 1;
+        ky = kx == 2 ? 0 : kx + 1;
+        if(r.d[kz] < 0)
+            std::swap(kx, ky);
+
+        sx = r.d[kx] / r.d[kz];
+        sy = r.d[ky] / r.d[kz];
+        sz = 1 / r.d[kz];
+    }
+};
+
+/**
+ * @brief 水密的射线与三角形求交
+ *
+ * 射线经过相邻三角形的公共边或顶点时不会从缝隙中漏过。
+ * 边上的重心坐标恰为0时不回退到双精度，因此此时可能同时命中相邻的两个三角形。
+ * 输出的含义同intersect_ray_triangle
+ */
+inline bool intersect_ray_triangle_watertight(
+    const watertight_ray_t &r,
+    const math::vec3f &a, const math::vec3f &b, const math::vec3f &c,
+    float &t, float &u, float &v) noexcept
+{
+    const math::vec3f ra = a - r.o;
+    const math::vec3f rb = b - r.o;
+    const math::vec3f rc = c - r.o;
+
+    const float ax = ra[r.kx] - r.sx * ra[r.kz];
+    const float ay = ra[r.ky] - r.sy * ra[r.kz];
+    const float bx = rb[r.kx] - r.sx * rb[r.kz];
+    const float by = rb[r.ky] - r.sy * rb[r.kz];
+    const float cx = rc[r.kx] - r.sx * rc[r.kz];
+    const float cy = rc[r.ky] - r.sy * rc[r.kz];
+
+    const float eu = cx * by - cy * bx;
+    const float ev = ax * cy - ay * cx;
+    const float ew = bx * ay - by * ax;
+
+    if((eu < 0 || ev < 0 || ew < 0) && (eu > 0 || ev > 0 || ew > 0))
+        return false;
+
+    const float det = eu + ev + ew;
+    if(det == 0)
+        return false;
+
+    const float az = r.sz * ra[r.kz];
+    const float bz = r.sz * rb[r.kz];
+    const float cz = r.sz * rc[r.kz];
+
+    const float inv_det = 1 / det;
+    const float bt = (eu * az + ev * bz + ew * cz) * inv_det;
+    if(!(bt >= r.t_min && bt <= r.t_max))
+        return false;
+
+    t = bt;
+    u = ev * inv_det;
+    v = ew * inv_det;
+    return true;
+}
+
+inline bool intersect_ray_triangle_watertight(
+    const ray_t &r,
+    const math::vec3f &a, const math::vec3f &b, const math::vec3f &c,
+    float &t, float &u, float &v) noexcept
+{
+    return intersect_ray_triangle_watertight(
+        watertight_ray_t(r), a, b, c, t, u, v);
+}
+
+/**
+ * @brief 射线与AABB求交（slab test）
+ *
+ * @param inv_d 射线方向各分量的倒数
+ * @param t_enter 命中时输出进入包围盒时的射线参数
+ */
+inline bool intersect_ray_aabb(
+    const math::vec3f &o, const math::vec3f &inv_d,
+    float t_min, float t_max,
+    const math::aabb3f &box, float &t_enter) noexcept
+{
+    for(int i = 0; i < 3; ++i)
+    {
+        float t0 = (box.low[i]  - o[i]) * inv_d[i];
+        float t1 = (box.high[i] - o[i]) * inv_d[i];
+        if(t0 > t1)
+            std::swap(t0, t1);
+
+        // 写成这种形式以使NaN（0 * inf）不会缩小区间
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+    }
+
+    t_enter = t_min;
+    return t_min <= t_max;
+}
+
+/**
+ * @brief 三角形abc上距离p最近的点
+ *
+ * 参见 Ericson, Real-Time Collision Detection, 5.1.5
+ */
+inline math::vec3f closest_point_on_triangle(
+    const math::vec3f &p,
+    const math::vec3f &a, const math::vec3f &b, const math::vec3f &c) noexcept
+{
+    const math::vec3f ab = b - a, ac = c - a, ap = p - a;
+
+    const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if(d1 <= 0 && d2 <= 0)
+        return a;
+
+    const math::vec3f bp = p - b;
+    const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if(d3 >= 0 && d4 <= d3)
+        return b;
+
+    const float vc = d1 * d4 - d3 * d2;
+    if(vc <= 0 && d1 >= 0 && d3 <= 0)
+        return a + d1 / (d1 - d3) * ab;
+
+    const math::vec3f cp = p - c;
+    const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if(d6 >= 0 && d5 <= d6)
+        return c;
+
+    const float vb = d5 * d2 - d1 * d6;
+    if(vb <= 0 && d2 >= 0 && d6 <= 0)
+        return a + d2 / (d2 - d6) * ac;
+
+    const float va = d3 * d6 - d5 * d4;
+    if(va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+        return b + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b);
+
+    const float denom = 1 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+/**
+ * @brief 点p到AABB的距离的平方，p在盒内时为0
+ */
+inline float distance_square_to_aabb(
+    const math::vec3f &p, const math::aabb3f &box) noexcept
+{
+    float ret = 0;
+    for(int i = 0; i < 3; ++i)
+    {
+        const float lo = box.low[i] - p[i];
+        const float hi = p[i] - box.high[i];
+        const float d = lo > 0 ? lo : (hi > 0 ? hi : 0.0f);
+        ret += d * d;
+    }
+    return ret;
+}
+
+} // namespace agz::geometry
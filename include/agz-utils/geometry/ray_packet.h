@@ -0,0 +1,591 @@
+﻿#pragma once
+
+#include "./ray.h"
+
+#ifdef AGZ_UTILS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace agz::geometry
+{
+
+/**
+ * @brief 以SoA形式存储的4条射线
+ *
+ * 未使用的通道的t_min > t_max，不会与任何物体相交
+ */
+struct alignas(16) ray4_t
+{
+    float o[3][4];
+    float d[3][4];
+    float inv_d[3][4];
+    float t_min[4];
+    float t_max[4];
+
+    ray4_t() noexcept
+    {
+        for(int i = 0; i < 4; ++i)
+            set_inactive(i);
+    }
+
+    ray4_t(const ray_t *rays, int count) noexcept
+    {
+        for(int i = 0; i < 4; ++i)
+        {
+            if(i < count)
+                set(i, rays[i]);
+            else
+                set_inactive(i);
+        }
+    }
+
+    void set(int lane, const ray_t &r) noexcept
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            o[k][lane]     = r.o[k];
+            d[k][lane]     = r.d[k];
+            inv_d[k][lane] = 1 / r.d[k];
+        }
+        t_min[lane] = r.t_min;
+        t_max[lane] = r.t_max;
+    }
+
+    void set_inactive(int lane) noexcept
+    {
+        set(lane, ray_t(
+            math::vec3f(0), math::vec3f(0, 0, 1),
+            std::numeric_limits<float>::infinity(),
+            -std::numeric_limits<float>::infinity()));
+    }
+
+    ray_t get(int lane) const noexcept
+    {
+        return ray_t(
+            { o[0][lane], o[1][lane], o[2][lane] },
+            { d[0][lane], d[1][lane], d[2][lane] },
+            t_min[lane], t_max[lane]);
+    }
+
+    /**
+     * @brief t_min <= t_max的通道
+     */
+    int active_mask() const noexcept
+    {
+        int ret = 0;
+        for(int i = 0; i < 4; ++i)
+        {
+            if(t_min[i] <= t_max[i])
+                ret |= 1 << i;
+        }
+        return ret;
+    }
+};
+
+/**
+ * @brief 为水密求交预处理的4条射线，参见watertight_ray_t
+ */
+struct alignas(16) watertight_ray4_t
+{
+    float o[3][4];
+    float sx[4], sy[4], sz[4];
+    float t_min[4];
+    float t_max[4];
+
+    // 各通道的坐标轴重排，kx_is[a]的第i位表示第i条射线的kx == a
+    int kx_is[2] = { 0, 0 }, ky_is[2] = { 0, 0 }, kz_is[2] = { 0, 0 };
+
+    watertight_ray4_t() noexcept
+        : watertight_ray4_t(ray4_t())
+    {
+
+    }
+
+    explicit watertight_ray4_t(const ray4_t &rays) noexcept
+    {
+        for(int i = 0; i < 4; ++i)
+            set(i, watertight_ray_t(rays.get(i)));
+    }
+
+    void set(int lane, const watertight_ray_t &r) noexcept
+    {
+        for(int k = 0; k < 3; ++k)
+            o[k][lane] = r.o[k];
+        sx[lane] = r.sx;
+        sy[lane] = r.sy;
+        sz[lane] = r.sz;
+        t_min[lane] = r.t_min;
+        t_max[lane] = r.t_max;
+
+        const int bit = 1 << lane;
+        for(int a = 0; a < 2; ++a)
+        {
+            kx_is[a] = r.kx == a ? (kx_is[a] | bit) : (kx_is[a] & ~bit);
+            ky_is[a] = r.ky == a ? (ky_is[a] | bit) : (ky_is[a] & ~bit);
+            kz_is[a] = r.kz == a ? (kz_is[a] | bit) : (kz_is[a] & ~bit);
+        }
+    }
+};
+
+/**
+ * @brief 以SoA形式存储的4个三角形
+ *
+ * 空的通道为退化三角形，不会与任何射线相交
+ */
+struct alignas(16) triangle4_t
+{
+    float a[3][4] = {};
+    float b[3][4] = {};
+    float c[3][4] = {};
+
+    void set(
+        int lane,
+        const math::vec3f &va,
+        const math::vec3f &vb,
+        const math::vec3f &vc) noexcept
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            a[k][lane] = va[k];
+            b[k][lane] = vb[k];
+            c[k][lane] = vc[k];
+        }
+    }
+
+    void set_empty(int lane) noexcept
+    {
+        set(lane, math::vec3f(0), math::vec3f(0), math::vec3f(0));
+    }
+
+    math::vec3f vertex_a(int lane) const noexcept
+    {
+        return { a[0][lane], a[1][lane], a[2][lane] };
+    }
+
+    math::vec3f vertex_b(int lane) const noexcept
+    {
+        return { b[0][lane], b[1][lane], b[2][lane] };
+    }
+
+    math::vec3f vertex_c(int lane) const noexcept
+    {
+        return { c[0][lane], c[1][lane], c[2][lane] };
+    }
+};
+
+/**
+ * @brief 以SoA形式存储的4个AABB
+ *
+ * 空的通道的low为+inf，high为-inf，不会与任何射线或包围盒相交
+ */
+struct alignas(16) aabb4_t
+{
+    float low[3][4];
+    float high[3][4];
+
+    void set(int lane, const math::aabb3f &box) noexcept
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            low[k][lane]  = box.low[k];
+            high[k][lane] = box.high[k];
+        }
+    }
+
+    void set_empty(int lane) noexcept
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            low[k][lane]  =  std::numeric_limits<float>::infinity();
+            high[k][lane] = -std::numeric_limits<float>::infinity();
+        }
+    }
+
+    math::aabb3f get(int lane) const noexcept
+    {
+        return math::aabb3f(
+            { low[0][lane],  low[1][lane],  low[2][lane]  },
+            { high[0][lane], high[1][lane], high[2][lane] });
+    }
+};
+
+static_assert(sizeof(aabb4_t) == 96);
+
+/**
+ * @brief 4个通道的求交结果，只有命中的通道中的值有意义
+ */
+struct alignas(16) hit4_t
+{
+    float t[4];
+    float u[4];
+    float v[4];
+};
+
+namespace ray_packet_impl
+{
+
+#ifdef AGZ_UTILS_SSE
+
+    using f4_t = math::float4;
+
+    struct mask4_t { __m128 m; };
+
+    inline f4_t load(const float *p) noexcept { return f4_t(_mm_load_ps(p)); }
+    inline f4_t splat(float v) noexcept { return f4_t(v); }
+
+    inline void store(float *p, const f4_t &v) noexcept { _mm_storeu_ps(p, v); }
+
+    // 与标量的a < b ? a : b相同，任一操作数为NaN时返回b
+    inline f4_t min4(const f4_t &a, const f4_t &b) noexcept { return f4_t(_mm_min_ps(a, b)); }
+    inline f4_t max4(const f4_t &a, const f4_t &b) noexcept { return f4_t(_mm_max_ps(a, b)); }
+
+    inline mask4_t lt(const f4_t &a, const f4_t &b) noexcept { return { _mm_cmplt_ps (a, b) }; }
+    inline mask4_t le(const f4_t &a, const f4_t &b) noexcept { return { _mm_cmple_ps (a, b) }; }
+    inline mask4_t gt(const f4_t &a, const f4_t &b) noexcept { return { _mm_cmpgt_ps (a, b) }; }
+    inline mask4_t ge(const f4_t &a, const f4_t &b) noexcept { return { _mm_cmpge_ps (a, b) }; }
+    inline mask4_t ne(const f4_t &a, const f4_t &b) noexcept { return { _mm_cmpneq_ps(a, b) }; }
+
+    inline mask4_t operator&(const mask4_t &a, const mask4_t &b) noexcept { return { _mm_and_ps(a.m, b.m) }; }
+    inline mask4_t operator|(const mask4_t &a, const mask4_t &b) noexcept { return { _mm_or_ps (a.m, b.m) }; }
+
+    /**
+     * @brief a & ~b
+     */
+    inline mask4_t and_not(const mask4_t &a, const mask4_t &b) noexcept
+    {
+        return { _mm_andnot_ps(b.m, a.m) };
+    }
+
+    inline mask4_t from_bits(int bits) noexcept
+    {
+        return { _mm_castsi128_ps(_mm_set_epi32(
+            -((bits >> 3) & 1), -((bits >> 2) & 1),
+            -((bits >> 1) & 1), -(bits & 1))) };
+    }
+
+    inline int to_bits(const mask4_t &m) noexcept { return _mm_movemask_ps(m.m); }
+
+    inline f4_t select(const mask4_t &m, const f4_t &a, const f4_t &b) noexcept
+    {
+        return f4_t(_mm_or_ps(_mm_and_ps(m.m, a), _mm_andnot_ps(m.m, b)));
+    }
+
+#else // #ifdef AGZ_UTILS_SSE
+
+    struct f4_t { float v[4]; };
+
+    struct mask4_t { bool b[4]; };
+
+    template<typename Func>
+    f4_t map4(Func &&func) noexcept
+    {
+        return { { func(0), func(1), func(2), func(3) } };
+    }
+
+    template<typename Func>
+    mask4_t test4(Func &&func) noexcept
+    {
+        return { { func(0), func(1), func(2), func(3) } };
+    }
+
+    inline f4_t load(const float *p) noexcept { return { { p[0], p[1], p[2], p[3] } }; }
+    inline f4_t splat(float v) noexcept { return { { v, v, v, v } }; }
+
+    inline void store(float *p, const f4_t &v) noexcept
+    {
+        for(int i = 0; i < 4; ++i)
+            p[i] = v.v[i];
+    }
+
+    inline f4_t operator+(const f4_t &a, const f4_t &b) noexcept { return map4([&](int i) { return a.v[i] + b.v[i]; }); }
+    inline f4_t operator-(const f4_t &a, const f4_t &b) noexcept { return map4([&](int i) { return a.v[i] - b.v[i]; }); }
+    inline f4_t operator*(const f4_t &a, const f4_t &b) noexcept { return map4([&](int i) { return a.v[i] * b.v[i]; }); }
+    inline f4_t operator/(const f4_t &a, const f4_t &b) noexcept { return map4([&](int i) { return a.v[i] / b.v[i]; }); }
+
+    inline f4_t min4(const f4_t &a, const f4_t &b) noexcept { return map4([&](int i) { return a.v[i] < b.v[i] ? a.v[i] : b.v[i]; }); }
+    inline f4_t max4(const f4_t &a, const f4_t &b) noexcept { return map4([&](int i) { return a.v[i] > b.v[i] ? a.v[i] : b.v[i]; }); }
+
+    inline mask4_t lt(const f4_t &a, const f4_t &b) noexcept { return test4([&](int i) { return a.v[i] <  b.v[i]; }); }
+    inline mask4_t le(const f4_t &a, const f4_t &b) noexcept { return test4([&](int i) { return a.v[i] <= b.v[i]; }); }
+    inline mask4_t gt(const f4_t &a, const f4_t &b) noexcept { return test4([&](int i) { return a.v[i] >  b.v[i]; }); }
+    inline mask4_t ge(const f4_t &a, const f4_t &b) noexcept { return test4([&](int i) { return a.v[i] >= b.v[i]; }); }
+    inline mask4_t ne(const f4_t &a, const f4_t &b) noexcept { return test4([&](int i) { return a.v[i] != b.v[i]; }); }
+
+    inline mask4_t operator&(const mask4_t &a, const mask4_t &b) noexcept { return test4([&](int i) { return a.b[i] && b.b[i]; }); }
+    inline mask4_t operator|(const mask4_t &a, const mask4_t &b) noexcept { return test4([&](int i) { return a.b[i] || b.b[i]; }); }
+
+    inline mask4_t and_not(const mask4_t &a, const mask4_t &b) noexcept
+    {
+        return test4([&](int i) { return a.b[i] && !b.b[i]; });
+    }
+
+    inline mask4_t from_bits(int bits) noexcept
+    {
+        return test4([&](int i) { return ((bits >> i) & 1) != 0; });
+    }
+
+    inline int to_bits(const mask4_t &m) noexcept
+    {
+        return int(m.b[0]) | (int(m.b[1]) << 1) | (int(m.b[2]) << 2) | (int(m.b[3]) << 3);
+    }
+
+    inline f4_t select(const mask4_t &m, const f4_t &a, const f4_t &b) noexcept
+    {
+        return map4([&](int i) { return m.b[i] ? a.v[i] : b.v[i]; });
+    }
+
+#endif // #ifdef AGZ_UTILS_SSE
+
+    /**
+     * @brief 逐通道的Möller–Trumbore求交，射线和三角形都可以是广播得到的
+     */
+    inline int moller_trumbore(
+        const f4_t o[3], const f4_t d[3],
+        const f4_t &t_min, const f4_t &t_max,
+        const f4_t a[3], const f4_t b[3], const f4_t c[3],
+        hit4_t &hit) noexcept
+    {
+        const f4_t e1x = b[0] - a[0], e1y = b[1] - a[1], e1z = b[2] - a[2];
+        const f4_t e2x = c[0] - a[0], e2y = c[1] - a[1], e2z = c[2] - a[2];
+
+        const f4_t px = d[1] * e2z - d[2] * e2y;
+        const f4_t py = d[2] * e2x - d[0] * e2z;
+        const f4_t pz = d[0] * e2y - d[1] * e2x;
+
+        const f4_t det = e1x * px + e1y * py + e1z * pz;
+        const f4_t inv_det = splat(1) / det;
+
+        const f4_t sx = o[0] - a[0], sy = o[1] - a[1], sz = o[2] - a[2];
+        const f4_t u = (sx * px + sy * py + sz * pz) * inv_det;
+
+        const f4_t qx = sy * e1z - sz * e1y;
+        const f4_t qy = sz * e1x - sx * e1z;
+        const f4_t qz = sx * e1y - sy * e1x;
+
+        const f4_t v = (d[0] * qx + d[1] * qy + d[2] * qz) * inv_det;
+        const f4_t t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+
+        const f4_t zero = splat(0);
+        const mask4_t valid =
+            ne(det, zero) & ge(u, zero) & ge(v, zero) & le(u + v, splat(1)) &
+            ge(t, t_min) & le(t, t_max);
+
+        store(hit.t, t);
+        store(hit.u, u);
+        store(hit.v, v);
+        return to_bits(valid);
+    }
+
+    /**
+     * @brief 逐通道的水密求交，参见intersect_ray_triangle_watertight
+     *
+     * ra/rb/rc为相对射线起点的三角形顶点，已按射线的(kx, ky, kz)重排坐标轴
+     */
+    inline int watertight(
+        const f4_t ra[3], const f4_t rb[3], const f4_t rc[3],
+        const f4_t &sx, const f4_t &sy, const f4_t &sz,
+        const f4_t &t_min, const f4_t &t_max,
+        hit4_t &hit) noexcept
+    {
+        const f4_t ax = ra[0] - sx * ra[2], ay = ra[1] - sy * ra[2];
+        const f4_t bx = rb[0] - sx * rb[2], by = rb[1] - sy * rb[2];
+        const f4_t cx = rc[0] - sx * rc[2], cy = rc[1] - sy * rc[2];
+
+        const f4_t eu = cx * by - cy * bx;
+        const f4_t ev = ax * cy - ay * cx;
+        const f4_t ew = bx * ay - by * ax;
+
+        const f4_t zero = splat(0);
+        const mask4_t neg = lt(eu, zero) | lt(ev, zero) | lt(ew, zero);
+        const mask4_t pos = gt(eu, zero) | gt(ev, zero) | gt(ew, zero);
+
+        const f4_t det = eu + ev + ew;
+        const f4_t inv_det = splat(1) / det;
+
+        const f4_t t =
+            (eu * (sz * ra[2]) + ev * (sz * rb[2]) + ew * (sz * rc[2])) * inv_det;
+
+        const mask4_t valid = and_not(
+            ne(det, zero) & ge(t, t_min) & le(t, t_max), neg & pos);
+
+        store(hit.t, t);
+        store(hit.u, ev * inv_det);
+        store(hit.v, ew * inv_det);
+        return to_bits(valid);
+    }
+
+    /**
+     * @brief 按各通道的轴编号从x/y/z中选取，is0/is1为编号等于0/1的通道
+     */
+    inline f4_t permute(
+        int is0, int is1, const f4_t &x, const f4_t &y, const f4_t &z) noexcept
+    {
+        return select(from_bits(is0), x, select(from_bits(is1), y, z));
+    }
+
+} // namespace ray_packet_impl
+
+/**
+ * @brief 1条射线与4个三角形求交（Möller–Trumbore）
+ *
+ * @return 第i位表示射线与第i个三角形相交，此时hit中第i个通道存放交点参数
+ */
+inline int intersect_ray_triangle4(
+    const ray_t &r, const triangle4_t &tri, hit4_t &hit) noexcept
+{
+    using namespace ray_packet_impl;
+
+    const f4_t o[3] = { splat(r.o.x), splat(r.o.y), splat(r.o.z) };
+    const f4_t d[3] = { splat(r.d.x), splat(r.d.y), splat(r.d.z) };
+    const f4_t a[3] = { load(tri.a[0]), load(tri.a[1]), load(tri.a[2]) };
+    const f4_t b[3] = { load(tri.b[0]), load(tri.b[1]), load(tri.b[2]) };
+    const f4_t c[3] = { load(tri.c[0]), load(tri.c[1]), load(tri.c[2]) };
+
+    return moller_trumbore(
+        o, d, splat(r.t_min), splat(r.t_max), a, b, c, hit);
+}
+
+/**
+ * @brief 1条射线与4个三角形的水密求交
+ */
+inline int intersect_ray_triangle4_watertight(
+    const watertight_ray_t &r, const triangle4_t &tri, hit4_t &hit) noexcept
+{
+    using namespace ray_packet_impl;
+
+    const int axes[3] = { r.kx, r.ky, r.kz };
+
+    f4_t ra[3], rb[3], rc[3];
+    for(int k = 0; k < 3; ++k)
+    {
+        const f4_t o = splat(r.o[axes[k]]);
+        ra[k] = load(tri.a[axes[k]]) - o;
+        rb[k] = load(tri.b[axes[k]]) - o;
+        rc[k] = load(tri.c[axes[k]]) - o;
+    }
+
+    return watertight(
+        ra, rb, rc, splat(r.sx), splat(r.sy), splat(r.sz),
+        splat(r.t_min), splat(r.t_max), hit);
+}
+
+/**
+ * @brief 4条射线与1个三角形求交（Möller–Trumbore）
+ *
+ * @return 第i位表示第i条射线与三角形相交，此时hit中第i个通道存放交点参数
+ */
+inline int intersect_ray4_triangle(
+    const ray4_t &r,
+    const math::vec3f &va, const math::vec3f &vb, const math::vec3f &vc,
+    hit4_t &hit) noexcept
+{
+    using namespace ray_packet_impl;
+
+    const f4_t o[3] = { load(r.o[0]), load(r.o[1]), load(r.o[2]) };
+    const f4_t d[3] = { load(r.d[0]), load(r.d[1]), load(r.d[2]) };
+    const f4_t a[3] = { splat(va.x), splat(va.y), splat(va.z) };
+    const f4_t b[3] = { splat(vb.x), splat(vb.y), splat(vb.z) };
+    const f4_t c[3] = { splat(vc.x), splat(vc.y), splat(vc.z) };
+
+    return moller_trumbore(
+        o, d, load(r.t_min), load(r.t_max), a, b, c, hit);
+}
+
+/**
+ * @brief 4条射线与1个三角形的水密求交
+ */
+inline int intersect_ray4_triangle_watertight(
+    const watertight_ray4_t &r,
+    const math::vec3f &va, const math::vec3f &vb, const math::vec3f &vc,
+    hit4_t &hit) noexcept
+{
+    using namespace ray_packet_impl;
+
+    f4_t ra[3], rb[3], rc[3];
+    for(int k = 0; k < 3; ++k)
+    {
+        const f4_t o = load(r.o[k]);
+        ra[k] = splat(va[k]) - o;
+        rb[k] = splat(vb[k]) - o;
+        rc[k] = splat(vc[k]) - o;
+    }
+
+    auto permute3 = [&](const f4_t v[3], f4_t out[3])
+    {
+        out[0] = permute(r.kx_is[0], r.kx_is[1], v[0], v[1], v[2]);
+        out[1] = permute(r.ky_is[0], r.ky_is[1], v[0], v[1], v[2]);
+        out[2] = permute(r.kz_is[0], r.kz_is[1], v[0], v[1], v[2]);
+    };
+
+    f4_t pa[3], pb[3], pc[3];
+    permute3(ra, pa);
+    permute3(rb, pb);
+    permute3(rc, pc);
+
+    return watertight(
+        pa, pb, pc, load(r.sx), load(r.sy), load(r.sz),
+        load(r.t_min), load(r.t_max), hit);
+}
+
+/**
+ * @brief 1条射线与4个AABB求交
+ *
+ * @param inv_d 射线方向各分量的倒数
+ * @param t_enter 输出射线进入各包围盒时的参数
+ *
+ * @return 第i位表示射线与第i个包围盒相交
+ */
+inline int intersect_ray_aabb4(
+    const math::vec3f &o, const math::vec3f &inv_d,
+    float t_min, float t_max,
+    const aabb4_t &box, float t_enter[4]) noexcept
+{
+    using namespace ray_packet_impl;
+
+    f4_t enter = splat(t_min);
+    f4_t exit  = splat(t_max);
+
+    for(int k = 0; k < 3; ++k)
+    {
+        const bool neg = inv_d[k] < 0;
+        const f4_t near_plane = load(neg ? box.high[k] : box.low[k]);
+        const f4_t far_plane  = load(neg ? box.low[k] : box.high[k]);
+        const f4_t ok = splat(o[k]), ik = splat(inv_d[k]);
+
+        // NaN（0 * inf）出现在第一个操作数时被忽略
+        enter = max4((near_plane - ok) * ik, enter);
+        exit  = min4((far_plane  - ok) * ik, exit);
+    }
+
+    store(t_enter, enter);
+    return to_bits(le(enter, exit));
+}
+
+/**
+ * @brief 4条射线与1个AABB求交
+ *
+ * @return 第i位表示第i条射线与包围盒相交
+ */
+inline int intersect_ray4_aabb(
+    const ray4_t &r, const math::aabb3f &box, float t_enter[4]) noexcept
+{
+    using namespace ray_packet_impl;
+
+    f4_t enter = load(r.t_min);
+    f4_t exit  = load(r.t_max);
+
+    for(int k = 0; k < 3; ++k)
+    {
+        const f4_t ok = load(r.o[k]), ik = load(r.inv_d[k]);
+        const mask4_t neg = lt(ik, splat(0));
+        const f4_t low = splat(box.low[k]), high = splat(box.high[k]);
+
+        enter = max4((select(neg, high, low) - ok) * ik, enter);
+        exit  = min4((select(neg, low, high) - ok) * ik, exit);
+    }
+
+    store(t_enter, enter);
+    return to_bits(le(enter, exit));
+}
+
+} // namespace agz::geometry
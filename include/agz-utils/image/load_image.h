@@ -3,6 +3,7 @@
 #include <string>
 
 #include <agz-utils/math.h>
+#include <agz-utils/misc/span.h>
 
 namespace agz::img
 {
@@ -61,4 +62,104 @@ math::tensor_t<math::color4b, 2> load_rgba_from_file(
 math::tensor_t<math::color3f, 2> load_rgb_from_hdr_file(
     const std::string &filename);
 
+//==================== 解码到调用者提供的缓冲区 ====================
+
+/**
+ * @brief 图像文件头中的基本信息
+ */
+struct image_info_t
+{
+    int width    = 0;
+    int height   = 0;
+    int channels = 0;
+    bool is_hdr  = false;
+};
+
+/**
+ * @brief 只解析文件头，取得图像的尺寸与通道数，失败时返回false
+ */
+bool query_image_info_from_memory(
+    const void *data, size_t byte_length, image_info_t *info);
+
+/** @brief 只解析文件头，取得图像的尺寸与通道数，失败时返回false */
+bool query_image_info_from_file(
+    const std::string &filename, image_info_t *info);
+
+/**
+ * @brief 解码目标的像素格式
+ */
+enum class pixel_format_t
+{
+    gray8,       // math::byte
+    gray_alpha8, // math::color2b
+    rgb8,        // math::color3b
+    rgba8,       // math::color4b
+    rgb32f       // math::color3f
+};
+
+/** @brief 单个像素的字节数 */
+size_t pixel_size(pixel_format_t format) noexcept;
+
+/**
+ * @brief 目标缓冲区中的图像布局
+ *
+ * 第y行第x个像素位于 y * row_pitch + x * pixel_size(format) 字节处
+ */
+struct image_layout_t
+{
+    pixel_format_t format = pixel_format_t::rgba8;
+    int width  = 0;
+    int height = 0;
+    size_t row_pitch = 0;
+
+    /** @brief 容纳该布局所需的最少字节数 */
+    size_t byte_size() const noexcept;
+};
+
+/**
+ * @brief 构造一个图像布局
+ *
+ * @param row_alignment 行首的对齐字节数，为1时各行紧密排列
+ */
+image_layout_t make_image_layout(
+    pixel_format_t format, int width, int height, size_t row_alignment = 1);
+
+/**
+ * @brief 将图像直接解码到调用者提供的缓冲区中
+ *
+ * 图像尺寸须与layout一致（通常先用query_image_info_from_memory确定），
+ * 通道数按layout.format转换
+ *
+ * @return 图像解码失败或尺寸不符时返回false，此时dst内容未定义
+ *
+ * @exception std::runtime_error dst容纳不下layout时抛出
+ */
+bool decode_into(
+    const void *data, size_t byte_length,
+    misc::span<math::byte> dst, const image_layout_t &layout);
+
+/**
+ * @brief 解码到已有的tensor中，尺寸相同时复用其存储，否则重新分配
+ *
+ * 可配合texture2d_t::get_data()使用。解码失败时返回false，dst保持不变
+ */
+bool decode_into(
+    const void *data, size_t byte_length, math::tensor_t<math::byte, 2> &dst);
+
+bool decode_into(
+    const void *data, size_t byte_length,
+    math::tensor_t<math::color2b, 2> &dst);
+
+bool decode_into(
+    const void *data, size_t byte_length,
+    math::tensor_t<math::color3b, 2> &dst);
+
+bool decode_into(
+    const void *data, size_t byte_length,
+    math::tensor_t<math::color4b, 2> &dst);
+
+bool decode_into(
+    const void *data, size_t byte_length,
+    math::tensor_t<math::color3f, 2> &dst);
+
 } // namespace agz::img
@@ -3,6 +3,8 @@
 #include <type_traits>
 #include <vector>
 
+#include "exec_policy.h"
+
 AGZ_MATH_BEGIN
 
 namespace distribution
@@ -51,10 +53,25 @@ public:
     T sample(F u) const noexcept;
 };
 
+/**
+ * @brief 按执行策略构建prob对应的alias表，以SoA形式写入accept_probs和alias_indices
+ *
+ * 两个输出数组的大小应不小于n，算法参见alias_sampler_t
+ */
+template<typename Policy, typename F, typename T>
+void build_alias_table(
+    const Policy &policy, const F *prob, T n,
+    F *accept_probs, T *alias_indices);
+
 /**
  * @brief 基于Alias Method在常数时间内按离散分布律进行采样
  * 
  * 参见 https://en.wikipedia.org/wiki/Alias_methods
+ *
+ * 表格按SoA形式存储为接受概率和别名下标两个数组，以便sample_n批量查表。
+ * 构建使用Hübschle-Schneider & Sanders的并行sweep方法：
+ * 将表项分为轻（归一化权重不超过1）和重两类后，每个表项的别名和接受概率
+ * 都可以由两类表项的前缀和独立地确定，因此可以分块并行构建，总工作量为O(n)
  */
 template<typename F, typename T = int>
 class alias_sampler_t
@@ -91,11 +108,24 @@ public:
      */
     void initialize(const F *prob, T n);
 
+    /**
+     * @brief 按执行策略构建表格，policy为exec::seq/par/par_unseq
+     */
+    template<typename Policy>
+    void initialize(const Policy &policy, const F *prob, T n);
+
     bool available() const noexcept;
 
     void destroy();
 
-    const std::vector<table_unit> &get_table() const;
+    /**
+     * @brief 以AoS形式返回表格的副本
+     */
+    std::vector<table_unit> get_table() const;
+
+    const std::vector<F> &get_accept_probs() const noexcept;
+
+    const std::vector<T> &get_alias_indices() const noexcept;
 
     /**
      * @brief 以归一化后的prob数组为分布律采样一个1到n-1间的整数
@@ -110,9 +140,23 @@ public:
      */
     T sample(F u1, F u2) const noexcept;
 
+    /**
+     * @brief 对u[0], ..., u[count - 1]分别调用sample(u[i])，结果写入output
+     *
+     * 循环体中没有分支，便于编译器向量化
+     */
+    void sample_n(const F *u, T *output, size_t count) const noexcept;
+
+    /**
+     * @brief 对i = 0, ..., count - 1分别调用sample(u1[i], u2[i])，结果写入output
+     */
+    void sample_n(
+        const F *u1, const F *u2, T *output, size_t count) const noexcept;
+
 private:
 
-    std::vector<table_unit> table_;
+    std::vector<F> accept_probs_;
+    std::vector<T> alias_indices_;
 };
 
 /**
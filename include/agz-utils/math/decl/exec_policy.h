@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <type_traits>
+
+#include "common.h"
+
+namespace agz::thread
+{
+    class thread_group_t;
+}
+
+AGZ_MATH_BEGIN
+
+/**
+ * @brief 张量/纹理上逐元素操作的执行策略
+ */
+namespace exec
+{
+
+/**
+ * @brief 在当前线程上按下标顺序执行
+ */
+struct seq_t { };
+
+/**
+ * @brief 将线性下标空间分块后在多个线程上并行执行
+ *
+ * worker_count的含义同thread::actual_worker_count；
+ * threads非空时在该线程组上执行，否则临时创建线程
+ */
+struct par_t
+{
+    int worker_count = 0;
+    thread::thread_group_t *threads = nullptr;
+};
+
+/**
+ * @brief 同par_t，且允许同一线程上的调用以任意顺序交错执行，
+ *        因此传入的函数中不应有任何同步操作
+ */
+struct par_unseq_t
+{
+    int worker_count = 0;
+    thread::thread_group_t *threads = nullptr;
+};
+
+inline constexpr seq_t       seq;
+inline constexpr par_t       par;
+inline constexpr par_unseq_t par_unseq;
+
+template<typename T>
+constexpr bool is_policy_v =
+    std::is_same_v<rm_rcv_t<T>, seq_t> ||
+    std::is_same_v<rm_rcv_t<T>, par_t> ||
+    std::is_same_v<rm_rcv_t<T>, par_unseq_t>;
+
+} // namespace exec
+
+AGZ_MATH_END
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include "./vec2.h"
 
 AGZ_MATH_BEGIN
@@ -11,6 +14,175 @@ inline float hammersleyRadicalInverse(uint32_t bits) noexcept;
 
 inline vec2f hammersley2D(uint32_t i, uint32_t N) noexcept;
 
+/**
+ * @brief 内置方向数的Sobol维数
+ *
+ * 更高的维度按Burley 2020的方法，以不同种子打乱样本下标后复用这些维度
+ */
+constexpr int SOBOL_DIMENSIONS = 16;
+
+/**
+ * @brief 32位整数的hash，用于由种子派生各维度的扰乱参数
+ */
+inline uint32_t hash_uint32(uint32_t x) noexcept;
+
+inline uint32_t hash_combine(uint32_t seed, uint32_t v) noexcept;
+
+/**
+ * @brief 基于hash的Owen扰乱（Burley, Practical Hash-based Owen Scrambling）
+ *
+ * 是[0, 2^32)上的一个双射，且保持任意以2为底的基本区间的分层性质
+ */
+inline uint32_t owen_scramble(uint32_t x, uint32_t seed) noexcept;
+
+/**
+ * @brief 未扰乱的Sobol序列第index个点的第dim维，以32位定点数表示
+ * @param dim 满足0 <= dim < SOBOL_DIMENSIONS
+ */
+inline uint32_t sobol_uint32(uint32_t index, int dim) noexcept;
+
+/**
+ * @brief Owen扰乱的Sobol序列第index个点的第dim维
+ *
+ * dim可以是任意非负整数；不同的seed给出独立的扰乱，例如可以用像素坐标的hash作为seed。
+ * 对同一seed，任意前2^k个点的每个维度都是分层的
+ */
+inline float sobol_sample(uint32_t index, int dim, uint32_t seed) noexcept;
+
+/**
+ * @brief 批量生成第first_index至first_index + count - 1个点的第dim维
+ */
+inline void sobol_sample_n(
+    uint32_t first_index, size_t count, int dim, uint32_t seed,
+    float *output) noexcept;
+
+/**
+ * @brief 批量生成多个点的第dim维，第i个结果为sobol_sample(indices[i], dim, seeds[i])
+ *
+ * 用于一次填充整个tile，此时indices为各像素的样本编号，seeds为各像素的种子
+ */
+inline void sobol_sample_n(
+    const uint32_t *indices, const uint32_t *seeds, size_t count, int dim,
+    float *output) noexcept;
+
+/**
+ * @brief Halton序列支持的最大维数，即内置素数表的大小
+ */
+constexpr int HALTON_MAX_DIMENSIONS = 1024;
+
+/**
+ * @brief 以第base_index个素数（从0开始计数）为底的radical inverse，不带扰乱
+ * @param base_index 满足0 <= base_index < HALTON_MAX_DIMENSIONS
+ */
+inline float radical_inverse(int base_index, uint64_t a) noexcept;
+
+/**
+ * @brief 带随机数字置换的Halton序列
+ *
+ * 第dim维以第dim个素数为底，各位数字使用独立的随机置换（含前导零位），
+ * 置换表在构造时由种子生成
+ */
+class halton_sampler_t
+{
+public:
+
+    /**
+     * @param dimension_count 维数，不超过HALTON_MAX_DIMENSIONS。
+     *        底数为b的维度的置换表包含ceil(32 / log2(b)) * b个元素
+     *
+     * @exception std::runtime_error dimension_count超出范围
+     */
+    explicit halton_sampler_t(int dimension_count, uint32_t seed = 0);
+
+    int dimension_count() const noexcept;
+
+    /**
+     * @brief 第dim维的底数
+     */
+    uint32_t base(int dim) const noexcept;
+
+    /**
+     * @brief 第index个点的第dim维
+     */
+    float sample(uint32_t index, int dim) const noexcept;
+
+    /**
+     * @brief 批量生成第first_index至first_index + count - 1个点的第dim维
+     */
+    void sample_n(
+        uint32_t first_index, size_t count, int dim, float *output) const noexcept;
+
+private:
+
+    struct dimension_t
+    {
+        uint32_t base;
+        int      digit_count;
+        double   inv_base_n;
+        size_t   perm_offset;
+    };
+
+    std::vector<dimension_t> dims_;
+    std::vector<uint16_t>    perms_;
+};
+
+/**
+ * @brief 点数为N的rank-1格点集，x_i = frac(i * g / N + shift)
+ *
+ * shift为Cranley-Patterson旋转量。在渲染中以蓝噪声纹理中像素对应的值作为shift，
+ * 可以使像素间的积分误差呈蓝噪声分布
+ */
+class rank1_lattice_t
+{
+public:
+
+    /**
+     * @brief 使用给定的生成向量
+     *
+     * @exception std::runtime_error N为0或生成向量为空
+     */
+    rank1_lattice_t(uint32_t N, std::vector<uint32_t> generator);
+
+    /**
+     * @brief 搜索Korobov形式的生成向量(1, a, a^2, ...) mod N，
+     *        使格点间的最小环面距离最大
+     *
+     * 搜索的代价为O(N^2 * dimension_count)，应在初始化时进行并复用结果
+     */
+    static rank1_lattice_t korobov(uint32_t N, int dimension_count);
+
+    uint32_t point_count() const noexcept;
+
+    int dimension_count() const noexcept;
+
+    const std::vector<uint32_t> &generator() const noexcept;
+
+    /**
+     * @brief 第index个点的第dim维，index应小于point_count()
+     */
+    float sample(uint32_t index, int dim, float shift = 0) const noexcept;
+
+    /**
+     * @brief 批量生成第first_index至first_index + count - 1个点的第dim维
+     */
+    void sample_n(
+        uint32_t first_index, size_t count, int dim, float shift,
+        float *output) const noexcept;
+
+    /**
+     * @brief 一次生成整个tile中各像素第index个点的第dim维，
+     *        第i个像素使用shifts[i]作为旋转量
+     */
+    void sample_tile(
+        uint32_t index, int dim, const float *shifts, size_t count,
+        float *output) const noexcept;
+
+private:
+
+    uint32_t N_;
+    std::vector<uint32_t> generator_;
+};
+
 } // namespace lowd
 
 AGZ_MATH_END
@@ -3,6 +3,7 @@
 #include <utility>
 
 #include "common.h"
+#include "exec_policy.h"
 #include "vec.h"
 
 AGZ_MATH_BEGIN
@@ -13,12 +14,19 @@ namespace spherical_harmonics
     /**
      * @brief 支持的最大L值
      */
-    constexpr int L_MAX = 4;
+    constexpr int L_MAX = 8;
+
+    /**
+     * @brief 0至L阶的球谐系数总数
+     */
+    constexpr int coef_count(int L) noexcept { return (L + 1) * (L + 1); }
 
     /**
      * @brief 计算球谐函数值
      * @tparam L 阶，满足0 <= L <= L_MAX
      * @tparam M 阶内编号，满足-L <= M <= L
+     *
+     * L <= 4时使用展开的多项式，更高阶使用关联勒让德多项式的递推式
      */
     template<int L, int M, typename T>
     auto eval(const tvec3<T> &v) noexcept;
@@ -59,6 +67,91 @@ namespace spherical_harmonics
     template<int L, typename T>
     void rotate_sh_coefs(const tmat3_c<T> &rot, T *coefs) noexcept;
 
+    /**
+     * @brief 批量计算count个方向上0至L阶的全部球谐函数值
+     *
+     * 方向以SoA形式给出且应已归一化。结果也以SoA形式存放：
+     * 线性下标为k的球谐函数在第i个方向上的值为output[k * count + i]
+     */
+    template<int L, typename T>
+    void eval_all_n(
+        const T *x, const T *y, const T *z, size_t count, T *output) noexcept;
+
+    /**
+     * @brief 将count个方向上的函数值投影到0至L阶球谐函数上，并累加到coefs中
+     *
+     * coefs[k] += sum_i Y_k(d_i) * values[i]，其中values[i]应已乘以立体角权重。
+     * 方向以SoA形式给出且应已归一化，V可以是T或vec3、color3等
+     */
+    template<int L, typename T, typename V>
+    void accumulate_sh_n(
+        const T *x, const T *y, const T *z, const V *values, size_t count,
+        V *coefs) noexcept;
+
+    /**
+     * @brief 按执行策略将经纬度参数化的环境贴图投影到0至L阶球谐函数上
+     *
+     * texels为按行存储的height * width个纹素。第y行第x列纹素中心对应的方向为
+     * (sin(theta)cos(phi), sin(theta)sin(phi), cos(theta))，
+     * 其中theta = pi * (y + 0.5) / height，phi = 2 * pi * (x + 0.5) / width。
+     * 各行块的部分和按固定的顺序合并，因此结果与执行策略无关
+     *
+     * @param coefs 输出，包含coef_count(L)个系数
+     */
+    template<int L, typename T, typename Policy, typename V>
+    void project_latlong_to_sh(
+        const Policy &policy, const V *texels, int width, int height,
+        V *coefs);
+
+    /**
+     * @brief 由一个旋转矩阵得到的0至max_L阶球谐系数的旋转矩阵
+     *
+     * 使用Ivanic & Ruedenberg的递推式由低阶矩阵逐阶构造，适用于任意阶。
+     * 构造一次后可以用于旋转大量系数组，rotate_n以SoA形式批量处理
+     */
+    template<typename T>
+    class sh_rotation_t
+    {
+    public:
+
+        explicit sh_rotation_t(
+            const tmat3_c<T> &rot, int max_L = L_MAX) noexcept;
+
+        int max_L() const noexcept;
+
+        /**
+         * @brief 第L阶的(2L+1) * (2L+1)旋转矩阵，按行存储
+         */
+        const T *band_matrix(int L) const noexcept;
+
+        /**
+         * @brief 旋转第L阶的2L+1个系数，结果与rotate_sh_coefs<L>相同
+         */
+        void rotate(int L, T *coefs) const noexcept;
+
+        /**
+         * @brief 旋转0至max_L阶的coef_count(max_L)个系数
+         */
+        void rotate_all(T *coefs) const noexcept;
+
+        /**
+         * @brief 旋转count组0至max_L阶系数
+         *
+         * 第i组的线性下标为k的系数为coefs[k * count + i]
+         */
+        void rotate_n(T *coefs, size_t count) const noexcept;
+
+    private:
+
+        static constexpr int matrix_offset(int L) noexcept
+        {
+            return L * (4 * L * L - 1) / 3;
+        }
+
+        int max_L_;
+        T matrices_[matrix_offset(L_MAX + 1)];
+    };
+
 } // namespace spherical_harmonics
 
 AGZ_MATH_END
@@ -1,28 +1,53 @@
 ﻿#pragma once
 
+#include <memory_resource>
+
 #include "../../misc/type_list.h"
 #include "common.h"
+#include "exec_policy.h"
 #include "vec.h"
+#include "tensor_expr.h"
 #include "tensor_view.h"
 
 AGZ_MATH_BEGIN
-    
+
+/**
+ * @brief 行主序连续存储的D维张量
+ *
+ * 元素总数与线性下标为size_t，因此单个维度不超过int的范围即可。
+ * 存储从std::pmr::memory_resource中分配，起始地址按STORAGE_ALIGNMENT对齐；
+ * 未指定memory_resource（或为nullptr）时使用std::pmr::get_default_resource()。
+ * 与std::pmr容器相同，复制构造使用默认资源，移动时资源随存储一起转移，
+ * 复制赋值和assign沿用被赋值张量的资源
+ */
 template<typename P, int D>
 class tensor_t
 {
     P *data_;
 
     vec<int, D> shape_;
-    int elem_count_;
+    size_t elem_count_;
+
+    std::pmr::memory_resource *resource_;
 
     struct from_indexed_func_t { };
     struct from_linear_indexed_func_t { };
 
-    template<typename F>
-    tensor_t(from_indexed_func_t, const vec<int, D> &shape, F &&func);
+    template<typename Policy, typename F>
+    tensor_t(
+        from_indexed_func_t, const Policy &policy,
+        const vec<int, D> &shape, F &&func,
+        std::pmr::memory_resource *resource);
 
-    template<typename F>
-    tensor_t(from_linear_indexed_func_t, const vec<int, D> &shape, F &&func);
+    template<typename Policy, typename F>
+    tensor_t(
+        from_linear_indexed_func_t, const Policy &policy,
+        const vec<int, D> &shape, F &&func,
+        std::pmr::memory_resource *resource);
+
+    P *allocate(size_t elem_count);
+
+    void deallocate(P *data, size_t elem_count) noexcept;
 
     void destruct();
 
@@ -34,9 +59,21 @@ public:
 
     static constexpr int dim_v = D;
 
+    /**
+     * @brief 存储起始地址的对齐字节数，不小于一条cache line
+     */
+    static constexpr size_t STORAGE_ALIGNMENT =
+        alignof(P) > 64 ? alignof(P) : 64;
+
     tensor_t();
-    tensor_t(const index_t &shape, uninitialized_t);
-    explicit tensor_t(const index_t &shape, const P &init_value = P());
+
+    tensor_t(
+        const index_t &shape, uninitialized_t,
+        std::pmr::memory_resource *resource = nullptr);
+
+    explicit tensor_t(
+        const index_t &shape, const P &init_value = P(),
+        std::pmr::memory_resource *resource = nullptr);
 
     template<typename F>
     static self_t from_indexed_fn(const index_t &shape, F &&func);
@@ -44,14 +81,59 @@ public:
     template<typename F>
     static self_t from_linear_indexed_fn(const index_t &shape, F &&func);
 
-    static self_t from_array(const index_t &shape, const P *data);
+    /**
+     * @brief 按执行策略构造，policy为exec::seq/par/par_unseq
+     *
+     * 并行策略下func会在多个线程上被同时调用
+     */
+    template<typename Policy, typename F>
+    static self_t from_indexed_fn(
+        const Policy &policy, const index_t &shape, F &&func,
+        std::pmr::memory_resource *resource = nullptr);
+
+    template<typename Policy, typename F>
+    static self_t from_linear_indexed_fn(
+        const Policy &policy, const index_t &shape, F &&func,
+        std::pmr::memory_resource *resource = nullptr);
+
+    static self_t from_array(
+        const index_t &shape, const P *data,
+        std::pmr::memory_resource *resource = nullptr);
+
+    /**
+     * @brief 在一次遍历中求出表达式的值，参见tensor_expr.h
+     */
+    template<typename E,
+             typename = std::enable_if_t<is_tensor_expr_v<E>>>
+    tensor_t(const E &expr);
 
     tensor_t(const self_t &copy_from);
     tensor_t(self_t &&move_from) noexcept;
 
+    /**
+     * @brief 复制copy_from，存储从resource中分配
+     */
+    tensor_t(const self_t &copy_from, std::pmr::memory_resource *resource);
+
     tensor_t<P, D> &operator=(const self_t &copy_from);
     tensor_t<P, D> &operator=(self_t &&move_from) noexcept;
 
+    /**
+     * @brief 将表达式的值赋给该张量，形状相同时复用已有的存储
+     *
+     * 表达式中可以引用该张量自身
+     */
+    template<typename E,
+             typename = std::enable_if_t<is_tensor_expr_v<E>>>
+    tensor_t<P, D> &operator=(const E &expr);
+
+    /**
+     * @brief 同operator=(const E&)，但在worker_count个线程上并行地求值
+     */
+    template<typename E,
+             typename = std::enable_if_t<is_tensor_expr_v<E>>>
+    tensor_t<P, D> &assign(const E &expr, int worker_count = 1);
+
     ~tensor_t();
 
     void initialize(const index_t &shape, const P &init_value = P());
@@ -62,15 +144,20 @@ public:
 
     const index_t &shape() const noexcept;
 
-    int elem_count() const noexcept;
+    size_t elem_count() const noexcept;
+
+    /**
+     * @brief 分配存储所用的资源
+     */
+    std::pmr::memory_resource *get_memory_resource() const noexcept;
 
     P &at(const index_t &index) noexcept;
 
     const P &at(const index_t &index) const noexcept;
 
-    P &at(int index) noexcept;
+    P &at(size_t index) noexcept;
 
-    const P &at(int index) const noexcept;
+    const P &at(size_t index) const noexcept;
 
     template<typename...Args,
              typename = std::enable_if_t<
@@ -90,6 +177,12 @@ public:
     template<typename F>
     void map_inplace(F &&func) const;
 
+    template<typename Policy, typename F>
+    auto map(const Policy &policy, F &&func) const;
+
+    template<typename Policy, typename F>
+    void map_inplace(const Policy &policy, F &&func) const;
+
           P *raw_data() noexcept;
     const P *raw_data() const noexcept;
 
@@ -121,16 +214,4 @@ bool operator==(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs);
 template<typename P, int D>
 bool operator!=(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs);
 
-template<typename P, int D>
-auto operator+(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs);
-
-template<typename P, int D>
-auto operator-(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs);
-
-template<typename P, int D>
-auto operator*(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs);
-
-template<typename P, int D>
-auto operator/(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs);
-
 AGZ_MATH_END
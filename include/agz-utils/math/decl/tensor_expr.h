@@ -0,0 +1,260 @@
+﻿#pragma once
+
+#include <functional>
+#include <type_traits>
+
+#include "common.h"
+#include "vec.h"
+
+AGZ_MATH_BEGIN
+
+template<typename P, int D>
+class tensor_t;
+
+/**
+ * @brief 所有张量表达式节点的基类，仅用于识别表达式类型
+ */
+struct tensor_expr_tag_t { };
+
+template<typename T>
+constexpr bool is_tensor_expr_v = std::is_base_of_v<tensor_expr_tag_t, T>;
+
+/**
+ * @brief 可以作为张量表达式的操作数的类型
+ *
+ * 特化时value为true，并提供data(const T&)和data(T&&)以取得底层的tensor_t，
+ * 参见texture2d_t和texture3d_t的特化
+ */
+template<typename T>
+struct tensor_operand_traits_t
+{
+    static constexpr bool value = false;
+};
+
+template<typename P, int D>
+struct tensor_operand_traits_t<tensor_t<P, D>>
+{
+    static constexpr bool value = true;
+
+    static const tensor_t<P, D> &data(const tensor_t<P, D> &t) noexcept { return t; }
+    static tensor_t<P, D> &&data(tensor_t<P, D> &&t) noexcept { return std::move(t); }
+};
+
+/**
+ * @brief 引用一个tensor_t的表达式叶节点
+ */
+template<typename P, int D>
+class tensor_ref_expr_t : public tensor_expr_tag_t
+{
+    const P *data_;
+    vec<int, D> shape_;
+
+public:
+
+    using elem_t = P;
+
+    static constexpr int dim_v = D;
+
+    explicit tensor_ref_expr_t(const tensor_t<P, D> &tensor) noexcept;
+
+    const vec<int, D> &shape() const noexcept;
+
+    const P &eval(size_t linear_index) const noexcept;
+};
+
+/**
+ * @brief 持有一个（由右值移动得到的）tensor_t的表达式叶节点
+ */
+template<typename P, int D>
+class tensor_value_expr_t : public tensor_expr_tag_t
+{
+    tensor_t<P, D> data_;
+
+public:
+
+    using elem_t = P;
+
+    static constexpr int dim_v = D;
+
+    explicit tensor_value_expr_t(tensor_t<P, D> &&tensor) noexcept;
+
+    const vec<int, D> &shape() const noexcept;
+
+    const P &eval(size_t linear_index) const noexcept;
+};
+
+/**
+ * @brief 广播到所有元素的标量，dim_v为0表示没有形状
+ */
+template<typename S>
+class tensor_scalar_expr_t : public tensor_expr_tag_t
+{
+    S value_;
+
+public:
+
+    using elem_t = S;
+
+    static constexpr int dim_v = 0;
+
+    explicit tensor_scalar_expr_t(const S &value);
+
+    const S &eval(size_t linear_index) const noexcept;
+};
+
+template<typename E, typename Op>
+class tensor_unary_expr_t : public tensor_expr_tag_t
+{
+    E   opd_;
+    Op  opr_;
+
+public:
+
+    using elem_t = rm_rcv_t<decltype(
+        std::declval<const Op&>()(std::declval<const E&>().eval(0)))>;
+
+    static constexpr int dim_v = E::dim_v;
+
+    static_assert(dim_v > 0, "the operand must be a tensor");
+
+    /**
+     * @exception std::runtime_error 操作数为空张量
+     */
+    tensor_unary_expr_t(E opd, Op opr);
+
+    const vec<int, dim_v> &shape() const noexcept;
+
+    elem_t eval(size_t linear_index) const;
+};
+
+template<typename L, typename R, typename Op>
+class tensor_binary_expr_t : public tensor_expr_tag_t
+{
+    L  lhs_;
+    R  rhs_;
+    Op opr_;
+
+public:
+
+    using elem_t = rm_rcv_t<decltype(std::declval<const Op&>()(
+        std::declval<const L&>().eval(0), std::declval<const R&>().eval(0)))>;
+
+    static constexpr int dim_v = L::dim_v ? L::dim_v : R::dim_v;
+
+    static_assert(dim_v > 0, "at least one operand must be a tensor");
+    static_assert(!L::dim_v || !R::dim_v || L::dim_v == R::dim_v,
+                  "unmatched tensor dimensions in elementwise binary operation");
+
+    /**
+     * @exception std::runtime_error 两个操作数的形状不同或为空张量
+     */
+    tensor_binary_expr_t(L lhs, R rhs, Op opr);
+
+    const vec<int, dim_v> &shape() const noexcept;
+
+    elem_t eval(size_t linear_index) const;
+};
+
+namespace tensor_impl
+{
+
+    template<typename T>
+    constexpr bool is_expr_operand_v =
+        is_tensor_expr_v<rm_rcv_t<T>> ||
+        tensor_operand_traits_t<rm_rcv_t<T>>::value;
+
+    template<typename L, typename R>
+    using enable_if_expr_operands_t = std::enable_if_t<
+        is_expr_operand_v<L> || is_expr_operand_v<R>>;
+
+} // namespace tensor_impl
+
+/**
+ * @brief 将张量、表达式或标量转换为表达式节点
+ *
+ * 左值张量被引用，右值张量被移动到节点中，其他非张量类型被视为标量
+ */
+template<typename T>
+auto to_tensor_expr(T &&operand);
+
+/**
+ * @brief 惰性地对每个元素应用func
+ *
+ * 返回的表达式引用作为左值的operand，operand须在求值前保持有效
+ *
+ * @exception std::runtime_error operand为空张量
+ */
+template<typename T, typename F,
+         typename = std::enable_if_t<tensor_impl::is_expr_operand_v<T>>>
+auto lazy_map(T &&operand, F &&func);
+
+/**
+ * @brief 惰性地对每对元素应用func
+ *
+ * 返回的表达式引用作为左值的操作数，这些操作数须在求值前保持有效
+ *
+ * @exception std::runtime_error 两个操作数的形状不同或为空张量
+ */
+template<typename L, typename R, typename F,
+         typename = tensor_impl::enable_if_expr_operands_t<L, R>>
+auto lazy_elemwise_binary(L &&lhs, R &&rhs, F &&func);
+
+/**
+ * @brief 在worker_count个线程上求出表达式的值
+ *
+ * worker_count的含义同thread::actual_worker_count，为1时在当前线程上求值
+ */
+template<typename E, typename = std::enable_if_t<is_tensor_expr_v<E>>>
+auto evaluate(const E &expr, int worker_count = 1);
+
+/*
+ * 张量（以及特化了tensor_operand_traits_t的纹理等）之间、张量与标量之间的
+ * 逐元素运算返回表达式而非张量。表达式在被赋值给tensor_t/texture2d_t/texture3d_t
+ * 或传给evaluate时在一次遍历中求值，不产生中间结果。
+ *
+ * 表达式以裸指针引用作为左值的操作数的数据，因此不应在这些操作数被销毁或
+ * 改变形状后求值。例如auto c = a + b中的c只是表达式，a或b被销毁后c即悬空；
+ * 需要保存结果时应写为tensor_t<P, D> c = a + b或auto c = evaluate(a + b)。
+ */
+
+/**
+ * @brief 逐元素取负，返回引用左值操作数的惰性表达式
+ *
+ * @exception std::runtime_error 操作数为空张量
+ */
+template<typename E, typename = std::enable_if_t<tensor_impl::is_expr_operand_v<E>>>
+auto operator-(E &&opd);
+
+/**
+ * @brief 逐元素相加，返回引用左值操作数的惰性表达式
+ *
+ * @exception std::runtime_error 两个操作数的形状不同或为空张量
+ */
+template<typename L, typename R, typename = tensor_impl::enable_if_expr_operands_t<L, R>>
+auto operator+(L &&lhs, R &&rhs);
+
+/**
+ * @brief 逐元素相减，返回引用左值操作数的惰性表达式
+ *
+ * @exception std::runtime_error 两个操作数的形状不同或为空张量
+ */
+template<typename L, typename R, typename = tensor_impl::enable_if_expr_operands_t<L, R>>
+auto operator-(L &&lhs, R &&rhs);
+
+/**
+ * @brief 逐元素相乘，返回引用左值操作数的惰性表达式
+ *
+ * @exception std::runtime_error 两个操作数的形状不同或为空张量
+ */
+template<typename L, typename R, typename = tensor_impl::enable_if_expr_operands_t<L, R>>
+auto operator*(L &&lhs, R &&rhs);
+
+/**
+ * @brief 逐元素相除，返回引用左值操作数的惰性表达式
+ *
+ * @exception std::runtime_error 两个操作数的形状不同或为空张量
+ */
+template<typename L, typename R, typename = tensor_impl::enable_if_expr_operands_t<L, R>>
+auto operator/(L &&lhs, R &&rhs);
+
+AGZ_MATH_END
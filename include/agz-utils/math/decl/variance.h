@@ -46,6 +46,36 @@ public:
         }
     }
 
+    /**
+     * @brief merge the sample values accumulated by another computer
+     *
+     * uses the pairwise update of Chan et al., so that partial results
+     * computed on different threads can be combined in any order
+     */
+    void merge(const variance_computer_t &other) noexcept
+    {
+        if(!other.n_)
+            return;
+
+        if(!n_)
+        {
+            *this = other;
+            return;
+        }
+
+        const F na = static_cast<F>(n_);
+        const F nb = static_cast<F>(other.n_);
+        const F n  = na + nb;
+
+        const F delta = other.new_m_ - new_m_;
+        new_m_ = new_m_ + delta * nb / n;
+        new_s_ = new_s_ + other.new_s_ + delta * delta * na * nb / n;
+
+        old_m_ = new_m_;
+        old_s_ = new_s_;
+        n_ += other.n_;
+    }
+
     /**
      * @brief how many sample values are accumulated since last calling of clear
      */
@@ -5,6 +5,8 @@
 #include <cmath>
 #include <numeric>
 
+#include "exec_policy.inl"
+
 AGZ_MATH_BEGIN
 
 namespace distribution
@@ -69,74 +71,252 @@ alias_sampler_t<F, T>::alias_sampler_t(const F *prob, T n)
     this->initialize(prob, n);
 }
 
-template<typename F, typename T>
-void alias_sampler_t<F, T>::initialize(const F *prob, T n)
+namespace alias_impl
+{
+
+    constexpr size_t BLOCK_SIZE = 1 << 16;
+
+    /**
+     * @brief 对[0, count)中每个大小为BLOCK_SIZE的块调用func(block_index, beg, end)，
+     *        块的划分与执行策略无关
+     */
+    template<typename Policy, typename Func>
+    void for_each_block(const Policy &policy, size_t count, Func &&func)
+    {
+        exec_impl::for_each_block(
+            policy, count, BLOCK_SIZE, [&](size_t beg, size_t end)
+        {
+            for(size_t b = beg; b < end; b += BLOCK_SIZE)
+                func(b / BLOCK_SIZE, b, (std::min)(b + BLOCK_SIZE, end));
+        });
+    }
+
+} // namespace alias_impl
+
+template<typename Policy, typename F, typename T>
+void build_alias_table(
+    const Policy &policy, const F *prob, T n,
+    F *accept_probs, T *alias_indices)
 {
-    // https://en.wikipedia.org/wiki/Alias_method
+    // Hübschle-Schneider & Sanders, Parallel Weighted Random Sampling
+    //
+    // 记归一化权重w，轻表项l_0, l_1, ...的亏量前缀和为SL(i) = sum_{k < i} (1 - w(l_k))，
+    // 重表项h_0, h_1, ...的盈余前缀和为SH(j) = sum_{k < j} (w(h_k) - 1)。
+    // 顺序的sweep方法依次用当前重表项填补轻表项，重表项的剩余权重不超过1时
+    // 成为一个表项并由下一个重表项填补。由此可知：
+    //    l_i的别名为满足SH(j + 1) > SL(i)的最小的j对应的h_j
+    //    h_j的接受概率为1 + SH(j + 1) - SL(i*)，其中i*为满足SL(i) >= SH(j + 1)的最小的i，
+    //    别名为h_{j + 1}
+    // 因此在求出前缀和后，每块表项可通过一次二分搜索和一次线性扫描独立确定
 
     assert(n > 0);
 
-    const F sum = std::accumulate(prob, prob + n, F(0));
-    const F ratio = n / sum;
+    const size_t count = static_cast<size_t>(n);
+    const size_t block_count =
+        (count + alias_impl::BLOCK_SIZE - 1) / alias_impl::BLOCK_SIZE;
 
-    std::vector<T> overs;
-    std::vector<T> unders;
+    std::vector<double> block_sums(block_count);
+    alias_impl::for_each_block(policy, count,
+        [&](size_t block, size_t beg, size_t end)
+    {
+        double sum = 0;
+        for(size_t i = beg; i < end; ++i)
+            sum += prob[i];
+        block_sums[block] = sum;
+    });
+
+    const double sum = std::accumulate(
+        block_sums.begin(), block_sums.end(), 0.0);
+    assert(sum > 0);
+    const double ratio = count / sum;
+
+    // 统计每块中的轻/重表项数及其亏量/盈余和
+
+    std::vector<size_t> light_offsets(block_count + 1);
+    std::vector<size_t> heavy_offsets(block_count + 1);
+    std::vector<double> deficit_offsets(block_count + 1);
+    std::vector<double> excess_offsets(block_count + 1);
+
+    alias_impl::for_each_block(policy, count,
+        [&](size_t block, size_t beg, size_t end)
+    {
+        size_t light_count = 0;
+        double deficit = 0, excess = 0;
+        for(size_t i = beg; i < end; ++i)
+        {
+            const double w = prob[i] * ratio;
+            if(w <= 1)
+            {
+                ++light_count;
+                deficit += 1 - w;
+            }
+            else
+                excess += w - 1;
+        }
+        light_offsets[block + 1]   = light_count;
+        heavy_offsets[block + 1]   = (end - beg) - light_count;
+        deficit_offsets[block + 1] = deficit;
+        excess_offsets[block + 1]  = excess;
+    });
+
+    for(size_t b = 0; b < block_count; ++b)
+    {
+        light_offsets[b + 1]   += light_offsets[b];
+        heavy_offsets[b + 1]   += heavy_offsets[b];
+        deficit_offsets[b + 1] += deficit_offsets[b];
+        excess_offsets[b + 1]  += excess_offsets[b];
+    }
 
-    table_.clear();
-    table_.resize(n);
+    const size_t light_count = light_offsets[block_count];
+    const size_t heavy_count = heavy_offsets[block_count];
 
-    for(T i = 0; i < n; ++i)
+    // 按原顺序划分轻/重表项并求前缀和。块内前缀和以与上面相同的顺序累加，
+    // 因此跨块时仍然单调
+
+    std::vector<T>      lights(light_count);
+    std::vector<T>      heavies(heavy_count);
+    std::vector<double> light_prefix(light_count + 1);
+    std::vector<double> heavy_prefix(heavy_count + 1);
+
+    alias_impl::for_each_block(policy, count,
+        [&](size_t block, size_t beg, size_t end)
     {
-        const F p = prob[i] * ratio;
+        size_t li = light_offsets[block], hi = heavy_offsets[block];
+        double deficit = 0, excess = 0;
+        for(size_t i = beg; i < end; ++i)
+        {
+            const double w = prob[i] * ratio;
+            if(w <= 1)
+            {
+                lights[li] = static_cast<T>(i);
+                light_prefix[li++] = deficit_offsets[block] + deficit;
+                deficit += 1 - w;
+            }
+            else
+            {
+                heavies[hi] = static_cast<T>(i);
+                heavy_prefix[hi++] = excess_offsets[block] + excess;
+                excess += w - 1;
+            }
+        }
+    });
 
-        table_[i].accept_prob = p;
-        table_[i].another_idx = i;
+    light_prefix[light_count] = deficit_offsets[block_count];
+    heavy_prefix[heavy_count] = excess_offsets[block_count];
 
-        if(p > 1)
-            overs.push_back(i);
-        else if(p < 1)
-            unders.push_back(i);
-    }
+    // 轻表项
 
-    while(!overs.empty() && !unders.empty())
+    alias_impl::for_each_block(policy, light_count,
+        [&](size_t, size_t beg, size_t end)
     {
-        const T over  = overs.back();
-        const T under = unders.back();
-        overs.pop_back();
-        unders.pop_back();
-
-        table_[over].accept_prob -= 1 - table_[under].accept_prob;
-        table_[under].another_idx = over;
-
-        if(table_[over].accept_prob > 1)
-            overs.push_back(over);
-        else if(table_[over].accept_prob < 1)
-            unders.push_back(over);
-    }
+        size_t j = std::upper_bound(
+            heavy_prefix.begin() + 1, heavy_prefix.end(), light_prefix[beg])
+          - (heavy_prefix.begin() + 1);
+
+        for(size_t i = beg; i < end; ++i)
+        {
+            while(j < heavy_count && heavy_prefix[j + 1] <= light_prefix[i])
+                ++j;
+
+            const T idx = lights[i];
+            if(j < heavy_count)
+            {
+                accept_probs[idx]  = static_cast<F>(prob[idx] * ratio);
+                alias_indices[idx] = heavies[j];
+            }
+            else
+            {
+                // 舍入误差导致重表项已被用完
+                accept_probs[idx]  = 1;
+                alias_indices[idx] = idx;
+            }
+        }
+    });
+
+    // 重表项
+
+    alias_impl::for_each_block(policy, heavy_count,
+        [&](size_t, size_t beg, size_t end)
+    {
+        size_t i = std::lower_bound(
+            light_prefix.begin(), light_prefix.end() - 1, heavy_prefix[beg + 1])
+          - light_prefix.begin();
+
+        for(size_t j = beg; j < end; ++j)
+        {
+            while(i < light_count && light_prefix[i] < heavy_prefix[j + 1])
+                ++i;
+
+            const T idx = heavies[j];
+            if(j + 1 < heavy_count)
+            {
+                const double r = 1 + heavy_prefix[j + 1] - light_prefix[i];
+                accept_probs[idx]  = static_cast<F>(
+                    (std::min)(1.0, (std::max)(0.0, r)));
+                alias_indices[idx] = heavies[j + 1];
+            }
+            else
+            {
+                accept_probs[idx]  = 1;
+                alias_indices[idx] = idx;
+            }
+        }
+    });
+}
+
+template<typename F, typename T>
+void alias_sampler_t<F, T>::initialize(const F *prob, T n)
+{
+    this->initialize(exec::seq, prob, n);
+}
+
+template<typename F, typename T>
+template<typename Policy>
+void alias_sampler_t<F, T>::initialize(
+    const Policy &policy, const F *prob, T n)
+{
+    assert(n > 0);
+
+    accept_probs_.resize(static_cast<size_t>(n));
+    alias_indices_.resize(static_cast<size_t>(n));
 
-    for(auto i : overs)
-        table_[i].accept_prob = 1;
-    for(auto i : unders)
-        table_[i].accept_prob = 1;
+    build_alias_table(
+        policy, prob, n, accept_probs_.data(), alias_indices_.data());
 }
 
 template<typename F, typename T>
 void alias_sampler_t<F, T>::destroy()
 {
-    table_.clear();
+    accept_probs_.clear();
+    alias_indices_.clear();
 }
 
 template<typename F, typename T>
-const std::vector<typename alias_sampler_t<F, T>::table_unit> &
+std::vector<typename alias_sampler_t<F, T>::table_unit>
     alias_sampler_t<F, T>::get_table() const
 {
-    return table_;
+    std::vector<table_unit> ret(accept_probs_.size());
+    for(size_t i = 0; i < ret.size(); ++i)
+        ret[i] = { accept_probs_[i], alias_indices_[i] };
+    return ret;
+}
+
+template<typename F, typename T>
+const std::vector<F> &alias_sampler_t<F, T>::get_accept_probs() const noexcept
+{
+    return accept_probs_;
+}
+
+template<typename F, typename T>
+const std::vector<T> &alias_sampler_t<F, T>::get_alias_indices() const noexcept
+{
+    return alias_indices_;
 }
 
 template<typename F, typename T>
 bool alias_sampler_t<F, T>::available() const noexcept
 {
-    return !table_.empty();
+    return !accept_probs_.empty();
 }
 
 template<typename F, typename T>
@@ -145,15 +325,15 @@ T alias_sampler_t<F, T>::sample(F u) const noexcept
     assert(available());
     assert(0 <= u && u <= 1);
 
-    const T n = static_cast<T>(table_.size());
+    const T n = static_cast<T>(accept_probs_.size());
     const F nu = n * u;
 
     const T i = (std::min)(static_cast<T>(nu), n - 1);
     const F s = nu - i;
 
-    if(s <= table_[i].accept_prob)
+    if(s < accept_probs_[i])
         return i;
-    return table_[i].another_idx;
+    return alias_indices_[i];
 }
 
 template<typename F, typename T>
@@ -163,14 +343,50 @@ T alias_sampler_t<F, T>::sample(F u1, F u2) const noexcept
     assert(0 <= u1 && u1 <= 1);
     assert(0 <= u2 && u2 <= 1);
 
-    const T n = static_cast<T>(table_.size());
+    const T n = static_cast<T>(accept_probs_.size());
     const F nu = n * u1;
 
     const T i = (std::min)(static_cast<T>(nu), n - 1);
 
-    if(u2 <= table_[i].accept_prob)
+    if(u2 < accept_probs_[i])
         return i;
-    return table_[i].another_idx;
+    return alias_indices_[i];
+}
+
+template<typename F, typename T>
+void alias_sampler_t<F, T>::sample_n(
+    const F *u, T *output, size_t count) const noexcept
+{
+    assert(available());
+
+    const F *accept_probs = accept_probs_.data();
+    const T *alias_indices = alias_indices_.data();
+    const T n = static_cast<T>(accept_probs_.size());
+
+    for(size_t k = 0; k < count; ++k)
+    {
+        const F nu = n * u[k];
+        const T i = (std::min)(static_cast<T>(nu), n - 1);
+        const F s = nu - i;
+        output[k] = s < accept_probs[i] ? i : alias_indices[i];
+    }
+}
+
+template<typename F, typename T>
+void alias_sampler_t<F, T>::sample_n(
+    const F *u1, const F *u2, T *output, size_t count) const noexcept
+{
+    assert(available());
+
+    const F *accept_probs = accept_probs_.data();
+    const T *alias_indices = alias_indices_.data();
+    const T n = static_cast<T>(accept_probs_.size());
+
+    for(size_t k = 0; k < count; ++k)
+    {
+        const T i = (std::min)(static_cast<T>(n * u1[k]), n - 1);
+        output[k] = u2[k] < accept_probs[i] ? i : alias_indices[i];
+    }
 }
 
 template<typename F>
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <algorithm>
+
+#include "../../thread/parallel_foreach.h"
+#include "../../thread/parallel_foreach_pooled.h"
+
+AGZ_MATH_BEGIN
+
+namespace exec_impl
+{
+
+    /**
+     * @brief 按执行策略将[0, count)分为大小为block_size的块，对每块调用func(beg, end)
+     *
+     * 顺序执行或只有一块时以func(0, count)调用一次，
+     * 否则每块的beg都是block_size的整数倍
+     */
+    template<typename Policy, typename Func>
+    void for_each_block(
+        const Policy &policy, size_t count, size_t block_size, Func &&func)
+    {
+        static_assert(exec::is_policy_v<Policy>, "invalid execution policy");
+
+        if(!count)
+            return;
+
+        if constexpr(std::is_same_v<Policy, exec::seq_t>)
+        {
+            func(size_t(0), count);
+        }
+        else
+        {
+            if(count <= block_size ||
+               (!policy.threads &&
+                thread::actual_worker_count(policy.worker_count) == 1))
+            {
+                func(size_t(0), count);
+                return;
+            }
+
+            const int block_count = static_cast<int>(
+                (count + block_size - 1) / block_size);
+
+            auto block_func = [&](int, int block)
+            {
+                const size_t beg = block * block_size;
+                func(beg, (std::min)(beg + block_size, count));
+            };
+
+            if(policy.threads)
+            {
+                thread::parallel_forrange(
+                    0, block_count, block_func,
+                    *policy.threads, policy.worker_count);
+            }
+            else
+            {
+                thread::parallel_forrange(
+                    0, block_count, block_func, policy.worker_count);
+            }
+        }
+    }
+
+} // namespace exec_impl
+
+AGZ_MATH_END
@@ -1,5 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
 #include "../decl/vec2.h"
 
 AGZ_MATH_BEGIN
@@ -22,6 +29,448 @@ inline vec2f hammersley2D(uint32_t i, uint32_t N) noexcept
     return vec2f(static_cast<float>(i) / N, hammersleyRadicalInverse(i));
 }
 
+namespace lowd_impl
+{
+
+    constexpr float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+    inline uint32_t reverse_bits(uint32_t bits) noexcept
+    {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return bits;
+    }
+
+    /**
+     * @brief 截断到24位而不是舍入，以免结果越过以2为底的分层边界
+     */
+    inline float to_unit_float(uint32_t bits) noexcept
+    {
+        return static_cast<float>(bits >> 8) * 0x1p-24f;
+    }
+
+    /**
+     * @brief 本原多项式的次数s、系数a以及初始方向数m_1...m_s，
+     *        取自Joe & Kuo, new-joe-kuo-6.21201的前15行
+     */
+    struct sobol_poly_t
+    {
+        uint32_t s;
+        uint32_t a;
+        uint32_t m[6];
+    };
+
+    constexpr sobol_poly_t SOBOL_POLYS[SOBOL_DIMENSIONS - 1] =
+    {
+        { 1, 0,  { 1 } },
+        { 2, 1,  { 1, 3 } },
+        { 3, 1,  { 1, 3, 1 } },
+        { 3, 2,  { 1, 1, 1 } },
+        { 4, 1,  { 1, 1, 3, 3 } },
+        { 4, 4,  { 1, 3, 5, 13 } },
+        { 5, 2,  { 1, 1, 5, 5, 17 } },
+        { 5, 4,  { 1, 1, 5, 5, 5 } },
+        { 5, 7,  { 1, 1, 7, 11, 19 } },
+        { 5, 11, { 1, 1, 5, 1, 1 } },
+        { 5, 13, { 1, 1, 1, 3, 11 } },
+        { 5, 14, { 1, 3, 5, 5, 31 } },
+        { 6, 1,  { 1, 3, 3, 9, 7, 49 } },
+        { 6, 13, { 1, 1, 1, 15, 21, 21 } },
+        { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+    };
+
+    using sobol_matrices_t =
+        std::array<std::array<uint32_t, 32>, SOBOL_DIMENSIONS>;
+
+    /**
+     * @brief 第dim维的第k个方向数为matrices[dim][k]，对应下标的第k位
+     */
+    inline const sobol_matrices_t &sobol_matrices() noexcept
+    {
+        static const sobol_matrices_t matrices = []
+        {
+            sobol_matrices_t ret = {};
+
+            for(int k = 0; k < 32; ++k)
+                ret[0][k] = 1u << (31 - k);
+
+            for(int dim = 1; dim < SOBOL_DIMENSIONS; ++dim)
+            {
+                const auto &poly = SOBOL_POLYS[dim - 1];
+                auto &v = ret[dim];
+
+                for(uint32_t k = 0; k < poly.s; ++k)
+                    v[k] = poly.m[k] << (31 - k);
+
+                for(uint32_t k = poly.s; k < 32; ++k)
+                {
+                    v[k] = v[k - poly.s] ^ (v[k - poly.s] >> poly.s);
+                    for(uint32_t j = 1; j < poly.s; ++j)
+                    {
+                        if((poly.a >> (poly.s - 1 - j)) & 1)
+                            v[k] ^= v[k - j];
+                    }
+                }
+            }
+
+            return ret;
+        }();
+        return matrices;
+    }
+
+    /**
+     * @brief 以不分支的方式计算下标与方向数矩阵之积，便于编译器在批量生成时向量化
+     */
+    inline uint32_t sobol_multiply(
+        const std::array<uint32_t, 32> &v, uint32_t index) noexcept
+    {
+        uint32_t ret = 0;
+        for(int k = 0; k < 32; ++k)
+            ret ^= v[k] & (0u - ((index >> k) & 1u));
+        return ret;
+    }
+
+    inline uint32_t sobol_owen_bits(
+        const sobol_matrices_t &matrices,
+        uint32_t index, int dim, uint32_t seed) noexcept
+    {
+        // 每SOBOL_DIMENSIONS维为一组，组内共享一个打乱后的下标
+
+        const uint32_t group = static_cast<uint32_t>(dim / SOBOL_DIMENSIONS);
+        const uint32_t shuffled = owen_scramble(
+            index, hash_combine(seed, hash_uint32(group)));
+
+        const uint32_t bits = sobol_multiply(
+            matrices[dim % SOBOL_DIMENSIONS], shuffled);
+
+        return owen_scramble(
+            bits, hash_combine(seed, hash_uint32(static_cast<uint32_t>(dim) + 0x9e3779b9u)));
+    }
+
+    inline const std::vector<uint32_t> &prime_table()
+    {
+        static const std::vector<uint32_t> primes = []
+        {
+            std::vector<uint32_t> ret;
+            ret.reserve(HALTON_MAX_DIMENSIONS);
+            for(uint32_t n = 2; ret.size() < HALTON_MAX_DIMENSIONS; ++n)
+            {
+                bool is_prime = true;
+                for(uint32_t p : ret)
+                {
+                    if(p * p > n)
+                        break;
+                    if(n % p == 0)
+                    {
+                        is_prime = false;
+                        break;
+                    }
+                }
+                if(is_prime)
+                    ret.push_back(n);
+            }
+            return ret;
+        }();
+        return primes;
+    }
+
+} // namespace lowd_impl
+
+inline uint32_t hash_uint32(uint32_t x) noexcept
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline uint32_t hash_combine(uint32_t seed, uint32_t v) noexcept
+{
+    return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+inline uint32_t owen_scramble(uint32_t x, uint32_t seed) noexcept
+{
+    // Laine-Karras置换作用于位反转后的值，使高位影响低位而不是反过来
+
+    x = lowd_impl::reverse_bits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return lowd_impl::reverse_bits(x);
+}
+
+inline uint32_t sobol_uint32(uint32_t index, int dim) noexcept
+{
+    return lowd_impl::sobol_multiply(lowd_impl::sobol_matrices()[dim], index);
+}
+
+inline float sobol_sample(uint32_t index, int dim, uint32_t seed) noexcept
+{
+    return lowd_impl::to_unit_float(lowd_impl::sobol_owen_bits(
+        lowd_impl::sobol_matrices(), index, dim, seed));
+}
+
+inline void sobol_sample_n(
+    uint32_t first_index, size_t count, int dim, uint32_t seed,
+    float *output) noexcept
+{
+    const auto &matrices = lowd_impl::sobol_matrices();
+    for(size_t i = 0; i < count; ++i)
+    {
+        const uint32_t index = first_index + static_cast<uint32_t>(i);
+        output[i] = lowd_impl::to_unit_float(
+            lowd_impl::sobol_owen_bits(matrices, index, dim, seed));
+    }
+}
+
+inline void sobol_sample_n(
+    const uint32_t *indices, const uint32_t *seeds, size_t count, int dim,
+    float *output) noexcept
+{
+    const auto &matrices = lowd_impl::sobol_matrices();
+    for(size_t i = 0; i < count; ++i)
+    {
+        output[i] = lowd_impl::to_unit_float(
+            lowd_impl::sobol_owen_bits(matrices, indices[i], dim, seeds[i]));
+    }
+}
+
+inline float radical_inverse(int base_index, uint64_t a) noexcept
+{
+    const uint32_t base = lowd_impl::prime_table()[base_index];
+    const double inv_base = 1.0 / base;
+
+    uint64_t reversed = 0;
+    double inv_base_n = 1;
+    while(a)
+    {
+        const uint64_t next = a / base;
+        reversed = reversed * base + (a - next * base);
+        inv_base_n *= inv_base;
+        a = next;
+    }
+
+    return (std::min)(
+        static_cast<float>(reversed * inv_base_n),
+        lowd_impl::ONE_MINUS_EPSILON);
+}
+
+inline halton_sampler_t::halton_sampler_t(int dimension_count, uint32_t seed)
+{
+    if(dimension_count < 0 || dimension_count > HALTON_MAX_DIMENSIONS)
+        throw std::runtime_error("invalid halton sampler dimension count");
+
+    const auto &primes = lowd_impl::prime_table();
+
+    dims_.reserve(dimension_count);
+    for(int dim = 0; dim < dimension_count; ++dim)
+    {
+        // 位数足以表示任意32位下标
+
+        dimension_t d;
+        d.base        = primes[dim];
+        d.digit_count = 0;
+        d.inv_base_n  = 1;
+        d.perm_offset = perms_.size();
+
+        uint64_t base_n = 1;
+        while(base_n <= 0xffffffffu)
+        {
+            base_n *= d.base;
+            d.inv_base_n /= d.base;
+            ++d.digit_count;
+        }
+
+        // 每一位使用独立的Fisher-Yates置换
+
+        uint32_t state = hash_combine(
+            hash_uint32(seed), hash_uint32(static_cast<uint32_t>(dim)));
+
+        for(int digit = 0; digit < d.digit_count; ++digit)
+        {
+            const size_t beg = perms_.size();
+            for(uint32_t i = 0; i < d.base; ++i)
+                perms_.push_back(static_cast<uint16_t>(i));
+
+            for(uint32_t i = d.base - 1; i > 0; --i)
+            {
+                state = hash_uint32(state + 0x9e3779b9u);
+                const uint32_t j = static_cast<uint32_t>(
+                    (uint64_t(state) * (i + 1)) >> 32);
+                std::swap(perms_[beg + i], perms_[beg + j]);
+            }
+        }
+
+        dims_.push_back(d);
+    }
+}
+
+inline int halton_sampler_t::dimension_count() const noexcept
+{
+    return static_cast<int>(dims_.size());
+}
+
+inline uint32_t halton_sampler_t::base(int dim) const noexcept
+{
+    return dims_[dim].base;
+}
+
+inline float halton_sampler_t::sample(uint32_t index, int dim) const noexcept
+{
+    float ret;
+    sample_n(index, 1, dim, &ret);
+    return ret;
+}
+
+inline void halton_sampler_t::sample_n(
+    uint32_t first_index, size_t count, int dim, float *output) const noexcept
+{
+    const dimension_t &d = dims_[dim];
+    const uint16_t *perm = perms_.data() + d.perm_offset;
+
+    // 每个下标都处理固定的digit_count位（前导零位同样被置换），循环次数与下标无关
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        uint32_t a = first_index + static_cast<uint32_t>(i);
+        uint64_t reversed = 0;
+        for(int digit = 0; digit < d.digit_count; ++digit)
+        {
+            const uint32_t next = a / d.base;
+            const uint32_t value = a - next * d.base;
+            reversed = reversed * d.base + perm[digit * d.base + value];
+            a = next;
+        }
+
+        output[i] = (std::min)(
+            static_cast<float>(reversed * d.inv_base_n),
+            lowd_impl::ONE_MINUS_EPSILON);
+    }
+}
+
+inline rank1_lattice_t::rank1_lattice_t(
+    uint32_t N, std::vector<uint32_t> generator)
+    : N_(N), generator_(std::move(generator))
+{
+    if(!N_ || generator_.empty())
+        throw std::runtime_error("invalid rank-1 lattice parameters");
+
+    for(auto &g : generator_)
+        g %= N_;
+}
+
+inline rank1_lattice_t rank1_lattice_t::korobov(
+    uint32_t N, int dimension_count)
+{
+    if(!N || dimension_count <= 0)
+        throw std::runtime_error("invalid rank-1 lattice parameters");
+
+    auto make_generator = [&](uint32_t a)
+    {
+        std::vector<uint32_t> ret(dimension_count);
+        uint64_t g = 1;
+        for(int j = 0; j < dimension_count; ++j)
+        {
+            ret[j] = static_cast<uint32_t>(g % N);
+            g = g * a % N;
+        }
+        return ret;
+    };
+
+    // 格点集是环面上的格，最小点距即为非零格点到原点的最小距离
+
+    std::vector<uint32_t> best_generator = make_generator(1);
+    double best_dist2 = -1;
+
+    for(uint32_t a = 1; a < N; ++a)
+    {
+        if(std::gcd(a, N) != 1)
+            continue;
+
+        const auto generator = make_generator(a);
+
+        double min_dist2 = std::numeric_limits<double>::max();
+        for(uint32_t i = 1; i < N && min_dist2 > best_dist2; ++i)
+        {
+            double dist2 = 0;
+            for(int j = 0; j < dimension_count; ++j)
+            {
+                const uint64_t r = uint64_t(i) * generator[j] % N;
+                const double d = static_cast<double>(
+                    (std::min)(r, N - r)) / N;
+                dist2 += d * d;
+            }
+            min_dist2 = (std::min)(min_dist2, dist2);
+        }
+
+        if(min_dist2 > best_dist2)
+        {
+            best_dist2 = min_dist2;
+            best_generator = generator;
+        }
+    }
+
+    return rank1_lattice_t(N, std::move(best_generator));
+}
+
+inline uint32_t rank1_lattice_t::point_count() const noexcept
+{
+    return N_;
+}
+
+inline int rank1_lattice_t::dimension_count() const noexcept
+{
+    return static_cast<int>(generator_.size());
+}
+
+inline const std::vector<uint32_t> &rank1_lattice_t::generator() const noexcept
+{
+    return generator_;
+}
+
+inline float rank1_lattice_t::sample(
+    uint32_t index, int dim, float shift) const noexcept
+{
+    float ret;
+    sample_tile(index, dim, &shift, 1, &ret);
+    return ret;
+}
+
+inline void rank1_lattice_t::sample_n(
+    uint32_t first_index, size_t count, int dim, float shift,
+    float *output) const noexcept
+{
+    const uint64_t g = generator_[dim];
+    const double inv_N = 1.0 / N_;
+    for(size_t i = 0; i < count; ++i)
+    {
+        const uint64_t r = (first_index + i) * g % N_;
+        const float x = static_cast<float>(r * inv_N) + shift;
+        output[i] = (std::min)(x - std::floor(x), lowd_impl::ONE_MINUS_EPSILON);
+    }
+}
+
+inline void rank1_lattice_t::sample_tile(
+    uint32_t index, int dim, const float *shifts, size_t count,
+    float *output) const noexcept
+{
+    const uint64_t r = uint64_t(index) * generator_[dim] % N_;
+    const float base = static_cast<float>(static_cast<double>(r) / N_);
+    for(size_t i = 0; i < count; ++i)
+    {
+        const float x = base + shifts[i];
+        output[i] = (std::min)(x - std::floor(x), lowd_impl::ONE_MINUS_EPSILON);
+    }
+}
+
 } // namespace lowd
 
 AGZ_MATH_END
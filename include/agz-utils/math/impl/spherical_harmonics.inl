@@ -1,12 +1,109 @@
 ﻿#pragma once
 
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "exec_policy.inl"
+
 AGZ_MATH_BEGIN
 
 namespace sh_impl
 {
 
+    /**
+     * @brief 各球谐函数的归一化系数，以线性下标索引，M != 0时包含因子sqrt(2)
+     */
+    template<typename T>
+    const T *normalization_table() noexcept
+    {
+        constexpr int L_MAX = spherical_harmonics::L_MAX;
+        static const auto table = []
+        {
+            std::array<T, spherical_harmonics::coef_count(L_MAX)> ret = {};
+            for(int l = 0; l <= L_MAX; ++l)
+            {
+                for(int m = 0; m <= l; ++m)
+                {
+                    // (l - m)! / (l + m)!
+                    double ratio = 1;
+                    for(int k = l - m + 1; k <= l + m; ++k)
+                        ratio /= k;
+
+                    double K = std::sqrt((2 * l + 1) / (4 * PI<double>) * ratio);
+                    if(m)
+                        K *= std::sqrt(2.0);
+
+                    ret[l * (l + 1) + m] = static_cast<T>(K);
+                    ret[l * (l + 1) - m] = static_cast<T>(K);
+                }
+            }
+            return ret;
+        }();
+        return table.data();
+    }
+
+    /**
+     * @brief 用递推式计算单位向量(x, y, z)处的球谐函数值
+     *
+     * 记P_l^m为去掉sin^m(theta)因子、不含Condon-Shortley相位的关联勒让德多项式，
+     * C_m + iS_m = (x + iy)^m，则
+     *    Y_l^m  = K_l^m P_l^m(z) C_m, m > 0
+     *    Y_l^0  = K_l^0 P_l^0(z)
+     *    Y_l^-m = K_l^m P_l^m(z) S_m, m > 0
+     */
+    template<typename T>
+    T eval_recurrence(int l, int m, T x, T y, T z) noexcept
+    {
+        const int am = m < 0 ? -m : m;
+
+        T c = 1, s = 0;
+        for(int k = 0; k < am; ++k)
+        {
+            const T nc = x * c - y * s;
+            s = x * s + y * c;
+            c = nc;
+        }
+
+        // P_m^m = (2m - 1)!!
+        T p = 1;
+        for(int k = 1; k <= am; ++k)
+            p *= 2 * k - 1;
+
+        if(l > am)
+        {
+            T p_prev = p;
+            p = z * (2 * am + 1) * p;
+            for(int k = am + 2; k <= l; ++k)
+            {
+                const T next =
+                    ((2 * k - 1) * z * p - (k + am - 1) * p_prev) / (k - am);
+                p_prev = p;
+                p = next;
+            }
+        }
+
+        const T K = normalization_table<T>()[l * (l + 1) + m];
+        if(m > 0)
+            return K * p * c;
+        if(m < 0)
+            return K * p * s;
+        return K * p;
+    }
+
+    template<typename T, int L, int M>
+    struct sh_expr
+    {
+        static_assert(0 <= L && L <= spherical_harmonics::L_MAX &&
+                      -L <= M && M <= L, "invalid spherical harmonics index");
+
+        static auto eval(const tvec3<T> &v) noexcept
+        {
+            return eval_recurrence<T>(L, M, v.x, v.y, v.z);
+        }
+    };
+
     // see https://en.wikipedia.org/wiki/Table_of_spherical_harmonics
-    template<typename T, int L, int M> struct sh_expr;
 
 #define DEFINE_SH(L, M, COEF, EXPR) \
     template<typename T> \
@@ -55,7 +152,17 @@ namespace sh_impl
 
 #undef DEFINE_SH
 
-    template<typename T, int L> struct rotate_sh_coefs_impl;
+    template<typename T, int L>
+    struct rotate_sh_coefs_impl
+    {
+        static_assert(0 <= L && L <= spherical_harmonics::L_MAX,
+                      "invalid spherical harmonics band");
+
+        static void call(const tmat3_c<T> &rot, T *coefs) noexcept
+        {
+            spherical_harmonics::sh_rotation_t<T>(rot, L).rotate(L, coefs);
+        }
+    };
 
     template<typename T>
     struct rotate_sh_coefs_impl<T, 0>
@@ -230,6 +337,57 @@ namespace sh_impl
         }
     };
 
+    constexpr int index_to_L(int index) noexcept
+    {
+        int L = 0;
+        while((L + 1) * (L + 1) <= index)
+            ++L;
+        return L;
+    }
+
+    template<typename T, int...Is>
+    spherical_harmonics::sh_func_t<T> *make_linear_table(
+        std::integer_sequence<int, Is...>) noexcept
+    {
+        static spherical_harmonics::sh_func_t<T> table[] =
+        {
+            &spherical_harmonics::eval<
+                index_to_L(Is), Is - index_to_L(Is) * (index_to_L(Is) + 1), T>...
+        };
+        return table;
+    }
+
+    /**
+     * @brief 以m, n in [-l, l]访问第l阶旋转矩阵
+     */
+    template<typename T>
+    struct band_matrix_t
+    {
+        T  *data;
+        int l;
+
+        T &operator()(int m, int n) const noexcept
+        {
+            return data[(m + l) * (2 * l + 1) + (n + l)];
+        }
+    };
+
+    // Ivanic & Ruedenberg, Rotation Matrices for Real Spherical Harmonics.
+    // Direct Determination by Recursion（含1998年的勘误）
+    template<typename T>
+    T ivanic_P(
+        int i, int l, int a, int b,
+        const band_matrix_t<T> &R1, const band_matrix_t<T> &prev) noexcept
+    {
+        if(b == l)
+            return R1(i, 1) * prev(a, l - 1) - R1(i, -1) * prev(a, -l + 1);
+        if(b == -l)
+            return R1(i, 1) * prev(a, -l + 1) + R1(i, -1) * prev(a, l - 1);
+        return R1(i, 0) * prev(a, b);
+    }
+
+    constexpr size_t BATCH_CHUNK_SIZE = 64;
+
 } // namespace sh_impl
 
 namespace spherical_harmonics
@@ -257,39 +415,8 @@ namespace spherical_harmonics
     template<typename T>
     sh_func_t<T> *linear_table() noexcept
     {
-        static sh_func_t<T> table[] =
-        {
-            &agz::math::spherical_harmonics::eval<0, 0, T>,
-
-            &agz::math::spherical_harmonics::eval<1, -1, T>,
-            &agz::math::spherical_harmonics::eval<1,  0, T>,
-            &agz::math::spherical_harmonics::eval<1,  1, T>,
-
-            &agz::math::spherical_harmonics::eval<2, -2, T>,
-            &agz::math::spherical_harmonics::eval<2, -1, T>,
-            &agz::math::spherical_harmonics::eval<2,  0, T>,
-            &agz::math::spherical_harmonics::eval<2,  1, T>,
-            &agz::math::spherical_harmonics::eval<2,  2, T>,
-
-            &agz::math::spherical_harmonics::eval<3, -3, T>,
-            &agz::math::spherical_harmonics::eval<3, -2, T>,
-            &agz::math::spherical_harmonics::eval<3, -1, T>,
-            &agz::math::spherical_harmonics::eval<3,  0, T>,
-            &agz::math::spherical_harmonics::eval<3,  1, T>,
-            &agz::math::spherical_harmonics::eval<3,  2, T>,
-            &agz::math::spherical_harmonics::eval<3,  3, T>,
-
-            &agz::math::spherical_harmonics::eval<4, -4, T>,
-            &agz::math::spherical_harmonics::eval<4, -3, T>,
-            &agz::math::spherical_harmonics::eval<4, -2, T>,
-            &agz::math::spherical_harmonics::eval<4, -1, T>,
-            &agz::math::spherical_harmonics::eval<4,  0, T>,
-            &agz::math::spherical_harmonics::eval<4,  1, T>,
-            &agz::math::spherical_harmonics::eval<4,  2, T>,
-            &agz::math::spherical_harmonics::eval<4,  3, T>,
-            &agz::math::spherical_harmonics::eval<4,  4, T>,
-        };
-        return table;
+        return sh_impl::make_linear_table<T>(
+            std::make_integer_sequence<int, coef_count(L_MAX)>());
     }
 
     template<int L, typename T>
@@ -311,6 +438,358 @@ namespace spherical_harmonics
         sh_impl::rotate_sh_coefs_impl<T, L>::call(rot, coefs);
     }
 
+    template<int L, typename T>
+    void eval_all_n(
+        const T *x, const T *y, const T *z, size_t count, T *output) noexcept
+    {
+        static_assert(0 <= L && L <= L_MAX, "invalid spherical harmonics band");
+
+        constexpr size_t CHUNK = sh_impl::BATCH_CHUNK_SIZE;
+        const T *K = sh_impl::normalization_table<T>();
+
+        // 逐块处理，块内以方向为最内层循环，便于编译器向量化
+
+        T c[CHUNK], s[CHUNK], p_prev[CHUNK], p_cur[CHUNK];
+
+        for(size_t beg = 0; beg < count; beg += CHUNK)
+        {
+            const size_t n = (std::min)(CHUNK, count - beg);
+            const T *cx = x + beg, *cy = y + beg, *cz = z + beg;
+            T *out = output + beg;
+
+            auto store = [&](int l, int m, const T *p)
+            {
+                T *pos = out + to_linear_index(l, m) * count;
+                const T k = K[to_linear_index(l, m)];
+                if(!m)
+                {
+                    for(size_t i = 0; i < n; ++i)
+                        pos[i] = k * p[i];
+                    return;
+                }
+
+                T *neg = out + to_linear_index(l, -m) * count;
+                for(size_t i = 0; i < n; ++i)
+                {
+                    pos[i] = k * p[i] * c[i];
+                    neg[i] = k * p[i] * s[i];
+                }
+            };
+
+            for(size_t i = 0; i < n; ++i)
+            {
+                c[i] = 1;
+                s[i] = 0;
+            }
+
+            // P_m^m = (2m - 1)!!
+            T pmm = 1;
+
+            for(int m = 0; m <= L; ++m)
+            {
+                if(m)
+                {
+                    pmm *= 2 * m - 1;
+                    for(size_t i = 0; i < n; ++i)
+                    {
+                        const T nc = cx[i] * c[i] - cy[i] * s[i];
+                        s[i] = cx[i] * s[i] + cy[i] * c[i];
+                        c[i] = nc;
+                    }
+                }
+
+                for(size_t i = 0; i < n; ++i)
+                    p_prev[i] = pmm;
+                store(m, m, p_prev);
+
+                if(m == L)
+                    break;
+
+                const T a = static_cast<T>(2 * m + 1) * pmm;
+                for(size_t i = 0; i < n; ++i)
+                    p_cur[i] = a * cz[i];
+                store(m + 1, m, p_cur);
+
+                for(int l = m + 2; l <= L; ++l)
+                {
+                    const T inv = T(1) / (l - m);
+                    const T a0 = static_cast<T>(2 * l - 1) * inv;
+                    const T a1 = static_cast<T>(l + m - 1) * inv;
+                    for(size_t i = 0; i < n; ++i)
+                    {
+                        const T next = a0 * cz[i] * p_cur[i] - a1 * p_prev[i];
+                        p_prev[i] = p_cur[i];
+                        p_cur[i] = next;
+                    }
+                    store(l, m, p_cur);
+                }
+            }
+        }
+    }
+
+    template<int L, typename T, typename V>
+    void accumulate_sh_n(
+        const T *x, const T *y, const T *z, const V *values, size_t count,
+        V *coefs) noexcept
+    {
+        constexpr size_t CHUNK = sh_impl::BATCH_CHUNK_SIZE;
+        constexpr int K = coef_count(L);
+
+        T basis[K * CHUNK];
+
+        for(size_t beg = 0; beg < count; beg += CHUNK)
+        {
+            const size_t n = (std::min)(CHUNK, count - beg);
+            eval_all_n<L>(x + beg, y + beg, z + beg, n, basis);
+
+            const V *vals = values + beg;
+            for(int k = 0; k < K; ++k)
+            {
+                const T *b = basis + k * n;
+                V acc = V();
+                for(size_t i = 0; i < n; ++i)
+                    acc += vals[i] * b[i];
+                coefs[k] += acc;
+            }
+        }
+    }
+
+    template<int L, typename T, typename Policy, typename V>
+    void project_latlong_to_sh(
+        const Policy &policy, const V *texels, int width, int height,
+        V *coefs)
+    {
+        constexpr int K = coef_count(L);
+
+        for(int k = 0; k < K; ++k)
+            coefs[k] = V();
+        if(width <= 0 || height <= 0)
+            return;
+
+        // 行块的划分与执行策略无关，以保证部分和的合并顺序固定
+
+        const int rows_per_block = (std::max)(1, 16384 / width);
+        const size_t block_count =
+            static_cast<size_t>((height + rows_per_block - 1) / rows_per_block);
+
+        std::vector<T> cos_phi(width), sin_phi(width);
+        for(int i = 0; i < width; ++i)
+        {
+            const double phi = 2 * PI<double> * (i + 0.5) / width;
+            cos_phi[i] = static_cast<T>(std::cos(phi));
+            sin_phi[i] = static_cast<T>(std::sin(phi));
+        }
+
+        std::vector<V> partials(block_count * K, V());
+
+        exec_impl::for_each_block(
+            policy, block_count, 1, [&](size_t block_beg, size_t block_end)
+        {
+            std::vector<T> dx(width), dy(width), dz(width);
+            std::vector<V> weighted(width);
+
+            for(size_t b = block_beg; b < block_end; ++b)
+            {
+                const int row_beg = static_cast<int>(b) * rows_per_block;
+                const int row_end = (std::min)(height, row_beg + rows_per_block);
+
+                for(int r = row_beg; r < row_end; ++r)
+                {
+                    const double theta = PI<double> * (r + 0.5) / height;
+                    const T sin_theta = static_cast<T>(std::sin(theta));
+                    const T cos_theta = static_cast<T>(std::cos(theta));
+
+                    const double theta0 = PI<double> * r / height;
+                    const double theta1 = PI<double> * (r + 1) / height;
+                    const T solid_angle = static_cast<T>(
+                        2 * PI<double> / width *
+                        (std::cos(theta0) - std::cos(theta1)));
+
+                    const V *row = texels + static_cast<size_t>(r) * width;
+                    for(int i = 0; i < width; ++i)
+                    {
+                        dx[i] = sin_theta * cos_phi[i];
+                        dy[i] = sin_theta * sin_phi[i];
+                        dz[i] = cos_theta;
+                        weighted[i] = row[i] * solid_angle;
+                    }
+
+                    accumulate_sh_n<L>(
+                        dx.data(), dy.data(), dz.data(), weighted.data(),
+                        static_cast<size_t>(width), &partials[b * K]);
+                }
+            }
+        });
+
+        for(size_t b = 0; b < block_count; ++b)
+        {
+            for(int k = 0; k < K; ++k)
+                coefs[k] += partials[b * K + k];
+        }
+    }
+
+    template<typename T>
+    sh_rotation_t<T>::sh_rotation_t(const tmat3_c<T> &rot, int max_L) noexcept
+        : max_L_((std::max)(0, (std::min)(max_L, L_MAX)))
+    {
+        matrices_[0] = 1;
+        if(max_L_ < 1)
+            return;
+
+        // 1阶的球谐函数依次正比于y, z, x
+
+        const sh_impl::band_matrix_t<T> R1 = { matrices_ + matrix_offset(1), 1 };
+        constexpr int axis[3] = { 1, 2, 0 };
+        for(int i = -1; i <= 1; ++i)
+        {
+            for(int j = -1; j <= 1; ++j)
+                R1(i, j) = rot(axis[i + 1], axis[j + 1]);
+        }
+
+        for(int l = 2; l <= max_L_; ++l)
+        {
+            const sh_impl::band_matrix_t<T> prev = { matrices_ + matrix_offset(l - 1), l - 1 };
+            const sh_impl::band_matrix_t<T> M    = { matrices_ + matrix_offset(l),     l     };
+
+            auto P = [&](int i, int a, int b)
+            {
+                return sh_impl::ivanic_P(i, l, a, b, R1, prev);
+            };
+
+            for(int m = -l; m <= l; ++m)
+            {
+                const int am = m < 0 ? -m : m;
+                const int d = m == 0;
+
+                for(int n = -l; n <= l; ++n)
+                {
+                    const int an = n < 0 ? -n : n;
+                    const T denom = static_cast<T>(
+                        an < l ? (l + n) * (l - n) : (2 * l) * (2 * l - 1));
+
+                    const T u = std::sqrt((l + m) * (l - m) / denom);
+                    const T v = T(0.5) * (1 - 2 * d) *
+                                std::sqrt((1 + d) * (l + am - 1) * (l + am) / denom);
+                    const T w = T(-0.5) * (1 - d) *
+                                std::sqrt((l - am - 1) * (l - am) / denom);
+
+                    T value = 0;
+
+                    if(u != 0)
+                        value += u * P(0, m, n);
+
+                    if(v != 0)
+                    {
+                        T V_;
+                        if(m == 0)
+                            V_ = P(1, 1, n) + P(-1, -1, n);
+                        else if(m > 0)
+                        {
+                            V_ = m == 1 ? std::sqrt(T(2)) * P(1, 0, n)
+                                        : P(1, m - 1, n) - P(-1, -m + 1, n);
+                        }
+                        else
+                        {
+                            V_ = m == -1 ? std::sqrt(T(2)) * P(-1, 0, n)
+                                         : P(1, m + 1, n) + P(-1, -m - 1, n);
+                        }
+                        value += v * V_;
+                    }
+
+                    if(w != 0)
+                    {
+                        const T W = m > 0 ? P(1, m + 1, n) + P(-1, -m - 1, n)
+                                          : P(1, m - 1, n) - P(-1, -m + 1, n);
+                        value += w * W;
+                    }
+
+                    M(m, n) = value;
+                }
+            }
+        }
+    }
+
+    template<typename T>
+    int sh_rotation_t<T>::max_L() const noexcept
+    {
+        return max_L_;
+    }
+
+    template<typename T>
+    const T *sh_rotation_t<T>::band_matrix(int L) const noexcept
+    {
+        return matrices_ + matrix_offset(L);
+    }
+
+    template<typename T>
+    void sh_rotation_t<T>::rotate(int L, T *coefs) const noexcept
+    {
+        const int size = 2 * L + 1;
+        const T *M = band_matrix(L);
+
+        T result[2 * L_MAX + 1];
+        for(int i = 0; i < size; ++i)
+        {
+            T sum = 0;
+            for(int j = 0; j < size; ++j)
+                sum += M[i * size + j] * coefs[j];
+            result[i] = sum;
+        }
+
+        for(int i = 0; i < size; ++i)
+            coefs[i] = result[i];
+    }
+
+    template<typename T>
+    void sh_rotation_t<T>::rotate_all(T *coefs) const noexcept
+    {
+        for(int L = 1; L <= max_L_; ++L)
+            rotate(L, coefs + L * L);
+    }
+
+    template<typename T>
+    void sh_rotation_t<T>::rotate_n(T *coefs, size_t count) const noexcept
+    {
+        constexpr size_t CHUNK = sh_impl::BATCH_CHUNK_SIZE;
+
+        T result[(2 * L_MAX + 1) * CHUNK];
+
+        for(size_t beg = 0; beg < count; beg += CHUNK)
+        {
+            const size_t n = (std::min)(CHUNK, count - beg);
+
+            for(int L = 1; L <= max_L_; ++L)
+            {
+                const int size = 2 * L + 1;
+                const T *M = band_matrix(L);
+                T *band = coefs + static_cast<size_t>(L * L) * count + beg;
+
+                for(int i = 0; i < size; ++i)
+                {
+                    T *dst = result + i * n;
+                    for(size_t k = 0; k < n; ++k)
+                        dst[k] = 0;
+
+                    for(int j = 0; j < size; ++j)
+                    {
+                        const T mij = M[i * size + j];
+                        const T *src = band + j * count;
+                        for(size_t k = 0; k < n; ++k)
+                            dst[k] += mij * src[k];
+                    }
+                }
+
+                for(int i = 0; i < size; ++i)
+                {
+                    T *dst = band + i * count;
+                    const T *src = result + i * n;
+                    for(size_t k = 0; k < n; ++k)
+                        dst[k] = src[k];
+                }
+            }
+        }
+    }
+
 } // namespace spherical_harmonics
 
 AGZ_MATH_END
@@ -1,10 +1,14 @@
 ﻿#pragma once
 
 #include <cassert>
+#include <limits>
+#include <new>
 #include <utility>
+#include <vector>
 
 #include "../../alloc/alloc.h"
 #include "../../misc/scope_guard.h"
+#include "exec_policy.inl"
 
 AGZ_MATH_BEGIN
 
@@ -26,17 +30,32 @@ namespace tensor_impl
         return ret;
     }
 
+    /**
+     * @brief 以size_t计算元素总数，避免大张量的int乘积溢出
+     */
+    template<int D>
+    size_t elem_count(const tvec<int, D> &shape) noexcept
+    {
+        size_t ret = 1;
+        for(int i = 0; i < D; ++i)
+        {
+            assert(shape[i] >= 0);
+            ret *= static_cast<size_t>(shape[i]);
+        }
+        return ret;
+    }
+
     template<int D>
     struct to_linear_index_aux
     {
-        static int eval(
+        static size_t eval(
             const tvec<int, D> &shape, const tvec<int, D> &index) noexcept
         {
-            int ret = 0, base = 1;
+            size_t ret = 0, base = 1;
             for(int i = D - 1; i >= 0; --i)
             {
-                ret += index[i] * base;
-                base *= shape[i];
+                ret += static_cast<size_t>(index[i]) * base;
+                base *= static_cast<size_t>(shape[i]);
             }
             return ret;
         }
@@ -45,111 +64,235 @@ namespace tensor_impl
     template<>
     struct to_linear_index_aux<1>
     {
-        static int eval(
+        static size_t eval(
             const tvec<int, 1> &, const tvec<int, 1> &index) noexcept
         {
-            return index[0];
+            return static_cast<size_t>(index[0]);
         }
     };
 
     template<>
     struct to_linear_index_aux<2>
     {
-        static int eval(
+        static size_t eval(
             const tvec<int, 2> &shape, const tvec<int, 2> &index) noexcept
         {
-            return index[0] * shape[1] + index[1];
+            return static_cast<size_t>(index[0]) * static_cast<size_t>(shape[1])
+                 + static_cast<size_t>(index[1]);
         }
     };
 
     template<>
     struct to_linear_index_aux<3>
     {
-        static int eval(
+        static size_t eval(
             const tvec<int, 3> &shape, const tvec<int, 3> &index) noexcept
         {
-            const int s2 = shape[2], s1 = shape[1] * shape[2];
-            return index[0] * s1 + index[1] * s2 + index[2];
+            const size_t s2 = static_cast<size_t>(shape[2]);
+            const size_t s1 = static_cast<size_t>(shape[1]) * s2;
+            return static_cast<size_t>(index[0]) * s1
+                 + static_cast<size_t>(index[1]) * s2
+                 + static_cast<size_t>(index[2]);
         }
     };
 
+    template<int D>
+    tvec<int, D> from_linear_index(
+        const tvec<int, D> &shape, size_t linear_index)
+    {
+        tvec<int, D> ret;
+        for(int i = D - 1; i >= 0; --i)
+        {
+            const size_t s = static_cast<size_t>(shape[i]);
+            ret[i] = static_cast<int>(linear_index % s);
+            linear_index /= s;
+        }
+        return ret;
+    }
+
+    constexpr size_t PARALLEL_BLOCK_SIZE = 1 << 14;
+
+    template<typename Policy, typename Func>
+    void for_each_block(const Policy &policy, size_t count, Func &&func)
+    {
+        exec_impl::for_each_block(
+            policy, count, PARALLEL_BLOCK_SIZE, std::forward<Func>(func));
+    }
+
+    /**
+     * @brief 在未初始化的data上按执行策略构造count个元素
+     *
+     * 对每块[beg, end)，make_generator(beg)返回的函数对象被依次调用end - beg次，
+     * 其返回值用于构造data[beg], ..., data[end - 1]。
+     * 任一构造抛出异常时，已构造的元素被析构后异常被重新抛出
+     */
+    template<typename P, typename Policy, typename MakeGenerator>
+    void construct_elements(
+        P *data, const Policy &policy, size_t count,
+        MakeGenerator &&make_generator)
+    {
+        if constexpr(std::is_trivially_destructible_v<P>)
+        {
+            // 无需记录已构造的元素
+            for_each_block(policy, count, [&](size_t beg, size_t end)
+            {
+                auto generator = make_generator(beg);
+                for(size_t i = beg; i < end; ++i)
+                    new(&data[i]) P(generator());
+            });
+        }
+        else
+        {
+            std::vector<size_t> constructed_counts(
+                (count + PARALLEL_BLOCK_SIZE - 1) / PARALLEL_BLOCK_SIZE, 0);
+
+            misc::scope_guard_t guard([&]
+            {
+                for(size_t b = 0; b < constructed_counts.size(); ++b)
+                {
+                    alloc::call_destructor(
+                        data + b * PARALLEL_BLOCK_SIZE, constructed_counts[b]);
+                }
+            });
+
+            for_each_block(policy, count, [&](size_t beg, size_t end)
+            {
+                size_t &constructed =
+                    constructed_counts[beg / PARALLEL_BLOCK_SIZE];
+                auto generator = make_generator(beg);
+                for(size_t i = beg; i < end; ++i, ++constructed)
+                    new(&data[i]) P(generator());
+            });
+
+            guard.dismiss();
+        }
+    }
+
+    /**
+     * @brief 将表达式的值写入已构造的dst中
+     */
+    template<typename P, typename E>
+    void eval_expr_into(
+        P *dst, const E &expr, size_t elem_count, int worker_count)
+    {
+        for_each_block(
+            exec::par_t{ worker_count }, elem_count, [&](size_t beg, size_t end)
+        {
+            for(size_t i = beg; i < end; ++i)
+                dst[i] = expr.eval(i);
+        });
+    }
+
 } // namespace tensor_impl
 
 template<typename P, int D>
-template<typename F>
-tensor_t<P, D>::tensor_t(from_indexed_func_t, const vec<int, D> &shape, F &&func)
-    : data_(nullptr), shape_(shape), elem_count_(shape.product())
+template<typename Policy, typename F>
+tensor_t<P, D>::tensor_t(
+    from_indexed_func_t, const Policy &policy,
+    const vec<int, D> &shape, F &&func,
+    std::pmr::memory_resource *resource)
+    : data_(nullptr), shape_(shape),
+      elem_count_(tensor_impl::elem_count(shape)),
+      resource_(resource ? resource : std::pmr::get_default_resource())
 {
     assert(elem_count_ > 0);
 
-    int constructed_count = 0;
-    P *data = std::allocator<P>().allocate(elem_count_);
+    P *data = allocate(elem_count_);
     misc::scope_guard_t guard([&]
     {
-        alloc::call_destructor(data, constructed_count);
-        std::allocator<P>().deallocate(data, elem_count_);
+        deallocate(data, elem_count_);
     });
 
-    index_t index(0);
-    for(int i = 0; i != elem_count_; ++i, ++constructed_count)
+    tensor_impl::construct_elements(data, policy, elem_count_, [&](size_t beg)
     {
-        const index_t &index_view = index;
-        new(&data[i]) P(func(index_view));
-        index = tensor_impl::next_index(shape, index);
-    }
+        return [&, index = tensor_impl::from_linear_index(shape, beg)]() mutable
+        {
+            const index_t &index_view = index;
+            P ret(func(index_view));
+            index = tensor_impl::next_index(shape, index);
+            return ret;
+        };
+    });
 
     data_ = data;
     guard.dismiss();
 }
 
 template<typename P, int D>
-template<typename F>
+template<typename Policy, typename F>
 tensor_t<P, D>::tensor_t(
-    from_linear_indexed_func_t, const vec<int, D> &shape, F &&func)
-    : data_(nullptr), shape_(shape), elem_count_(shape.product())
+    from_linear_indexed_func_t, const Policy &policy,
+    const vec<int, D> &shape, F &&func,
+    std::pmr::memory_resource *resource)
+    : data_(nullptr), shape_(shape),
+      elem_count_(tensor_impl::elem_count(shape)),
+      resource_(resource ? resource : std::pmr::get_default_resource())
 {
     assert(elem_count_ > 0);
 
-    int constructed_count = 0;
-    P *data = std::allocator<P>().allocate(elem_count_);
+    P *data = allocate(elem_count_);
     misc::scope_guard_t guard([&]
     {
-        alloc::call_destructor(data, constructed_count);
-        std::allocator<P>().deallocate(data, elem_count_);
+        deallocate(data, elem_count_);
     });
 
-    for(int i = 0; i != elem_count_; ++i, ++constructed_count)
-        new(&data[i]) P(func(i));
+    tensor_impl::construct_elements(data, policy, elem_count_, [&](size_t beg)
+    {
+        return [&, i = beg]() mutable { return func(i++); };
+    });
 
     data_ = data;
     guard.dismiss();
 }
 
+template<typename P, int D>
+P *tensor_t<P, D>::allocate(size_t elem_count)
+{
+    if(elem_count > (std::numeric_limits<size_t>::max)() / sizeof(P))
+        throw std::bad_array_new_length();
+    return static_cast<P*>(
+        resource_->allocate(elem_count * sizeof(P), STORAGE_ALIGNMENT));
+}
+
+template<typename P, int D>
+void tensor_t<P, D>::deallocate(P *data, size_t elem_count) noexcept
+{
+    resource_->deallocate(data, elem_count * sizeof(P), STORAGE_ALIGNMENT);
+}
+
 template<typename P, int D>
 void tensor_t<P, D>::destruct()
 {
     assert(data_);
-    for(int i = 0; i < elem_count_; ++i)
+    for(size_t i = 0; i < elem_count_; ++i)
         alloc::call_destructor(data_[i]);
 }
 
 template<typename P, int D>
 tensor_t<P, D>::tensor_t()
-    : data_(nullptr), shape_(0), elem_count_(0)
+    : data_(nullptr), shape_(0), elem_count_(0),
+      resource_(std::pmr::get_default_resource())
 {
 
 }
 
 template<typename P, int D>
-tensor_t<P, D>::tensor_t(const index_t &shape, uninitialized_t)
-    : data_(nullptr), shape_(shape), elem_count_(shape.product())
+tensor_t<P, D>::tensor_t(
+    const index_t &shape, uninitialized_t,
+    std::pmr::memory_resource *resource)
+    : data_(nullptr), shape_(shape),
+      elem_count_(tensor_impl::elem_count(shape)),
+      resource_(resource ? resource : std::pmr::get_default_resource())
 {
-    data_ = std::allocator<P>().allocate(elem_count_);
+    data_ = allocate(elem_count_);
 }
 
 template<typename P, int D>
-tensor_t<P, D>::tensor_t(const index_t &shape, const P &init_value)
-    : tensor_t(from_linear_indexed_func_t{ }, shape, [&](int) { return init_value; })
+tensor_t<P, D>::tensor_t(
+    const index_t &shape, const P &init_value,
+    std::pmr::memory_resource *resource)
+    : tensor_t(from_linear_indexed_func_t{ }, exec::seq, shape,
+               [&](size_t) { return init_value; }, resource)
 {
 
 }
@@ -159,7 +302,9 @@ template<typename F>
 typename tensor_t<P, D>::self_t tensor_t<P, D>::from_indexed_fn(
     const index_t &shape, F &&func)
 {
-    return self_t(from_indexed_func_t{ }, shape, std::forward<F>(func));
+    return self_t(
+        from_indexed_func_t{ }, exec::seq, shape,
+        std::forward<F>(func), nullptr);
 }
 
 template<typename P, int D>
@@ -167,28 +312,69 @@ template<typename F>
 typename tensor_t<P, D>::self_t tensor_t<P, D>::from_linear_indexed_fn(
     const index_t &shape, F &&func)
 {
-    return self_t(from_linear_indexed_func_t{ }, shape, std::forward<F>(func));
+    return self_t(
+        from_linear_indexed_func_t{ }, exec::seq, shape,
+        std::forward<F>(func), nullptr);
+}
+
+template<typename P, int D>
+template<typename Policy, typename F>
+typename tensor_t<P, D>::self_t tensor_t<P, D>::from_indexed_fn(
+    const Policy &policy, const index_t &shape, F &&func,
+    std::pmr::memory_resource *resource)
+{
+    return self_t(
+        from_indexed_func_t{ }, policy, shape,
+        std::forward<F>(func), resource);
+}
+
+template<typename P, int D>
+template<typename Policy, typename F>
+typename tensor_t<P, D>::self_t tensor_t<P, D>::from_linear_indexed_fn(
+    const Policy &policy, const index_t &shape, F &&func,
+    std::pmr::memory_resource *resource)
+{
+    return self_t(
+        from_linear_indexed_func_t{ }, policy, shape,
+        std::forward<F>(func), resource);
 }
 
 template<typename P, int D>
 typename tensor_t<P, D>::self_t tensor_t<P, D>::from_array(
-    const index_t &shape, const P *data)
+    const index_t &shape, const P *data, std::pmr::memory_resource *resource)
 {
-    return from_linear_indexed_fn(shape, [&](int i)
-    {
-        return data[i];
-    });
+    return self_t(from_linear_indexed_func_t{ }, exec::seq, shape,
+                  [&](size_t i) { return data[i]; }, resource);
+}
+
+template<typename P, int D>
+template<typename E, typename>
+tensor_t<P, D>::tensor_t(const E &expr)
+    : tensor_t(from_linear_indexed_func_t{ }, exec::seq, expr.shape(),
+               [&](size_t i) { return expr.eval(i); }, nullptr)
+{
+    static_assert(E::dim_v == D, "unmatched tensor dimensions in assignment");
 }
 
 template<typename P, int D>
 tensor_t<P, D>::tensor_t(const self_t &copy_from)
+    : tensor_t(copy_from, nullptr)
+{
+
+}
+
+template<typename P, int D>
+tensor_t<P, D>::tensor_t(
+    const self_t &copy_from, std::pmr::memory_resource *resource)
     : tensor_t()
 {
     if(copy_from.is_available())
     {
-        *this = tensor_t(from_linear_indexed_func_t{ }, copy_from.shape_,
-            [&](int i) { return copy_from.data_[i]; });
+        *this = tensor_t(from_linear_indexed_func_t{ }, exec::seq, copy_from.shape_,
+            [&](size_t i) { return copy_from.data_[i]; }, resource);
     }
+    else if(resource)
+        resource_ = resource;
 }
 
 template<typename P, int D>
@@ -203,13 +389,13 @@ tensor_t<P, D> &tensor_t<P, D>::operator=(const self_t &copy_from)
 {
     if(shape() != copy_from.shape())
     {
-        self_t t(copy_from);
+        self_t t(copy_from, resource_);
         this->swap(t);
         return *this;
     }
 
     auto *raw = copy_from.raw_data();
-    for(int i = 0; i < elem_count_; ++i)
+    for(size_t i = 0; i < elem_count_; ++i)
         data_[i] = raw[i];
 
     return *this;
@@ -222,6 +408,39 @@ tensor_t<P, D> &tensor_t<P, D>::operator=(self_t &&move_from) noexcept
     return *this;
 }
 
+template<typename P, int D>
+template<typename E, typename>
+tensor_t<P, D> &tensor_t<P, D>::operator=(const E &expr)
+{
+    return assign(expr, 1);
+}
+
+template<typename P, int D>
+template<typename E, typename>
+tensor_t<P, D> &tensor_t<P, D>::assign(const E &expr, int worker_count)
+{
+    static_assert(E::dim_v == D, "unmatched tensor dimensions in assignment");
+
+    if(shape() != expr.shape())
+    {
+        // 表达式不会引用形状不同的自身，因此可以直接替换存储
+        if constexpr(std::is_trivially_copyable_v<P> &&
+                     std::is_trivially_destructible_v<P>)
+        {
+            self_t t(expr.shape(), UNINIT, resource_);
+            swap(t);
+        }
+        else
+        {
+            self_t t(expr.shape(), P(), resource_);
+            swap(t);
+        }
+    }
+
+    tensor_impl::eval_expr_into(data_, expr, elem_count_, worker_count);
+    return *this;
+}
+
 template<typename P, int D>
 tensor_t<P, D>::~tensor_t()
 {
@@ -231,7 +450,7 @@ tensor_t<P, D>::~tensor_t()
 template<typename P, int D>
 void tensor_t<P, D>::initialize(const index_t &shape, const P &init_value)
 {
-    self_t t(shape, init_value);
+    self_t t(shape, init_value, resource_);
     swap(t);
 }
 
@@ -249,7 +468,7 @@ void tensor_t<P, D>::destroy()
         assert(elem_count_ > 0);
 
         this->destruct();
-        std::allocator<P>().deallocate(data_, elem_count_);
+        deallocate(data_, elem_count_);
         data_ = nullptr;
     }
     shape_ = index_t(0);
@@ -263,16 +482,22 @@ const typename tensor_t<P, D>::index_t& tensor_t<P, D>::shape() const noexcept
 }
 
 template<typename P, int D>
-int tensor_t<P, D>::elem_count() const noexcept
+size_t tensor_t<P, D>::elem_count() const noexcept
 {
     return elem_count_;
 }
 
+template<typename P, int D>
+std::pmr::memory_resource *tensor_t<P, D>::get_memory_resource() const noexcept
+{
+    return resource_;
+}
+
 template<typename P, int D>
 P &tensor_t<P, D>::at(const index_t &index) noexcept
 {
     assert(is_available());
-    const int linear_index = tensor_impl::
+    const size_t linear_index = tensor_impl::
             to_linear_index_aux<D>::eval(shape_, index);
     assert(linear_index < elem_count_);
     return data_[linear_index];
@@ -282,7 +507,7 @@ template<typename P, int D>
 const P &tensor_t<P, D>::at(const index_t &index) const noexcept
 {
     assert(is_available());
-    const int linear_index = tensor_impl::
+    const size_t linear_index = tensor_impl::
             to_linear_index_aux<D>::eval(shape_, index);
     assert(linear_index < elem_count_);
     return data_[linear_index];
@@ -292,25 +517,25 @@ template<typename P, int D>
 template<typename...Args, typename>
 P &tensor_t<P, D>::operator()(Args...indices) noexcept
 {
-    return at({ int(indices)... });
+    return at(index_t{ int(indices)... });
 }
 
 template<typename P, int D>
 template<typename...Args, typename>
 const P &tensor_t<P, D>::operator()(Args...indices) const noexcept
 {
-    return at({ int(indices)... });
+    return at(index_t{ int(indices)... });
 }
 
 template<typename P, int D>
-P &tensor_t<P, D>::at(int index) noexcept
+P &tensor_t<P, D>::at(size_t index) noexcept
 {
     assert(is_available() && index < elem_count_);
     return data_[index];
 }
 
 template<typename P, int D>
-const P &tensor_t<P, D>::at(int index) const noexcept
+const P &tensor_t<P, D>::at(size_t index) const noexcept
 {
     assert(is_available() && index < elem_count_);
     return data_[index];
@@ -322,6 +547,7 @@ void tensor_t<P, D>::swap(self_t &swap_with) noexcept
     std::swap(data_, swap_with.data_);
     std::swap(shape_, swap_with.shape_);
     std::swap(elem_count_, swap_with.elem_count_);
+    std::swap(resource_, swap_with.resource_);
 }
 
 template<typename P, int D>
@@ -334,7 +560,7 @@ auto tensor_t<P, D>::map(F &&func) const
         return tensor_t<ret_pixel_t, D>();
 
     return tensor_t<ret_pixel_t, D>::from_linear_indexed_fn(
-        shape_, [&](int i)
+        shape_, [&](size_t i)
     {
         return func(data_[i]);
     });
@@ -347,10 +573,40 @@ void tensor_t<P, D>::map_inplace(F &&func) const
     if(!is_available())
         return;
 
-    for(int i = 0; i < elem_count_; ++i)
+    for(size_t i = 0; i < elem_count_; ++i)
         func(data_[i]);
 }
 
+template<typename P, int D>
+template<typename Policy, typename F>
+auto tensor_t<P, D>::map(const Policy &policy, F &&func) const
+{
+    using ret_pixel_t = rm_rcv_t<decltype(func(data_[0]))>;
+
+    if(!is_available())
+        return tensor_t<ret_pixel_t, D>();
+
+    return tensor_t<ret_pixel_t, D>::from_linear_indexed_fn(
+        policy, shape_, [&](size_t i)
+    {
+        return func(data_[i]);
+    });
+}
+
+template<typename P, int D>
+template<typename Policy, typename F>
+void tensor_t<P, D>::map_inplace(const Policy &policy, F &&func) const
+{
+    if(!is_available())
+        return;
+
+    tensor_impl::for_each_block(policy, elem_count_, [&](size_t beg, size_t end)
+    {
+        for(size_t i = beg; i < end; ++i)
+            func(data_[i]);
+    });
+}
+
 template<typename P, int D>
 P *tensor_t<P, D>::raw_data() noexcept
 {
@@ -409,7 +665,7 @@ auto elemwise_binary(
     using ret_pixel_t = rm_rcv_t<decltype(
         opr(std::declval<const P&>(), std::declval<const P&>()))>;
     return tensor_t<ret_pixel_t, D>::from_linear_indexed_fn(lhs.shape(),
-        [&](int i)
+        [&](size_t i)
     {
         return opr(lhs.at(i), rhs.at(i));
     });
@@ -424,7 +680,7 @@ bool operator==(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs)
             "invalid/unmatched tensor size in elementwise binary operation");
     }
 
-    for(int i = 0; i != lhs.elem_count(); ++i)
+    for(size_t i = 0; i != lhs.elem_count(); ++i)
     {
         if(lhs.at(i) != rhs.at(i))
             return false;
@@ -442,7 +698,7 @@ bool operator!=(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs)
             "invalid/unmatched tensor size in elementwise binary operation");
     }
 
-    for(int i = 0; i != lhs.elem_count(); ++i)
+    for(size_t i = 0; i != lhs.elem_count(); ++i)
     {
         if(lhs.at(i) != rhs.at(i))
             return true;
@@ -451,28 +707,4 @@ bool operator!=(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs)
     return false;
 }
 
-template<typename P, int D>
-auto operator+(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs)
-{
-    return elemwise_binary(lhs, rhs, std::plus<P>());
-}
-
-template<typename P, int D>
-auto operator-(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs)
-{
-    return elemwise_binary(lhs, rhs, std::minus<P>());
-}
-
-template<typename P, int D>
-auto operator*(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs)
-{
-    return elemwise_binary(lhs, rhs, std::multiplies<P>());
-}
-
-template<typename P, int D>
-auto operator/(const tensor_t<P, D> &lhs, const tensor_t<P, D> &rhs)
-{
-    return elemwise_binary(lhs, rhs, std::divides<P>());
-}
-
 AGZ_MATH_END
@@ -0,0 +1,218 @@
+﻿#pragma once
+
+#include <stdexcept>
+
+AGZ_MATH_BEGIN
+
+template<typename P, int D>
+tensor_ref_expr_t<P, D>::tensor_ref_expr_t(const tensor_t<P, D> &tensor) noexcept
+    : data_(tensor.raw_data()), shape_(tensor.shape())
+{
+
+}
+
+template<typename P, int D>
+const vec<int, D> &tensor_ref_expr_t<P, D>::shape() const noexcept
+{
+    return shape_;
+}
+
+template<typename P, int D>
+const P &tensor_ref_expr_t<P, D>::eval(size_t linear_index) const noexcept
+{
+    return data_[linear_index];
+}
+
+template<typename P, int D>
+tensor_value_expr_t<P, D>::tensor_value_expr_t(tensor_t<P, D> &&tensor) noexcept
+    : data_(std::move(tensor))
+{
+
+}
+
+template<typename P, int D>
+const vec<int, D> &tensor_value_expr_t<P, D>::shape() const noexcept
+{
+    return data_.shape();
+}
+
+template<typename P, int D>
+const P &tensor_value_expr_t<P, D>::eval(size_t linear_index) const noexcept
+{
+    return data_.raw_data()[linear_index];
+}
+
+template<typename S>
+tensor_scalar_expr_t<S>::tensor_scalar_expr_t(const S &value)
+    : value_(value)
+{
+
+}
+
+template<typename S>
+const S &tensor_scalar_expr_t<S>::eval(size_t) const noexcept
+{
+    return value_;
+}
+
+template<typename E, typename Op>
+tensor_unary_expr_t<E, Op>::tensor_unary_expr_t(E opd, Op opr)
+    : opd_(std::move(opd)), opr_(std::move(opr))
+{
+    if(shape().product() <= 0)
+    {
+        throw std::runtime_error(
+            "invalid tensor size in elementwise unary operation");
+    }
+}
+
+template<typename E, typename Op>
+const vec<int, tensor_unary_expr_t<E, Op>::dim_v> &
+    tensor_unary_expr_t<E, Op>::shape() const noexcept
+{
+    return opd_.shape();
+}
+
+template<typename E, typename Op>
+typename tensor_unary_expr_t<E, Op>::elem_t
+    tensor_unary_expr_t<E, Op>::eval(size_t linear_index) const
+{
+    return opr_(opd_.eval(linear_index));
+}
+
+template<typename L, typename R, typename Op>
+tensor_binary_expr_t<L, R, Op>::tensor_binary_expr_t(L lhs, R rhs, Op opr)
+    : lhs_(std::move(lhs)), rhs_(std::move(rhs)), opr_(std::move(opr))
+{
+    bool valid = shape().product() > 0;
+    if constexpr(L::dim_v != 0 && R::dim_v != 0)
+        valid &= lhs_.shape() == rhs_.shape();
+
+    if(!valid)
+    {
+        throw std::runtime_error(
+            "invalid/unmatched tensor size in elementwise binary operation");
+    }
+}
+
+template<typename L, typename R, typename Op>
+const vec<int, tensor_binary_expr_t<L, R, Op>::dim_v> &
+    tensor_binary_expr_t<L, R, Op>::shape() const noexcept
+{
+    if constexpr(L::dim_v != 0)
+        return lhs_.shape();
+    else
+        return rhs_.shape();
+}
+
+template<typename L, typename R, typename Op>
+typename tensor_binary_expr_t<L, R, Op>::elem_t
+    tensor_binary_expr_t<L, R, Op>::eval(size_t linear_index) const
+{
+    return opr_(lhs_.eval(linear_index), rhs_.eval(linear_index));
+}
+
+namespace tensor_impl
+{
+
+    template<typename L, typename R, typename Op>
+    auto make_binary_expr(L &&lhs, R &&rhs, Op opr)
+    {
+        auto l = to_tensor_expr(std::forward<L>(lhs));
+        auto r = to_tensor_expr(std::forward<R>(rhs));
+        return tensor_binary_expr_t<decltype(l), decltype(r), Op>(
+            std::move(l), std::move(r), std::move(opr));
+    }
+
+} // namespace tensor_impl
+
+template<typename T>
+auto to_tensor_expr(T &&operand)
+{
+    using operand_t = rm_rcv_t<T>;
+
+    if constexpr(is_tensor_expr_v<operand_t>)
+    {
+        return operand_t(std::forward<T>(operand));
+    }
+    else if constexpr(tensor_operand_traits_t<operand_t>::value)
+    {
+        using traits_t = tensor_operand_traits_t<operand_t>;
+        using data_t   = rm_rcv_t<decltype(traits_t::data(operand))>;
+        using elem_t   = typename data_t::elem_t;
+
+        if constexpr(std::is_lvalue_reference_v<T> ||
+                     std::is_const_v<std::remove_reference_t<T>>)
+        {
+            return tensor_ref_expr_t<elem_t, data_t::dim_v>(
+                traits_t::data(operand));
+        }
+        else
+        {
+            return tensor_value_expr_t<elem_t, data_t::dim_v>(
+                traits_t::data(std::move(operand)));
+        }
+    }
+    else
+        return tensor_scalar_expr_t<operand_t>(operand);
+}
+
+template<typename T, typename F, typename>
+auto lazy_map(T &&operand, F &&func)
+{
+    auto opd = to_tensor_expr(std::forward<T>(operand));
+    return tensor_unary_expr_t<decltype(opd), rm_rcv_t<F>>(
+        std::move(opd), std::forward<F>(func));
+}
+
+template<typename L, typename R, typename F, typename>
+auto lazy_elemwise_binary(L &&lhs, R &&rhs, F &&func)
+{
+    return tensor_impl::make_binary_expr(
+        std::forward<L>(lhs), std::forward<R>(rhs),
+        rm_rcv_t<F>(std::forward<F>(func)));
+}
+
+template<typename E, typename>
+auto evaluate(const E &expr, int worker_count)
+{
+    tensor_t<typename E::elem_t, E::dim_v> ret;
+    ret.assign(expr, worker_count);
+    return ret;
+}
+
+template<typename E, typename>
+auto operator-(E &&opd)
+{
+    return lazy_map(std::forward<E>(opd), std::negate<>());
+}
+
+template<typename L, typename R, typename>
+auto operator+(L &&lhs, R &&rhs)
+{
+    return tensor_impl::make_binary_expr(
+        std::forward<L>(lhs), std::forward<R>(rhs), std::plus<>());
+}
+
+template<typename L, typename R, typename>
+auto operator-(L &&lhs, R &&rhs)
+{
+    return tensor_impl::make_binary_expr(
+        std::forward<L>(lhs), std::forward<R>(rhs), std::minus<>());
+}
+
+template<typename L, typename R, typename>
+auto operator*(L &&lhs, R &&rhs)
+{
+    return tensor_impl::make_binary_expr(
+        std::forward<L>(lhs), std::forward<R>(rhs), std::multiplies<>());
+}
+
+template<typename L, typename R, typename>
+auto operator/(L &&lhs, R &&rhs)
+{
+    return tensor_impl::make_binary_expr(
+        std::forward<L>(lhs), std::forward<R>(rhs), std::divides<>());
+}
+
+AGZ_MATH_END
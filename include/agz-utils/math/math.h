@@ -8,6 +8,7 @@
 #include "decl/color4.h"
 #include "decl/coord.h"
 #include "decl/distribution.h"
+#include "decl/exec_policy.h"
 #include "decl/func.h"
 #include "decl/low_discrepancy.h"
 #include "decl/mat3_c.h"
@@ -24,6 +25,7 @@
 
 #include "decl/spherical_harmonics.h"
 #include "decl/tensor.h"
+#include "decl/tensor_expr.h"
 #include "decl/tensor_view.h"
 
 #include "decl/simd/float3.h"
@@ -40,6 +42,7 @@
 #include "impl/color4.inl"
 #include "impl/coord.inl"
 #include "impl/distribution.inl"
+#include "impl/exec_policy.inl"
 #include "impl/mat3_c.inl"
 #include "impl/mat4_c.inl"
 #include "impl/quaternion.inl"
@@ -53,6 +56,7 @@
 
 #include "impl/spherical_harmonics.inl"
 #include "impl/tensor.inl"
+#include "impl/tensor_expr.inl"
 #include "impl/tensor_view.inl"
 
 #include "impl/simd/float3.inl"
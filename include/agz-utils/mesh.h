@@ -1,3 +1,5 @@
 ﻿#pragma once
 
+#include "./mesh/agzmesh.h"
+#include "./mesh/indexed_mesh.h"
 #include "./mesh/load_mesh.h"
@@ -0,0 +1,205 @@
+﻿#pragma once
+
+#include <cstdint>
+
+#include "../file/mapped_file.h"
+#include "./indexed_mesh.h"
+
+namespace agz::mesh
+{
+
+/**
+ * @brief agzmesh二进制网格格式
+ *
+ * 文件由128字节的文件头和若干按64字节对齐的段组成：
+ *      positions  : vec3f[vertex_count]
+ *      normals    : vec3f[vertex_count]，或八面体映射编码的2个snorm16
+ *      tex_coords : vec2f[vertex_count]，或在其包围盒中量化的2个unorm16
+ *      indices    : uint32[index_count]
+ *      chunks     : agzmesh_chunk_t[chunk_count]
+ *
+ * 所有数据均为小端序，且与内存中的布局完全一致，因此可以通过内存映射直接使用
+ */
+
+/**
+ * @brief 写出agzmesh文件时的选项
+ */
+struct agzmesh_options_t
+{
+    // 将法线量化为4字节（八面体映射，2个snorm16）
+    bool quantize_normals = false;
+
+    // 将纹理坐标量化为4字节（在所有纹理坐标的包围盒中，2个unorm16）
+    bool quantize_tex_coords = false;
+
+    // 每个块包含的三角形数，块按索引顺序划分
+    uint32_t chunk_triangle_count = 1024;
+
+    // 从三角形列表写出时，是否优化三角形和顶点的顺序
+    // （参见optimize_vertex_cache和optimize_vertex_fetch）
+    bool optimize_vertex_order = true;
+};
+
+/**
+ * @brief 一组连续三角形及其包围盒
+ */
+struct agzmesh_chunk_t
+{
+    math::aabb3f bounds;
+    uint32_t     first_triangle;
+    uint32_t     triangle_count;
+};
+
+static_assert(sizeof(agzmesh_chunk_t) == 32);
+
+/**
+ * @brief 将带索引的网格写入agzmesh文件
+ *
+ * @exception std::runtime_error 索引越界或写入失败时抛出
+ */
+void save_agzmesh(
+    const std::string             &filename,
+    const std::vector<vertex_t>   &vertices,
+    const std::vector<uint32_t>   &indices,
+    const agzmesh_options_t       &options = {});
+
+/**
+ * @brief 合并完全相同的顶点（参见weld_vertices）后，将三角形列表写入agzmesh文件
+ */
+void save_agzmesh(
+    const std::string             &filename,
+    const std::vector<triangle_t> &triangles,
+    const agzmesh_options_t       &options = {});
+
+/**
+ * @brief 用load_from_file加载src_filename，并转换为agzmesh文件
+ */
+void convert_to_agzmesh(
+    const std::string       &src_filename,
+    const std::string       &dst_filename,
+    const agzmesh_options_t &options = {});
+
+/**
+ * @brief 通过内存映射读取的agzmesh文件
+ *
+ * 打开时仅校验文件头，各段数据以span的形式直接指向映射的内存，
+ * 因此其生命周期不能超过该对象
+ */
+class agzmesh_view_t : public misc::uncopyable_t
+{
+public:
+
+    agzmesh_view_t() noexcept = default;
+
+    /**
+     * @exception std::runtime_error 文件无法打开或格式错误时抛出
+     */
+    explicit agzmesh_view_t(const std::string &filename);
+
+    agzmesh_view_t(agzmesh_view_t &&move_from) noexcept;
+
+    agzmesh_view_t &operator=(agzmesh_view_t &&move_from) noexcept;
+
+    /**
+     * @exception std::runtime_error 文件无法打开或格式错误时抛出
+     */
+    void open(const std::string &filename);
+
+    void close() noexcept;
+
+    bool is_open() const noexcept;
+
+    size_t vertex_count()   const noexcept;
+    size_t index_count()    const noexcept;
+    size_t triangle_count() const noexcept;
+
+    /**
+     * @brief 所有顶点位置的包围盒
+     */
+    const math::aabb3f &bounds() const noexcept;
+
+    bool has_quantized_normals()    const noexcept;
+    bool has_quantized_tex_coords() const noexcept;
+
+    misc::span<const math::vec3f> positions() const noexcept;
+
+    /**
+     * @brief 未量化的法线，法线被量化时为空
+     */
+    misc::span<const math::vec3f> normals() const noexcept;
+
+    /**
+     * @brief 未量化的纹理坐标，纹理坐标被量化时为空
+     */
+    misc::span<const math::vec2f> tex_coords() const noexcept;
+
+    /**
+     * @brief 量化后的法线，低16位为x，高16位为y；法线未被量化时为空
+     */
+    misc::span<const uint32_t> quantized_normals() const noexcept;
+
+    /**
+     * @brief 量化后的纹理坐标，低16位为u，高16位为v；纹理坐标未被量化时为空
+     */
+    misc::span<const uint32_t> quantized_tex_coords() const noexcept;
+
+    misc::span<const uint32_t> indices() const noexcept;
+
+    misc::span<const agzmesh_chunk_t> chunks() const noexcept;
+
+    /**
+     * @brief 取得第i个顶点的法线，必要时解码
+     */
+    math::vec3f normal(size_t i) const noexcept;
+
+    /**
+     * @brief 取得第i个顶点的纹理坐标，必要时解码
+     */
+    math::vec2f tex_coord(size_t i) const noexcept;
+
+    vertex_t vertex(size_t i) const noexcept;
+
+    /**
+     * @brief 解码所有顶点
+     */
+    std::vector<vertex_t> decode_vertices() const;
+
+    /**
+     * @brief 解码所有顶点并复制索引
+     */
+    indexed_mesh_t to_indexed_mesh() const;
+
+    /**
+     * @brief 展开为三角形列表
+     */
+    std::vector<triangle_t> to_triangles() const;
+
+private:
+
+    file::mapped_file_t file_;
+
+    math::aabb3f bounds_;
+
+    math::vec2f tex_coord_low_;
+    math::vec2f tex_coord_extent_;
+
+    bool quantized_normals_    = false;
+    bool quantized_tex_coords_ = false;
+
+    size_t vertex_count_ = 0;
+    size_t index_count_  = 0;
+    size_t chunk_count_  = 0;
+
+    const unsigned char *positions_  = nullptr;
+    const unsigned char *normals_    = nullptr;
+    const unsigned char *tex_coords_ = nullptr;
+    const unsigned char *indices_    = nullptr;
+    const unsigned char *chunks_     = nullptr;
+};
+
+/**
+ * @brief 从agzmesh文件中加载三角网格
+ */
+std::vector<triangle_t> load_from_agzmesh(const std::string &filename);
+
+} // namespace agz::mesh
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <cstdint>
+
+#include "./load_mesh.h"
+
+namespace agz::mesh
+{
+
+/**
+ * @brief 顶点缓冲加32位索引缓冲表示的三角网格
+ */
+struct indexed_mesh_t
+{
+    std::vector<vertex_t> vertices;
+    std::vector<uint32_t> indices;
+
+    size_t triangle_count() const noexcept;
+
+    /**
+     * @brief 展开为三角形列表
+     */
+    std::vector<triangle_t> to_triangles() const;
+};
+
+/**
+ * @brief 网格的内存占用和顶点缓存效率统计
+ */
+struct indexed_mesh_stats_t
+{
+    size_t vertex_count   = 0;
+    size_t triangle_count = 0;
+
+    size_t vertex_bytes = 0;
+    size_t index_bytes  = 0;
+
+    // 同一网格以std::vector<triangle_t>表示时的字节数
+    size_t triangle_list_bytes = 0;
+
+    // average cache miss ratio，每个三角形平均的顶点缓存缺失数，介于0.5和3之间
+    float acmr = 0;
+
+    // average transform to vertex ratio，每个顶点平均被变换的次数，最优为1
+    float atvr = 0;
+};
+
+/**
+ * @brief 合并按位完全相同的顶点，得到带索引的网格
+ *
+ * 顶点按首次出现的顺序编号，因此结果与线程数无关
+ *
+ * @param worker_count 线程数，含义同thread::actual_worker_count
+ */
+indexed_mesh_t weld_vertices(
+    const std::vector<triangle_t> &triangles, int worker_count = 0);
+
+/**
+ * @brief 用Tipsify算法重排三角形顺序，提高post-transform顶点缓存的命中率
+ *
+ * 参见 Sander et al., Fast Triangle Reordering for Vertex Locality and
+ * Reduced Overdraw, 2007
+ *
+ * @param cache_size 目标FIFO顶点缓存的大小
+ */
+void optimize_vertex_cache(indexed_mesh_t &mesh, int cache_size = 16);
+
+/**
+ * @brief 将顶点按其在索引缓冲中首次被引用的顺序重排，并移除未被引用的顶点
+ *
+ * 应在optimize_vertex_cache之后调用
+ */
+void optimize_vertex_fetch(indexed_mesh_t &mesh);
+
+/**
+ * @brief 统计网格的内存占用，并模拟大小为cache_size的FIFO顶点缓存
+ */
+indexed_mesh_stats_t compute_indexed_mesh_stats(
+    const indexed_mesh_t &mesh, int cache_size = 16);
+
+} // namespace agz::mesh
@@ -43,21 +43,39 @@ std::vector<face_t> load_from_obj(const std::string &filename);
 
 /**
  * @brief 从内存中加载三角网格
+ *
+ * obj按行边界分块后并行解析，多边形按扇形三角化
+ *
+ * @param worker_count 线程数，含义同thread::actual_worker_count
  */
-std::vector<triangle_t> load_from_obj_mem(const std::string &str);
+std::vector<triangle_t> load_from_obj_mem(
+    const std::string &str, int worker_count = 0);
+
+/**
+ * @brief 从内存中加载三角网格，data无需以'\0'结尾
+ */
+std::vector<triangle_t> load_from_obj_mem(
+    const char *data, size_t size, int worker_count = 0);
 
 /**
  * @brief 从内存中解析obj格式，加载网格对象
+ *
+ * 每个'o'/'g'开始一个新的网格对象，没有面的对象会被丢弃
  */
-std::vector<mesh_t> load_meshes_from_obj_mem(const std::string &str);
+std::vector<mesh_t> load_meshes_from_obj_mem(
+    const std::string &str, int worker_count = 0);
 
 /**
- * @brief 从.obj中加载网格对象
+ * @brief 从.obj中加载网格对象，文件通过内存映射读取
  */
-std::vector<mesh_t> load_meshes_from_obj(const std::string &filename);
+std::vector<mesh_t> load_meshes_from_obj(
+    const std::string &filename, int worker_count = 0);
 
 /**
  * @brief 从内存中解析ply格式，加载网格对象
+ *
+ * 二进制格式且顶点属性为float32时直接整块复制顶点数据（big endian时整块转换字节序），
+ * 否则使用tinyply解析
  */
 std::vector<triangle_t> load_from_ply_mem(
     const std::vector<uint8_t> &byte_buffer);
@@ -68,7 +86,7 @@ std::vector<triangle_t> load_from_ply_mem(
 std::vector<triangle_t> load_from_ply(const std::string &filename);
 
 /**
- * @brief 从.obj/.stl/.ply文件中加载三角网格
+ * @brief 从.obj/.stl/.ply/.agzmesh文件中加载三角网格
  */
 std::vector<triangle_t> load_from_file(const std::string &filename);
 
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "misc/base64.h"
+#include "misc/binary_stream.h"
 #include "misc/bitcast.h"
 #include "misc/construct_from_tuple.h"
 #include "misc/detect.h"
@@ -15,6 +16,7 @@
 #include "misc/type_list.h"
 #include "misc/scope_assignment.h"
 #include "misc/scope_guard.h"
+#include "misc/serialize.h"
 #include "misc/singleton.h"
 #include "misc/span.h"
 #include "misc/uint_ptr_variant.h"
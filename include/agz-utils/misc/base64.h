@@ -1,13 +1,118 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace agz::misc
 {
 
+/**
+ * @brief 编码byte_size字节得到的base64字符数（含填充）
+ */
+size_t encoded_base64_size(size_t byte_size) noexcept;
+
+/**
+ * @brief 将data编码为base64并写入output
+ *
+ * output至少应能容纳encoded_base64_size(byte_size)个字符，不写入结尾的'\0'
+ *
+ * @return 写入的字符数
+ */
+size_t encode_base64(const void *data, size_t byte_size, char *output) noexcept;
+
 std::string encode_base64(const void *data, size_t byte_size);
 
+/**
+ * @brief 解码char_count个字符最多得到的字节数
+ */
+size_t decoded_base64_max_size(size_t char_count) noexcept;
+
+/**
+ * @brief 将base64字符串解码到output中
+ *
+ * 解码在第一个'='或非base64字符处停止。
+ * output至少应能容纳decoded_base64_max_size(str.size())个字节
+ *
+ * @return 写入的字节数
+ */
+size_t decode_base64(std::string_view str, void *output) noexcept;
+
 std::vector<unsigned char> decode_base64(std::string_view str);
 
+/**
+ * @brief 分块的base64编码器，用于无法一次放入内存的数据
+ *
+ * 依次对各块调用update，最后调用finish；输出与一次性编码全部数据相同
+ */
+class base64_encoder_t
+{
+public:
+
+    /**
+     * @brief 对接下来byte_size字节调用update时最多写入的字符数
+     */
+    size_t max_update_size(size_t byte_size) const noexcept;
+
+    /**
+     * @return 写入output的字符数
+     */
+    size_t update(const void *data, size_t byte_size, char *output) noexcept;
+
+    void update(const void *data, size_t byte_size, std::string &output);
+
+    /**
+     * @brief 输出剩余的字节和填充，最多写入4个字符，之后可以开始编码新的数据
+     */
+    size_t finish(char *output) noexcept;
+
+    void finish(std::string &output);
+
+private:
+
+    unsigned char pending_[3] = {};
+    size_t        pending_count_ = 0;
+};
+
+/**
+ * @brief 分块的base64解码器
+ *
+ * 依次对各块调用update，最后调用finish；输出与一次性解码全部数据相同，
+ * 即在第一个'='或非base64字符处停止，之后的输入被忽略
+ */
+class base64_decoder_t
+{
+public:
+
+    /**
+     * @brief 对接下来char_count个字符调用update时最多写入的字节数
+     */
+    size_t max_update_size(size_t char_count) const noexcept;
+
+    /**
+     * @return 写入output的字节数
+     */
+    size_t update(std::string_view str, void *output) noexcept;
+
+    void update(std::string_view str, std::vector<unsigned char> &output);
+
+    /**
+     * @brief 输出剩余的不完整字符组，最多写入2个字节，之后可以开始解码新的数据
+     */
+    size_t finish(void *output) noexcept;
+
+    void finish(std::vector<unsigned char> &output);
+
+    /**
+     * @brief 是否已遇到'='或非base64字符
+     */
+    bool stopped() const noexcept;
+
+private:
+
+    char   pending_[4] = {};
+    size_t pending_count_ = 0;
+    bool   stopped_ = false;
+};
+
 } // namespace agz::misc
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "./endian.h"
+#include "./span.h"
+
+namespace agz::misc
+{
+
+/**
+ * @brief 从一段内存中按给定字节序读取二进制数据
+ *
+ * 不持有数据。数据不足时抛出std::runtime_error，读取位置保持不变
+ */
+class binary_reader_t
+{
+    const unsigned char *data_;
+    size_t size_;
+    size_t pos_;
+
+    endian_type endian_;
+
+    void require(size_t bytes) const
+    {
+        if(bytes > size_ - pos_)
+            throw std::runtime_error("binary_reader_t: unexpected end of data");
+    }
+
+public:
+
+    binary_reader_t(
+        const void *data, size_t byte_size,
+        endian_type endian = endian_type::little) noexcept
+        : data_(static_cast<const unsigned char *>(data)),
+          size_(byte_size), pos_(0), endian_(endian)
+    {
+
+    }
+
+    endian_type endian() const noexcept
+    {
+        return endian_;
+    }
+
+    void set_endian(endian_type endian) noexcept
+    {
+        endian_ = endian;
+    }
+
+    size_t size() const noexcept
+    {
+        return size_;
+    }
+
+    size_t position() const noexcept
+    {
+        return pos_;
+    }
+
+    size_t remaining() const noexcept
+    {
+        return size_ - pos_;
+    }
+
+    bool eof() const noexcept
+    {
+        return pos_ == size_;
+    }
+
+    void seek(size_t position)
+    {
+        if(position > size_)
+            throw std::runtime_error("binary_reader_t: seek out of range");
+        pos_ = position;
+    }
+
+    void skip(size_t bytes)
+    {
+        require(bytes);
+        pos_ += bytes;
+    }
+
+    /**
+     * @brief 跳过byte_size字节，返回指向其中第一个字节的指针
+     */
+    const unsigned char *read_bytes(size_t byte_size)
+    {
+        require(byte_size);
+        const unsigned char *ret = data_ + pos_;
+        pos_ += byte_size;
+        return ret;
+    }
+
+    void read_bytes(void *output, size_t byte_size)
+    {
+        if(byte_size)
+            std::memcpy(output, read_bytes(byte_size), byte_size);
+    }
+
+    /**
+     * @brief 读取一个T类型的值并转换为本机字节序
+     *
+     * T须为算术类型或枚举类型，其他类型只能整体按字节读取，参见read_bytes
+     */
+    template<typename T>
+    T read()
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>,
+                      "binary_reader_t::read: T must be an arithmetic or enum type");
+
+        T ret;
+        std::memcpy(&ret, read_bytes(sizeof(T)), sizeof(T));
+        if(endian_ != endian_type::local)
+            ret = convert_endian<endian_type::little, endian_type::big>(ret);
+        return ret;
+    }
+
+    /**
+     * @brief 读取count个T类型的值并转换为本机字节序，整块转换
+     */
+    template<typename T>
+    void read_array(T *output, size_t count)
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>,
+                      "binary_reader_t::read_array: T must be an arithmetic or enum type");
+
+        if(count > remaining() / sizeof(T))
+            throw std::runtime_error("binary_reader_t: unexpected end of data");
+        if(!count)
+            return;
+
+        const unsigned char *src = read_bytes(count * sizeof(T));
+        if(endian_ != endian_type::local && sizeof(T) > 1)
+            copy_swap_bytes(src, output, count, sizeof(T));
+        else
+            std::memcpy(output, src, count * sizeof(T));
+    }
+
+    template<typename T>
+    void read_array(span<T> output)
+    {
+        read_array(output.data(), output.size());
+    }
+
+    template<typename T>
+    std::vector<T> read_array(size_t count)
+    {
+        if(count > remaining() / sizeof(T))
+            throw std::runtime_error("binary_reader_t: unexpected end of data");
+
+        std::vector<T> ret(count);
+        read_array(ret.data(), count);
+        return ret;
+    }
+};
+
+/**
+ * @brief 按给定字节序将二进制数据追加到内部缓冲区中
+ */
+class binary_writer_t
+{
+    std::vector<unsigned char> buffer_;
+
+    endian_type endian_;
+
+public:
+
+    explicit binary_writer_t(endian_type endian = endian_type::little) noexcept
+        : endian_(endian)
+    {
+
+    }
+
+    endian_type endian() const noexcept
+    {
+        return endian_;
+    }
+
+    void set_endian(endian_type endian) noexcept
+    {
+        endian_ = endian;
+    }
+
+    size_t size() const noexcept
+    {
+        return buffer_.size();
+    }
+
+    void reserve(size_t byte_size)
+    {
+        buffer_.reserve(byte_size);
+    }
+
+    const std::vector<unsigned char> &buffer() const noexcept
+    {
+        return buffer_;
+    }
+
+    /**
+     * @brief 已写入的数据，可用于回填先前预留的字节
+     */
+    unsigned char *data() noexcept
+    {
+        return buffer_.data();
+    }
+
+    const unsigned char *data() const noexcept
+    {
+        return buffer_.data();
+    }
+
+    /**
+     * @brief 取出已写入的数据并清空缓冲区
+     */
+    std::vector<unsigned char> take() noexcept
+    {
+        std::vector<unsigned char> ret;
+        ret.swap(buffer_);
+        return ret;
+    }
+
+    /**
+     * @brief 追加byte_size个未初始化的字节，返回指向其中第一个字节的指针
+     *
+     * 返回的指针在下一次写入前有效
+     */
+    unsigned char *append(size_t byte_size)
+    {
+        const size_t old_size = buffer_.size();
+        buffer_.resize(old_size + byte_size);
+        return buffer_.data() + old_size;
+    }
+
+    void write_bytes(const void *data, size_t byte_size)
+    {
+        if(byte_size)
+            std::memcpy(append(byte_size), data, byte_size);
+    }
+
+    /**
+     * @brief 将本机字节序的value转换为目标字节序后写入
+     *
+     * T须为算术类型或枚举类型，其他类型只能整体按字节写入，参见write_bytes
+     */
+    template<typename T>
+    void write(const T &value)
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>,
+                      "binary_writer_t::write: T must be an arithmetic or enum type");
+
+        const T converted = endian_ != endian_type::local ?
+            convert_endian<endian_type::little, endian_type::big>(value) : value;
+        std::memcpy(append(sizeof(T)), &converted, sizeof(T));
+    }
+
+    /**
+     * @brief 将count个本机字节序的值转换为目标字节序后写入，整块转换
+     */
+    template<typename T>
+    void write_array(const T *data, size_t count)
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>,
+                      "binary_writer_t::write_array: T must be an arithmetic or enum type");
+
+        if(!count)
+            return;
+
+        unsigned char *dst = append(count * sizeof(T));
+        if(endian_ != endian_type::local && sizeof(T) > 1)
+            copy_swap_bytes(data, dst, count, sizeof(T));
+        else
+            std::memcpy(dst, data, count * sizeof(T));
+    }
+
+    template<typename T>
+    void write_array(span<T> data)
+    {
+        write_array<std::remove_const_t<T>>(data.data(), data.size());
+    }
+};
+
+} // namespace agz::misc
@@ -1,5 +1,8 @@
 ﻿#pragma once
 
+#include <cassert>
+#include <cstddef>
+#include <cstring>
 #include <type_traits>
 
 #ifdef __GNUC__
@@ -7,6 +10,7 @@
 #endif
 
 #include "../system/platform.h"
+#include "./span.h"
 
 namespace agz::misc
 {
@@ -99,4 +103,85 @@ T to_local_endian(T value) noexcept
     return convert_endian<From, endian_type::local, T>(value);
 }
 
+/**
+ * @brief 将src中的count个大小为elem_size的元素逐个反转字节序后写入dst
+ *
+ * 元素大小为2/4/8字节时使用SSSE3/AVX2（若处理器支持）整块转换。
+ * dst可以等于src，但不可与src部分重叠
+ */
+void copy_swap_bytes(
+    const void *src, void *dst, size_t count, size_t elem_size) noexcept;
+
+/**
+ * @brief 原地反转count个大小为elem_size的元素的字节序
+ */
+void swap_bytes_inplace(void *data, size_t count, size_t elem_size) noexcept;
+
+/**
+ * @brief 原地将data中的每个元素从From字节序转换为To字节序
+ *
+ * 与对每个元素调用convert_endian的结果相同
+ */
+template<endian_type From, endian_type To, typename T>
+void convert_endian_inplace(span<T> data) noexcept
+{
+    static_assert(std::is_trivially_copyable_v<T> && !std::is_const_v<T>);
+
+    if constexpr(From != To && sizeof(T) > 1)
+        swap_bytes_inplace(data.data(), data.size(), sizeof(T));
+}
+
+/**
+ * @brief 原地将data中的每个元素从from字节序转换为to字节序
+ */
+template<typename T>
+void convert_endian_inplace(span<T> data, endian_type from, endian_type to) noexcept
+{
+    static_assert(std::is_trivially_copyable_v<T> && !std::is_const_v<T>);
+
+    if(from != to && sizeof(T) > 1)
+        swap_bytes_inplace(data.data(), data.size(), sizeof(T));
+}
+
+/**
+ * @brief 将src中的每个元素从From字节序转换为To字节序后写入dst
+ *
+ * dst的长度不得小于src，dst可以与src相同但不可部分重叠
+ */
+template<endian_type From, endian_type To, typename S, typename D>
+void copy_convert_endian(span<S> src, span<D> dst) noexcept
+{
+    static_assert(std::is_same_v<std::remove_const_t<S>, D>);
+    static_assert(std::is_trivially_copyable_v<D>);
+    assert(dst.size() >= src.size());
+
+    if(src.empty())
+        return;
+
+    if constexpr(From != To && sizeof(D) > 1)
+        copy_swap_bytes(src.data(), dst.data(), src.size(), sizeof(D));
+    else if(src.data() != dst.data())
+        std::memmove(dst.data(), src.data(), src.size() * sizeof(D));
+}
+
+/**
+ * @brief 将src中的每个元素从from字节序转换为to字节序后写入dst
+ */
+template<typename S, typename D>
+void copy_convert_endian(
+    span<S> src, span<D> dst, endian_type from, endian_type to) noexcept
+{
+    static_assert(std::is_same_v<std::remove_const_t<S>, D>);
+    static_assert(std::is_trivially_copyable_v<D>);
+    assert(dst.size() >= src.size());
+
+    if(src.empty())
+        return;
+
+    if(from != to && sizeof(D) > 1)
+        copy_swap_bytes(src.data(), dst.data(), src.size(), sizeof(D));
+    else if(src.data() != dst.data())
+        std::memmove(dst.data(), src.data(), src.size() * sizeof(D));
+}
+
 } // namespace agz::misc
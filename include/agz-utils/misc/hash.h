@@ -1,6 +1,19 @@
 ﻿#pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#include "detect.h"
+#include "reflection.h"
 
 #ifndef __CUDACC__
 
@@ -44,6 +57,201 @@ size_t hash(const A &a, const Others&...others)
     return hash_impl::hash(std::hash<A>()(a), others...);
 }
 
+/**
+ * @brief 128位hash值
+ */
+struct hash128_t
+{
+    uint64_t low  = 0;
+    uint64_t high = 0;
+
+    bool operator==(const hash128_t &rhs) const noexcept
+    {
+        return low == rhs.low && high == rhs.high;
+    }
+
+    bool operator!=(const hash128_t &rhs) const noexcept
+    {
+        return !(*this == rhs);
+    }
+};
+
+/**
+ * @brief 求一段字节的64位hash值
+ *
+ * 短输入使用wyhash的结构，长输入使用XXH3式的分条累加，
+ * 并在运行时选择AVX2/SSE2/标量实现。各实现的结果相同且与平台无关，
+ * 但与wyhash/xxHash的参考实现不兼容
+ */
+uint64_t hash_bytes(const void *data, size_t byte_size, uint64_t seed = 0) noexcept;
+
+/**
+ * @brief 求一段字节的128位hash值
+ */
+hash128_t hash_bytes_128(
+    const void *data, size_t byte_size, uint64_t seed = 0) noexcept;
+
+namespace hash_impl
+{
+
+    /**
+     * @brief 64位乘法，a和b分别被置为128位积的低64位和高64位
+     */
+    inline void mum(uint64_t &a, uint64_t &b) noexcept
+    {
+#if defined(__SIZEOF_INT128__)
+        const __uint128_t r = static_cast<__uint128_t>(a) * b;
+        a = static_cast<uint64_t>(r);
+        b = static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        a = _umul128(a, b, &b);
+#else
+        const uint64_t ha = a >> 32, hb = b >> 32;
+        const uint64_t la = a & 0xffffffff, lb = b & 0xffffffff;
+        const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        const uint64_t t = rl + (rm0 << 32);
+        uint64_t carry = t < rl;
+        const uint64_t lo = t + (rm1 << 32);
+        carry += lo < t;
+        a = lo;
+        b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+    }
+
+} // namespace hash_impl
+
+/**
+ * @brief 将两个64位值混合为一个，质量远好于hash_combine
+ */
+inline uint64_t hash_mix(uint64_t a, uint64_t b) noexcept
+{
+    a ^= 0xa0761d6478bd642full;
+    b ^= 0xe7037ed1a0b428dbull;
+    hash_impl::mum(a, b);
+    return a ^ b;
+}
+
+/**
+ * @brief 整数的hash值，所有输入位都影响所有输出位
+ *
+ * libstdc++等实现中std::hash对整数是恒等映射，用于开放寻址的哈希表时会产生聚集
+ */
+inline uint64_t hash_uint64(uint64_t x, uint64_t seed = 0) noexcept
+{
+    return hash_mix(x ^ seed, 0x8ebc6af09c88c6e3ull ^ seed);
+}
+
+template<typename T>
+uint64_t hash_value(const T &value, uint64_t seed = 0);
+
+namespace hash_impl
+{
+
+    template<typename T>
+    using data_size_t = decltype(
+        std::data(std::declval<const T&>()), std::size(std::declval<const T&>()));
+
+    template<typename T>
+    using begin_end_t = decltype(
+        std::begin(std::declval<const T&>()), std::end(std::declval<const T&>()));
+
+    template<typename T>
+    using std_hash_t = decltype(std::hash<T>()(std::declval<const T&>()));
+
+    /**
+     * @brief 可以直接按字节求hash的类型，要求值相等当且仅当字节相等
+     */
+    template<typename T>
+    constexpr bool is_bytewise_v =
+        std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>;
+
+} // namespace hash_impl
+
+/**
+ * @brief 求任意值的hash值
+ *
+ * - 整数、枚举和指针：hash_uint64
+ * - 浮点数：+0和-0视为相同
+ * - 通过AGZ_BEGIN_CLASS_RELECTION反射的类型：按声明顺序混合各成员变量的hash值
+ * - 字符串、数组等提供连续存储的区间：元素可以按字节比较时对整段求hash_bytes，
+ *   否则逐个元素混合
+ * - 其他类型使用std::hash的结果
+ */
+template<typename T>
+uint64_t hash_value(const T &value, uint64_t seed)
+{
+    using namespace hash_impl;
+
+    if constexpr(is_bytewise_v<T>)
+    {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(T));
+        return hash_uint64(bits, seed);
+    }
+    else if constexpr(std::is_floating_point_v<T>)
+    {
+        const T v = value == T(0) ? T(0) : value;
+        if constexpr(sizeof(T) <= sizeof(uint64_t))
+        {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &v, sizeof(T));
+            return hash_uint64(bits, seed);
+        }
+        else
+            return hash_bytes(&v, sizeof(T), seed);
+    }
+    else if constexpr(refl::is_reflected_v<T>)
+    {
+        uint64_t h = hash_uint64(refl::get_member_variable_count<T>(), seed);
+        refl::for_each_member_variable<T>([&](auto mem_ptr, const char *)
+        {
+            h = hash_mix(h, hash_value(value.*mem_ptr, seed));
+        });
+        return h;
+    }
+    else if constexpr(is_detected_v<data_size_t, T>)
+    {
+        using elem_t = std::remove_cv_t<std::remove_pointer_t<
+            decltype(std::data(value))>>;
+        if constexpr(is_bytewise_v<elem_t>)
+        {
+            return hash_bytes(
+                std::data(value), std::size(value) * sizeof(elem_t), seed);
+        }
+        else
+        {
+            uint64_t h = hash_uint64(std::size(value), seed);
+            for(auto &elem : value)
+                h = hash_mix(h, hash_value(elem, seed));
+            return h;
+        }
+    }
+    else if constexpr(is_detected_v<begin_end_t, T>)
+    {
+        uint64_t h = hash_uint64(0, seed);
+        for(auto &elem : value)
+            h = hash_mix(h, hash_value(elem, seed));
+        return h;
+    }
+    else
+    {
+        static_assert(is_detected_v<std_hash_t, T>, "unhashable type");
+        return hash_uint64(std::hash<T>()(value), seed);
+    }
+}
+
+/**
+ * @brief 基于hash_value的哈希函数对象，可用于std::unordered_map等
+ */
+template<typename T>
+struct hasher_t
+{
+    size_t operator()(const T &value) const
+    {
+        return static_cast<size_t>(hash_value(value));
+    }
+};
+
 } } // namespace agz::misc
 
 #endif // #ifndef __CUDACC__
@@ -25,6 +25,13 @@ namespace detail
 
     static_assert(sizeof(sizer_t<17>) == 17);
 
+    template<typename T, typename = void>
+    struct is_reflected_t : std::false_type { };
+
+    template<typename T>
+    struct is_reflected_t<T, std::void_t<typename T::_agz_refl_self_t>>
+        : std::is_same<T, typename T::_agz_refl_self_t> { };
+
     template<typename T, int...Is>
     constexpr int get_member_variable_count_aux(
         std::integer_sequence<int, Is...>)
@@ -51,12 +58,12 @@ namespace detail
     template<typename T, typename F, int...Is>                                  \
     friend void ::agz::misc::refl::detail::for_each_member_variable_aux(        \
         const F &f, std::integer_sequence<int, Is...>);                         \
-    template<int N>                                                             \
+    template<int N, typename = void>                                            \
     struct _agz_refl_mem_var_entry                                              \
     {                                                                           \
         static constexpr int exists = 0;                                        \
         template<typename F>                                                    \
-        static void process(const F &f) { }                                     \
+        static void process(const F &) { }                                      \
     }
 
 #define AGZ_MEMBER_VARIABLE_REFLECTION(NAME)                                    \
@@ -68,8 +75,9 @@ namespace detail
         _agz_refl_mem_var_counter(                                              \
             ::agz::misc::refl::detail::int_t<                                   \
                 NAME##agz_refl_mem_var_index + 1>*);                            \
-    template<>                                                                  \
-    struct _agz_refl_mem_var_entry<NAME##agz_refl_mem_var_index - 1>            \
+    template<typename _agz_refl_dummy_t>                                        \
+    struct _agz_refl_mem_var_entry<                                             \
+        NAME##agz_refl_mem_var_index - 1, _agz_refl_dummy_t>                    \
     {                                                                           \
         static constexpr int exists = 1;                                        \
         template<typename F>                                                    \
@@ -79,6 +87,12 @@ namespace detail
         }                                                                       \
     }
 
+/**
+ * @brief T是否通过AGZ_BEGIN_CLASS_RELECTION声明了反射信息
+ */
+template<typename T>
+constexpr bool is_reflected_v = detail::is_reflected_t<T>::value;
+
 template<typename T>
 constexpr int get_member_variable_count()
 {
@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include <exception>
+
 #include "../common/common.h"
 #include "uncopyable.h"
 
@@ -0,0 +1,655 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./binary_stream.h"
+#include "./detect.h"
+#include "./reflection.h"
+#include "./span.h"
+
+/*
+ * 二进制序列化格式：
+ *
+ * - bool：1字节
+ * - 其他整数和枚举：LEB128变长整数，有符号数先进行zigzag编码。
+ *   读取时若值超出目标类型的范围，抛出std::runtime_error
+ * - 浮点数：原样存储
+ * - 反射类型（参见reflection.h）：版本号、成员数，以及每个成员的
+ *   (名字的hash值, 8字节的内容长度, 内容)。
+ *   读取时按名字匹配成员，跳过未知成员，缺少的成员保持原值，因此可以增删成员。
+ *   类型可以用static constexpr uint32_t serialize_version声明版本号（默认为0），
+ *   读到较旧版本的数据后会调用成员函数upgrade_serialized(uint32_t old_version)（如果存在）
+ * - 元素可平凡复制的连续容器（std::vector、std::basic_string和span）：
+ *   元素数，补齐到元素的对齐要求的0，以及整块复制的元素。
+ *   补齐是相对于数据起始位置的，因此当数据起始地址足够对齐时（如通过mmap映射的文件），
+ *   可以将这样的数组直接读取为span<const T>而不复制
+ * - std::array、std::pair、std::tuple：依次存储各元素
+ * - std::optional：1字节的标志，以及可能存在的值
+ * - 其他区间：元素数和各个元素
+ * - 其他可平凡复制的类型：按本机内存布局原样存储
+ *
+ * 数值的字节序由binary_writer_t/binary_reader_t决定，serialize和deserialize使用小端。
+ * 可以通过特化serializer_t为其他类型提供自定义的格式
+ */
+
+namespace agz::misc
+{
+
+/**
+ * @brief 类型T的序列化方式，可以特化该模板以自定义格式
+ *
+ * 特化需提供：
+ *  static void write(binary_writer_t &writer, const T &value);
+ *  static void read(binary_reader_t &reader, T &value);
+ */
+template<typename T, typename = void>
+struct serializer_t;
+
+/**
+ * @brief 将value追加到writer中
+ */
+template<typename T>
+void serialize(binary_writer_t &writer, const T &value);
+
+/**
+ * @brief 将value序列化为小端格式的字节数组
+ */
+template<typename T>
+std::vector<unsigned char> serialize(const T &value);
+
+/**
+ * @brief 从reader中读取value
+ *
+ * 数据不完整或不合法时抛出std::runtime_error
+ */
+template<typename T>
+void deserialize(binary_reader_t &reader, T &value);
+
+/**
+ * @brief 从小端格式的数据中读取一个T类型的值
+ *
+ * T中的span<const U>成员直接引用data中的数据，此时data需在其生命周期内保持有效
+ */
+template<typename T>
+T deserialize(const void *data, size_t byte_size);
+
+namespace serialize_impl
+{
+
+    template<typename T>
+    using rm_rcv_ref_t = std::remove_cv_t<std::remove_reference_t<T>>;
+
+    template<typename T>
+    using default_format_t = decltype(serializer_t<T>::default_format);
+
+    /**
+     * @brief 以serializer_t的默认格式序列化的类型
+     */
+    template<typename T>
+    constexpr bool is_default_format_v = is_detected_v<default_format_t, T>;
+
+    /**
+     * @brief 在连续容器中可以整块复制的元素类型
+     */
+    template<typename T>
+    constexpr bool is_bulk_v =
+        std::is_trivially_copyable_v<T> &&
+        !refl::is_reflected_v<T> && is_default_format_v<T>;
+
+    /**
+     * @brief 写入和读取时需要转换字节序的类型
+     */
+    template<typename T>
+    constexpr bool has_byte_order_v =
+        (std::is_arithmetic_v<T> || std::is_enum_v<T>) && sizeof(T) > 1;
+
+    template<typename T, template<typename...> class Tmpl>
+    struct is_instance_of_t : std::false_type { };
+
+    template<template<typename...> class Tmpl, typename...Args>
+    struct is_instance_of_t<Tmpl<Args...>, Tmpl> : std::true_type { };
+
+    template<typename T, template<typename...> class Tmpl>
+    constexpr bool is_instance_of_v = is_instance_of_t<T, Tmpl>::value;
+
+    template<typename T>
+    struct is_std_array_t : std::false_type { };
+
+    template<typename T, size_t N>
+    struct is_std_array_t<std::array<T, N>> : std::true_type { };
+
+    template<typename T>
+    using serialize_version_t = decltype(T::serialize_version);
+
+    template<typename T>
+    using upgrade_serialized_t = decltype(
+        std::declval<T&>().upgrade_serialized(uint32_t(0)));
+
+    template<typename T>
+    using contiguous_t = decltype(
+        std::declval<T&>().resize(size_t(0)),
+        std::data(std::declval<T&>()), std::size(std::declval<const T&>()));
+
+    template<typename T>
+    using resize_t = decltype(std::declval<T&>().resize(size_t(0)));
+
+    /**
+     * @brief 元素可以整块复制的可变长连续容器
+     */
+    template<typename T>
+    constexpr bool is_bulk_container_v = []
+    {
+        if constexpr(is_detected_v<contiguous_t, T>)
+            return is_bulk_v<rm_rcv_ref_t<decltype(*std::data(std::declval<T&>()))>>;
+        else
+            return false;
+    }();
+
+    template<typename T>
+    using range_t = decltype(
+        std::begin(std::declval<const T&>()), std::end(std::declval<const T&>()),
+        std::size(std::declval<const T&>()), std::declval<T&>().clear());
+
+    template<typename T>
+    uint32_t serialize_version() noexcept
+    {
+        if constexpr(is_detected_v<serialize_version_t, T>)
+            return static_cast<uint32_t>(T::serialize_version);
+        else
+            return 0;
+    }
+
+    /**
+     * @brief 区间的元素类型，其中std::pair<const K, V>被替换为std::pair<K, V>
+     */
+    template<typename T>
+    struct mutable_value_t
+    {
+        using type = T;
+    };
+
+    template<typename K, typename V>
+    struct mutable_value_t<std::pair<const K, V>>
+    {
+        using type = std::pair<K, V>;
+    };
+
+    [[noreturn]] inline void throw_invalid(const char *msg)
+    {
+        throw std::runtime_error(std::string("deserialize: ") + msg);
+    }
+
+    inline void write_varint(binary_writer_t &writer, uint64_t value)
+    {
+        unsigned char bytes[10];
+        size_t n = 0;
+        while(value >= 0x80)
+        {
+            bytes[n++] = static_cast<unsigned char>(value | 0x80);
+            value >>= 7;
+        }
+        bytes[n++] = static_cast<unsigned char>(value);
+        writer.write_bytes(bytes, n);
+    }
+
+    inline uint64_t read_varint(binary_reader_t &reader)
+    {
+        uint64_t value = 0;
+        for(int shift = 0; shift < 64; shift += 7)
+        {
+            const uint8_t byte = reader.read<uint8_t>();
+            value |= uint64_t(byte & 0x7f) << shift;
+            if(!(byte & 0x80))
+                return value;
+        }
+        throw_invalid("invalid varint");
+    }
+
+    inline void write_fixed64(unsigned char *dst, uint64_t value) noexcept
+    {
+        for(int i = 0; i < 8; ++i)
+            dst[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+
+    inline uint64_t read_fixed64(binary_reader_t &reader)
+    {
+        const unsigned char *src = reader.read_bytes(8);
+        uint64_t value = 0;
+        for(int i = 0; i < 8; ++i)
+            value |= uint64_t(src[i]) << (8 * i);
+        return value;
+    }
+
+    inline size_t padding(size_t position, size_t align) noexcept
+    {
+        return (align - position % align) % align;
+    }
+
+    /**
+     * @brief 成员名的FNV-1a hash值
+     */
+    inline uint32_t member_tag(const char *name) noexcept
+    {
+        uint32_t h = 0x811c9dc5u;
+        for(; *name; ++name)
+            h = (h ^ static_cast<unsigned char>(*name)) * 0x01000193u;
+        return h;
+    }
+
+    template<typename T>
+    const std::vector<uint32_t> &member_tags()
+    {
+        static const std::vector<uint32_t> ret = []
+        {
+            std::vector<uint32_t> tags;
+            refl::for_each_member_variable<T>([&](auto, const char *name)
+            {
+                tags.push_back(member_tag(name));
+            });
+
+            for(size_t i = 0; i < tags.size(); ++i)
+            {
+                for(size_t j = i + 1; j < tags.size(); ++j)
+                {
+                    if(tags[i] == tags[j])
+                        throw std::runtime_error(
+                            "serialize: member name hash collision");
+                }
+            }
+
+            return tags;
+        }();
+        return ret;
+    }
+
+    template<typename T>
+    void write_bulk(binary_writer_t &writer, const T *data, size_t count)
+    {
+        write_varint(writer, count);
+
+        const size_t pad = padding(writer.size(), alignof(T));
+        if(pad)
+            std::memset(writer.append(pad), 0, pad);
+
+        if constexpr(has_byte_order_v<T>)
+            writer.write_array(data, count);
+        else
+            writer.write_bytes(data, count * sizeof(T));
+    }
+
+    /**
+     * @brief 读取整块存储的数组的头部，返回元素数并跳过补齐
+     */
+    template<typename T>
+    size_t read_bulk_header(binary_reader_t &reader)
+    {
+        const uint64_t count = read_varint(reader);
+        reader.skip((std::min)(
+            padding(reader.position(), alignof(T)), reader.remaining()));
+        if(count > reader.remaining() / sizeof(T))
+            throw_invalid("truncated array");
+        return static_cast<size_t>(count);
+    }
+
+    template<typename T>
+    void read_bulk(binary_reader_t &reader, T *output, size_t count)
+    {
+        if constexpr(has_byte_order_v<T>)
+            reader.read_array(output, count);
+        else
+            reader.read_bytes(output, count * sizeof(T));
+    }
+
+    template<typename T>
+    void write_integer(binary_writer_t &writer, T value)
+    {
+        if constexpr(std::is_signed_v<T>)
+        {
+            const int64_t v = value;
+            write_varint(writer, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+        }
+        else
+            write_varint(writer, value);
+    }
+
+    template<typename T>
+    void read_integer(binary_reader_t &reader, T &value)
+    {
+        const uint64_t u = read_varint(reader);
+        if constexpr(std::is_signed_v<T>)
+        {
+            const int64_t v = static_cast<int64_t>(u >> 1) ^ -static_cast<int64_t>(u & 1);
+            if(v < (std::numeric_limits<T>::min)() ||
+               v > (std::numeric_limits<T>::max)())
+                throw_invalid("integer out of range");
+            value = static_cast<T>(v);
+        }
+        else
+        {
+            if(u > (std::numeric_limits<T>::max)())
+                throw_invalid("integer out of range");
+            value = static_cast<T>(u);
+        }
+    }
+
+    template<typename T>
+    void write_reflected(binary_writer_t &writer, const T &value)
+    {
+        const auto &tags = member_tags<T>();
+
+        write_varint(writer, serialize_version<T>());
+        write_varint(writer, tags.size());
+
+        size_t index = 0;
+        refl::for_each_member_variable<T>([&](auto mem_ptr, const char *)
+        {
+            using member_t = rm_rcv_ref_t<decltype(value.*mem_ptr)>;
+
+            write_varint(writer, tags[index++]);
+
+            const size_t length_pos = writer.size();
+            writer.append(8);
+            serializer_t<member_t>::write(writer, value.*mem_ptr);
+            write_fixed64(
+                writer.data() + length_pos, writer.size() - length_pos - 8);
+        });
+    }
+
+    template<typename T>
+    void read_reflected(binary_reader_t &reader, T &value)
+    {
+        const auto &tags = member_tags<T>();
+
+        const uint64_t version = read_varint(reader);
+        if(version > serialize_version<T>())
+            throw_invalid("data is newer than the type");
+
+        const uint64_t count = read_varint(reader);
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            const uint64_t tag = read_varint(reader);
+            const uint64_t length = read_fixed64(reader);
+            if(length > reader.remaining())
+                throw_invalid("truncated member");
+            const size_t end = reader.position() + static_cast<size_t>(length);
+
+            // 成员未变化时第i个成员就是要找的
+
+            size_t target = i < tags.size() && tags[i] == tag ? i : tags.size();
+            for(size_t j = 0; target == tags.size() && j < tags.size(); ++j)
+            {
+                if(tags[j] == tag)
+                    target = j;
+            }
+
+            if(target == tags.size())
+            {
+                reader.seek(end);
+                continue;
+            }
+
+            size_t index = 0;
+            refl::for_each_member_variable<T>([&](auto mem_ptr, const char *)
+            {
+                using member_t = rm_rcv_ref_t<decltype(value.*mem_ptr)>;
+                if(index++ == target)
+                    serializer_t<member_t>::read(reader, value.*mem_ptr);
+            });
+
+            if(reader.position() != end)
+                throw_invalid("member size mismatch");
+        }
+
+        if constexpr(is_detected_v<upgrade_serialized_t, T>)
+        {
+            if(version < serialize_version<T>())
+                value.upgrade_serialized(static_cast<uint32_t>(version));
+        }
+    }
+
+} // namespace serialize_impl
+
+template<typename T, typename>
+struct serializer_t
+{
+    static constexpr bool default_format = true;
+
+    static void write(binary_writer_t &writer, const T &value)
+    {
+        using namespace serialize_impl;
+
+        if constexpr(std::is_same_v<T, bool>)
+            writer.write<uint8_t>(value ? 1 : 0);
+        else if constexpr(std::is_enum_v<T>)
+            write_integer(writer, static_cast<std::underlying_type_t<T>>(value));
+        else if constexpr(std::is_integral_v<T>)
+            write_integer(writer, value);
+        else if constexpr(std::is_floating_point_v<T>)
+            writer.write(value);
+        else if constexpr(refl::is_reflected_v<T>)
+            write_reflected(writer, value);
+        else if constexpr(is_std_array_t<T>::value)
+        {
+            using elem_t = typename T::value_type;
+            if constexpr(has_byte_order_v<elem_t>)
+                writer.write_array(value.data(), value.size());
+            else if constexpr(is_bulk_v<elem_t>)
+                writer.write_bytes(value.data(), sizeof(T));
+            else
+            {
+                for(auto &elem : value)
+                    serializer_t<elem_t>::write(writer, elem);
+            }
+        }
+        else if constexpr(is_instance_of_v<T, std::optional>)
+        {
+            writer.write<uint8_t>(value.has_value() ? 1 : 0);
+            if(value)
+                serializer_t<typename T::value_type>::write(writer, *value);
+        }
+        else if constexpr(is_instance_of_v<T, std::pair> ||
+                          is_instance_of_v<T, std::tuple>)
+        {
+            std::apply([&](const auto &...elems)
+            {
+                (serializer_t<rm_rcv_ref_t<decltype(elems)>>::write(writer, elems), ...);
+            }, value);
+        }
+        else if constexpr(is_instance_of_v<T, span>)
+        {
+            using elem_t = std::remove_const_t<typename T::value_t>;
+            static_assert(is_bulk_v<elem_t>);
+            write_bulk(writer, value.data(), value.size());
+        }
+        else if constexpr(is_bulk_container_v<T>)
+        {
+            write_bulk(writer, std::data(value), std::size(value));
+        }
+        else if constexpr(is_detected_v<range_t, T>)
+        {
+            using elem_t = typename T::value_type;
+            write_varint(writer, std::size(value));
+            for(auto &&elem : value)
+                serializer_t<elem_t>::write(writer, elem);
+        }
+        else
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "unserializable type");
+            writer.write_bytes(&value, sizeof(T));
+        }
+    }
+
+    static void read(binary_reader_t &reader, T &value)
+    {
+        using namespace serialize_impl;
+
+        if constexpr(std::is_same_v<T, bool>)
+        {
+            const uint8_t v = reader.read<uint8_t>();
+            if(v > 1)
+                throw_invalid("invalid bool");
+            value = v != 0;
+        }
+        else if constexpr(std::is_enum_v<T>)
+        {
+            std::underlying_type_t<T> v;
+            read_integer(reader, v);
+            value = static_cast<T>(v);
+        }
+        else if constexpr(std::is_integral_v<T>)
+            read_integer(reader, value);
+        else if constexpr(std::is_floating_point_v<T>)
+            value = reader.read<T>();
+        else if constexpr(refl::is_reflected_v<T>)
+            read_reflected(reader, value);
+        else if constexpr(is_std_array_t<T>::value)
+        {
+            using elem_t = typename T::value_type;
+            if constexpr(has_byte_order_v<elem_t>)
+                reader.read_array(value.data(), value.size());
+            else if constexpr(is_bulk_v<elem_t>)
+                reader.read_bytes(value.data(), sizeof(T));
+            else
+            {
+                for(auto &elem : value)
+                    serializer_t<elem_t>::read(reader, elem);
+            }
+        }
+        else if constexpr(is_instance_of_v<T, std::optional>)
+        {
+            const uint8_t has_value = reader.read<uint8_t>();
+            if(has_value > 1)
+                throw_invalid("invalid optional flag");
+
+            if(has_value)
+            {
+                if(!value)
+                    value.emplace();
+                serializer_t<typename T::value_type>::read(reader, *value);
+            }
+            else
+                value.reset();
+        }
+        else if constexpr(is_instance_of_v<T, std::pair> ||
+                          is_instance_of_v<T, std::tuple>)
+        {
+            std::apply([&](auto &...elems)
+            {
+                (serializer_t<rm_rcv_ref_t<decltype(elems)>>::read(reader, elems), ...);
+            }, value);
+        }
+        else if constexpr(is_instance_of_v<T, span>)
+        {
+            // 只有span<const U>可以读取，得到的span直接引用reader中的数据
+
+            using elem_t = typename T::value_t;
+            static_assert(std::is_const_v<elem_t>);
+            using bulk_t = std::remove_const_t<elem_t>;
+            static_assert(is_bulk_v<bulk_t>);
+
+            const size_t count = read_bulk_header<bulk_t>(reader);
+            if(has_byte_order_v<bulk_t> && reader.endian() != endian_type::local)
+                throw_invalid("cannot reference data with a different byte order");
+
+            const unsigned char *data = reader.read_bytes(count * sizeof(bulk_t));
+            if(reinterpret_cast<uintptr_t>(data) % alignof(bulk_t))
+                throw_invalid("misaligned array data");
+
+            value = count ? T(reinterpret_cast<elem_t *>(data), count) : T();
+        }
+        else if constexpr(is_bulk_container_v<T>)
+        {
+            using elem_t = rm_rcv_ref_t<decltype(*std::data(value))>;
+            const size_t count = read_bulk_header<elem_t>(reader);
+            value.resize(count);
+            read_bulk(reader, std::data(value), count);
+        }
+        else if constexpr(is_detected_v<range_t, T>)
+        {
+            const uint64_t count = read_varint(reader);
+            if(count > reader.remaining())
+                throw_invalid("truncated range");
+
+            if constexpr(is_detected_v<resize_t, T>)
+            {
+                using elem_t = typename T::value_type;
+
+                value.clear();
+                value.resize(static_cast<size_t>(count));
+                for(auto &&elem : value)
+                {
+                    if constexpr(std::is_lvalue_reference_v<decltype(elem)>)
+                        serializer_t<elem_t>::read(reader, elem);
+                    else
+                    {
+                        // std::vector<bool>等以代理对象访问元素的容器
+                        elem_t e{};
+                        serializer_t<elem_t>::read(reader, e);
+                        elem = e;
+                    }
+                }
+            }
+            else
+            {
+                using elem_t = typename mutable_value_t<
+                    typename T::value_type>::type;
+
+                value.clear();
+                for(uint64_t i = 0; i < count; ++i)
+                {
+                    elem_t elem{};
+                    serializer_t<elem_t>::read(reader, elem);
+                    value.insert(value.end(), std::move(elem));
+                }
+            }
+        }
+        else
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "unserializable type");
+            reader.read_bytes(&value, sizeof(T));
+        }
+    }
+};
+
+template<typename T>
+void serialize(binary_writer_t &writer, const T &value)
+{
+    serializer_t<T>::write(writer, value);
+}
+
+template<typename T>
+std::vector<unsigned char> serialize(const T &value)
+{
+    binary_writer_t writer(endian_type::little);
+    serialize(writer, value);
+    return writer.take();
+}
+
+template<typename T>
+void deserialize(binary_reader_t &reader, T &value)
+{
+    serializer_t<T>::read(reader, value);
+}
+
+template<typename T>
+T deserialize(const void *data, size_t byte_size)
+{
+    binary_reader_t reader(data, byte_size, endian_type::little);
+    T ret{};
+    deserialize(reader, ret);
+    return ret;
+}
+
+} // namespace agz::misc
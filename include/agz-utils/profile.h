@@ -0,0 +1,4 @@
+#pragma once
+
+#include "profile/profiler.h"
+#include "profile/metrics.h"
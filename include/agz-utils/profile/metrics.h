@@ -0,0 +1,334 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#   include <intrin.h>
+#endif
+
+#include "../math/math.h"
+#include "../misc/uncopyable.h"
+#include "../thread/spinlock.h"
+
+/*
+ * 可在多个线程间共享的运行时统计量。
+ *
+ * 计数器、直方图和分布将数据分散到若干分片中，每个线程固定写入其中一个，
+ * 以减少缓存行争用；读取时合并所有分片。读取不阻塞写入，
+ * 但与写入同时进行时得到的各字段可能不完全一致。
+ */
+
+namespace agz::profile
+{
+
+namespace metrics_impl
+{
+
+    constexpr size_t SHARD_COUNT = 16;
+
+    size_t next_shard_index() noexcept;
+
+    /**
+     * @brief 当前线程写入的分片下标
+     */
+    inline size_t shard_index() noexcept
+    {
+        static thread_local const size_t index = next_shard_index();
+        return index;
+    }
+
+} // namespace metrics_impl
+
+/**
+ * @brief 单调（或可增可减）的整数计数器
+ */
+class counter_t : public misc::uncopyable_t
+{
+    struct alignas(64) shard_t
+    {
+        std::atomic<int64_t> value = { 0 };
+    };
+
+    std::array<shard_t, metrics_impl::SHARD_COUNT> shards_;
+
+public:
+
+    void add(int64_t delta = 1) noexcept
+    {
+        shards_[metrics_impl::shard_index()].value.fetch_add(
+            delta, std::memory_order_relaxed);
+    }
+
+    int64_t value() const noexcept;
+
+    void reset() noexcept;
+};
+
+/**
+ * @brief 表示当前状态的值，如队列长度
+ */
+class gauge_t : public misc::uncopyable_t
+{
+    std::atomic<double> value_ = { 0 };
+
+public:
+
+    void set(double value) noexcept
+    {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    void add(double delta) noexcept
+    {
+        double old = value_.load(std::memory_order_relaxed);
+        while(!value_.compare_exchange_weak(
+            old, old + delta, std::memory_order_relaxed))
+            ;
+    }
+
+    double value() const noexcept
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief 直方图的快照
+ */
+struct histogram_snapshot_t
+{
+    uint64_t count = 0;
+    uint64_t sum   = 0;
+    uint64_t min   = 0;
+    uint64_t max   = 0;
+
+    // 下标同histogram_t::bucket_index，count为0时为空
+    std::vector<uint64_t> buckets;
+
+    double mean() const noexcept;
+
+    /**
+     * @brief 至少p%的样本小于等于返回值，p位于[0, 100]
+     *
+     * 返回值是样本所在的桶的上界，相对误差不超过1 / histogram_t::SUB_BUCKET_COUNT
+     */
+    uint64_t percentile(double p) const noexcept;
+};
+
+/**
+ * @brief 非负整数（如以纳秒为单位的耗时）的对数-线性分桶直方图
+ *
+ * 小于SUB_BUCKET_COUNT的值各自占一个桶；更大的值按最高位分组，
+ * 每组再均分为SUB_BUCKET_COUNT个桶，因此桶的宽度与值的比例不超过1 / SUB_BUCKET_COUNT。
+ * 每个分片的桶在对应线程第一次记录时分配
+ */
+class histogram_t : public misc::uncopyable_t
+{
+public:
+
+    static constexpr int    SUB_BUCKET_BITS  = 5;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT     = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    histogram_t();
+
+    ~histogram_t();
+
+    /**
+     * @brief 记录count个值为value的样本
+     */
+    void record(uint64_t value, uint64_t count = 1) noexcept
+    {
+        shard_t *shard = get_shard();
+        if(!shard)
+            return;
+
+        shard->buckets[bucket_index(value)].fetch_add(count, std::memory_order_relaxed);
+        shard->count.fetch_add(count, std::memory_order_relaxed);
+        shard->sum.fetch_add(value * count, std::memory_order_relaxed);
+
+        uint64_t old_min = shard->min.load(std::memory_order_relaxed);
+        while(value < old_min && !shard->min.compare_exchange_weak(
+            old_min, value, std::memory_order_relaxed))
+            ;
+
+        uint64_t old_max = shard->max.load(std::memory_order_relaxed);
+        while(value > old_max && !shard->max.compare_exchange_weak(
+            old_max, value, std::memory_order_relaxed))
+            ;
+    }
+
+    histogram_snapshot_t snapshot() const;
+
+    void reset() noexcept;
+
+    static size_t bucket_index(uint64_t value) noexcept
+    {
+        if(value < SUB_BUCKET_COUNT)
+            return static_cast<size_t>(value);
+
+        const int shift = highest_bit(value) - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKET_COUNT +
+               static_cast<size_t>((value >> shift) - SUB_BUCKET_COUNT);
+    }
+
+    /**
+     * @brief 落入第index个桶的最小值
+     */
+    static uint64_t bucket_lower(size_t index) noexcept;
+
+    /**
+     * @brief 落入第index个桶的最大值
+     */
+    static uint64_t bucket_upper(size_t index) noexcept;
+
+private:
+
+    struct shard_t
+    {
+        std::atomic<uint64_t> buckets[BUCKET_COUNT];
+
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> min;
+        std::atomic<uint64_t> max;
+
+        shard_t() noexcept;
+
+        void reset() noexcept;
+    };
+
+    static int highest_bit(uint64_t value) noexcept
+    {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<int>(index);
+#else
+        int ret = 0;
+        while(value >>= 1)
+            ++ret;
+        return ret;
+#endif
+    }
+
+    shard_t *get_shard() noexcept
+    {
+        auto &slot = shards_[metrics_impl::shard_index()];
+        shard_t *shard = slot.load(std::memory_order_acquire);
+        return shard ? shard : create_shard(slot);
+    }
+
+    shard_t *create_shard(std::atomic<shard_t *> &slot) noexcept;
+
+    std::array<std::atomic<shard_t *>, metrics_impl::SHARD_COUNT> shards_;
+};
+
+/**
+ * @brief 实数样本的均值和方差
+ *
+ * 每个分片以自旋锁保护一个variance_computer_t，读取时依次锁住各分片并合并，
+ * 每个分片被锁住的时间只够复制其状态
+ */
+class distribution_t : public misc::uncopyable_t
+{
+public:
+
+    using computer_t = math::variance_computer_t<double, uint64_t>;
+
+    void add(double value) noexcept
+    {
+        auto &shard = shards_[metrics_impl::shard_index()];
+        std::lock_guard lk(shard.lock);
+        shard.computer.add(value);
+    }
+
+    computer_t snapshot() const;
+
+    void reset() noexcept;
+
+private:
+
+    struct alignas(64) shard_t
+    {
+        mutable thread::spinlock_t lock;
+        computer_t computer;
+    };
+
+    std::array<shard_t, metrics_impl::SHARD_COUNT> shards_;
+};
+
+/**
+ * @brief 某一时刻所有统计量的值
+ */
+struct metrics_snapshot_t
+{
+    std::map<std::string, int64_t>                  counters;
+    std::map<std::string, double>                   gauges;
+    std::map<std::string, histogram_snapshot_t>     histograms;
+    std::map<std::string, distribution_t::computer_t> distributions;
+
+    /**
+     * @brief 每个统计量一行的文本
+     */
+    std::string to_text() const;
+
+    std::string to_json() const;
+};
+
+/**
+ * @brief 按名字管理统计量
+ *
+ * 创建和查找需要加锁，因此应保存返回的引用而非每次都按名字查找。
+ * 返回的引用在registry销毁前一直有效
+ */
+class metrics_registry_t : public misc::uncopyable_t
+{
+public:
+
+    /**
+     * @brief 取得名为name的统计量，不存在时创建
+     *
+     * @exception std::runtime_error name已被用于其他种类的统计量
+     */
+    counter_t      &counter     (const std::string &name);
+    gauge_t        &gauge       (const std::string &name);
+    histogram_t    &histogram   (const std::string &name);
+    distribution_t &distribution(const std::string &name);
+
+    /**
+     * @brief 读取所有统计量，只阻塞统计量的创建
+     */
+    metrics_snapshot_t snapshot() const;
+
+    /**
+     * @brief 清空所有统计量的值（不含gauge_t）
+     */
+    void reset();
+
+private:
+
+    template<typename T>
+    T &get_or_create(
+        std::map<std::string, std::unique_ptr<T>> &metrics, const std::string &name);
+
+    bool contains(const std::string &name) const;
+
+    mutable std::mutex mutex_;
+
+    std::map<std::string, std::unique_ptr<counter_t>>      counters_;
+    std::map<std::string, std::unique_ptr<gauge_t>>        gauges_;
+    std::map<std::string, std::unique_ptr<histogram_t>>    histograms_;
+    std::map<std::string, std::unique_ptr<distribution_t>> distributions_;
+};
+
+} // namespace agz::profile
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <x86intrin.h>
+#   define AGZ_PROFILE_RDTSC
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   include <intrin.h>
+#   define AGZ_PROFILE_RDTSC
+#endif
+
+#include "../common/common.h"
+#include "../misc/uncopyable.h"
+
+/*
+ * 定义AGZ_ENABLE_PROFILE时（参见CMakeLists.txt中的同名选项），
+ * AGZ_PROFILE_ZONE等宏记录其所在作用域的开始和结束时刻，否则这些宏展开为空。
+ *
+ * 每个线程将事件写入只属于自己的缓冲区，写入时不加锁；
+ * 导出时将所有线程的事件汇总为Chrome trace（chrome://tracing或Perfetto可打开）、
+ * 调用树或文本摘要。
+ */
+
+#ifdef AGZ_ENABLE_PROFILE
+
+/**
+ * @brief 记录当前作用域，NAME须为具有静态存储期的字符串
+ */
+#define AGZ_PROFILE_ZONE(NAME) \
+    ::agz::profile::zone_t AGZ_ANONYMOUS_NAME(_agz_profile_zone)(NAME)
+
+/**
+ * @brief 以函数名记录当前函数
+ */
+#define AGZ_PROFILE_FUNCTION() AGZ_PROFILE_ZONE(__func__)
+
+/**
+ * @brief 设置当前线程在导出结果中的名字
+ */
+#define AGZ_PROFILE_THREAD_NAME(NAME) ::agz::profile::set_thread_name(NAME)
+
+#else
+
+#define AGZ_PROFILE_ZONE(NAME)        do { } while(false)
+#define AGZ_PROFILE_FUNCTION()        do { } while(false)
+#define AGZ_PROFILE_THREAD_NAME(NAME) do { } while(false)
+
+#endif
+
+namespace agz::profile
+{
+
+/**
+ * @brief 运行时开启或关闭记录，默认开启
+ *
+ * 关闭时zone_t只读取一个原子变量
+ */
+void set_enabled(bool enabled) noexcept;
+
+bool is_enabled() noexcept;
+
+/**
+ * @brief 设置当前线程在导出结果中的名字
+ */
+void set_thread_name(std::string name);
+
+/**
+ * @brief 丢弃已记录的所有事件，并释放已退出的线程的缓冲区
+ *
+ * 调用时不得有其他线程正在记录
+ */
+void reset();
+
+/**
+ * @brief 调用树中的节点
+ *
+ * 同一父节点下的同名区域被合并为一个节点，不同线程的调用树也按路径合并
+ */
+struct call_tree_node_t
+{
+    std::string name;
+
+    uint64_t call_count = 0;
+
+    // 该区域的总耗时以及除去子区域后的耗时，单位为毫秒
+    double total_ms = 0;
+    double self_ms  = 0;
+
+    std::vector<call_tree_node_t> children;
+};
+
+/**
+ * @brief 将已记录的事件汇总为调用树
+ *
+ * 返回的根节点不对应任何区域，其total_ms为所有顶层区域的耗时之和
+ */
+call_tree_node_t build_call_tree();
+
+/**
+ * @brief 以Chrome trace event格式导出已记录的事件
+ */
+std::string to_chrome_trace();
+
+/**
+ * @brief 将to_chrome_trace的结果写入文件
+ *
+ * @exception std::runtime_error 无法写入文件
+ */
+void export_chrome_trace(const std::string &filename);
+
+/**
+ * @brief 以缩进文本的形式输出调用树
+ */
+std::string summary();
+
+namespace profile_impl
+{
+
+    struct event_t
+    {
+        const char *name;
+        uint64_t begin;
+        uint64_t end;
+        uint32_t depth;
+    };
+
+    /**
+     * @brief 单个线程的事件缓冲区
+     *
+     * 只有所属线程写入，写入事件后以release语义发布数量，
+     * 导出时其他线程以acquire语义读取数量后即可读取之前的事件
+     */
+    struct chunk_t
+    {
+        static constexpr size_t CAPACITY = 4096;
+
+        event_t events[CAPACITY];
+
+        std::atomic<size_t>    count = { 0 };
+        std::atomic<chunk_t *> next  = { nullptr };
+    };
+
+    struct thread_buffer_t : misc::uncopyable_t
+    {
+        chunk_t *head  = nullptr;
+        chunk_t *tail  = nullptr;
+
+        uint32_t depth = 0;
+
+        // 所属线程退出后置为true，此后reset可以释放该缓冲区
+        std::atomic<bool> finished = { false };
+
+        // 分配新的块失败时丢弃事件
+        void push(const event_t &event) noexcept
+        {
+            size_t n = tail->count.load(std::memory_order_relaxed);
+            if(n == chunk_t::CAPACITY)
+            {
+                if(!grow())
+                    return;
+                n = 0;
+            }
+            tail->events[n] = event;
+            tail->count.store(n + 1, std::memory_order_release);
+        }
+
+        bool grow() noexcept;
+    };
+
+    inline std::atomic<bool> enabled = { true };
+
+    inline thread_local thread_buffer_t *local_buffer = nullptr;
+
+    // 当前线程的缓冲区已被标记为finished，不再记录
+    inline thread_local bool local_finished = false;
+
+    thread_buffer_t *register_thread();
+
+    inline thread_buffer_t *get_local_buffer() noexcept
+    {
+        if(!local_buffer)
+        {
+            if(local_finished)
+                return nullptr;
+            try
+            {
+                local_buffer = register_thread();
+            }
+            catch(...)
+            {
+                return nullptr;
+            }
+        }
+        return local_buffer;
+    }
+
+    /**
+     * @brief 当前时刻，x86上为时间戳计数器，否则为steady_clock的纳秒数
+     */
+    inline uint64_t ticks() noexcept
+    {
+#ifdef AGZ_PROFILE_RDTSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+} // namespace profile_impl
+
+/**
+ * @brief 记录从构造到析构的时间区间
+ */
+class zone_t : public misc::uncopyable_t
+{
+    profile_impl::thread_buffer_t *buffer_;
+
+    const char *name_;
+    uint64_t    begin_;
+    uint32_t    depth_;
+
+public:
+
+    explicit zone_t(const char *name) noexcept
+        : buffer_(nullptr), name_(name), begin_(0), depth_(0)
+    {
+        if(!profile_impl::enabled.load(std::memory_order_relaxed))
+            return;
+
+        buffer_ = profile_impl::get_local_buffer();
+        if(!buffer_)
+            return;
+
+        depth_ = buffer_->depth++;
+        begin_ = profile_impl::ticks();
+    }
+
+    ~zone_t()
+    {
+        if(!buffer_)
+            return;
+
+        const uint64_t end = profile_impl::ticks();
+        --buffer_->depth;
+        buffer_->push({ name_, begin_, end, depth_ });
+    }
+};
+
+} // namespace agz::profile
@@ -1,3 +1,4 @@
 ﻿#pragma once
 
 #include "string/stdstr.h"
+#include "string/tokenize.h"
@@ -2,6 +2,7 @@
 
 #include <cctype>
 #include <iterator>
+#include <limits>
 #include <sstream>
 
 #include "../../misc/type_list.h"
@@ -162,20 +163,12 @@ template<typename TIt>
 size_t split(
     std::string_view src, char splitter, TIt out_iterator, bool rm_empty_result)
 {
-    size_t beg = 0, ret = 0;
-    while(beg < src.size())
+    size_t ret = 0;
+    for(std::string_view token : split_view(src, splitter, rm_empty_result))
     {
-        size_t end = beg;
-        while(end < src.size() && src[end] != splitter)
-            ++end;
-        if(end != beg || !rm_empty_result)
-        {
-            ++ret;
-            out_iterator = typename TIt::container_type::value_type(
-                src.substr(beg, end - beg));
-            ++out_iterator;
-        }
-        beg = end + 1;
+        ++ret;
+        out_iterator = typename TIt::container_type::value_type(token);
+        ++out_iterator;
     }
     return ret;
 }
@@ -185,29 +178,12 @@ size_t split(
     std::string_view src, std::string_view splitter, TIt out_iterator,
     bool rm_empty_result)
 {
-    size_t beg = 0, ret = 0;
-    while(beg < src.size())
+    size_t ret = 0;
+    for(std::string_view token : split_view(src, splitter, rm_empty_result))
     {
-        size_t end = src.find(splitter, beg);
-
-        if(end == std::string::npos)
-        {
-            ++ret;
-            out_iterator = typename TIt::container_type::value_type(
-                src.substr(beg, src.size() - beg));
-            ++out_iterator;
-            break;
-        }
-
-        if(end != beg || !rm_empty_result)
-        {
-            ++ret;
-            out_iterator = typename TIt::container_type::value_type(
-                src.substr(beg, end - beg));
-            ++out_iterator;
-        }
-
-        beg = end + splitter.size();
+        ++ret;
+        out_iterator = typename TIt::container_type::value_type(token);
+        ++out_iterator;
     }
     return ret;
 }
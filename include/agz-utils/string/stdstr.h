@@ -6,6 +6,8 @@
 #include <string_view>
 #include <vector>
 
+#include "./tokenize.h"
+
 namespace agz::stdstr
 {
 
@@ -72,6 +74,8 @@ std::string join(std::string_view joiner, TIt begin, TIt end);
  * @param rm_empty_result 是否移除分割结果中的空串
  * 
  * @return 分割得到的所有字符串构成的vector
+ *
+ * 不需要复制分割结果时，可使用./tokenize.h中的split_view
  */
 inline std::vector<std::string> split(
     std::string_view src, char splitter, bool rm_empty_result = true);
@@ -138,6 +142,9 @@ inline std::string replace(
  * @brief 把一个字符串转为指定的数值类型
  * 
  * 支持：(unsigned) int, (unsigned) long, (unsigned) long long, float, double, long double
+ *
+ * 基于std::sto*，会忽略开头的空白和末尾的非数值字符；
+ * 严格且不分配内存的解析参见./tokenize.h中的parse_number
  */
 template<typename T>
 T from_string(const std::string &str);
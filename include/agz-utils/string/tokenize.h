@@ -0,0 +1,398 @@
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "../misc/span.h"
+
+/*
+ * 不分配内存的分割与数值解析。
+ *
+ * split_view等函数返回惰性求值的范围，迭代得到的std::string_view均指向原字符串，
+ * 原字符串须在迭代期间保持有效。
+ */
+
+namespace agz::stdstr
+{
+
+/**
+ * @brief 在[beg, end)中查找第一个属于chars的字符，找不到时返回end
+ *
+ * chars不超过8个字符时使用SIMD指令（若处理器支持）
+ */
+const char *find_first_of(
+    const char *beg, const char *end, std::string_view chars) noexcept;
+
+/**
+ * @brief 在str中从pos开始查找第一个属于chars的字符，找不到时返回npos
+ */
+inline size_t find_first_of(
+    std::string_view str, std::string_view chars, size_t pos = 0) noexcept
+{
+    if(pos >= str.size())
+        return std::string_view::npos;
+    const char *end = str.data() + str.size();
+    const char *ret = find_first_of(str.data() + pos, end, chars);
+    return ret == end ? std::string_view::npos : size_t(ret - str.data());
+}
+
+/**
+ * @brief 分割结果的惰性范围，参见split_view、split_any_view和lines
+ *
+ * 分割规则同split：分隔符之后到字符串末尾的空串不会被输出
+ */
+class split_view_t
+{
+public:
+
+    enum class mode_t
+    {
+        single_char, // 以一个字符分割
+        substring,   // 以一个字符串分割
+        any_of,      // 以若干字符中的任意一个分割
+        line         // 以'\n'分割，并去掉结果末尾的'\r'
+    };
+
+    class iterator
+    {
+    public:
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::string_view;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const std::string_view*;
+        using reference         = const std::string_view&;
+
+        iterator() noexcept
+            : view_(nullptr), pos_(0), at_end_(true)
+        {
+
+        }
+
+        reference operator*() const noexcept
+        {
+            return token_;
+        }
+
+        pointer operator->() const noexcept
+        {
+            return &token_;
+        }
+
+        iterator &operator++() noexcept
+        {
+            advance();
+            return *this;
+        }
+
+        iterator operator++(int) noexcept
+        {
+            iterator ret = *this;
+            advance();
+            return ret;
+        }
+
+        bool operator==(const iterator &rhs) const noexcept
+        {
+            if(at_end_ || rhs.at_end_)
+                return at_end_ == rhs.at_end_;
+            return token_.data() == rhs.token_.data();
+        }
+
+        bool operator!=(const iterator &rhs) const noexcept
+        {
+            return !(*this == rhs);
+        }
+
+    private:
+
+        friend class split_view_t;
+
+        explicit iterator(const split_view_t *view) noexcept
+            : view_(view), pos_(0), at_end_(false)
+        {
+            advance();
+        }
+
+        void advance() noexcept;
+
+        const split_view_t *view_;
+        size_t              pos_;
+        std::string_view    token_;
+        bool                at_end_;
+    };
+
+    split_view_t(
+        std::string_view src, std::string_view splitter,
+        mode_t mode, bool rm_empty_result) noexcept
+        : src_(src), splitter_(splitter), mode_(mode),
+          rm_empty_result_(rm_empty_result), splitter_char_('\0')
+    {
+        if(mode_ == mode_t::single_char || mode_ == mode_t::line)
+        {
+            splitter_char_ = mode_ == mode_t::line ? '\n' : splitter[0];
+            splitter_      = {};
+        }
+    }
+
+    /**
+     * @brief 返回的迭代器引用*this，须在其使用期间保持有效
+     */
+    iterator begin() const noexcept
+    {
+        return iterator(this);
+    }
+
+    iterator end() const noexcept
+    {
+        return iterator();
+    }
+
+private:
+
+    /**
+     * @brief 从pos开始查找下一个分隔符，返回其位置和长度；找不到时返回(src_.size(), 1)
+     */
+    std::pair<size_t, size_t> find_splitter(size_t pos) const noexcept
+    {
+        const char *beg = src_.data() + pos;
+        const char *end = src_.data() + src_.size();
+
+        switch(mode_)
+        {
+        case mode_t::single_char:
+        case mode_t::line:
+            {
+                auto p = static_cast<const char*>(
+                    std::memchr(beg, splitter_char_, size_t(end - beg)));
+                return { p ? size_t(p - src_.data()) : src_.size(), 1 };
+            }
+        case mode_t::any_of:
+            return { size_t(find_first_of(beg, end, splitter_) - src_.data()), 1 };
+        case mode_t::substring:
+            if(!splitter_.empty())
+            {
+                const size_t p = src_.find(splitter_, pos);
+                if(p != std::string_view::npos)
+                    return { p, splitter_.size() };
+            }
+            break;
+        }
+
+        return { src_.size(), 1 };
+    }
+
+    std::string_view src_;
+    std::string_view splitter_;
+    mode_t           mode_;
+    bool             rm_empty_result_;
+    char             splitter_char_;
+};
+
+inline void split_view_t::iterator::advance() noexcept
+{
+    const std::string_view src = view_->src_;
+    while(pos_ < src.size())
+    {
+        const auto [end, splitter_size] = view_->find_splitter(pos_);
+        const size_t beg = pos_;
+        pos_ = end + splitter_size;
+
+        if(end != beg || !view_->rm_empty_result_)
+        {
+            token_ = src.substr(beg, end - beg);
+            if(view_->mode_ == mode_t::line &&
+               !token_.empty() && token_.back() == '\r')
+                token_.remove_suffix(1);
+            return;
+        }
+    }
+    at_end_ = true;
+}
+
+/**
+ * @brief 以一个字符为分隔符惰性地分割一个字符串
+ *
+ * 结果同split(src, splitter, rm_empty_result)，但不复制任何字符
+ */
+inline split_view_t split_view(
+    std::string_view src, char splitter, bool rm_empty_result = true) noexcept
+{
+    return split_view_t(
+        src, std::string_view(&splitter, 1),
+        split_view_t::mode_t::single_char, rm_empty_result);
+}
+
+/**
+ * @brief 以一个字符串为分隔符惰性地分割一个字符串
+ *
+ * 结果同split(src, splitter, rm_empty_result)，splitter须在迭代期间保持有效
+ */
+inline split_view_t split_view(
+    std::string_view src, std::string_view splitter,
+    bool rm_empty_result = true) noexcept
+{
+    return split_view_t(
+        src, splitter, split_view_t::mode_t::substring, rm_empty_result);
+}
+
+/**
+ * @brief 以delimiters中的任意一个字符为分隔符惰性地分割一个字符串
+ *
+ * 如split_any_view(line, " \t")可将一行按空白拆分为单词。
+ * delimiters须在迭代期间保持有效
+ */
+inline split_view_t split_any_view(
+    std::string_view src, std::string_view delimiters,
+    bool rm_empty_result = true) noexcept
+{
+    return split_view_t(
+        src, delimiters, split_view_t::mode_t::any_of, rm_empty_result);
+}
+
+/**
+ * @brief 惰性地逐行遍历文本
+ *
+ * 行尾的"\n"或"\r\n"不包含在结果中，保留空行，但最后一个换行符之后的空行除外
+ */
+inline split_view_t lines(std::string_view text) noexcept
+{
+    return split_view_t(text, {}, split_view_t::mode_t::line, false);
+}
+
+/**
+ * @brief 逐行遍历一段字节（如file::mapped_file_t::bytes()）
+ */
+inline split_view_t lines(misc::span<const unsigned char> bytes) noexcept
+{
+    return lines(std::string_view(
+        reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+}
+
+namespace stdstr_impl
+{
+
+    // 浮点数的std::from_chars需要较新的标准库（如GCC 11、MSVC 2019）
+#if defined(__cpp_lib_to_chars)
+    constexpr bool has_fp_from_chars = true;
+#else
+    constexpr bool has_fp_from_chars = false;
+#endif
+
+    template<typename T>
+    constexpr bool is_parsable_number_v =
+        (std::is_integral_v<T> && !std::is_same_v<T, bool>) ||
+        std::is_floating_point_v<T>;
+
+    template<typename T>
+    std::errc parse_number_impl(std::string_view str, T &value) noexcept
+    {
+        // std::from_chars不接受'+'，但from_string接受
+        if(!str.empty() && str[0] == '+')
+        {
+            str.remove_prefix(1);
+            if(!str.empty() && str[0] == '-')
+                return std::errc::invalid_argument;
+        }
+
+        if(str.empty())
+            return std::errc::invalid_argument;
+
+        const char *beg = str.data();
+        const char *end = beg + str.size();
+
+        if constexpr(std::is_floating_point_v<T> && !has_fp_from_chars)
+        {
+            // 标准库不支持浮点数的from_chars时退回到strtod
+
+            if(std::isspace(static_cast<unsigned char>(*beg)))
+                return std::errc::invalid_argument;
+
+            char local[64];
+            std::string heap;
+            const char *cstr;
+            if(str.size() < sizeof(local))
+            {
+                std::memcpy(local, beg, str.size());
+                local[str.size()] = '\0';
+                cstr = local;
+            }
+            else
+            {
+                heap = std::string(str);
+                cstr = heap.c_str();
+            }
+
+            char *ptr;
+            errno = 0;
+            if constexpr(std::is_same_v<T, float>)
+                value = std::strtof(cstr, &ptr);
+            else if constexpr(std::is_same_v<T, double>)
+                value = std::strtod(cstr, &ptr);
+            else
+                value = std::strtold(cstr, &ptr);
+
+            if(ptr != cstr + str.size())
+                return std::errc::invalid_argument;
+            return errno == ERANGE ? std::errc::result_out_of_range : std::errc();
+        }
+        else
+        {
+            T result;
+            const auto [ptr, ec] = std::from_chars(beg, end, result);
+            if(ec != std::errc())
+                return ec;
+            if(ptr != end)
+                return std::errc::invalid_argument;
+            value = result;
+            return std::errc();
+        }
+    }
+
+} // namespace stdstr_impl
+
+/**
+ * @brief 将整个str解析为数值
+ *
+ * 基于std::from_chars，不受locale影响，不接受首尾空白，允许开头的'+'。
+ * 失败时返回false且不修改value
+ */
+template<typename T>
+bool try_parse_number(std::string_view str, T &value) noexcept
+{
+    static_assert(stdstr_impl::is_parsable_number_v<T>,
+                  "unsupported dst type by agz::stdstr::try_parse_number");
+    return stdstr_impl::parse_number_impl(str, value) == std::errc();
+}
+
+/**
+ * @brief 将整个str解析为数值，规则同try_parse_number
+ *
+ * @exception std::out_of_range 数值超出T的表示范围
+ * @exception std::invalid_argument str不是合法的数值
+ */
+template<typename T>
+T parse_number(std::string_view str)
+{
+    static_assert(stdstr_impl::is_parsable_number_v<T>,
+                  "unsupported dst type by agz::stdstr::parse_number");
+
+    T ret = T(0);
+    const std::errc ec = stdstr_impl::parse_number_impl(str, ret);
+    if(ec == std::errc::result_out_of_range)
+        throw std::out_of_range("number out of range: " + std::string(str));
+    if(ec != std::errc())
+        throw std::invalid_argument("invalid number: " + std::string(str));
+    return ret;
+}
+
+} // namespace agz::stdstr
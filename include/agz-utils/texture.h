@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include "texture/distribution2d.h"
 #include "texture/mipmap.h"
 #include "texture/sample2d.h"
 #include "texture/sample3d.h"
@@ -0,0 +1,88 @@
+﻿#pragma once
+
+#include "./texture2d.h"
+
+namespace agz::texture
+{
+
+/**
+ * @brief 纹理上的二维分段常数分布，用于按亮度等权重对图像进行重要性采样
+ *
+ * 先按行和选出一行，再在该行中按纹素值选出一列，两步都使用alias表，
+ * 因此采样的代价与纹理大小无关。alias查表剩余的随机性被重新映射到[0, 1)，
+ * 用于在选中的纹素内均匀地生成连续坐标，故每个样本只消耗两个均匀随机数。
+ *
+ * 所有行的alias表连续地存放在同一组数组中。纹素值应非负，
+ * 纹素值全为零时退化为[0, 1]^2上的均匀分布
+ */
+template<typename F>
+class distribution2d_t
+{
+    static_assert(std::is_floating_point_v<F>, "");
+
+public:
+
+    using self_t = distribution2d_t<F>;
+
+    distribution2d_t() = default;
+
+    explicit distribution2d_t(const texture2d_t<F> &weights);
+
+    template<typename Policy>
+    distribution2d_t(const Policy &policy, const texture2d_t<F> &weights);
+
+    void initialize(const texture2d_t<F> &weights);
+
+    /**
+     * @brief 按执行策略构建，policy为math::exec::seq/par/par_unseq
+     *
+     * 各行的alias表被并行地构建
+     */
+    template<typename Policy>
+    void initialize(const Policy &policy, const texture2d_t<F> &weights);
+
+    bool available() const noexcept;
+
+    void destroy();
+
+    int width() const noexcept;
+
+    int height() const noexcept;
+
+    /**
+     * @brief 以两个[0, 1]间的均匀随机数采样一个纹理坐标
+     *
+     * 纹理坐标的约定同sample2d.h，即uv.x对应水平方向的x下标，uv.y对应垂直方向的y下标
+     *
+     * @return 纹理坐标，以及[0, 1]^2上w.r.t. uv面积的pdf
+     */
+    std::pair<math::tvec2<F>, F> sample(F u1, F u2) const noexcept;
+
+    /**
+     * @brief 纹理坐标uv处的pdf（w.r.t. uv面积）
+     */
+    F pdf(const math::tvec2<F> &uv) const noexcept;
+
+    /**
+     * @brief 纹素(y, x)处的pdf（w.r.t. uv面积）
+     */
+    F pdf(int y, int x) const noexcept;
+
+private:
+
+    int width_  = 0;
+    int height_ = 0;
+
+    std::vector<F>   row_accept_probs_;
+    std::vector<int> row_alias_indices_;
+
+    // 第y行的表项位于[y * width_, (y + 1) * width_)
+    std::vector<F>   accept_probs_;
+    std::vector<int> alias_indices_;
+
+    std::vector<F> pdfs_;
+};
+
+} // namespace agz::texture
+
+#include "impl/distribution2d.inl"
@@ -0,0 +1,244 @@
+﻿#pragma once
+
+#include <cmath>
+#include <limits>
+
+namespace agz::texture
+{
+
+namespace distribution2d_impl
+{
+
+    /**
+     * @brief 在alias表中以u查得一个下标，并将剩余的随机性映射为[0, 1)上的均匀随机数
+     */
+    template<typename F>
+    int lookup(
+        const F *accept_probs, const int *alias_indices, int n,
+        F u, F &remapped) noexcept
+    {
+        constexpr F ONE_MINUS_EPSILON =
+            1 - std::numeric_limits<F>::epsilon() / 2;
+
+        const F nu = n * u;
+        const int i = (std::min)(static_cast<int>(nu), n - 1);
+        const F s = (std::min)(nu - i, ONE_MINUS_EPSILON);
+        const F accept = accept_probs[i];
+
+        // 严格小于，以免s == 0时选中接受概率为0的表项
+        if(s < accept)
+        {
+            remapped = (std::min)(s / accept, ONE_MINUS_EPSILON);
+            return i;
+        }
+
+        remapped = (std::min)((s - accept) / (1 - accept), ONE_MINUS_EPSILON);
+        return alias_indices[i];
+    }
+
+    /**
+     * @brief 第i个纹素内偏移为d处的纹理坐标分量
+     *
+     * 舍入可能使坐标落入相邻的纹素，此时将其调整回来，以保证pdf(uv)与采样时的纹素一致
+     */
+    template<typename F>
+    F to_texture_coord(int i, F d, int n) noexcept
+    {
+        F c = (i + d) / n;
+        while(static_cast<int>(c * n) > i)
+            c = std::nextafter(c, F(0));
+        while(static_cast<int>(c * n) < i)
+            c = std::nextafter(c, F(1));
+        return c;
+    }
+
+    template<typename F>
+    void uniform_alias_table(F *accept_probs, int *alias_indices, int n) noexcept
+    {
+        for(int i = 0; i < n; ++i)
+        {
+            accept_probs[i]  = 1;
+            alias_indices[i] = i;
+        }
+    }
+
+} // namespace distribution2d_impl
+
+template<typename F>
+distribution2d_t<F>::distribution2d_t(const texture2d_t<F> &weights)
+{
+    this->initialize(weights);
+}
+
+template<typename F>
+template<typename Policy>
+distribution2d_t<F>::distribution2d_t(
+    const Policy &policy, const texture2d_t<F> &weights)
+{
+    this->initialize(policy, weights);
+}
+
+template<typename F>
+void distribution2d_t<F>::initialize(const texture2d_t<F> &weights)
+{
+    this->initialize(math::exec::seq, weights);
+}
+
+template<typename F>
+template<typename Policy>
+void distribution2d_t<F>::initialize(
+    const Policy &policy, const texture2d_t<F> &weights)
+{
+    assert(weights.is_available());
+
+    const int w = weights.width();
+    const int h = weights.height();
+    const size_t texel_count = static_cast<size_t>(w) * h;
+
+    std::vector<F> row_sums(h);
+    std::vector<F> accept_probs(texel_count);
+    std::vector<int> alias_indices(texel_count);
+
+    // 每块约含64K个纹素
+    const size_t rows_per_block = (std::max)(1, (1 << 16) / w);
+
+    math::exec_impl::for_each_block(policy, static_cast<size_t>(h), rows_per_block,
+        [&](size_t beg, size_t end)
+    {
+        for(size_t y = beg; y < end; ++y)
+        {
+            const F *row = weights.raw_data() + y * w;
+            F *row_accept_probs = accept_probs.data() + y * w;
+            int *row_alias_indices = alias_indices.data() + y * w;
+
+            double sum = 0;
+            for(int x = 0; x < w; ++x)
+            {
+                assert(row[x] >= 0);
+                sum += row[x];
+            }
+            row_sums[y] = static_cast<F>(sum);
+
+            if(sum > 0)
+            {
+                math::distribution::build_alias_table(
+                    math::exec::seq, row, w,
+                    row_accept_probs, row_alias_indices);
+            }
+            else
+            {
+                distribution2d_impl::uniform_alias_table(
+                    row_accept_probs, row_alias_indices, w);
+            }
+        }
+    });
+
+    double total = 0;
+    for(F s : row_sums)
+        total += s;
+
+    std::vector<F> row_accept_probs(h);
+    std::vector<int> row_alias_indices(h);
+    std::vector<F> pdfs(texel_count);
+
+    if(total > 0)
+    {
+        math::distribution::build_alias_table(
+            policy, row_sums.data(), h,
+            row_accept_probs.data(), row_alias_indices.data());
+
+        const double ratio = texel_count / total;
+        math::exec_impl::for_each_block(policy, texel_count, size_t(1) << 16,
+            [&](size_t beg, size_t end)
+        {
+            for(size_t i = beg; i < end; ++i)
+                pdfs[i] = static_cast<F>(weights.raw_data()[i] * ratio);
+        });
+    }
+    else
+    {
+        distribution2d_impl::uniform_alias_table(
+            row_accept_probs.data(), row_alias_indices.data(), h);
+        std::fill(pdfs.begin(), pdfs.end(), F(1));
+    }
+
+    width_  = w;
+    height_ = h;
+
+    row_accept_probs_.swap(row_accept_probs);
+    row_alias_indices_.swap(row_alias_indices);
+    accept_probs_.swap(accept_probs);
+    alias_indices_.swap(alias_indices);
+    pdfs_.swap(pdfs);
+}
+
+template<typename F>
+bool distribution2d_t<F>::available() const noexcept
+{
+    return !pdfs_.empty();
+}
+
+template<typename F>
+void distribution2d_t<F>::destroy()
+{
+    width_ = height_ = 0;
+    row_accept_probs_.clear();
+    row_alias_indices_.clear();
+    accept_probs_.clear();
+    alias_indices_.clear();
+    pdfs_.clear();
+}
+
+template<typename F>
+int distribution2d_t<F>::width() const noexcept
+{
+    return width_;
+}
+
+template<typename F>
+int distribution2d_t<F>::height() const noexcept
+{
+    return height_;
+}
+
+template<typename F>
+std::pair<math::tvec2<F>, F> distribution2d_t<F>::sample(
+    F u1, F u2) const noexcept
+{
+    assert(available());
+    assert(0 <= u1 && u1 <= 1);
+    assert(0 <= u2 && u2 <= 1);
+
+    F dy, dx;
+    const int y = distribution2d_impl::lookup(
+        row_accept_probs_.data(), row_alias_indices_.data(), height_, u1, dy);
+
+    const size_t row_offset = static_cast<size_t>(y) * width_;
+    const int x = distribution2d_impl::lookup(
+        accept_probs_.data() + row_offset, alias_indices_.data() + row_offset,
+        width_, u2, dx);
+
+    const math::tvec2<F> uv(
+        distribution2d_impl::to_texture_coord(x, dx, width_),
+        distribution2d_impl::to_texture_coord(y, dy, height_));
+    return { uv, pdfs_[row_offset + x] };
+}
+
+template<typename F>
+F distribution2d_t<F>::pdf(const math::tvec2<F> &uv) const noexcept
+{
+    assert(available());
+    const int x = math::clamp(static_cast<int>(uv.x * width_),  0, width_  - 1);
+    const int y = math::clamp(static_cast<int>(uv.y * height_), 0, height_ - 1);
+    return pdf(y, x);
+}
+
+template<typename F>
+F distribution2d_t<F>::pdf(int y, int x) const noexcept
+{
+    assert(available());
+    assert(0 <= y && y < height_ && 0 <= x && x < width_);
+    return pdfs_[static_cast<size_t>(y) * width_ + x];
+}
+
+} // namespace agz::texture
@@ -52,6 +52,14 @@ texture2d_t<T>::texture2d_t(data_t &&data) noexcept
     
 }
 
+template<typename T>
+template<typename E, typename>
+texture2d_t<T>::texture2d_t(const E &expr)
+    : data_(expr)
+{
+
+}
+
 template<typename T>
 texture2d_t<T>::texture2d_t(self_t &&move_from) noexcept
     : data_(std::move(move_from.data_))
@@ -66,6 +74,22 @@ texture2d_t<T> &texture2d_t<T>::operator=(self_t &&move_from) noexcept
     return *this;
 }
 
+template<typename T>
+template<typename E, typename>
+texture2d_t<T> &texture2d_t<T>::operator=(const E &expr)
+{
+    data_ = expr;
+    return *this;
+}
+
+template<typename T>
+template<typename E, typename>
+texture2d_t<T> &texture2d_t<T>::assign(const E &expr, int worker_count)
+{
+    data_.assign(expr, worker_count);
+    return *this;
+}
+
 template<typename T>
 void texture2d_t<T>::initialize(int h, int w, uninitialized_t)
 {
@@ -205,6 +229,22 @@ void texture2d_t<T>::map_inplace(Func &&func) const
     data_.map_inplace(std::forward<Func>(func));
 }
 
+template<typename T>
+template<typename Policy, typename Func>
+auto texture2d_t<T>::map(const Policy &policy, Func &&func) const
+{
+    using ret_pixel_t = rm_rcv_t<decltype(func(data_.at({ 0, 0 })))>;
+    return texture2d_t<ret_pixel_t>(
+        data_.map(policy, std::forward<Func>(func)));
+}
+
+template<typename T>
+template<typename Policy, typename Func>
+void texture2d_t<T>::map_inplace(const Policy &policy, Func &&func) const
+{
+    data_.map_inplace(policy, std::forward<Func>(func));
+}
+
 template<typename T>
 T *texture2d_t<T>::raw_data() noexcept
 {
@@ -222,7 +262,7 @@ void texture2d_t<T>::clear(const T &value)
 {
     if(!is_available())
         return;
-    for(int i = 0; i < data_.elem_count(); ++i)
+    for(size_t i = 0; i < data_.elem_count(); ++i)
         data_.raw_data()[i] = value;
 }
 
@@ -303,46 +343,6 @@ typename texture2d_t<T>::self_t texture2d_t<T>::flip_horizontally() const
     return ret;
 }
 
-template<typename T>
-template<typename S>
-auto texture2d_t<T>::operator+(const texture2d_t<S> &rhs) const
-{
-    assert(is_available() && rhs.is_available());
-    assert(width() == rhs.width());
-    assert(height() == rhs.height());
-
-    using texel_t = rm_rcv_t<decltype(std::declval<T>() + std::declval<S>())>;
-    texture2d_t<texel_t> ret(height(), width());
-
-    for(int y = 0; y < ret.height(); ++y)
-    {
-        for(int x = 0; x < ret.width(); ++x)
-            ret(y, x) = this->at(y, x) + rhs(y, x);
-    }
-
-    return ret;
-}
-
-template<typename T>
-template<typename S>
-auto texture2d_t<T>::operator*(const texture2d_t<S> &rhs) const
-{
-    assert(is_available() && rhs.is_available());
-    assert(width() == rhs.width());
-    assert(height() == rhs.height());
-
-    using texel_t = rm_rcv_t<decltype(std::declval<T>() * std::declval<S>())>;
-    texture2d_t<texel_t> ret(height(), width());
-
-    for(int y = 0; y < ret.height(); ++y)
-    {
-        for(int x = 0; x < ret.width(); ++x)
-            ret(y, x) = this->at(y, x) * rhs(y, x);
-    }
-
-    return ret;
-}
-
 template<typename T>
 template<typename S>
 texture2d_t<T> &texture2d_t<T>::operator+=(const texture2d_t<S> &rhs)
@@ -360,28 +360,4 @@ texture2d_t<T> &texture2d_t<T>::operator+=(const texture2d_t<S> &rhs)
     return *this;
 }
 
-template<typename T>
-template<typename S, typename>
-auto texture2d_t<T>::operator*(S rhs) const
-{
-    assert(is_available());
-
-    using texel_t = rm_rcv_t<decltype(std::declval<T>() * std::declval<S>())>;
-    texture2d_t<texel_t> ret(height(), width());
-
-    for(int y = 0; y < ret.height(); ++y)
-    {
-        for(int x = 0; x < ret.width(); ++x)
-            ret(y, x) = this->at(y, x) * rhs;
-    }
-
-    return ret;
-}
-
-template<typename T, typename S, typename>
-auto operator*(S lhs, const texture2d_t<T> &rhs)
-{
-    return rhs * lhs;
-}
-
 } // namespace agz::texture
@@ -55,6 +55,30 @@ texture3d_t<T>::texture3d_t(data_t &&data) noexcept
     
 }
 
+template<typename T>
+template<typename E, typename>
+texture3d_t<T>::texture3d_t(const E &expr)
+    : data_(expr)
+{
+
+}
+
+template<typename T>
+template<typename E, typename>
+texture3d_t<T> &texture3d_t<T>::operator=(const E &expr)
+{
+    data_ = expr;
+    return *this;
+}
+
+template<typename T>
+template<typename E, typename>
+texture3d_t<T> &texture3d_t<T>::assign(const E &expr, int worker_count)
+{
+    data_.assign(expr, worker_count);
+    return *this;
+}
+
 template<typename T>
 void texture3d_t<T>::initialize(int d, int h, int w, uninitialized_t)
 {
@@ -167,6 +191,29 @@ auto texture3d_t<T>::map(Func &&func) const
     return texture3d_t<ret_texel_t>(data_.map(std::forward<Func>(func)));
 }
 
+template<typename T>
+template<typename Func>
+void texture3d_t<T>::map_inplace(Func &&func) const
+{
+    data_.map_inplace(std::forward<Func>(func));
+}
+
+template<typename T>
+template<typename Policy, typename Func>
+auto texture3d_t<T>::map(const Policy &policy, Func &&func) const
+{
+    using ret_texel_t = rm_rcv_t<decltype(func(data_.at({ 0, 0, 0 })))>;
+    return texture3d_t<ret_texel_t>(
+        data_.map(policy, std::forward<Func>(func)));
+}
+
+template<typename T>
+template<typename Policy, typename Func>
+void texture3d_t<T>::map_inplace(const Policy &policy, Func &&func) const
+{
+    data_.map_inplace(policy, std::forward<Func>(func));
+}
+
 template<typename T>
 T *texture3d_t<T>::raw_data() noexcept
 {
@@ -184,7 +231,7 @@ void texture3d_t<T>::clear(const T &value)
 {
     if(!is_available())
         return;
-    for(int i = 0; i < data_.elem_count(); ++i)
+    for(size_t i = 0; i < data_.elem_count(); ++i)
         data_.raw_data()[i] = value;
 }
 
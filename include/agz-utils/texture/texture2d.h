@@ -26,12 +26,30 @@ public:
     explicit texture2d_t(const data_t &data);
     explicit texture2d_t(data_t &&data) noexcept;
 
+    /**
+     * @brief 在一次遍历中求出纹理/张量表达式的值，参见math/decl/tensor_expr.h
+     */
+    template<typename E,
+             typename = std::enable_if_t<math::is_tensor_expr_v<E>>>
+    texture2d_t(const E &expr);
+
     texture2d_t(const self_t&)               = default;
     texture2d_t<T> &operator=(const self_t&) = default;
 
     texture2d_t(self_t &&move_from)               noexcept;
     texture2d_t<T> &operator=(self_t &&move_from) noexcept;
 
+    template<typename E,
+             typename = std::enable_if_t<math::is_tensor_expr_v<E>>>
+    texture2d_t<T> &operator=(const E &expr);
+
+    /**
+     * @brief 在worker_count个线程上并行地求出表达式的值并赋给该纹理
+     */
+    template<typename E,
+             typename = std::enable_if_t<math::is_tensor_expr_v<E>>>
+    texture2d_t<T> &assign(const E &expr, int worker_count = 1);
+
     ~texture2d_t() = default;
 
     void initialize(int h, int w, uninitialized_t);
@@ -69,6 +87,15 @@ public:
     template<typename Func>
     void map_inplace(Func &&func) const;
 
+    /**
+     * @brief 按执行策略逐像素处理，参见math::exec
+     */
+    template<typename Policy, typename Func>
+    auto map(const Policy &policy, Func &&func) const;
+
+    template<typename Policy, typename Func>
+    void map_inplace(const Policy &policy, Func &&func) const;
+
     const T *raw_data() const noexcept;
           T *raw_data()       noexcept;
 
@@ -89,27 +116,43 @@ public:
 
     self_t flip_horizontally() const;
 
-    template<typename S>
-    auto operator+(const texture2d_t<S> &rhs) const;
-
-    template<typename S>
-    auto operator*(const texture2d_t<S> &rhs) const;
-
     template<typename S>
     texture2d_t<T> &operator+=(const texture2d_t<S> &rhs);
 
-    template<typename S, typename = std::enable_if_t<std::is_arithmetic_v<S>>>
-    auto operator*(S rhs) const;
-
 protected:
 
     data_t data_;
 };
 
-template<typename T, typename S,
-         typename = std::enable_if_t<std::is_arithmetic_v<S>>>
-auto operator*(S lhs, const texture2d_t<T> &rhs);
+// 纹理间、纹理与标量间的+-*/由math/decl/tensor_expr.h中的运算符实现，以using声明引入，
+// 取代了原先texture2d_t的成员运算符。它们返回以裸指针引用左值操作数的惰性表达式而非纹理，
+// 如auto c = a + b在a或b被销毁后悬空，需要保存结果时应写为texture2d_t<T> c = a + b
+using math::operator+;
+using math::operator-;
+using math::operator*;
+using math::operator/;
 
 } // namespace agz::texture
 
+namespace agz::math
+{
+
+template<typename T>
+struct tensor_operand_traits_t<texture::texture2d_t<T>>
+{
+    static constexpr bool value = true;
+
+    static const tensor_t<T, 2> &data(const texture::texture2d_t<T> &t) noexcept
+    {
+        return t.get_data();
+    }
+
+    static tensor_t<T, 2> &&data(texture::texture2d_t<T> &&t) noexcept
+    {
+        return std::move(t.get_data());
+    }
+};
+
+} // namespace agz::math
+
 #include "impl/texture2d.inl"
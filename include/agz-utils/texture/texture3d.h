@@ -23,12 +23,30 @@ public:
     explicit texture3d_t(const data_t &data);
     explicit texture3d_t(data_t &&data) noexcept;
 
+    /**
+     * @brief 在一次遍历中求出纹理/张量表达式的值，参见math/decl/tensor_expr.h
+     */
+    template<typename E,
+             typename = std::enable_if_t<math::is_tensor_expr_v<E>>>
+    texture3d_t(const E &expr);
+
     texture3d_t(const self_t &)               = default;
     texture3d_t<T> &operator=(const self_t &) = default;
 
     texture3d_t(self_t &&)               noexcept = default;
     texture3d_t<T> &operator=(self_t &&) noexcept = default;
 
+    template<typename E,
+             typename = std::enable_if_t<math::is_tensor_expr_v<E>>>
+    texture3d_t<T> &operator=(const E &expr);
+
+    /**
+     * @brief 在worker_count个线程上并行地求出表达式的值并赋给该纹理
+     */
+    template<typename E,
+             typename = std::enable_if_t<math::is_tensor_expr_v<E>>>
+    texture3d_t<T> &assign(const E &expr, int worker_count = 1);
+
     ~texture3d_t() = default;
     
     void initialize(int d, int h, int w, uninitialized_t);
@@ -58,6 +76,18 @@ public:
     template<typename Func>
     auto map(Func &&func) const;
 
+    template<typename Func>
+    void map_inplace(Func &&func) const;
+
+    /**
+     * @brief 按执行策略逐体素处理，参见math::exec
+     */
+    template<typename Policy, typename Func>
+    auto map(const Policy &policy, Func &&func) const;
+
+    template<typename Policy, typename Func>
+    void map_inplace(const Policy &policy, Func &&func) const;
+
     const T *raw_data() const noexcept;
           T *raw_data()       noexcept;
 
@@ -80,6 +110,35 @@ protected:
     data_t data_;
 };
 
+// 纹理间、纹理与标量间的+-*/由math/decl/tensor_expr.h中的运算符实现，以using声明引入，
+// 取代了原先texture3d_t的成员运算符。它们返回以裸指针引用左值操作数的惰性表达式而非纹理，
+// 如auto c = a + b在a或b被销毁后悬空，需要保存结果时应写为texture3d_t<T> c = a + b
+using math::operator+;
+using math::operator-;
+using math::operator*;
+using math::operator/;
+
 } // namespace agz::texture
 
+namespace agz::math
+{
+
+template<typename T>
+struct tensor_operand_traits_t<texture::texture3d_t<T>>
+{
+    static constexpr bool value = true;
+
+    static const tensor_t<T, 3> &data(const texture::texture3d_t<T> &t) noexcept
+    {
+        return t.get_data();
+    }
+
+    static tensor_t<T, 3> &&data(texture::texture3d_t<T> &&t) noexcept
+    {
+        return std::move(t.get_data());
+    }
+};
+
+} // namespace agz::math
+
 #include "./impl/texture3d.inl"
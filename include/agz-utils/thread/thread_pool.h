@@ -5,6 +5,7 @@
 #include <thread>
 
 #include "../misc/uncopyable.h"
+#include "../profile/profiler.h"
 #include "./blocking_queue.h"
 #include "./parallel_foreach.h"
 
@@ -62,13 +63,18 @@ public:
 
 inline void thread_group_t::worker_func(int thread_index)
 {
+    AGZ_PROFILE_THREAD_NAME("thread_group_t worker " + std::to_string(thread_index));
+
     for(;;)
     {
         auto opt_task = task_queue_.pop_or_stop();
         if(!opt_task)
             break;
 
-        (*opt_task)(thread_index);
+        {
+            AGZ_PROFILE_ZONE("thread_group_t task");
+            (*opt_task)(thread_index);
+        }
 
         std::lock_guard lk(busy_task_cnt_mut_);
         --busy_task_cnt_;
@@ -0,0 +1,291 @@
+﻿#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+
+#include <agz-utils/asset/asset_loader.h>
+#include <agz-utils/file/async_reader.h>
+#include <agz-utils/image/load_image.h>
+#include <agz-utils/string/stdstr.h>
+
+namespace agz::asset
+{
+
+namespace
+{
+
+    using steady_clock_t = std::chrono::steady_clock;
+
+    uint64_t elapsed_us(
+        steady_clock_t::time_point beg, steady_clock_t::time_point end)
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                end - beg).count());
+    }
+
+    template<typename T>
+    T check_image(T &&image, const std::string &filename)
+    {
+        if(!image.is_available())
+            throw std::runtime_error("failed to decode image: " + filename);
+        return std::forward<T>(image);
+    }
+
+    std::vector<mesh::triangle_t> decode_mesh(
+        const std::string &filename, std::vector<unsigned char> &&content)
+    {
+        if(stdstr::ends_with(filename, ".obj"))
+        {
+            // 解码本身已经在工作线程上并行，不再为单个obj创建线程
+            return mesh::load_from_obj_mem(
+                reinterpret_cast<const char*>(content.data()), content.size(), 1);
+        }
+        if(stdstr::ends_with(filename, ".ply"))
+            return mesh::load_from_ply_mem(content);
+        throw std::runtime_error("unsupported mesh file: " + filename);
+    }
+
+    /**
+     * @brief 按字节数限制同时在途的资源
+     */
+    class memory_budget_t
+    {
+        size_t budget_;
+        size_t inflight_ = 0;
+        size_t peak_     = 0;
+
+        std::mutex mutex_;
+        std::condition_variable cond_;
+
+    public:
+
+        explicit memory_budget_t(size_t budget)
+            : budget_(budget)
+        {
+
+        }
+
+        void acquire(size_t bytes)
+        {
+            std::unique_lock lk(mutex_);
+            if(budget_)
+            {
+                cond_.wait(lk, [&]
+                {
+                    return !inflight_ || inflight_ + bytes <= budget_;
+                });
+            }
+            inflight_ += bytes;
+            peak_ = (std::max)(peak_, inflight_);
+        }
+
+        void release(size_t bytes)
+        {
+            std::lock_guard lk(mutex_);
+            inflight_ -= bytes;
+            cond_.notify_all();
+        }
+
+        size_t peak() const noexcept
+        {
+            return peak_;
+        }
+    };
+
+} // namespace anonymous
+
+asset_loader_t::asset_loader_t(int worker_count, size_t memory_budget)
+    : worker_count_(worker_count), memory_budget_(memory_budget)
+{
+
+}
+
+asset_loader_t::handle_t<math::tensor_t<math::byte, 2>>
+    asset_loader_t::add_gray(std::string filename)
+{
+    return add<math::tensor_t<math::byte, 2>>(
+        std::move(filename), kind_t::gray);
+}
+
+asset_loader_t::handle_t<math::tensor_t<math::color2b, 2>>
+    asset_loader_t::add_gray_alpha(std::string filename)
+{
+    return add<math::tensor_t<math::color2b, 2>>(
+        std::move(filename), kind_t::gray_alpha);
+}
+
+asset_loader_t::handle_t<math::tensor_t<math::color3b, 2>>
+    asset_loader_t::add_rgb(std::string filename)
+{
+    return add<math::tensor_t<math::color3b, 2>>(
+        std::move(filename), kind_t::rgb);
+}
+
+asset_loader_t::handle_t<math::tensor_t<math::color4b, 2>>
+    asset_loader_t::add_rgba(std::string filename)
+{
+    return add<math::tensor_t<math::color4b, 2>>(
+        std::move(filename), kind_t::rgba);
+}
+
+asset_loader_t::handle_t<math::tensor_t<math::color3f, 2>>
+    asset_loader_t::add_rgb_hdr(std::string filename)
+{
+    return add<math::tensor_t<math::color3f, 2>>(
+        std::move(filename), kind_t::rgb_hdr);
+}
+
+asset_loader_t::handle_t<std::vector<mesh::triangle_t>>
+    asset_loader_t::add_mesh(std::string filename)
+{
+    return add<std::vector<mesh::triangle_t>>(
+        std::move(filename), kind_t::mesh);
+}
+
+void asset_loader_t::load()
+{
+    const auto load_start = steady_clock_t::now();
+
+    stats_ = load_stats_t{};
+
+    std::mutex stats_mutex;
+    memory_budget_t budget(memory_budget_);
+
+    auto decode = [&](
+        size_t index, std::vector<unsigned char> &&content) -> std::any
+    {
+        const std::string &filename = requests_[index].filename;
+        const void *data = content.data();
+        const size_t size = content.size();
+
+        switch(requests_[index].kind)
+        {
+        case kind_t::gray:
+            return check_image(img::load_gray_from_memory(data, size), filename);
+        case kind_t::gray_alpha:
+            return check_image(
+                img::load_gray_alpha_from_memory(data, size), filename);
+        case kind_t::rgb:
+            return check_image(img::load_rgb_from_memory(data, size), filename);
+        case kind_t::rgba:
+            return check_image(img::load_rgba_from_memory(data, size), filename);
+        case kind_t::rgb_hdr:
+            return check_image(
+                img::load_rgb_from_hdr_memory(data, size), filename);
+        case kind_t::mesh:
+            return decode_mesh(filename, std::move(content));
+        }
+        throw std::runtime_error("unknown asset kind: " + filename);
+    };
+
+    std::exception_ptr except_ptr;
+    auto record_error = [&](std::exception_ptr err)
+    {
+        std::lock_guard lk(stats_mutex);
+        if(!except_ptr)
+            except_ptr = err;
+    };
+
+    // stl_reader只能从文件读取，agzmesh直接通过内存映射读取，
+    // 这部分网格在调用线程上等待其他资源时加载
+
+    std::vector<size_t> file_mesh_indices;
+
+    {
+        file::async_reader_t reader(worker_count_);
+
+        for(size_t i = 0; i < requests_.size(); ++i)
+        {
+            auto &req = requests_[i];
+            if(req.loaded)
+                continue;
+
+            if(req.kind == kind_t::mesh &&
+               (stdstr::ends_with(req.filename, ".stl") ||
+                stdstr::ends_with(req.filename, ".agzmesh")))
+            {
+                file_mesh_indices.push_back(i);
+                continue;
+            }
+
+            std::error_code ec;
+            const size_t file_size = static_cast<size_t>(
+                std::filesystem::file_size(req.filename, ec));
+            const size_t charge = ec ? 0 : file_size;
+
+            budget.acquire(charge);
+            const auto submit_time = steady_clock_t::now();
+
+            reader.read(req.filename,
+                [&, i, charge, submit_time](std::vector<unsigned char> &&content)
+            {
+                const auto decode_start = steady_clock_t::now();
+                const size_t bytes = content.size();
+
+                std::any result;
+                try
+                {
+                    result = decode(i, std::move(content));
+                }
+                catch(...)
+                {
+                    budget.release(charge);
+                    record_error(std::current_exception());
+                    return;
+                }
+                budget.release(charge);
+
+                const auto decode_end = steady_clock_t::now();
+
+                std::lock_guard lk(stats_mutex);
+                results_[i] = std::move(result);
+                requests_[i].loaded = true;
+                ++stats_.asset_count;
+                stats_.bytes_read += bytes;
+                stats_.read_us    += elapsed_us(submit_time, decode_start);
+                stats_.decode_us  += elapsed_us(decode_start, decode_end);
+            },
+                [&, charge](std::exception_ptr err)
+            {
+                budget.release(charge);
+                record_error(err);
+            });
+        }
+
+        for(size_t i : file_mesh_indices)
+        {
+            try
+            {
+                const auto decode_start = steady_clock_t::now();
+                auto triangles = mesh::load_from_file(requests_[i].filename);
+                const auto decode_end = steady_clock_t::now();
+
+                std::lock_guard lk(stats_mutex);
+                results_[i] = std::move(triangles);
+                requests_[i].loaded = true;
+                ++stats_.asset_count;
+                stats_.decode_us += elapsed_us(decode_start, decode_end);
+            }
+            catch(...)
+            {
+                record_error(std::current_exception());
+            }
+        }
+
+        reader.wait_all();
+    }
+
+    stats_.peak_inflight_bytes = budget.peak();
+    stats_.wall_us = elapsed_us(load_start, steady_clock_t::now());
+
+    if(except_ptr)
+        std::rethrow_exception(except_ptr);
+}
+
+const load_stats_t &asset_loader_t::stats() const noexcept
+{
+    return stats_;
+}
+
+} // namespace agz::asset
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <agz-utils/console/progress.h>
+
+namespace agz::console
+{
+
+progress_tracker_t::progress_tracker_t(
+    uint64_t                  total,
+    int                       width,
+    std::chrono::milliseconds refresh_interval,
+    std::ostream             &out)
+    : total_(total), width_((std::max)(width, 1)), out_(out),
+      start_(clock_t::now()), last_sample_time_(start_),
+      last_sample_finished_(0), smoothed_rate_(0), has_rate_(false),
+      done_(false), refresh_interval_(refresh_interval), stop_refresh_(false)
+{
+    if(refresh_interval_.count() > 0)
+        refresh_thread_ = std::thread(&progress_tracker_t::refresh_loop, this);
+}
+
+progress_tracker_t::~progress_tracker_t()
+{
+    {
+        std::lock_guard lk(refresh_mutex_);
+        stop_refresh_ = true;
+    }
+    refresh_cond_.notify_all();
+
+    if(refresh_thread_.joinable())
+        refresh_thread_.join();
+}
+
+uint64_t progress_tracker_t::finished() const noexcept
+{
+    return static_cast<uint64_t>((std::max<int64_t>)(finished_.value(), 0));
+}
+
+double progress_tracker_t::eta_seconds() const
+{
+    const uint64_t finished = this->finished();
+    if(finished >= total_)
+        return 0;
+
+    std::lock_guard lk(state_mutex_);
+    if(!has_rate_ || smoothed_rate_ <= 0)
+        return -1;
+    return static_cast<double>(total_ - finished) / smoothed_rate_;
+}
+
+void progress_tracker_t::display()
+{
+    std::lock_guard lk(state_mutex_);
+    if(done_)
+        return;
+
+    const uint64_t finished = this->finished();
+    const auto now = clock_t::now();
+
+    update_rate(finished, now);
+    write(render(finished, now) + "\r");
+}
+
+void progress_tracker_t::done()
+{
+    {
+        std::lock_guard lk(refresh_mutex_);
+        stop_refresh_ = true;
+    }
+    refresh_cond_.notify_all();
+
+    if(refresh_thread_.joinable())
+        refresh_thread_.join();
+
+    std::lock_guard lk(state_mutex_);
+    if(done_)
+        return;
+    done_ = true;
+
+    const uint64_t finished = this->finished();
+    const auto now = clock_t::now();
+
+    update_rate(finished, now);
+    write(render(finished, now) + "\n");
+}
+
+void progress_tracker_t::refresh_loop()
+{
+    std::unique_lock lk(refresh_mutex_);
+    for(;;)
+    {
+        if(refresh_cond_.wait_for(
+            lk, refresh_interval_, [&] { return stop_refresh_; }))
+            break;
+
+        // 显示时不持有refresh_mutex_，以免done等待输出完成
+
+        lk.unlock();
+        display();
+        lk.lock();
+    }
+}
+
+void progress_tracker_t::update_rate(uint64_t finished, clock_t::time_point now)
+{
+    const double dt = std::chrono::duration<double>(now - last_sample_time_).count();
+    if(dt <= 0 || finished < last_sample_finished_)
+        return;
+
+    const double rate =
+        static_cast<double>(finished - last_sample_finished_) / dt;
+
+    // 按时间间隔计算平滑系数，使估计不受刷新频率影响
+
+    if(has_rate_)
+    {
+        const double alpha = 1 - std::exp(-dt / RATE_TIME_CONSTANT);
+        smoothed_rate_ += alpha * (rate - smoothed_rate_);
+    }
+    else if(finished > 0)
+    {
+        smoothed_rate_ = rate;
+        has_rate_      = true;
+    }
+    else
+        return;
+
+    last_sample_time_     = now;
+    last_sample_finished_ = finished;
+}
+
+std::string progress_tracker_t::render(
+    uint64_t finished, clock_t::time_point now) const
+{
+    const double progress = total_ ?
+        (std::min)(static_cast<double>(finished) / total_, 1.0) : 1.0;
+    const int pos = static_cast<int>(width_ * progress);
+
+    std::string ret = "[";
+    for(int i = 0; i < width_; ++i)
+    {
+        if(i < pos)
+            ret += '#';
+        else if(i == pos)
+            ret += '>';
+        else
+            ret += ' ';
+    }
+
+    const double elapsed = std::chrono::duration<double>(now - start_).count();
+
+    char info[128];
+    std::snprintf(
+        info, sizeof(info), "] %d%% %llu/%llu %.1fs",
+        static_cast<int>(progress * 100),
+        static_cast<unsigned long long>(finished),
+        static_cast<unsigned long long>(total_), elapsed);
+    ret += info;
+
+    if(finished < total_ && has_rate_ && smoothed_rate_ > 0)
+    {
+        std::snprintf(
+            info, sizeof(info), " ETA %.1fs",
+            static_cast<double>(total_ - finished) / smoothed_rate_);
+        ret += info;
+    }
+
+    ret += "   ";
+    return ret;
+}
+
+void progress_tracker_t::write(const std::string &line)
+{
+    out_ << line;
+    out_.flush();
+}
+
+} // namespace agz::console
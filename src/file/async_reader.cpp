@@ -0,0 +1,704 @@
+﻿#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include <agz-utils/common/common.h>
+#include <agz-utils/file/async_reader.h>
+#include <agz-utils/system/platform.h>
+#include <agz-utils/thread/thread_pool.h>
+
+#if defined(AGZ_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define AGZ_FILE_IO_URING
+#endif
+#endif
+
+namespace agz::file
+{
+
+namespace
+{
+
+    struct request_t
+    {
+        std::string filename;
+        async_reader_t::callback_t callback;
+
+        // 若非空，读取失败时的异常交给它处理，而不是记录到reader中
+        std::function<void(std::exception_ptr)> on_error;
+    };
+
+    std::vector<unsigned char> read_file_blocking(const std::string &filename)
+    {
+        std::ifstream fin(filename, std::ios::in | std::ios::binary);
+        if(!fin)
+            throw std::runtime_error("failed to open file: " + filename);
+
+        fin.seekg(0, std::ios::end);
+        const auto len = fin.tellg();
+        fin.seekg(0, std::ios::beg);
+
+        std::vector<unsigned char> ret(static_cast<size_t>(len));
+        if(!fin.read(reinterpret_cast<char*>(ret.data()), len))
+            throw std::runtime_error("failed to read file: " + filename);
+
+        return ret;
+    }
+
+#ifdef AGZ_FILE_IO_URING
+
+    /**
+     * @brief 直接基于系统调用的最小io_uring封装，只在io线程上使用
+     */
+    class uring_t : public misc::uncopyable_t
+    {
+        int fd_ = -1;
+
+        void  *sq_ptr_  = MAP_FAILED;
+        size_t sq_size_ = 0;
+        void  *cq_ptr_  = MAP_FAILED;
+        size_t cq_size_ = 0;
+
+        io_uring_sqe *sqes_      = nullptr;
+        size_t        sqes_size_ = 0;
+
+        unsigned *sq_head_  = nullptr;
+        unsigned *sq_tail_  = nullptr;
+        unsigned *sq_mask_  = nullptr;
+        unsigned *sq_array_ = nullptr;
+
+        unsigned     *cq_head_ = nullptr;
+        unsigned     *cq_tail_ = nullptr;
+        unsigned     *cq_mask_ = nullptr;
+        io_uring_cqe *cqes_    = nullptr;
+
+        unsigned entries_ = 0;
+
+        bool initialize(unsigned entries)
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+
+            fd_ = static_cast<int>(
+                syscall(__NR_io_uring_setup, entries, &params));
+            if(fd_ < 0)
+                return false;
+
+            entries_ = params.sq_entries;
+
+            sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_size_ = params.cq_off.cqes
+                     + params.cq_entries * sizeof(io_uring_cqe);
+            sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+
+            sq_ptr_ = mmap(
+                nullptr, sq_size_, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+            if(sq_ptr_ == MAP_FAILED)
+                return false;
+
+            cq_ptr_ = mmap(
+                nullptr, cq_size_, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+            if(cq_ptr_ == MAP_FAILED)
+                return false;
+
+            void *sqes = mmap(
+                nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+            if(sqes == MAP_FAILED)
+                return false;
+            sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+            auto sq = static_cast<char*>(sq_ptr_);
+            sq_head_  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sq_tail_  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sq_mask_  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+            auto cq = static_cast<char*>(cq_ptr_);
+            cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes_    = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            return true;
+        }
+
+    public:
+
+        /**
+         * @brief 创建io_uring实例，不可用时返回nullptr
+         */
+        static std::unique_ptr<uring_t> create(unsigned entries)
+        {
+            auto ret = std::make_unique<uring_t>();
+            if(!ret->initialize(entries))
+                return nullptr;
+            return ret;
+        }
+
+        ~uring_t()
+        {
+            if(sqes_)
+                munmap(sqes_, sqes_size_);
+            if(cq_ptr_ != MAP_FAILED)
+                munmap(cq_ptr_, cq_size_);
+            if(sq_ptr_ != MAP_FAILED)
+                munmap(sq_ptr_, sq_size_);
+            if(fd_ >= 0)
+                close(fd_);
+        }
+
+        unsigned entries() const noexcept
+        {
+            return entries_;
+        }
+
+        /**
+         * @brief 取得一个空闲的sqe并将其放入提交队列，队列已满时返回nullptr
+         */
+        io_uring_sqe *push_sqe() noexcept
+        {
+            const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            const unsigned tail = *sq_tail_;
+            if(tail - head >= entries_)
+                return nullptr;
+
+            const unsigned index = tail & *sq_mask_;
+            io_uring_sqe *sqe = &sqes_[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sq_array_[index] = index;
+
+            __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+            return sqe;
+        }
+
+        /**
+         * @brief 提交to_submit个请求，并至少等待wait_nr个请求完成
+         *
+         * 返回被内核接收的请求数，失败时返回-errno
+         */
+        int enter(unsigned to_submit, unsigned wait_nr) noexcept
+        {
+            for(;;)
+            {
+                const int ret = static_cast<int>(syscall(
+                    __NR_io_uring_enter, fd_, to_submit, wait_nr,
+                    wait_nr ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0));
+                if(ret >= 0)
+                    return ret;
+                if(errno != EINTR)
+                    return -errno;
+            }
+        }
+
+        /**
+         * @brief 处理所有已完成的请求，func(user_data, res)
+         */
+        template<typename F>
+        void reap(const F &func)
+        {
+            unsigned head = *cq_head_;
+            const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            while(head != tail)
+            {
+                const io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+                func(cqe.user_data, cqe.res);
+                ++head;
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        }
+    };
+
+#endif // #ifdef AGZ_FILE_IO_URING
+
+} // namespace anonymous
+
+class async_reader_t::impl_t : public misc::uncopyable_t
+{
+    // 工作线程：执行回调，以及退化模式下的阻塞读取
+
+    thread::thread_group_t workers_;
+    thread::blocking_queue_t<std::function<void()>> tasks_;
+
+    // 尚未完成的请求数及记录下的第一个异常
+
+    std::mutex pending_mutex_;
+    std::condition_variable pending_cond_;
+    size_t pending_ = 0;
+    std::exception_ptr except_ptr_;
+
+    void finish_one(std::exception_ptr err)
+    {
+        std::lock_guard lk(pending_mutex_);
+        if(err && !except_ptr_)
+            except_ptr_ = err;
+        if(--pending_ == 0)
+            pending_cond_.notify_all();
+    }
+
+    void dispatch_complete(request_t &&req, std::vector<unsigned char> &&data)
+    {
+        tasks_.push(
+            [this, req = std::move(req), data = std::move(data)]() mutable
+        {
+            std::exception_ptr err;
+            try
+            {
+                req.callback(std::move(data));
+            }
+            catch(...)
+            {
+                err = std::current_exception();
+            }
+            finish_one(err);
+        });
+    }
+
+    void dispatch_error(request_t &&req, std::exception_ptr err)
+    {
+        tasks_.push([this, req = std::move(req), err]
+        {
+            if(req.on_error)
+            {
+                req.on_error(err);
+                finish_one(nullptr);
+            }
+            else
+                finish_one(err);
+        });
+    }
+
+    void read_blocking(request_t &&req)
+    {
+        std::vector<unsigned char> data;
+        try
+        {
+            data = read_file_blocking(req.filename);
+        }
+        catch(...)
+        {
+            return dispatch_error(std::move(req), std::current_exception());
+        }
+        dispatch_complete(std::move(req), std::move(data));
+    }
+
+    void submit_blocking(request_t &&req)
+    {
+        tasks_.push([this, req = std::move(req)]() mutable
+        {
+            read_blocking(std::move(req));
+        });
+    }
+
+#ifdef AGZ_FILE_IO_URING
+
+    struct read_op_t
+    {
+        request_t req;
+        int fd = -1;
+        std::vector<unsigned char> data;
+        size_t offset = 0;
+        iovec iov = {};
+    };
+
+    std::unique_ptr<uring_t> uring_;
+    unsigned queue_depth_ = 0;
+
+    std::thread io_thread_;
+    std::mutex io_mutex_;
+    std::condition_variable io_cond_;
+    std::deque<request_t> io_requests_;
+    bool io_stop_ = false;
+
+    // io_uring_enter出错后置为true，此后所有请求都由工作线程阻塞读取
+    std::atomic<bool> io_failed_ = { false };
+
+    static void prepare_read(io_uring_sqe *sqe, read_op_t *op) noexcept
+    {
+        // 单次读取不超过1GB，更大的文件由多次短读拼接而成
+        constexpr size_t MAX_CHUNK = size_t(1) << 30;
+
+        op->iov.iov_base = op->data.data() + op->offset;
+        op->iov.iov_len  = (std::min)(op->data.size() - op->offset, MAX_CHUNK);
+
+        sqe->opcode    = IORING_OP_READV;
+        sqe->fd        = op->fd;
+        sqe->addr      = reinterpret_cast<uint64_t>(&op->iov);
+        sqe->len       = 1;
+        sqe->off       = op->offset;
+        sqe->user_data = reinterpret_cast<uint64_t>(op);
+    }
+
+    /**
+     * @brief 打开文件并准备读操作，文件为空或打开失败时直接完成该请求
+     */
+    std::unique_ptr<read_op_t> open_request(request_t &&req)
+    {
+        auto op = std::make_unique<read_op_t>();
+        op->req = std::move(req);
+
+        op->fd = open(op->req.filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if(op->fd < 0)
+        {
+            dispatch_error(std::move(op->req), std::make_exception_ptr(
+                std::runtime_error("failed to open file: " + op->req.filename)));
+            return nullptr;
+        }
+
+        struct stat st;
+        if(fstat(op->fd, &st) != 0)
+        {
+            close(op->fd);
+            dispatch_error(std::move(op->req), std::make_exception_ptr(
+                std::runtime_error("failed to stat file: " + op->req.filename)));
+            return nullptr;
+        }
+
+        if(st.st_size == 0)
+        {
+            close(op->fd);
+            dispatch_complete(std::move(op->req), {});
+            return nullptr;
+        }
+
+        op->data.resize(static_cast<size_t>(st.st_size));
+        return op;
+    }
+
+    /**
+     * @brief io_uring出错后，将尚未完成和排队中的请求都转为阻塞读取
+     *
+     * 内核可能仍在写入已提交请求的缓冲区，因此不释放这些read_op_t
+     */
+    void fall_back_to_blocking(std::unordered_set<read_op_t*> &live_ops)
+    {
+        for(read_op_t *op : live_ops)
+        {
+            close(op->fd);
+            submit_blocking(std::move(op->req));
+        }
+        live_ops.clear();
+
+        std::deque<request_t> queued;
+        {
+            std::lock_guard lk(io_mutex_);
+            io_failed_ = true;
+            queued.swap(io_requests_);
+        }
+
+        for(auto &req : queued)
+            submit_blocking(std::move(req));
+    }
+
+    void io_loop()
+    {
+        unsigned in_flight = 0;
+        unsigned to_submit = 0;
+
+        // 已放入提交队列但尚未完成的读操作
+        std::unordered_set<read_op_t*> live_ops;
+
+        for(;;)
+        {
+            std::vector<request_t> new_requests;
+            {
+                std::unique_lock lk(io_mutex_);
+                if(in_flight + to_submit == 0)
+                {
+                    io_cond_.wait(lk, [&]
+                    {
+                        return io_stop_ || !io_requests_.empty();
+                    });
+                    if(io_requests_.empty())
+                        break;
+                }
+
+                while(in_flight + to_submit + new_requests.size() < queue_depth_
+                   && !io_requests_.empty())
+                {
+                    new_requests.push_back(std::move(io_requests_.front()));
+                    io_requests_.pop_front();
+                }
+            }
+
+            for(auto &req : new_requests)
+            {
+                auto op = open_request(std::move(req));
+                if(!op)
+                    continue;
+
+                io_uring_sqe *sqe = uring_->push_sqe();
+                if(!sqe)
+                {
+                    // 队列深度不超过ring大小，正常情况下不会发生
+                    close(op->fd);
+                    read_blocking(std::move(op->req));
+                    continue;
+                }
+
+                live_ops.insert(op.get());
+                prepare_read(sqe, op.release());
+                ++to_submit;
+            }
+
+            if(in_flight + to_submit == 0)
+                continue;
+
+            // 有新请求时不阻塞，以便尽快取走后续请求
+
+            const unsigned wait_nr = new_requests.empty() ? 1 : 0;
+            const int submitted = uring_->enter(to_submit, wait_nr);
+            if(submitted < 0)
+            {
+                if(submitted == -EAGAIN || submitted == -EBUSY)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                fall_back_to_blocking(live_ops);
+                return;
+            }
+
+            in_flight += static_cast<unsigned>(submitted);
+            to_submit -= static_cast<unsigned>(submitted);
+
+            uring_->reap([&](uint64_t user_data, int res)
+            {
+                --in_flight;
+                auto op = reinterpret_cast<read_op_t*>(user_data);
+
+                if(res > 0)
+                {
+                    op->offset += static_cast<size_t>(res);
+                    if(op->offset < op->data.size())
+                    {
+                        // 短读，继续读取剩余部分
+                        if(io_uring_sqe *sqe = uring_->push_sqe())
+                        {
+                            prepare_read(sqe, op);
+                            ++to_submit;
+                            return;
+                        }
+                    }
+                }
+
+                std::unique_ptr<read_op_t> op_guard(op);
+                live_ops.erase(op);
+                close(op->fd);
+
+                if(res < 0)
+                {
+                    dispatch_error(std::move(op->req), std::make_exception_ptr(
+                        std::runtime_error(
+                            "failed to read file: " + op->req.filename)));
+                }
+                else if(op->offset < op->data.size())
+                {
+                    // 文件在读取过程中变短，或sqe不足
+                    read_blocking(std::move(op->req));
+                }
+                else
+                    dispatch_complete(std::move(op->req), std::move(op->data));
+            });
+        }
+    }
+
+#endif // #ifdef AGZ_FILE_IO_URING
+
+public:
+
+    impl_t(int worker_count, int queue_depth)
+    {
+        worker_count = thread::actual_worker_count(worker_count);
+        queue_depth  = (std::max)(queue_depth, 1);
+
+#ifdef AGZ_FILE_IO_URING
+        uring_ = uring_t::create(static_cast<unsigned>(queue_depth));
+        if(uring_)
+        {
+            queue_depth_ = (std::min)(
+                static_cast<unsigned>(queue_depth), uring_->entries());
+            io_thread_ = std::thread(&impl_t::io_loop, this);
+        }
+#else
+        AGZ_UNACCESSED(queue_depth);
+#endif
+
+        workers_.run_async(worker_count, [this](int)
+        {
+            for(;;)
+            {
+                auto task = tasks_.pop_or_stop();
+                if(!task)
+                    break;
+                (*task)();
+            }
+        });
+    }
+
+    ~impl_t()
+    {
+        {
+            std::unique_lock lk(pending_mutex_);
+            pending_cond_.wait(lk, [&] { return pending_ == 0; });
+        }
+
+#ifdef AGZ_FILE_IO_URING
+        if(io_thread_.joinable())
+        {
+            {
+                std::lock_guard lk(io_mutex_);
+                io_stop_ = true;
+            }
+            io_cond_.notify_one();
+            io_thread_.join();
+        }
+#endif
+
+        tasks_.stop();
+        workers_.join_async();
+    }
+
+    bool is_io_uring_enabled() const noexcept
+    {
+#ifdef AGZ_FILE_IO_URING
+        return uring_ != nullptr && !io_failed_;
+#else
+        return false;
+#endif
+    }
+
+    void submit(request_t &&req)
+    {
+        {
+            std::lock_guard lk(pending_mutex_);
+            ++pending_;
+        }
+
+#ifdef AGZ_FILE_IO_URING
+        if(uring_)
+        {
+            std::unique_lock lk(io_mutex_);
+            if(!io_failed_)
+            {
+                io_requests_.push_back(std::move(req));
+                lk.unlock();
+                io_cond_.notify_one();
+                return;
+            }
+        }
+#endif
+
+        submit_blocking(std::move(req));
+    }
+
+    void wait_all()
+    {
+        std::unique_lock lk(pending_mutex_);
+        pending_cond_.wait(lk, [&] { return pending_ == 0; });
+
+        if(except_ptr_)
+        {
+            auto err = except_ptr_;
+            except_ptr_ = nullptr;
+            std::rethrow_exception(err);
+        }
+    }
+};
+
+async_reader_t::async_reader_t(int worker_count, int queue_depth)
+    : impl_(std::make_unique<impl_t>(worker_count, queue_depth))
+{
+
+}
+
+async_reader_t::~async_reader_t() = default;
+
+bool async_reader_t::is_io_uring_enabled() const noexcept
+{
+    return impl_->is_io_uring_enabled();
+}
+
+void async_reader_t::read(std::string filename, callback_t callback)
+{
+    impl_->submit({ std::move(filename), std::move(callback), {} });
+}
+
+void async_reader_t::read(
+    std::string filename, callback_t callback,
+    std::function<void(std::exception_ptr)> on_error)
+{
+    impl_->submit({
+        std::move(filename), std::move(callback), std::move(on_error) });
+}
+
+std::future<std::vector<unsigned char>> async_reader_t::read(
+    std::string filename)
+{
+    auto promise = std::make_shared<
+        std::promise<std::vector<unsigned char>>>();
+    auto ret = promise->get_future();
+
+    impl_->submit({
+        std::move(filename),
+        [promise](std::vector<unsigned char> &&data)
+        {
+            promise->set_value(std::move(data));
+        },
+        [promise](std::exception_ptr err)
+        {
+            promise->set_exception(err);
+        }
+    });
+
+    return ret;
+}
+
+void async_reader_t::read_batch(
+    const std::vector<std::string> &filenames,
+    std::function<void(size_t, std::vector<unsigned char> &&)> callback)
+{
+    auto shared_callback = std::make_shared<
+        std::function<void(size_t, std::vector<unsigned char> &&)>>(
+            std::move(callback));
+
+    for(size_t i = 0; i < filenames.size(); ++i)
+    {
+        read(filenames[i], [i, shared_callback](std::vector<unsigned char> &&data)
+        {
+            (*shared_callback)(i, std::move(data));
+        });
+    }
+}
+
+std::vector<std::future<std::vector<unsigned char>>> async_reader_t::read_batch(
+    const std::vector<std::string> &filenames)
+{
+    std::vector<std::future<std::vector<unsigned char>>> ret;
+    ret.reserve(filenames.size());
+    for(auto &filename : filenames)
+        ret.push_back(read(filename));
+    return ret;
+}
+
+void async_reader_t::wait_all()
+{
+    impl_->wait_all();
+}
+
+} // namespace agz::file
@@ -0,0 +1,189 @@
+﻿#include <stdexcept>
+#include <utility>
+
+#include <agz-utils/file/mapped_file.h>
+#include <agz-utils/system/platform.h>
+
+#ifdef AGZ_OS_WIN32
+#include <filesystem>
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace agz::file
+{
+
+mapped_file_t::mapped_file_t() noexcept = default;
+
+mapped_file_t::mapped_file_t(const std::string &filename)
+{
+    open(filename);
+}
+
+mapped_file_t::mapped_file_t(mapped_file_t &&move_from) noexcept
+{
+    swap(move_from);
+}
+
+mapped_file_t &mapped_file_t::operator=(mapped_file_t &&move_from) noexcept
+{
+    close();
+    swap(move_from);
+    return *this;
+}
+
+mapped_file_t::~mapped_file_t()
+{
+    close();
+}
+
+#ifdef AGZ_OS_WIN32
+
+void mapped_file_t::open(const std::string &filename)
+{
+    close();
+
+    const std::wstring wfilename = std::filesystem::path(filename).wstring();
+    HANDLE file = CreateFileW(
+        wfilename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("failed to open file: " + filename);
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        throw std::runtime_error("failed to get file size: " + filename);
+    }
+
+    if(file_size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        is_open_ = true;
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingW(
+        file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mapping)
+    {
+        CloseHandle(file);
+        throw std::runtime_error("failed to map file: " + filename);
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("failed to map file: " + filename);
+    }
+
+    is_open_        = true;
+    data_           = static_cast<const unsigned char*>(view);
+    size_           = static_cast<size_t>(file_size.QuadPart);
+    file_handle_    = file;
+    mapping_handle_ = mapping;
+}
+
+void mapped_file_t::close() noexcept
+{
+    if(data_)
+        UnmapViewOfFile(data_);
+    if(mapping_handle_)
+        CloseHandle(mapping_handle_);
+    if(file_handle_)
+        CloseHandle(file_handle_);
+
+    is_open_        = false;
+    data_           = nullptr;
+    size_           = 0;
+    file_handle_    = nullptr;
+    mapping_handle_ = nullptr;
+}
+
+#else
+
+void mapped_file_t::open(const std::string &filename)
+{
+    close();
+
+    const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw std::runtime_error("failed to open file: " + filename);
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("failed to get file size: " + filename);
+    }
+
+    if(st.st_size == 0)
+    {
+        ::close(fd);
+        is_open_ = true;
+        return;
+    }
+
+    void *view = mmap(
+        nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+
+    // 映射建立后即可关闭文件描述符
+    ::close(fd);
+
+    if(view == MAP_FAILED)
+        throw std::runtime_error("failed to map file: " + filename);
+
+    is_open_ = true;
+    data_    = static_cast<const unsigned char*>(view);
+    size_    = static_cast<size_t>(st.st_size);
+}
+
+void mapped_file_t::close() noexcept
+{
+    if(data_)
+        munmap(const_cast<unsigned char*>(data_), size_);
+
+    is_open_ = false;
+    data_    = nullptr;
+    size_    = 0;
+}
+
+#endif
+
+void mapped_file_t::swap(mapped_file_t &swap_with) noexcept
+{
+    std::swap(is_open_,        swap_with.is_open_);
+    std::swap(data_,           swap_with.data_);
+    std::swap(size_,           swap_with.size_);
+    std::swap(file_handle_,    swap_with.file_handle_);
+    std::swap(mapping_handle_, swap_with.mapping_handle_);
+}
+
+bool mapped_file_t::is_open() const noexcept
+{
+    return is_open_;
+}
+
+const unsigned char *mapped_file_t::data() const noexcept
+{
+    return data_;
+}
+
+size_t mapped_file_t::size() const noexcept
+{
+    return size_;
+}
+
+misc::span<const unsigned char> mapped_file_t::bytes() const noexcept
+{
+    return misc::span<const unsigned char>(data_, size_);
+}
+
+} // namespace agz::file
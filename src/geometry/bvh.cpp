@@ -0,0 +1,1148 @@
+﻿#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <agz-utils/geometry/bvh.h>
+#include <agz-utils/thread/parallel_foreach_pooled.h>
+
+namespace agz::geometry
+{
+
+namespace
+{
+
+    constexpr float FLOAT_INF = std::numeric_limits<float>::infinity();
+
+    // 超过该深度后强制按中位数划分，以限制遍历栈的大小
+    constexpr int MAX_SAH_DEPTH = 96;
+
+    // 中位数划分每层至少减半，因此二叉树深度不超过MAX_SAH_DEPTH + 32，
+    // 四叉树的深度不超过二叉树；遍历时每层最多留下3个待访问的子节点
+    constexpr int TRAVERSAL_STACK_SIZE = 512;
+
+    static_assert(TRAVERSAL_STACK_SIZE >= 3 * (MAX_SAH_DEPTH + 32) + 1);
+
+    constexpr size_t BINNING_BLOCK_SIZE = 1 << 15;
+
+    constexpr uint8_t DEFERRED_AXIS = 0xff;
+
+    math::aabb3f empty_aabb() noexcept
+    {
+        return math::aabb3f(math::vec3f(FLOAT_INF), math::vec3f(-FLOAT_INF));
+    }
+
+    float surface_area(const math::aabb3f &box) noexcept
+    {
+        if(!(box.low.x <= box.high.x))
+            return 0;
+        const math::vec3f d = box.high - box.low;
+        return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    void union_into(math::aabb3f &dst, const math::aabb3f &src) noexcept
+    {
+        for(int i = 0; i < 3; ++i)
+        {
+            dst.low[i]  = (std::min)(dst.low[i],  src.low[i]);
+            dst.high[i] = (std::max)(dst.high[i], src.high[i]);
+        }
+    }
+
+    void union_into(math::aabb3f &dst, const math::vec3f &p) noexcept
+    {
+        for(int i = 0; i < 3; ++i)
+        {
+            dst.low[i]  = (std::min)(dst.low[i],  p[i]);
+            dst.high[i] = (std::max)(dst.high[i], p[i]);
+        }
+    }
+
+    struct build_primitive_t
+    {
+        math::aabb3f bounds;
+        math::vec3f  centroid;
+    };
+
+    /**
+     * @brief 延迟到并行阶段构建的子树
+     */
+    struct deferred_task_t
+    {
+        size_t beg;
+        size_t end;
+        int    depth;
+    };
+
+    struct range_info_t
+    {
+        math::aabb3f bounds          = empty_aabb();
+        math::aabb3f centroid_bounds = empty_aabb();
+
+        void merge(const range_info_t &rhs) noexcept
+        {
+            union_into(bounds, rhs.bounds);
+            union_into(centroid_bounds, rhs.centroid_bounds);
+        }
+    };
+
+    struct bin_t
+    {
+        math::aabb3f bounds = empty_aabb();
+        uint32_t     count  = 0;
+    };
+
+    /**
+     * @brief 分桶SAH构建器
+     *
+     * 顶层的大节点并行地分桶，规模小于parallel_threshold的子树记为延迟任务，
+     * 之后在线程组上并行构建，最后拼接为一个深度优先的节点数组
+     */
+    class builder_t
+    {
+    public:
+
+        builder_t(
+            const bvh_build_options_t            &options,
+            const std::vector<build_primitive_t> &primitives,
+            std::vector<uint32_t>                &indices,
+            thread::thread_group_t               &threads,
+            int                                   worker_count)
+            : options_(options), primitives_(primitives), indices_(indices),
+              threads_(threads), worker_count_(worker_count)
+        {
+            bin_count_     = (std::max)(options_.bin_count, 2);
+            max_leaf_size_ = (std::min)((std::max)(options_.max_leaf_size, 1), 0xffff);
+        }
+
+        std::vector<bvh_node_t> build()
+        {
+            std::vector<bvh_node_t> top_nodes;
+            std::vector<deferred_task_t> tasks;
+
+            const bool parallel = worker_count_ > 1;
+            build_recursive(0, indices_.size(), 0, top_nodes, parallel ? &tasks : nullptr);
+
+            std::vector<std::vector<bvh_node_t>> task_nodes(tasks.size());
+            if(!tasks.empty())
+            {
+                thread::parallel_forrange(
+                    size_t(0), tasks.size(), [&](int, size_t i)
+                {
+                    build_recursive(
+                        tasks[i].beg, tasks[i].end, tasks[i].depth,
+                        task_nodes[i], nullptr);
+                }, threads_, (std::min)(worker_count_, static_cast<int>(tasks.size())));
+            }
+
+            std::vector<bvh_node_t> nodes;
+            nodes.reserve(2 * indices_.size());
+            assemble(top_nodes, task_nodes, 0, nodes);
+            return nodes;
+        }
+
+    private:
+
+        range_info_t compute_range_info(size_t beg, size_t end, bool parallel)
+        {
+            auto compute = [&](size_t b, size_t e)
+            {
+                range_info_t info;
+                for(size_t i = b; i < e; ++i)
+                {
+                    auto &prim = primitives_[indices_[i]];
+                    union_into(info.bounds, prim.bounds);
+                    union_into(info.centroid_bounds, prim.centroid);
+                }
+                return info;
+            };
+
+            if(!parallel)
+                return compute(beg, end);
+
+            const size_t block_count =
+                (end - beg + BINNING_BLOCK_SIZE - 1) / BINNING_BLOCK_SIZE;
+            std::vector<range_info_t> block_infos(block_count);
+
+            thread::parallel_forrange(
+                size_t(0), block_count, [&](int, size_t block)
+            {
+                const size_t b = beg + block * BINNING_BLOCK_SIZE;
+                block_infos[block] = compute(
+                    b, (std::min)(b + BINNING_BLOCK_SIZE, end));
+            }, threads_, worker_count_);
+
+            range_info_t ret;
+            for(auto &info : block_infos)
+                ret.merge(info);
+            return ret;
+        }
+
+        int bin_index(
+            float centroid, float low, float scale) const noexcept
+        {
+            const int ret = static_cast<int>((centroid - low) * scale);
+            return (std::max)(0, (std::min)(ret, bin_count_ - 1));
+        }
+
+        /**
+         * @brief 对3个轴同时分桶，bins[axis * bin_count + k]
+         */
+        std::vector<bin_t> compute_bins(
+            size_t beg, size_t end, const math::aabb3f &centroid_bounds,
+            const float scales[3], bool parallel)
+        {
+            auto compute = [&](size_t b, size_t e, std::vector<bin_t> &bins)
+            {
+                for(size_t i = b; i < e; ++i)
+                {
+                    auto &prim = primitives_[indices_[i]];
+                    for(int axis = 0; axis < 3; ++axis)
+                    {
+                        const int k = bin_index(
+                            prim.centroid[axis],
+                            centroid_bounds.low[axis], scales[axis]);
+                        auto &bin = bins[axis * bin_count_ + k];
+                        union_into(bin.bounds, prim.bounds);
+                        ++bin.count;
+                    }
+                }
+            };
+
+            std::vector<bin_t> ret(3 * bin_count_);
+
+            if(!parallel)
+            {
+                compute(beg, end, ret);
+                return ret;
+            }
+
+            const size_t block_count =
+                (end - beg + BINNING_BLOCK_SIZE - 1) / BINNING_BLOCK_SIZE;
+            std::vector<std::vector<bin_t>> block_bins(block_count);
+
+            thread::parallel_forrange(
+                size_t(0), block_count, [&](int, size_t block)
+            {
+                const size_t b = beg + block * BINNING_BLOCK_SIZE;
+                block_bins[block].resize(3 * bin_count_);
+                compute(b, (std::min)(b + BINNING_BLOCK_SIZE, end), block_bins[block]);
+            }, threads_, worker_count_);
+
+            for(auto &bins : block_bins)
+            {
+                for(size_t k = 0; k < ret.size(); ++k)
+                {
+                    union_into(ret[k].bounds, bins[k].bounds);
+                    ret[k].count += bins[k].count;
+                }
+            }
+
+            return ret;
+        }
+
+        /**
+         * @brief 将[beg, end)按质心在axis上的中位数划分
+         */
+        size_t median_split(size_t beg, size_t end, int axis)
+        {
+            const size_t mid = (beg + end) / 2;
+            std::nth_element(
+                indices_.begin() + beg, indices_.begin() + mid,
+                indices_.begin() + end, [&](uint32_t a, uint32_t b)
+            {
+                return primitives_[a].centroid[axis] <
+                       primitives_[b].centroid[axis];
+            });
+            return mid;
+        }
+
+        static bvh_node_t make_node(const math::aabb3f &bounds) noexcept
+        {
+            bvh_node_t node = {};
+            for(int i = 0; i < 3; ++i)
+            {
+                node.low[i]  = bounds.low[i];
+                node.high[i] = bounds.high[i];
+            }
+            return node;
+        }
+
+        void build_recursive(
+            size_t beg, size_t end, int depth,
+            std::vector<bvh_node_t>      &nodes,
+            std::vector<deferred_task_t> *tasks)
+        {
+            const size_t count = end - beg;
+
+            if(tasks && count < options_.parallel_threshold)
+            {
+                bvh_node_t node = {};
+                node.axis   = DEFERRED_AXIS;
+                node.offset = static_cast<uint32_t>(tasks->size());
+                tasks->push_back({ beg, end, depth });
+                nodes.push_back(node);
+                return;
+            }
+
+            const bool parallel = tasks != nullptr;
+            const range_info_t info = compute_range_info(beg, end, parallel);
+
+            const size_t node_index = nodes.size();
+            nodes.push_back(make_node(info.bounds));
+
+            auto make_leaf = [&]
+            {
+                nodes[node_index].offset          = static_cast<uint32_t>(beg);
+                nodes[node_index].primitive_count = static_cast<uint16_t>(count);
+            };
+
+            if(count == 1)
+            {
+                make_leaf();
+                return;
+            }
+
+            // 选择划分
+
+            const math::vec3f extent =
+                info.centroid_bounds.high - info.centroid_bounds.low;
+
+            int split_axis = -1;
+            size_t mid = beg;
+
+            if(depth < MAX_SAH_DEPTH && extent.max_elem() > 0)
+            {
+                float scales[3];
+                for(int axis = 0; axis < 3; ++axis)
+                {
+                    scales[axis] = extent[axis] > 0 ?
+                        bin_count_ * (1 - 1e-6f) / extent[axis] : 0;
+                }
+
+                const auto bins = compute_bins(
+                    beg, end, info.centroid_bounds, scales, parallel);
+
+                float best_cost = FLOAT_INF;
+                int best_axis = -1, best_split = -1;
+
+                std::vector<float> right_area(bin_count_);
+                std::vector<uint32_t> right_count(bin_count_);
+
+                for(int axis = 0; axis < 3; ++axis)
+                {
+                    if(extent[axis] <= 0)
+                        continue;
+
+                    const bin_t *axis_bins = &bins[axis * bin_count_];
+
+                    math::aabb3f acc = empty_aabb();
+                    uint32_t acc_count = 0;
+                    for(int k = bin_count_ - 1; k > 0; --k)
+                    {
+                        union_into(acc, axis_bins[k].bounds);
+                        acc_count += axis_bins[k].count;
+                        right_area[k]  = surface_area(acc);
+                        right_count[k] = acc_count;
+                    }
+
+                    acc = empty_aabb();
+                    acc_count = 0;
+                    for(int k = 1; k < bin_count_; ++k)
+                    {
+                        union_into(acc, axis_bins[k - 1].bounds);
+                        acc_count += axis_bins[k - 1].count;
+                        if(!acc_count || !right_count[k])
+                            continue;
+
+                        const float cost =
+                            surface_area(acc) * acc_count +
+                            right_area[k] * right_count[k];
+                        if(cost < best_cost)
+                        {
+                            best_cost  = cost;
+                            best_axis  = axis;
+                            best_split = k;
+                        }
+                    }
+                }
+
+                if(best_axis >= 0)
+                {
+                    const float node_area = surface_area(info.bounds);
+                    const float split_cost =
+                        options_.traversal_cost + options_.intersection_cost *
+                        (node_area > 0 ? best_cost / node_area : float(count));
+                    const float leaf_cost = options_.intersection_cost * count;
+
+                    if(count <= size_t(max_leaf_size_) && leaf_cost <= split_cost)
+                    {
+                        make_leaf();
+                        return;
+                    }
+
+                    split_axis = best_axis;
+                    const float low = info.centroid_bounds.low[best_axis];
+                    const float scale = scales[best_axis];
+
+                    mid = std::partition(
+                        indices_.begin() + beg, indices_.begin() + end,
+                        [&](uint32_t i)
+                    {
+                        return bin_index(
+                            primitives_[i].centroid[best_axis], low, scale) < best_split;
+                    }) - indices_.begin();
+                }
+            }
+
+            if(split_axis < 0)
+            {
+                if(count <= size_t(max_leaf_size_))
+                {
+                    make_leaf();
+                    return;
+                }
+
+                // 质心重合或深度过大时按中位数划分
+                split_axis = 0;
+                for(int axis = 1; axis < 3; ++axis)
+                {
+                    if(extent[axis] > extent[split_axis])
+                        split_axis = axis;
+                }
+                mid = median_split(beg, end, split_axis);
+            }
+            else if(mid == beg || mid == end)
+                mid = median_split(beg, end, split_axis);
+
+            nodes[node_index].axis = static_cast<uint8_t>(split_axis);
+
+            build_recursive(beg, mid, depth + 1, nodes, tasks);
+            nodes[node_index].offset = static_cast<uint32_t>(nodes.size());
+            build_recursive(mid, end, depth + 1, nodes, tasks);
+        }
+
+        /**
+         * @brief 将顶层节点和延迟构建的子树拼接为一个深度优先数组
+         */
+        static void assemble(
+            const std::vector<bvh_node_t>              &top_nodes,
+            const std::vector<std::vector<bvh_node_t>> &task_nodes,
+            size_t                                      top_index,
+            std::vector<bvh_node_t>                    &output)
+        {
+            const bvh_node_t &top = top_nodes[top_index];
+
+            if(top.axis == DEFERRED_AXIS && !top.is_leaf())
+            {
+                const uint32_t base = static_cast<uint32_t>(output.size());
+                for(auto node : task_nodes[top.offset])
+                {
+                    if(!node.is_leaf())
+                        node.offset += base;
+                    output.push_back(node);
+                }
+                return;
+            }
+
+            const size_t output_index = output.size();
+            output.push_back(top);
+            if(top.is_leaf())
+                return;
+
+            assemble(top_nodes, task_nodes, top_index + 1, output);
+            output[output_index].offset = static_cast<uint32_t>(output.size());
+            assemble(top_nodes, task_nodes, top.offset, output);
+        }
+
+        const bvh_build_options_t            &options_;
+        const std::vector<build_primitive_t> &primitives_;
+        std::vector<uint32_t>                &indices_;
+        thread::thread_group_t               &threads_;
+        int worker_count_;
+
+        int bin_count_;
+        int max_leaf_size_;
+    };
+
+    math::aabb3f node_bounds(const bvh_node_t &node) noexcept
+    {
+        return math::aabb3f(
+            { node.low[0],  node.low[1],  node.low[2]  },
+            { node.high[0], node.high[1], node.high[2] });
+    }
+
+    uint32_t pack_count(uint32_t primitive_count) noexcept
+    {
+        return (primitive_count + 3) / 4;
+    }
+
+    /**
+     * @brief 将二叉bvh合并为4叉节点，并把叶节点中的三角形打包为triangle4_t
+     */
+    class collapser_t
+    {
+    public:
+
+        collapser_t(
+            const std::vector<bvh_node_t>       &nodes,
+            const std::vector<uint32_t>         &primitive_indices,
+            const std::vector<mesh::triangle_t> &triangles,
+            std::vector<bvh4_node_t>            &wide_nodes,
+            std::vector<triangle4_t>            &packs,
+            std::vector<uint32_t>               &pack_primitive_indices)
+            : nodes_(nodes), primitive_indices_(primitive_indices),
+              triangles_(triangles), wide_nodes_(wide_nodes),
+              packs_(packs), pack_primitive_indices_(pack_primitive_indices)
+        {
+            
+        }
+
+        /**
+         * @brief 返回4叉节点下标
+         */
+        uint32_t collapse(uint32_t node_index)
+        {
+            const uint32_t wide_index = static_cast<uint32_t>(wide_nodes_.size());
+            wide_nodes_.emplace_back();
+
+            uint32_t children[4];
+            int child_count = 0;
+
+            const bvh_node_t &node = nodes_[node_index];
+            if(node.is_leaf())
+                children[child_count++] = node_index;
+            else
+            {
+                children[child_count++] = node_index + 1;
+                children[child_count++] = node.offset;
+            }
+
+            // 反复展开表面积最大的内部子节点
+            while(child_count < 4)
+            {
+                int best = -1;
+                float best_area = -1;
+                for(int i = 0; i < child_count; ++i)
+                {
+                    const bvh_node_t &child = nodes_[children[i]];
+                    if(child.is_leaf())
+                        continue;
+                    const float area = surface_area(node_bounds(child));
+                    if(area > best_area)
+                    {
+                        best_area = area;
+                        best = i;
+                    }
+                }
+
+                if(best < 0)
+                    break;
+
+                const uint32_t expanded = children[best];
+                children[best]          = expanded + 1;
+                children[child_count++] = nodes_[expanded].offset;
+            }
+
+            bvh4_node_t wide;
+            uint32_t interior_children[4];
+
+            for(int i = 0; i < 4; ++i)
+            {
+                interior_children[i] = bvh4_node_t::EMPTY;
+
+                if(i >= child_count)
+                {
+                    wide.bounds.set_empty(i);
+                    wide.children[i] = bvh4_node_t::EMPTY;
+                    wide.counts[i]   = 0;
+                    continue;
+                }
+
+                const bvh_node_t &child = nodes_[children[i]];
+                wide.bounds.set(i, node_bounds(child));
+
+                if(child.is_leaf())
+                {
+                    wide.children[i] = make_packs(child);
+                    wide.counts[i]   = child.primitive_count;
+                }
+                else
+                {
+                    wide.children[i]     = bvh4_node_t::EMPTY;
+                    wide.counts[i]       = 0;
+                    interior_children[i] = children[i];
+                }
+            }
+
+            wide_nodes_[wide_index] = wide;
+
+            for(int i = 0; i < 4; ++i)
+            {
+                if(interior_children[i] != bvh4_node_t::EMPTY)
+                {
+                    const uint32_t child_wide = collapse(interior_children[i]);
+                    wide_nodes_[wide_index].children[i] = child_wide;
+                }
+            }
+
+            return wide_index;
+        }
+
+    private:
+
+        uint32_t make_packs(const bvh_node_t &leaf)
+        {
+            const uint32_t first_pack = static_cast<uint32_t>(packs_.size());
+
+            for(uint32_t p = 0; p < pack_count(leaf.primitive_count); ++p)
+            {
+                triangle4_t pack;
+                for(uint32_t lane = 0; lane < 4; ++lane)
+                {
+                    const uint32_t k = 4 * p + lane;
+                    if(k >= leaf.primitive_count)
+                    {
+                        pack.set_empty(lane);
+                        pack_primitive_indices_.push_back(bvh4_node_t::EMPTY);
+                        continue;
+                    }
+
+                    const uint32_t primitive = primitive_indices_[leaf.offset + k];
+                    auto &v = triangles_[primitive].vertices;
+                    pack.set(lane, v[0].position, v[1].position, v[2].position);
+                    pack_primitive_indices_.push_back(primitive);
+                }
+                packs_.push_back(pack);
+            }
+
+            return first_pack;
+        }
+
+        const std::vector<bvh_node_t>       &nodes_;
+        const std::vector<uint32_t>         &primitive_indices_;
+        const std::vector<mesh::triangle_t> &triangles_;
+        std::vector<bvh4_node_t>            &wide_nodes_;
+        std::vector<triangle4_t>            &packs_;
+        std::vector<uint32_t>               &pack_primitive_indices_;
+    };
+
+    bool overlaps(const math::aabb3f &a, const math::aabb3f &b) noexcept
+    {
+        return a.low.x <= b.high.x && b.low.x <= a.high.x &&
+               a.low.y <= b.high.y && b.low.y <= a.high.y &&
+               a.low.z <= b.high.z && b.low.z <= a.high.z;
+    }
+
+    struct stack_entry_t
+    {
+        uint32_t node;
+        float    t;
+    };
+
+    /**
+     * @brief 将count个候选子节点按t从大到小压栈，使最近的子节点最先被访问
+     */
+    void push_sorted(
+        stack_entry_t *stack, int &top,
+        stack_entry_t *candidates, int count) noexcept
+    {
+        for(int i = 1; i < count; ++i)
+        {
+            const stack_entry_t e = candidates[i];
+            int j = i - 1;
+            while(j >= 0 && candidates[j].t < e.t)
+            {
+                candidates[j + 1] = candidates[j];
+                --j;
+            }
+            candidates[j + 1] = e;
+        }
+
+        assert(top + count <= TRAVERSAL_STACK_SIZE);
+        for(int i = 0; i < count; ++i)
+            stack[top++] = candidates[i];
+    }
+
+    float max_t_max(const ray4_t &rays, int active) noexcept
+    {
+        float ret = -FLOAT_INF;
+        for(int i = 0; i < 4; ++i)
+        {
+            if(active & (1 << i))
+                ret = (std::max)(ret, rays.t_max[i]);
+        }
+        return ret;
+    }
+
+} // namespace anonymous
+
+void bvh_t::build(
+    const std::vector<mesh::triangle_t> &triangles,
+    const bvh_build_options_t &options,
+    int worker_count)
+{
+    thread::thread_group_t threads(worker_count);
+    build(triangles, options, threads, worker_count);
+}
+
+void bvh_t::build(
+    const std::vector<mesh::triangle_t> &triangles,
+    const bvh_build_options_t &options,
+    thread::thread_group_t &threads,
+    int worker_count)
+{
+    clear();
+
+    if(triangles.empty())
+        return;
+    if(triangles.size() > (std::numeric_limits<uint32_t>::max)())
+        throw std::runtime_error("bvh: too many primitives");
+
+    worker_count = thread::actual_worker_count(worker_count);
+
+    const size_t count = triangles.size();
+
+    std::vector<build_primitive_t> build_primitives(count);
+    std::vector<uint32_t> indices(count);
+
+    thread::parallel_forrange(
+        size_t(0), (count + BINNING_BLOCK_SIZE - 1) / BINNING_BLOCK_SIZE,
+        [&](int, size_t block)
+    {
+        const size_t beg = block * BINNING_BLOCK_SIZE;
+        const size_t end = (std::min)(beg + BINNING_BLOCK_SIZE, count);
+        for(size_t i = beg; i < end; ++i)
+        {
+            auto &v = triangles[i].vertices;
+            auto &prim = build_primitives[i];
+
+            prim.bounds = empty_aabb();
+            for(int k = 0; k < 3; ++k)
+                union_into(prim.bounds, v[k].position);
+            prim.centroid = 0.5f * (prim.bounds.low + prim.bounds.high);
+
+            indices[i] = static_cast<uint32_t>(i);
+        }
+    }, threads, worker_count);
+
+    builder_t builder(options, build_primitives, indices, threads, worker_count);
+    nodes_ = builder.build();
+    primitive_indices_ = std::move(indices);
+
+    wide_nodes_.reserve(nodes_.size() / 2 + 1);
+    packs_.reserve(count / 2 + 1);
+    pack_primitive_indices_.reserve(2 * count + 4);
+
+    collapser_t collapser(
+        nodes_, primitive_indices_, triangles,
+        wide_nodes_, packs_, pack_primitive_indices_);
+    collapser.collapse(0);
+}
+
+void bvh_t::clear() noexcept
+{
+    nodes_.clear();
+    wide_nodes_.clear();
+    packs_.clear();
+    pack_primitive_indices_.clear();
+    primitive_indices_.clear();
+}
+
+bool bvh_t::empty() const noexcept
+{
+    return nodes_.empty();
+}
+
+size_t bvh_t::primitive_count() const noexcept
+{
+    return primitive_indices_.size();
+}
+
+math::aabb3f bvh_t::bounds() const noexcept
+{
+    return nodes_.empty() ? math::aabb3f() : node_bounds(nodes_[0]);
+}
+
+const std::vector<bvh_node_t> &bvh_t::nodes() const noexcept
+{
+    return nodes_;
+}
+
+const std::vector<bvh4_node_t> &bvh_t::wide_nodes() const noexcept
+{
+    return wide_nodes_;
+}
+
+const std::vector<triangle4_t> &bvh_t::triangle_packs() const noexcept
+{
+    return packs_;
+}
+
+const std::vector<uint32_t> &bvh_t::pack_primitive_indices() const noexcept
+{
+    return pack_primitive_indices_;
+}
+
+const std::vector<uint32_t> &bvh_t::primitive_indices() const noexcept
+{
+    return primitive_indices_;
+}
+
+template<bool ANY_HIT, bool WATERTIGHT>
+bool bvh_t::traverse_ray(const ray_t &ray, ray_hit_t *hit) const noexcept
+{
+    if(wide_nodes_.empty())
+        return false;
+
+    ray_t cur_ray = ray;
+    watertight_ray_t watertight_ray;
+    if constexpr(WATERTIGHT)
+        watertight_ray = watertight_ray_t(ray);
+
+    const math::vec3f inv_d(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    bool found = false;
+
+    stack_entry_t stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = { 0, ray.t_min };
+
+    while(top > 0)
+    {
+        const stack_entry_t entry = stack[--top];
+        if(entry.t > cur_ray.t_max)
+            continue;
+
+        const bvh4_node_t &node = wide_nodes_[entry.node];
+
+        float t_enter[4];
+        const int mask = intersect_ray_aabb4(
+            cur_ray.o, inv_d, cur_ray.t_min, cur_ray.t_max, node.bounds, t_enter);
+
+        stack_entry_t candidates[4];
+        int candidate_count = 0;
+
+        for(int i = 0; i < 4; ++i)
+        {
+            if(!(mask & (1 << i)) || node.children[i] == bvh4_node_t::EMPTY)
+                continue;
+
+            if(!node.counts[i])
+            {
+                candidates[candidate_count++] = { node.children[i], t_enter[i] };
+                continue;
+            }
+
+            const uint32_t first_pack = node.children[i];
+            for(uint32_t p = 0; p < pack_count(node.counts[i]); ++p)
+            {
+                const uint32_t pack = first_pack + p;
+
+                hit4_t pack_hit;
+                int hit_mask;
+                if constexpr(WATERTIGHT)
+                {
+                    hit_mask = intersect_ray_triangle4_watertight(
+                        watertight_ray, packs_[pack], pack_hit);
+                }
+                else
+                {
+                    hit_mask = intersect_ray_triangle4(
+                        cur_ray, packs_[pack], pack_hit);
+                }
+
+                const uint32_t lane_count = (std::min)(4u, node.counts[i] - 4 * p);
+                hit_mask &= (1 << lane_count) - 1;
+                if(!hit_mask)
+                    continue;
+
+                if constexpr(ANY_HIT)
+                    return true;
+
+                for(int lane = 0; lane < 4; ++lane)
+                {
+                    if(!(hit_mask & (1 << lane)) || pack_hit.t[lane] > cur_ray.t_max)
+                        continue;
+
+                    found = true;
+                    cur_ray.t_max = pack_hit.t[lane];
+                    watertight_ray.t_max = pack_hit.t[lane];
+                    *hit = {
+                        pack_primitive_indices_[4 * pack + lane],
+                        pack_hit.t[lane], pack_hit.u[lane], pack_hit.v[lane]
+                    };
+                }
+            }
+        }
+
+        push_sorted(stack, top, candidates, candidate_count);
+    }
+
+    return found;
+}
+
+template<bool ANY_HIT, bool WATERTIGHT>
+int bvh_t::traverse_ray4(const ray4_t &rays, ray_hit_t *hits) const noexcept
+{
+    ray4_t cur_rays = rays;
+    int active = cur_rays.active_mask();
+    if(wide_nodes_.empty() || !active)
+        return 0;
+
+    watertight_ray4_t watertight_rays;
+    if constexpr(WATERTIGHT)
+        watertight_rays = watertight_ray4_t(rays);
+
+    int found = 0;
+
+    stack_entry_t stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = { 0, -FLOAT_INF };
+
+    while(top > 0)
+    {
+        const stack_entry_t entry = stack[--top];
+        if(entry.t > max_t_max(cur_rays, active))
+            continue;
+
+        const bvh4_node_t &node = wide_nodes_[entry.node];
+
+        stack_entry_t candidates[4];
+        int candidate_count = 0;
+
+        for(int i = 0; i < 4; ++i)
+        {
+            if(node.children[i] == bvh4_node_t::EMPTY)
+                continue;
+
+            float t_enter[4];
+            const int ray_mask = active & intersect_ray4_aabb(
+                cur_rays, node.bounds.get(i), t_enter);
+            if(!ray_mask)
+                continue;
+
+            if(!node.counts[i])
+            {
+                float t_near = FLOAT_INF;
+                for(int lane = 0; lane < 4; ++lane)
+                {
+                    if(ray_mask & (1 << lane))
+                        t_near = (std::min)(t_near, t_enter[lane]);
+                }
+                candidates[candidate_count++] = { node.children[i], t_near };
+                continue;
+            }
+
+            const uint32_t first_pack = node.children[i];
+            for(uint32_t k = 0; k < node.counts[i]; ++k)
+            {
+                const uint32_t pack = first_pack + k / 4;
+                const int tri_lane = static_cast<int>(k % 4);
+                const triangle4_t &tri = packs_[pack];
+
+                hit4_t ray_hit;
+                int hit_mask;
+                if constexpr(WATERTIGHT)
+                {
+                    hit_mask = intersect_ray4_triangle_watertight(
+                        watertight_rays, tri.vertex_a(tri_lane),
+                        tri.vertex_b(tri_lane), tri.vertex_c(tri_lane), ray_hit);
+                }
+                else
+                {
+                    hit_mask = intersect_ray4_triangle(
+                        cur_rays, tri.vertex_a(tri_lane),
+                        tri.vertex_b(tri_lane), tri.vertex_c(tri_lane), ray_hit);
+                }
+
+                hit_mask &= ray_mask & active;
+                if(!hit_mask)
+                    continue;
+
+                found |= hit_mask;
+
+                for(int lane = 0; lane < 4; ++lane)
+                {
+                    if(!(hit_mask & (1 << lane)))
+                        continue;
+
+                    if constexpr(ANY_HIT)
+                    {
+                        // 已被遮挡的射线不再参与求交
+                        cur_rays.t_max[lane]        = -FLOAT_INF;
+                        watertight_rays.t_max[lane] = -FLOAT_INF;
+                    }
+                    else
+                    {
+                        cur_rays.t_max[lane]        = ray_hit.t[lane];
+                        watertight_rays.t_max[lane] = ray_hit.t[lane];
+                        hits[lane] = {
+                            pack_primitive_indices_[4 * pack + tri_lane],
+                            ray_hit.t[lane], ray_hit.u[lane], ray_hit.v[lane]
+                        };
+                    }
+                }
+
+                if constexpr(ANY_HIT)
+                {
+                    active &= ~hit_mask;
+                    if(!active)
+                        return found;
+                }
+            }
+        }
+
+        push_sorted(stack, top, candidates, candidate_count);
+    }
+
+    return found;
+}
+
+bool bvh_t::closest_hit(
+    const ray_t &ray, ray_hit_t &hit, intersection_mode_t mode) const noexcept
+{
+    if(mode == intersection_mode_t::watertight)
+        return traverse_ray<false, true>(ray, &hit);
+    return traverse_ray<false, false>(ray, &hit);
+}
+
+bool bvh_t::any_hit(const ray_t &ray, intersection_mode_t mode) const noexcept
+{
+    if(mode == intersection_mode_t::watertight)
+        return traverse_ray<true, true>(ray, nullptr);
+    return traverse_ray<true, false>(ray, nullptr);
+}
+
+int bvh_t::closest_hit4(
+    const ray4_t &rays, ray_hit_t hits[4], intersection_mode_t mode) const noexcept
+{
+    if(mode == intersection_mode_t::watertight)
+        return traverse_ray4<false, true>(rays, hits);
+    return traverse_ray4<false, false>(rays, hits);
+}
+
+int bvh_t::any_hit4(const ray4_t &rays, intersection_mode_t mode) const noexcept
+{
+    if(mode == intersection_mode_t::watertight)
+        return traverse_ray4<true, true>(rays, nullptr);
+    return traverse_ray4<true, false>(rays, nullptr);
+}
+
+void bvh_t::query_aabb(
+    const math::aabb3f &box, std::vector<uint32_t> &output) const
+{
+    if(wide_nodes_.empty())
+        return;
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+
+    while(top > 0)
+    {
+        const bvh4_node_t &node = wide_nodes_[stack[--top]];
+
+        for(int i = 0; i < 4; ++i)
+        {
+            if(node.children[i] == bvh4_node_t::EMPTY ||
+               !overlaps(node.bounds.get(i), box))
+                continue;
+
+            if(!node.counts[i])
+            {
+                assert(top < TRAVERSAL_STACK_SIZE);
+                stack[top++] = node.children[i];
+                continue;
+            }
+
+            const uint32_t first_pack = node.children[i];
+            for(uint32_t k = 0; k < node.counts[i]; ++k)
+            {
+                const uint32_t pack = first_pack + k / 4;
+                const int lane = static_cast<int>(k % 4);
+                const triangle4_t &tri = packs_[pack];
+
+                math::aabb3f prim_bounds = empty_aabb();
+                union_into(prim_bounds, tri.vertex_a(lane));
+                union_into(prim_bounds, tri.vertex_b(lane));
+                union_into(prim_bounds, tri.vertex_c(lane));
+                if(overlaps(prim_bounds, box))
+                    output.push_back(pack_primitive_indices_[4 * pack + lane]);
+            }
+        }
+    }
+}
+
+std::vector<uint32_t> bvh_t::query_aabb(const math::aabb3f &box) const
+{
+    std::vector<uint32_t> ret;
+    query_aabb(box, ret);
+    return ret;
+}
+
+bool bvh_t::nearest_point(
+    const math::vec3f &p, nearest_point_t &result, float max_distance) const noexcept
+{
+    if(wide_nodes_.empty())
+        return false;
+
+    float best = max_distance * max_distance;
+    bool found = false;
+
+    stack_entry_t stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = { 0, 0 };
+
+    while(top > 0)
+    {
+        const stack_entry_t entry = stack[--top];
+        if(entry.t > best)
+            continue;
+
+        const bvh4_node_t &node = wide_nodes_[entry.node];
+
+        stack_entry_t candidates[4];
+        int candidate_count = 0;
+
+        for(int i = 0; i < 4; ++i)
+        {
+            if(node.children[i] == bvh4_node_t::EMPTY)
+                continue;
+
+            const float box_dist = distance_square_to_aabb(p, node.bounds.get(i));
+            if(box_dist > best)
+                continue;
+
+            if(!node.counts[i])
+            {
+                candidates[candidate_count++] = { node.children[i], box_dist };
+                continue;
+            }
+
+            const uint32_t first_pack = node.children[i];
+            for(uint32_t k = 0; k < node.counts[i]; ++k)
+            {
+                const uint32_t pack = first_pack + k / 4;
+                const int lane = static_cast<int>(k % 4);
+                const triangle4_t &tri = packs_[pack];
+
+                const math::vec3f q = closest_point_on_triangle(
+                    p, tri.vertex_a(lane), tri.vertex_b(lane), tri.vertex_c(lane));
+                const float dist = (q - p).length_square();
+                if(dist <= best)
+                {
+                    best  = dist;
+                    found = true;
+                    result = { pack_primitive_indices_[4 * pack + lane], q, dist };
+                }
+            }
+        }
+
+        push_sorted(stack, top, candidates, candidate_count);
+    }
+
+    return found;
+}
+
+} // namespace agz::geometry
@@ -1,5 +1,6 @@
 ﻿#include <cassert>
 #include <climits>
+#include <cstring>
 
 #include <agz-utils/file/file_raw.h>
 #include <agz-utils/image/load_image.h>
@@ -131,104 +132,147 @@ std::vector<math::byte> load_bytes_from_memory(
     return std::vector<math::byte>(bytes, bytes + w * h * c);
 }
 
-image_buffer<math::byte> load_gray_from_memory(const void *data, size_t byte_length)
+namespace img_impl
 {
-    int w, h, channels;
-    unsigned char *bytes = stbi_load_from_memory(
-        static_cast<const stbi_uc*>(data),
-        static_cast<int>(byte_length),
-        &w, &h, &channels, STBI_grey);
-    if(!bytes)
-        return image_buffer<math::byte>();
 
-    AGZ_SCOPE_EXIT{ stbi_image_free(bytes); };
+    int stb_channels(pixel_format_t format) noexcept
+    {
+        switch(format)
+        {
+        case pixel_format_t::gray8:       return STBI_grey;
+        case pixel_format_t::gray_alpha8: return STBI_grey_alpha;
+        case pixel_format_t::rgb8:        return STBI_rgb;
+        case pixel_format_t::rgba8:       return STBI_rgb_alpha;
+        case pixel_format_t::rgb32f:      return STBI_rgb;
+        }
+        return STBI_default;
+    }
 
-    assert(w > 0 && h > 0);
+    /**
+     * @brief stb解码得到的像素数据，析构时释放
+     */
+    struct stb_pixels_t : misc::uncopyable_t
+    {
+        void *pixels = nullptr;
+        int width    = 0;
+        int height   = 0;
 
-    return image_buffer<math::byte>::from_linear_indexed_fn(
-        { h, w }, [&](int i) { return bytes[i]; });
-}
+        ~stb_pixels_t()
+        {
+            if(pixels)
+                stbi_image_free(pixels);
+        }
+    };
+
+    bool stb_decode(
+        const void *data, size_t byte_length,
+        pixel_format_t format, stb_pixels_t &out)
+    {
+        if(byte_length > static_cast<size_t>(INT_MAX))
+            return false;
 
-namespace img_impl
-{
+        int channels;
+        if(format == pixel_format_t::rgb32f)
+        {
+            out.pixels = stbi_loadf_from_memory(
+                static_cast<const stbi_uc*>(data),
+                static_cast<int>(byte_length),
+                &out.width, &out.height, &channels, stb_channels(format));
+        }
+        else
+        {
+            out.pixels = stbi_load_from_memory(
+                static_cast<const stbi_uc*>(data),
+                static_cast<int>(byte_length),
+                &out.width, &out.height, &channels, stb_channels(format));
+        }
 
-    template<typename P, int CH, int STBchannel>
-    image_buffer<P> load_from_memory(const void *data, size_t byte_length)
+        return out.pixels != nullptr;
+    }
+
+    void copy_rows(
+        const stb_pixels_t &src, pixel_format_t format,
+        math::byte *dst, size_t row_pitch) noexcept
     {
-        int w, h, channels;
-        unsigned char *bytes = stbi_load_from_memory(
-            static_cast<const stbi_uc*>(data),
-            static_cast<int>(byte_length),
-            &w, &h, &channels, STBchannel);
-        if(!bytes)
-            return image_buffer<P>();
+        const size_t row_bytes = src.width * pixel_size(format);
+        auto src_bytes = static_cast<const math::byte*>(src.pixels);
 
-        AGZ_SCOPE_EXIT{ stbi_image_free(bytes); };
+        if(row_pitch == row_bytes)
+        {
+            std::memcpy(dst, src_bytes, row_bytes * src.height);
+            return;
+        }
 
-        assert(w > 0 && h > 0);
+        for(int y = 0; y < src.height; ++y)
+        {
+            std::memcpy(dst, src_bytes, row_bytes);
+            dst       += row_pitch;
+            src_bytes += row_bytes;
+        }
+    }
 
-        int idx = 0;
+    template<typename P, pixel_format_t Format>
+    bool decode_into_tensor(
+        const void *data, size_t byte_length, image_buffer<P> &dst)
+    {
+        static_assert(std::is_trivially_copyable_v<P>);
 
-        return image_buffer<P>::from_linear_indexed_fn(
-            { h, w }, [&](int i)
-        {
-            P ret(UNINIT);
-            for(int j = 0; j < CH; ++j)
-                ret[j] = bytes[idx + j];
-            idx += CH;
-            return ret;
-        });
+        stb_pixels_t pixels;
+        if(!stb_decode(data, byte_length, Format, pixels))
+            return false;
+
+        assert(pixels.width > 0 && pixels.height > 0);
+        assert(sizeof(P) == pixel_size(Format));
+
+        const typename image_buffer<P>::index_t shape(
+            pixels.height, pixels.width);
+        if(!dst.is_available() || dst.shape() != shape)
+            dst = image_buffer<P>(shape, UNINIT);
+
+        copy_rows(
+            pixels, Format, reinterpret_cast<math::byte*>(dst.raw_data()),
+            sizeof(P) * pixels.width);
+
+        return true;
+    }
+
+    template<typename P>
+    image_buffer<P> load_from_memory(const void *data, size_t byte_length)
+    {
+        image_buffer<P> ret;
+        decode_into(data, byte_length, ret);
+        return ret;
     }
 
 } // namespace img_impl
 
+image_buffer<math::byte> load_gray_from_memory(const void *data, size_t byte_length)
+{
+    return img_impl::load_from_memory<math::byte>(data, byte_length);
+}
+
 image_buffer<math::color2b> load_gray_alpha_from_memory(
     const void *data, size_t byte_length)
 {
-    return img_impl::load_from_memory<math::color2b, 2, STBI_grey_alpha>(
-        data, byte_length);
+    return img_impl::load_from_memory<math::color2b>(data, byte_length);
 }
 
 image_buffer<math::color3b> load_rgb_from_memory(
     const void *data, size_t byte_length)
 {
-    return img_impl::load_from_memory<math::color3b, 3, STBI_rgb>(
-        data, byte_length);
+    return img_impl::load_from_memory<math::color3b>(data, byte_length);
 }
 
 image_buffer<math::color4b> load_rgba_from_memory(
     const void *data, size_t byte_length)
 {
-    return img_impl::load_from_memory<math::color4b, 4, STBI_rgb_alpha>(
-        data, byte_length);
+    return img_impl::load_from_memory<math::color4b>(data, byte_length);
 }
 
 math::tensor_t<math::color3f, 2> load_rgb_from_hdr_memory(
-    const void *data_ptr, size_t byte_length)
+    const void *data, size_t byte_length)
 {
-    int w, h, channels;
-
-    float *data = stbi_loadf_from_memory(
-        static_cast<const stbi_uc *>(data_ptr),
-        static_cast<int>(byte_length),
-        &w, &h, &channels, STBI_rgb);
-    if(!data)
-        return image_buffer<math::color3f>();
-
-    AGZ_SCOPE_EXIT{ stbi_image_free(data); };
-
-    assert(w > 0 && h > 0);
-
-    int idx = 0;
-    return image_buffer<math::color3f>::from_linear_indexed_fn(
-        { h, w }, [&](int i)
-    {
-        math::color3f ret(UNINIT);
-        for(int j = 0; j < 3; ++j)
-            ret[j] = data[idx + j];
-        idx += 3;
-        return ret;
-    });
+    return img_impl::load_from_memory<math::color3f>(data, byte_length);
 }
 
 std::vector<math::byte> load_bytes_from_file(
@@ -272,4 +316,136 @@ math::tensor_t<math::color3f, 2> load_rgb_from_hdr_file(
     return load_rgb_from_hdr_memory(content.data(), content.size());
 }
 
+bool query_image_info_from_memory(
+    const void *data, size_t byte_length, image_info_t *info)
+{
+    assert(info);
+
+    if(byte_length > static_cast<size_t>(INT_MAX))
+        return false;
+
+    int w, h, c;
+    if(!stbi_info_from_memory(
+        static_cast<const stbi_uc*>(data), static_cast<int>(byte_length),
+        &w, &h, &c))
+        return false;
+
+    info->width    = w;
+    info->height   = h;
+    info->channels = c;
+    info->is_hdr   = stbi_is_hdr_from_memory(
+        static_cast<const stbi_uc*>(data), static_cast<int>(byte_length)) != 0;
+
+    return true;
+}
+
+bool query_image_info_from_file(
+    const std::string &filename, image_info_t *info)
+{
+    assert(info);
+
+    FILE *file = stbi__fopen(filename.c_str(), "rb");
+    if(!file)
+        return false;
+    AGZ_SCOPE_EXIT{ fclose(file); };
+
+    int w, h, c;
+    if(!stbi_info_from_file(file, &w, &h, &c))
+        return false;
+
+    info->width    = w;
+    info->height   = h;
+    info->channels = c;
+    info->is_hdr   = stbi_is_hdr_from_file(file) != 0;
+
+    return true;
+}
+
+size_t pixel_size(pixel_format_t format) noexcept
+{
+    switch(format)
+    {
+    case pixel_format_t::gray8:       return sizeof(math::byte);
+    case pixel_format_t::gray_alpha8: return sizeof(math::color2b);
+    case pixel_format_t::rgb8:        return sizeof(math::color3b);
+    case pixel_format_t::rgba8:       return sizeof(math::color4b);
+    case pixel_format_t::rgb32f:      return sizeof(math::color3f);
+    }
+    return 0;
+}
+
+size_t image_layout_t::byte_size() const noexcept
+{
+    if(width <= 0 || height <= 0)
+        return 0;
+    return row_pitch * (height - 1) + width * pixel_size(format);
+}
+
+image_layout_t make_image_layout(
+    pixel_format_t format, int width, int height, size_t row_alignment)
+{
+    assert(row_alignment > 0);
+
+    image_layout_t ret;
+    ret.format    = format;
+    ret.width     = width;
+    ret.height    = height;
+    ret.row_pitch = upalign_to(width * pixel_size(format), row_alignment);
+    return ret;
+}
+
+bool decode_into(
+    const void *data, size_t byte_length,
+    misc::span<math::byte> dst, const image_layout_t &layout)
+{
+    if(layout.row_pitch < layout.width * pixel_size(layout.format) ||
+       dst.size() < layout.byte_size())
+        throw std::runtime_error("image buffer is too small for given layout");
+
+    img_impl::stb_pixels_t pixels;
+    if(!img_impl::stb_decode(data, byte_length, layout.format, pixels))
+        return false;
+
+    if(pixels.width != layout.width || pixels.height != layout.height)
+        return false;
+
+    img_impl::copy_rows(pixels, layout.format, dst.data(), layout.row_pitch);
+    return true;
+}
+
+bool decode_into(
+    const void *data, size_t byte_length, image_buffer<math::byte> &dst)
+{
+    return img_impl::decode_into_tensor<math::byte, pixel_format_t::gray8>(
+        data, byte_length, dst);
+}
+
+bool decode_into(
+    const void *data, size_t byte_length, image_buffer<math::color2b> &dst)
+{
+    return img_impl::decode_into_tensor<
+        math::color2b, pixel_format_t::gray_alpha8>(data, byte_length, dst);
+}
+
+bool decode_into(
+    const void *data, size_t byte_length, image_buffer<math::color3b> &dst)
+{
+    return img_impl::decode_into_tensor<math::color3b, pixel_format_t::rgb8>(
+        data, byte_length, dst);
+}
+
+bool decode_into(
+    const void *data, size_t byte_length, image_buffer<math::color4b> &dst)
+{
+    return img_impl::decode_into_tensor<math::color4b, pixel_format_t::rgba8>(
+        data, byte_length, dst);
+}
+
+bool decode_into(
+    const void *data, size_t byte_length, image_buffer<math::color3f> &dst)
+{
+    return img_impl::decode_into_tensor<math::color3f, pixel_format_t::rgb32f>(
+        data, byte_length, dst);
+}
+
 } // namespace agz::img
@@ -0,0 +1,641 @@
+﻿#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <agz-utils/mesh/agzmesh.h>
+#include <agz-utils/mesh/indexed_mesh.h>
+#include <agz-utils/misc/endian.h>
+
+namespace agz::mesh
+{
+
+namespace
+{
+
+    constexpr char AGZMESH_MAGIC[8] = { 'A', 'G', 'Z', 'M', 'E', 'S', 'H', '\0' };
+
+    constexpr uint32_t AGZMESH_VERSION = 1;
+
+    constexpr uint32_t FLAG_QUANTIZED_NORMALS    = 1u << 0;
+    constexpr uint32_t FLAG_QUANTIZED_TEX_COORDS = 1u << 1;
+
+    constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+    struct file_header_t
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t flags;
+
+        uint64_t vertex_count;
+        uint64_t index_count;
+        uint64_t chunk_count;
+
+        float bounds_low[3];
+        float bounds_high[3];
+
+        float tex_coord_low[2];
+        float tex_coord_extent[2];
+
+        uint64_t position_offset;
+        uint64_t normal_offset;
+        uint64_t tex_coord_offset;
+        uint64_t index_offset;
+        uint64_t chunk_offset;
+
+        uint64_t file_size;
+    };
+
+    static_assert(sizeof(file_header_t) == 128);
+    static_assert(sizeof(math::vec3f) == 12);
+    static_assert(sizeof(math::vec2f) == 8);
+    static_assert(sizeof(vertex_t) == 32);
+
+    uint64_t align_section(uint64_t offset) noexcept
+    {
+        return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT
+                                                * SECTION_ALIGNMENT;
+    }
+
+    uint32_t pack_u16x2(uint16_t low, uint16_t high) noexcept
+    {
+        return uint32_t(low) | (uint32_t(high) << 16);
+    }
+
+    uint16_t to_snorm16(float v) noexcept
+    {
+        v = (std::max)(-1.0f, (std::min)(1.0f, v));
+        return static_cast<uint16_t>(
+            static_cast<int16_t>(std::lround(v * 32767.0f)));
+    }
+
+    float from_snorm16(uint16_t v) noexcept
+    {
+        return (std::max)(-1.0f, static_cast<int16_t>(v) / 32767.0f);
+    }
+
+    uint16_t to_unorm16(float v) noexcept
+    {
+        v = (std::max)(0.0f, (std::min)(1.0f, v));
+        return static_cast<uint16_t>(std::lround(v * 65535.0f));
+    }
+
+    float sign_not_zero(float v) noexcept
+    {
+        return v >= 0 ? 1.0f : -1.0f;
+    }
+
+    uint32_t encode_normal(const math::vec3f &n) noexcept
+    {
+        const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if(l1 <= 0)
+            return pack_u16x2(to_snorm16(0), to_snorm16(0));
+
+        float x = n.x / l1, y = n.y / l1;
+        if(n.z < 0)
+        {
+            const float ox = x;
+            x = (1 - std::abs(y)) * sign_not_zero(ox);
+            y = (1 - std::abs(ox)) * sign_not_zero(y);
+        }
+
+        return pack_u16x2(to_snorm16(x), to_snorm16(y));
+    }
+
+    math::vec3f decode_normal(uint32_t packed) noexcept
+    {
+        float x = from_snorm16(static_cast<uint16_t>(packed & 0xffff));
+        float y = from_snorm16(static_cast<uint16_t>(packed >> 16));
+        const float z = 1 - std::abs(x) - std::abs(y);
+
+        const float t = (std::max)(-z, 0.0f);
+        x += x >= 0 ? -t : t;
+        y += y >= 0 ? -t : t;
+
+        return math::vec3f(x, y, z).normalize();
+    }
+
+    class section_writer_t
+    {
+        std::ofstream &fout_;
+        uint64_t written_ = 0;
+
+    public:
+
+        explicit section_writer_t(std::ofstream &fout) noexcept
+            : fout_(fout)
+        {
+
+        }
+
+        void write(uint64_t offset, const void *data, size_t bytes)
+        {
+            static const char zeros[SECTION_ALIGNMENT] = {};
+            while(written_ < offset)
+            {
+                const size_t pad = static_cast<size_t>(
+                    (std::min)(offset - written_, SECTION_ALIGNMENT));
+                fout_.write(zeros, static_cast<std::streamsize>(pad));
+                written_ += pad;
+            }
+
+            fout_.write(
+                static_cast<const char*>(data),
+                static_cast<std::streamsize>(bytes));
+            written_ += bytes;
+        }
+    };
+
+} // namespace anonymous
+
+void save_agzmesh(
+    const std::string           &filename,
+    const std::vector<vertex_t> &vertices,
+    const std::vector<uint32_t> &indices,
+    const agzmesh_options_t     &options)
+{
+    if constexpr(misc::endian_type::local != misc::endian_type::little)
+        throw std::runtime_error("agzmesh: big-endian hosts are not supported");
+
+    if(indices.size() % 3)
+        throw std::runtime_error("agzmesh: index count is not a multiple of 3");
+    if(vertices.size() > uint64_t((std::numeric_limits<uint32_t>::max)()) + 1)
+        throw std::runtime_error("agzmesh: too many vertices");
+    if(indices.size() / 3 > (std::numeric_limits<uint32_t>::max)())
+        throw std::runtime_error("agzmesh: too many triangles");
+
+    for(uint32_t i : indices)
+    {
+        if(i >= vertices.size())
+            throw std::runtime_error("agzmesh: vertex index out of range");
+    }
+
+    const size_t vertex_count   = vertices.size();
+    const size_t triangle_count = indices.size() / 3;
+    const size_t chunk_size     = (std::max)(options.chunk_triangle_count, 1u);
+    const size_t chunk_count    = (triangle_count + chunk_size - 1) / chunk_size;
+
+    // bounds
+
+    math::aabb3f bounds(
+        math::vec3f((std::numeric_limits<float>::max)()),
+        math::vec3f((std::numeric_limits<float>::lowest)()));
+    math::vec2f tex_coord_low((std::numeric_limits<float>::max)());
+    math::vec2f tex_coord_high((std::numeric_limits<float>::lowest)());
+
+    for(auto &v : vertices)
+    {
+        bounds |= v.position;
+        tex_coord_low.x  = (std::min)(tex_coord_low.x,  v.tex_coord.x);
+        tex_coord_low.y  = (std::min)(tex_coord_low.y,  v.tex_coord.y);
+        tex_coord_high.x = (std::max)(tex_coord_high.x, v.tex_coord.x);
+        tex_coord_high.y = (std::max)(tex_coord_high.y, v.tex_coord.y);
+    }
+
+    if(vertices.empty())
+    {
+        bounds         = math::aabb3f();
+        tex_coord_low  = math::vec2f();
+        tex_coord_high = math::vec2f();
+    }
+
+    const math::vec2f tex_coord_extent = tex_coord_high - tex_coord_low;
+
+    // header
+
+    file_header_t header = {};
+    std::memcpy(header.magic, AGZMESH_MAGIC, sizeof(AGZMESH_MAGIC));
+    header.version = AGZMESH_VERSION;
+
+    if(options.quantize_normals)
+        header.flags |= FLAG_QUANTIZED_NORMALS;
+    if(options.quantize_tex_coords)
+        header.flags |= FLAG_QUANTIZED_TEX_COORDS;
+
+    header.vertex_count = vertex_count;
+    header.index_count  = indices.size();
+    header.chunk_count  = chunk_count;
+
+    for(int i = 0; i < 3; ++i)
+    {
+        header.bounds_low[i]  = bounds.low[i];
+        header.bounds_high[i] = bounds.high[i];
+    }
+
+    header.tex_coord_low[0]    = tex_coord_low.x;
+    header.tex_coord_low[1]    = tex_coord_low.y;
+    header.tex_coord_extent[0] = tex_coord_extent.x;
+    header.tex_coord_extent[1] = tex_coord_extent.y;
+
+    const uint64_t normal_size = options.quantize_normals ?
+        sizeof(uint32_t) : sizeof(math::vec3f);
+    const uint64_t tex_coord_size = options.quantize_tex_coords ?
+        sizeof(uint32_t) : sizeof(math::vec2f);
+
+    header.position_offset  = align_section(sizeof(file_header_t));
+    header.normal_offset    = align_section(
+        header.position_offset + vertex_count * sizeof(math::vec3f));
+    header.tex_coord_offset = align_section(
+        header.normal_offset + vertex_count * normal_size);
+    header.index_offset     = align_section(
+        header.tex_coord_offset + vertex_count * tex_coord_size);
+    header.chunk_offset     = align_section(
+        header.index_offset + indices.size() * sizeof(uint32_t));
+    header.file_size        =
+        header.chunk_offset + chunk_count * sizeof(agzmesh_chunk_t);
+
+    // sections
+
+    std::vector<math::vec3f> positions(vertex_count);
+    for(size_t i = 0; i < vertex_count; ++i)
+        positions[i] = vertices[i].position;
+
+    std::vector<math::vec3f> normals;
+    std::vector<uint32_t> quantized_normals;
+    if(options.quantize_normals)
+    {
+        quantized_normals.resize(vertex_count);
+        for(size_t i = 0; i < vertex_count; ++i)
+            quantized_normals[i] = encode_normal(vertices[i].normal);
+    }
+    else
+    {
+        normals.resize(vertex_count);
+        for(size_t i = 0; i < vertex_count; ++i)
+            normals[i] = vertices[i].normal;
+    }
+
+    std::vector<math::vec2f> tex_coords;
+    std::vector<uint32_t> quantized_tex_coords;
+    if(options.quantize_tex_coords)
+    {
+        quantized_tex_coords.resize(vertex_count);
+        for(size_t i = 0; i < vertex_count; ++i)
+        {
+            const math::vec2f uv = vertices[i].tex_coord - tex_coord_low;
+            quantized_tex_coords[i] = pack_u16x2(
+                to_unorm16(tex_coord_extent.x > 0 ? uv.x / tex_coord_extent.x : 0),
+                to_unorm16(tex_coord_extent.y > 0 ? uv.y / tex_coord_extent.y : 0));
+        }
+    }
+    else
+    {
+        tex_coords.resize(vertex_count);
+        for(size_t i = 0; i < vertex_count; ++i)
+            tex_coords[i] = vertices[i].tex_coord;
+    }
+
+    std::vector<agzmesh_chunk_t> chunks(chunk_count);
+    for(size_t c = 0; c < chunk_count; ++c)
+    {
+        const size_t beg = c * chunk_size;
+        const size_t end = (std::min)(beg + chunk_size, triangle_count);
+
+        math::aabb3f chunk_bounds(
+            vertices[indices[3 * beg]].position,
+            vertices[indices[3 * beg]].position);
+        for(size_t i = 3 * beg; i < 3 * end; ++i)
+            chunk_bounds |= vertices[indices[i]].position;
+
+        chunks[c].bounds         = chunk_bounds;
+        chunks[c].first_triangle = static_cast<uint32_t>(beg);
+        chunks[c].triangle_count = static_cast<uint32_t>(end - beg);
+    }
+
+    // write
+
+    std::ofstream fout(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!fout)
+        throw std::runtime_error("failed to open file: " + filename);
+
+    section_writer_t writer(fout);
+    writer.write(0, &header, sizeof(header));
+    writer.write(
+        header.position_offset, positions.data(),
+        positions.size() * sizeof(math::vec3f));
+
+    if(options.quantize_normals)
+    {
+        writer.write(
+            header.normal_offset, quantized_normals.data(),
+            quantized_normals.size() * sizeof(uint32_t));
+    }
+    else
+    {
+        writer.write(
+            header.normal_offset, normals.data(),
+            normals.size() * sizeof(math::vec3f));
+    }
+
+    if(options.quantize_tex_coords)
+    {
+        writer.write(
+            header.tex_coord_offset, quantized_tex_coords.data(),
+            quantized_tex_coords.size() * sizeof(uint32_t));
+    }
+    else
+    {
+        writer.write(
+            header.tex_coord_offset, tex_coords.data(),
+            tex_coords.size() * sizeof(math::vec2f));
+    }
+
+    writer.write(
+        header.index_offset, indices.data(), indices.size() * sizeof(uint32_t));
+    writer.write(
+        header.chunk_offset, chunks.data(),
+        chunks.size() * sizeof(agzmesh_chunk_t));
+
+    fout.close();
+    if(!fout)
+        throw std::runtime_error("failed to write file: " + filename);
+}
+
+void save_agzmesh(
+    const std::string             &filename,
+    const std::vector<triangle_t> &triangles,
+    const agzmesh_options_t       &options)
+{
+    indexed_mesh_t mesh = weld_vertices(triangles);
+    if(options.optimize_vertex_order)
+    {
+        optimize_vertex_cache(mesh);
+        optimize_vertex_fetch(mesh);
+    }
+    save_agzmesh(filename, mesh.vertices, mesh.indices, options);
+}
+
+void convert_to_agzmesh(
+    const std::string       &src_filename,
+    const std::string       &dst_filename,
+    const agzmesh_options_t &options)
+{
+    save_agzmesh(dst_filename, load_from_file(src_filename), options);
+}
+
+agzmesh_view_t::agzmesh_view_t(const std::string &filename)
+{
+    open(filename);
+}
+
+agzmesh_view_t::agzmesh_view_t(agzmesh_view_t &&move_from) noexcept
+{
+    *this = std::move(move_from);
+}
+
+agzmesh_view_t &agzmesh_view_t::operator=(agzmesh_view_t &&move_from) noexcept
+{
+    file_                 = std::move(move_from.file_);
+    bounds_               = move_from.bounds_;
+    tex_coord_low_        = move_from.tex_coord_low_;
+    tex_coord_extent_     = move_from.tex_coord_extent_;
+    quantized_normals_    = move_from.quantized_normals_;
+    quantized_tex_coords_ = move_from.quantized_tex_coords_;
+    vertex_count_         = move_from.vertex_count_;
+    index_count_          = move_from.index_count_;
+    chunk_count_          = move_from.chunk_count_;
+    positions_            = move_from.positions_;
+    normals_              = move_from.normals_;
+    tex_coords_           = move_from.tex_coords_;
+    indices_              = move_from.indices_;
+    chunks_               = move_from.chunks_;
+    move_from.close();
+    return *this;
+}
+
+void agzmesh_view_t::open(const std::string &filename)
+{
+    close();
+
+    if constexpr(misc::endian_type::local != misc::endian_type::little)
+        throw std::runtime_error("agzmesh: big-endian hosts are not supported");
+
+    file::mapped_file_t file(filename);
+    const uint64_t file_size = file.size();
+
+    auto check = [&](bool cond, const char *msg)
+    {
+        if(!cond)
+            throw std::runtime_error(
+                "invalid agzmesh file (" + std::string(msg) + "): " + filename);
+    };
+
+    check(file_size >= sizeof(file_header_t), "truncated header");
+
+    file_header_t header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    check(!std::memcmp(header.magic, AGZMESH_MAGIC, sizeof(AGZMESH_MAGIC)),
+          "magic number mismatch");
+    check(header.version == AGZMESH_VERSION, "unsupported version");
+    check(header.file_size == file_size, "file size mismatch");
+    check(header.index_count % 3 == 0, "invalid index count");
+    check(header.vertex_count <=
+            uint64_t((std::numeric_limits<uint32_t>::max)()) + 1,
+          "too many vertices");
+
+    const bool quantized_normals =
+        (header.flags & FLAG_QUANTIZED_NORMALS) != 0;
+    const bool quantized_tex_coords =
+        (header.flags & FLAG_QUANTIZED_TEX_COORDS) != 0;
+
+    // 各段必须4字节对齐且位于文件内；先限制元素数以避免乘法溢出
+
+    check(header.index_count <= file_size && header.chunk_count <= file_size,
+          "invalid element count");
+
+    auto check_section = [&](uint64_t offset, uint64_t count, uint64_t elem_size)
+    {
+        check(offset % alignof(float) == 0, "misaligned section");
+        check(offset >= sizeof(file_header_t) && offset <= file_size,
+              "section out of range");
+        check(count * elem_size <= file_size - offset, "section out of range");
+    };
+
+    check_section(header.position_offset, header.vertex_count, sizeof(math::vec3f));
+    check_section(
+        header.normal_offset, header.vertex_count,
+        quantized_normals ? sizeof(uint32_t) : sizeof(math::vec3f));
+    check_section(
+        header.tex_coord_offset, header.vertex_count,
+        quantized_tex_coords ? sizeof(uint32_t) : sizeof(math::vec2f));
+    check_section(header.index_offset, header.index_count, sizeof(uint32_t));
+    check_section(
+        header.chunk_offset, header.chunk_count, sizeof(agzmesh_chunk_t));
+
+    const unsigned char *data = file.data();
+
+    bounds_ = math::aabb3f(
+        { header.bounds_low[0],  header.bounds_low[1],  header.bounds_low[2]  },
+        { header.bounds_high[0], header.bounds_high[1], header.bounds_high[2] });
+    tex_coord_low_    = { header.tex_coord_low[0],    header.tex_coord_low[1]    };
+    tex_coord_extent_ = { header.tex_coord_extent[0], header.tex_coord_extent[1] };
+
+    quantized_normals_    = quantized_normals;
+    quantized_tex_coords_ = quantized_tex_coords;
+
+    vertex_count_ = static_cast<size_t>(header.vertex_count);
+    index_count_  = static_cast<size_t>(header.index_count);
+    chunk_count_  = static_cast<size_t>(header.chunk_count);
+
+    positions_  = data + header.position_offset;
+    normals_    = data + header.normal_offset;
+    tex_coords_ = data + header.tex_coord_offset;
+    indices_    = data + header.index_offset;
+    chunks_     = data + header.chunk_offset;
+
+    file_ = std::move(file);
+}
+
+void agzmesh_view_t::close() noexcept
+{
+    file_.close();
+
+    bounds_               = math::aabb3f();
+    tex_coord_low_        = math::vec2f();
+    tex_coord_extent_     = math::vec2f();
+    quantized_normals_    = false;
+    quantized_tex_coords_ = false;
+    vertex_count_         = 0;
+    index_count_          = 0;
+    chunk_count_          = 0;
+    positions_            = nullptr;
+    normals_              = nullptr;
+    tex_coords_           = nullptr;
+    indices_              = nullptr;
+    chunks_               = nullptr;
+}
+
+bool agzmesh_view_t::is_open() const noexcept
+{
+    return file_.is_open();
+}
+
+size_t agzmesh_view_t::vertex_count() const noexcept
+{
+    return vertex_count_;
+}
+
+size_t agzmesh_view_t::index_count() const noexcept
+{
+    return index_count_;
+}
+
+size_t agzmesh_view_t::triangle_count() const noexcept
+{
+    return index_count_ / 3;
+}
+
+const math::aabb3f &agzmesh_view_t::bounds() const noexcept
+{
+    return bounds_;
+}
+
+bool agzmesh_view_t::has_quantized_normals() const noexcept
+{
+    return quantized_normals_;
+}
+
+bool agzmesh_view_t::has_quantized_tex_coords() const noexcept
+{
+    return quantized_tex_coords_;
+}
+
+misc::span<const math::vec3f> agzmesh_view_t::positions() const noexcept
+{
+    return { reinterpret_cast<const math::vec3f*>(positions_), vertex_count_ };
+}
+
+misc::span<const math::vec3f> agzmesh_view_t::normals() const noexcept
+{
+    if(quantized_normals_)
+        return {};
+    return { reinterpret_cast<const math::vec3f*>(normals_), vertex_count_ };
+}
+
+misc::span<const math::vec2f> agzmesh_view_t::tex_coords() const noexcept
+{
+    if(quantized_tex_coords_)
+        return {};
+    return { reinterpret_cast<const math::vec2f*>(tex_coords_), vertex_count_ };
+}
+
+misc::span<const uint32_t> agzmesh_view_t::quantized_normals() const noexcept
+{
+    if(!quantized_normals_)
+        return {};
+    return { reinterpret_cast<const uint32_t*>(normals_), vertex_count_ };
+}
+
+misc::span<const uint32_t> agzmesh_view_t::quantized_tex_coords() const noexcept
+{
+    if(!quantized_tex_coords_)
+        return {};
+    return { reinterpret_cast<const uint32_t*>(tex_coords_), vertex_count_ };
+}
+
+misc::span<const uint32_t> agzmesh_view_t::indices() const noexcept
+{
+    return { reinterpret_cast<const uint32_t*>(indices_), index_count_ };
+}
+
+misc::span<const agzmesh_chunk_t> agzmesh_view_t::chunks() const noexcept
+{
+    return { reinterpret_cast<const agzmesh_chunk_t*>(chunks_), chunk_count_ };
+}
+
+math::vec3f agzmesh_view_t::normal(size_t i) const noexcept
+{
+    if(quantized_normals_)
+        return decode_normal(quantized_normals()[i]);
+    return normals()[i];
+}
+
+math::vec2f agzmesh_view_t::tex_coord(size_t i) const noexcept
+{
+    if(quantized_tex_coords_)
+    {
+        const uint32_t packed = quantized_tex_coords()[i];
+        const math::vec2f t(
+            (packed & 0xffff) / 65535.0f, (packed >> 16) / 65535.0f);
+        return tex_coord_low_ + t * tex_coord_extent_;
+    }
+    return tex_coords()[i];
+}
+
+vertex_t agzmesh_view_t::vertex(size_t i) const noexcept
+{
+    return { positions()[i], normal(i), tex_coord(i) };
+}
+
+std::vector<vertex_t> agzmesh_view_t::decode_vertices() const
+{
+    std::vector<vertex_t> ret(vertex_count_);
+    for(size_t i = 0; i < vertex_count_; ++i)
+        ret[i] = vertex(i);
+    return ret;
+}
+
+indexed_mesh_t agzmesh_view_t::to_indexed_mesh() const
+{
+    const auto idx = indices();
+
+    indexed_mesh_t ret;
+    ret.vertices = decode_vertices();
+    ret.indices.assign(idx.begin(), idx.end());
+    return ret;
+}
+
+std::vector<triangle_t> agzmesh_view_t::to_triangles() const
+{
+    return to_indexed_mesh().to_triangles();
+}
+
+std::vector<triangle_t> load_from_agzmesh(const std::string &filename)
+{
+    return agzmesh_view_t(filename).to_triangles();
+}
+
+} // namespace agz::mesh
@@ -0,0 +1,352 @@
+﻿#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include <agz-utils/mesh/indexed_mesh.h>
+#include <agz-utils/misc/hash.h>
+#include <agz-utils/thread/parallel_foreach.h>
+
+namespace agz::mesh
+{
+
+namespace
+{
+
+    static_assert(sizeof(vertex_t) == 8 * sizeof(uint32_t));
+
+    size_t hash_vertex(const vertex_t &v) noexcept
+    {
+        return static_cast<size_t>(misc::hash_bytes(&v, sizeof(vertex_t)));
+    }
+
+    /**
+     * @brief 以预先计算好的hash值为键，按位比较顶点
+     */
+    struct vertex_ref_t
+    {
+        const vertex_t *vertex;
+        size_t hash;
+
+        bool operator==(const vertex_ref_t &rhs) const noexcept
+        {
+            return std::memcmp(vertex, rhs.vertex, sizeof(vertex_t)) == 0;
+        }
+    };
+
+    struct vertex_ref_hash_t
+    {
+        size_t operator()(const vertex_ref_t &v) const noexcept
+        {
+            return v.hash;
+        }
+    };
+
+    const vertex_t &corner(
+        const std::vector<triangle_t> &triangles, size_t i) noexcept
+    {
+        return triangles[i / 3].vertices[i % 3];
+    }
+
+    /**
+     * @brief 将[0, count)划分为若干块并行处理，func(beg, end)
+     */
+    template<typename Func>
+    void parallel_for_blocks(
+        size_t count, size_t block_size, int worker_count, Func &&func)
+    {
+        const size_t block_count = (count + block_size - 1) / block_size;
+        thread::parallel_forrange(
+            size_t(0), block_count, [&](int, size_t block)
+        {
+            const size_t beg = block * block_size;
+            func(beg, (std::min)(beg + block_size, count));
+        }, worker_count);
+    }
+
+} // namespace anonymous
+
+size_t indexed_mesh_t::triangle_count() const noexcept
+{
+    return indices.size() / 3;
+}
+
+std::vector<triangle_t> indexed_mesh_t::to_triangles() const
+{
+    std::vector<triangle_t> ret(triangle_count());
+    for(size_t i = 0; i < ret.size(); ++i)
+    {
+        for(int j = 0; j < 3; ++j)
+            ret[i].vertices[j] = vertices.at(indices[3 * i + j]);
+    }
+    return ret;
+}
+
+indexed_mesh_t weld_vertices(
+    const std::vector<triangle_t> &triangles, int worker_count)
+{
+    constexpr size_t BLOCK_SIZE = 1 << 16;
+
+    const size_t corner_count = triangles.size() * 3;
+    if(corner_count > (std::numeric_limits<uint32_t>::max)())
+        throw std::runtime_error("weld_vertices: too many triangles");
+
+    worker_count = thread::actual_worker_count(worker_count);
+
+    // 并行计算每个角点的hash
+
+    std::vector<size_t> hashes(corner_count);
+    parallel_for_blocks(corner_count, BLOCK_SIZE, worker_count,
+        [&](size_t beg, size_t end)
+    {
+        for(size_t i = beg; i < end; ++i)
+            hashes[i] = hash_vertex(corner(triangles, i));
+    });
+
+    // 按hash将角点分入若干分片，分片内保持原有顺序
+
+    const size_t shard_count = worker_count > 1 ? size_t(worker_count) * 4 : 1;
+
+    std::vector<uint32_t> shard_offsets(shard_count + 1, 0);
+    for(size_t i = 0; i < corner_count; ++i)
+        ++shard_offsets[hashes[i] % shard_count + 1];
+    for(size_t s = 0; s < shard_count; ++s)
+        shard_offsets[s + 1] += shard_offsets[s];
+
+    std::vector<uint32_t> shard_corners(corner_count);
+    {
+        std::vector<uint32_t> cursor(
+            shard_offsets.begin(), shard_offsets.end() - 1);
+        for(size_t i = 0; i < corner_count; ++i)
+        {
+            const size_t s = hashes[i] % shard_count;
+            shard_corners[cursor[s]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // 各分片独立地找出每个角点第一次出现的位置
+
+    std::vector<uint32_t> first_occurrence(corner_count);
+    thread::parallel_forrange(
+        size_t(0), shard_count, [&](int, size_t shard)
+    {
+        const uint32_t beg = shard_offsets[shard];
+        const uint32_t end = shard_offsets[shard + 1];
+
+        std::unordered_map<vertex_ref_t, uint32_t, vertex_ref_hash_t> first;
+        first.reserve(end - beg);
+
+        for(uint32_t k = beg; k < end; ++k)
+        {
+            const uint32_t i = shard_corners[k];
+            const auto it = first.try_emplace(
+                vertex_ref_t{ &corner(triangles, i), hashes[i] }, i).first;
+            first_occurrence[i] = it->second;
+        }
+    }, worker_count);
+
+    // 按首次出现的顺序为顶点编号
+
+    indexed_mesh_t ret;
+    ret.indices.resize(corner_count);
+
+    for(size_t i = 0; i < corner_count; ++i)
+    {
+        const uint32_t first = first_occurrence[i];
+        if(first == i)
+        {
+            ret.indices[i] = static_cast<uint32_t>(ret.vertices.size());
+            ret.vertices.push_back(corner(triangles, i));
+        }
+        else
+            ret.indices[i] = ret.indices[first];
+    }
+
+    ret.vertices.shrink_to_fit();
+    return ret;
+}
+
+void optimize_vertex_cache(indexed_mesh_t &mesh, int cache_size)
+{
+    const size_t vertex_count   = mesh.vertices.size();
+    const size_t triangle_count = mesh.triangle_count();
+    const auto  &indices        = mesh.indices;
+
+    if(!triangle_count)
+        return;
+
+    for(uint32_t v : indices)
+    {
+        if(v >= vertex_count)
+            throw std::runtime_error(
+                "optimize_vertex_cache: vertex index out of range");
+    }
+
+    // 顶点到三角形的邻接表
+
+    std::vector<uint32_t> live(vertex_count, 0);
+    for(uint32_t v : indices)
+        ++live[v];
+
+    std::vector<size_t> adj_offsets(vertex_count + 1, 0);
+    for(size_t v = 0; v < vertex_count; ++v)
+        adj_offsets[v + 1] = adj_offsets[v] + live[v];
+
+    std::vector<uint32_t> adj(indices.size());
+    {
+        std::vector<size_t> cursor(adj_offsets.begin(), adj_offsets.end() - 1);
+        for(size_t i = 0; i < indices.size(); ++i)
+            adj[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    // Tipsify
+
+    const int64_t k = (std::max)(cache_size, 3);
+
+    std::vector<int64_t>  cache_time(vertex_count, 0);
+    std::vector<char>     emitted(triangle_count, 0);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    int64_t timestamp = k + 1;
+    size_t  cursor    = 0;
+
+    auto skip_dead_end = [&]() -> int64_t
+    {
+        while(!dead_end.empty())
+        {
+            const uint32_t d = dead_end.back();
+            dead_end.pop_back();
+            if(live[d])
+                return d;
+        }
+
+        while(cursor < vertex_count)
+        {
+            if(live[cursor])
+                return static_cast<int64_t>(cursor);
+            ++cursor;
+        }
+
+        return -1;
+    };
+
+    auto next_vertex = [&]() -> int64_t
+    {
+        int64_t best = -1, best_priority = -1;
+        for(uint32_t v : candidates)
+        {
+            if(!live[v])
+                continue;
+
+            // 发出v的剩余三角形后v仍在缓存中时，优先选择最早进入缓存的顶点
+            int64_t priority = 0;
+            if(timestamp - cache_time[v] + 2 * int64_t(live[v]) <= k)
+                priority = timestamp - cache_time[v];
+
+            if(priority > best_priority)
+            {
+                best_priority = priority;
+                best = v;
+            }
+        }
+
+        return best >= 0 ? best : skip_dead_end();
+    };
+
+    int64_t fanning = 0;
+    while(fanning >= 0)
+    {
+        candidates.clear();
+
+        for(size_t a = adj_offsets[fanning]; a < adj_offsets[fanning + 1]; ++a)
+        {
+            const uint32_t t = adj[a];
+            if(emitted[t])
+                continue;
+
+            for(int j = 0; j < 3; ++j)
+            {
+                const uint32_t v = indices[3 * t + j];
+                output.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+
+                if(timestamp - cache_time[v] > k)
+                    cache_time[v] = timestamp++;
+            }
+
+            emitted[t] = 1;
+        }
+
+        fanning = next_vertex();
+    }
+
+    mesh.indices = std::move(output);
+}
+
+void optimize_vertex_fetch(indexed_mesh_t &mesh)
+{
+    constexpr uint32_t UNUSED = (std::numeric_limits<uint32_t>::max)();
+
+    std::vector<uint32_t> remap(mesh.vertices.size(), UNUSED);
+    std::vector<vertex_t> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for(uint32_t &v : mesh.indices)
+    {
+        if(v >= remap.size())
+            throw std::runtime_error(
+                "optimize_vertex_fetch: vertex index out of range");
+
+        if(remap[v] == UNUSED)
+        {
+            remap[v] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[v]);
+        }
+        v = remap[v];
+    }
+
+    vertices.shrink_to_fit();
+    mesh.vertices = std::move(vertices);
+}
+
+indexed_mesh_stats_t compute_indexed_mesh_stats(
+    const indexed_mesh_t &mesh, int cache_size)
+{
+    indexed_mesh_stats_t ret;
+    ret.vertex_count        = mesh.vertices.size();
+    ret.triangle_count      = mesh.triangle_count();
+    ret.vertex_bytes        = mesh.vertices.size() * sizeof(vertex_t);
+    ret.index_bytes         = mesh.indices.size() * sizeof(uint32_t);
+    ret.triangle_list_bytes = ret.triangle_count * sizeof(triangle_t);
+
+    // FIFO缓存：第m次缺失时进入缓存的顶点在第m+cache_size次缺失时被换出
+
+    const int64_t k = (std::max)(cache_size, 1);
+    std::vector<int64_t> miss_time(mesh.vertices.size(), -k - 1);
+    int64_t miss_count = 0;
+
+    for(uint32_t v : mesh.indices)
+    {
+        if(v >= miss_time.size())
+            throw std::runtime_error(
+                "compute_indexed_mesh_stats: vertex index out of range");
+
+        if(miss_count - miss_time[v] >= k)
+            miss_time[v] = miss_count++;
+    }
+
+    if(ret.triangle_count)
+        ret.acmr = static_cast<float>(miss_count) / ret.triangle_count;
+    if(ret.vertex_count)
+        ret.atvr = static_cast<float>(miss_count) / ret.vertex_count;
+
+    return ret;
+}
+
+} // namespace agz::mesh
@@ -1,8 +1,10 @@
 ﻿#include <agz-utils/file.h>
+#include <agz-utils/mesh/agzmesh.h>
 #include <agz-utils/mesh/load_mesh.h>
 #include <agz-utils/string.h>
 
 #define TINYOBJLOADER_IMPLEMENTATION
+#include "./parse_mesh.h"
 #include "./tinyply.h"
 #include "./stl_reader.h"
 #include "./tiny_obj_loader.h"
@@ -10,111 +12,6 @@
 namespace agz::mesh
 {
 
-static std::vector<mesh_t> parse_meshes_from_obj(const std::string &_src)
-{
-    std::string src = _src;
-    stdstr::replace_(src, "\\\n", " ");
-    stdstr::replace_(src, "\\\r\n", " ");
-
-    tinyobj::ObjReader reader;
-    if(!reader.ParseFromString(src, ""))
-        throw std::runtime_error(reader.Error());
-
-    auto &attrib = reader.GetAttrib();
-    
-    auto get_pos = [&](size_t index)
-    {
-        if(3 * index + 2 >= attrib.vertices.size())
-            throw std::runtime_error("invalid obj vertex index: out of range");
-        return math::vec3f(attrib.vertices[3 * index + 0],
-                           attrib.vertices[3 * index + 1],
-                           attrib.vertices[3 * index + 2]);
-    };
-
-    auto get_nor = [&](size_t index)
-    {
-        if(3 * index + 2 >= attrib.normals.size())
-            throw std::runtime_error("invalid obj normal index: out of range");
-        return math::vec3f(attrib.normals[3 * index + 0],
-                           attrib.normals[3 * index + 1],
-                           attrib.normals[3 * index + 2]);
-    };
-
-    auto get_uv = [&](size_t index)
-    {
-        if(2 * index + 1 >= attrib.texcoords.size())
-            throw std::runtime_error("invalid obj texcoord index: out of range");
-        return math::vec2f(attrib.texcoords[2 * index + 0],
-                           attrib.texcoords[2 * index + 1]);
-    };
-
-    std::vector<mesh_t> meshes;
-
-    for(auto &shape : reader.GetShapes())
-    {
-        for(auto face_vertex_count : shape.mesh.num_face_vertices)
-        {
-            if(face_vertex_count != 3)
-            {
-                throw std::runtime_error(
-                    "invalid obj face vertex count: " +
-                    std::to_string(+face_vertex_count));
-            }
-        }
-
-        if(shape.mesh.indices.size() % 3 != 0)
-        {
-            throw std::runtime_error(
-                "invalid obj index count: " +
-                std::to_string(shape.mesh.indices.size()));
-        }
-
-        const size_t triangle_count = shape.mesh.indices.size() / 3;
-
-        meshes.emplace_back();
-        auto &mesh = meshes.back();
-
-        mesh.name = shape.name;
-        mesh.triangles.reserve(triangle_count);
-
-        for(size_t i = 0, j = 0; i < triangle_count; ++i, j += 3)
-        {
-            triangle_t tri;
-            auto &vtx = tri.vertices;
-
-            for(size_t k = 0; k < 3; ++k)
-                vtx[k].position = get_pos(shape.mesh.indices[j + k].vertex_index);
-
-            for(size_t k = 0; k < 3; ++k)
-            {
-                auto &idx = shape.mesh.indices[j + k];
-
-                if(idx.normal_index < 0)
-                    vtx[k].normal = cross(
-                        vtx[1].position - vtx[0].position,
-                        vtx[2].position - vtx[0].position).normalize();
-                else
-                {
-                    vtx[k].normal = get_nor(idx.normal_index);
-                    if(!vtx[k].normal)
-                        vtx[k].normal = cross(
-                            vtx[1].position - vtx[0].position,
-                            vtx[2].position - vtx[0].position).normalize();
-                }
-
-                if(idx.texcoord_index < 0)
-                    vtx[k].tex_coord = math::vec2f();
-                else
-                    vtx[k].tex_coord = get_uv(idx.texcoord_index);
-            }
-
-            mesh.triangles.push_back(tri);
-        }
-    }
-
-    return meshes;
-}
-
 static std::vector<triangle_t> load_triangles_from_stl(
     const std::string &filename)
 {
@@ -413,7 +310,7 @@ static std::vector<triangle_t> load_ply(std::vector<uint8_t> byte_buffer)
                     tri.vertices[2].position - tri.vertices[0].position).normalize();
 
                 for(int j = 0; j < 3; ++j)
-                    tri.vertices[i].normal = nor;
+                    tri.vertices[j].normal = nor;
             }
 
             triangles.push_back(tri);
@@ -423,54 +320,61 @@ static std::vector<triangle_t> load_ply(std::vector<uint8_t> byte_buffer)
     return triangles;
 }
 
-std::vector<triangle_t> load_from_obj_mem(const std::string &str)
+std::vector<triangle_t> load_from_obj_mem(const std::string &str, int worker_count)
 {
-    auto meshes = parse_meshes_from_obj(str);
-
-    size_t total_triangle_count = 0;
-    for(auto &mesh : meshes)
-        total_triangle_count += mesh.triangles.size();
-
-    std::vector<triangle_t> ret;
-    ret.reserve(total_triangle_count);
-
-    for(auto &mesh : meshes)
-    {
-        for(auto &tri : mesh.triangles)
-            ret.push_back(tri);
-    }
+    return load_from_obj_mem(str.data(), str.size(), worker_count);
+}
 
-    return ret;
+std::vector<triangle_t> load_from_obj_mem(
+    const char *data, size_t size, int worker_count)
+{
+    return mesh_impl::parse_obj_triangles(data, size, worker_count);
 }
 
-std::vector<mesh_t> load_meshes_from_obj_mem(const std::string &str)
+std::vector<mesh_t> load_meshes_from_obj_mem(
+    const std::string &str, int worker_count)
 {
-    return parse_meshes_from_obj(str);
+    return mesh_impl::parse_obj_meshes(str.data(), str.size(), worker_count);
 }
 
-std::vector<mesh_t> load_meshes_from_obj(const std::string &filename)
+std::vector<mesh_t> load_meshes_from_obj(
+    const std::string &filename, int worker_count)
 {
-    return load_meshes_from_obj_mem(file::read_txt_file(filename));
+    const file::mapped_file_t file(filename);
+    return mesh_impl::parse_obj_meshes(
+        reinterpret_cast<const char*>(file.data()), file.size(), worker_count);
 }
 
 std::vector<triangle_t> load_from_ply_mem(const std::vector<uint8_t> &byte_buffer)
 {
+    if(auto ret = mesh_impl::parse_binary_ply(
+        byte_buffer.data(), byte_buffer.size()))
+        return std::move(*ret);
     return load_ply(byte_buffer);
 }
 
 std::vector<triangle_t> load_from_ply(const std::string &filename)
 {
-    return load_from_ply_mem(file::read_raw_file(filename));
+    const file::mapped_file_t file(filename);
+    if(auto ret = mesh_impl::parse_binary_ply(file.data(), file.size()))
+        return std::move(*ret);
+    return load_ply(std::vector<uint8_t>(file.data(), file.data() + file.size()));
 }
 
 std::vector<triangle_t> load_from_file(const std::string &filename)
 {
     if(stdstr::ends_with(filename, ".obj"))
-        return load_from_obj_mem(file::read_txt_file(filename));
+    {
+        const file::mapped_file_t file(filename);
+        return load_from_obj_mem(
+            reinterpret_cast<const char*>(file.data()), file.size());
+    }
     if(stdstr::ends_with(filename, ".stl"))
         return load_triangles_from_stl(filename);
     if(stdstr::ends_with(filename, ".ply"))
         return load_from_ply(filename);
+    if(stdstr::ends_with(filename, ".agzmesh"))
+        return load_from_agzmesh(filename);
     throw std::runtime_error("unsupported mesh file: " + filename);
 }
 
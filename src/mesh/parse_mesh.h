@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include <optional>
+
+#include <agz-utils/mesh/load_mesh.h>
+
+namespace agz::mesh::mesh_impl
+{
+
+/**
+ * @brief 按行边界将obj分块并行解析
+ *
+ * 每个'o'/'g'开始一个新的网格对象，没有面的对象会被丢弃；多边形按扇形三角化
+ */
+std::vector<mesh_t> parse_obj_meshes(
+    const char *data, size_t size, int worker_count);
+
+/**
+ * @brief 同parse_obj_meshes，但直接返回所有三角形，不按对象拆分
+ */
+std::vector<triangle_t> parse_obj_triangles(
+    const char *data, size_t size, int worker_count);
+
+/**
+ * @brief 解析二进制格式（binary_little_endian或binary_big_endian）的ply，
+ *        顶点属性整块复制，字节序与本机不同时整块转换
+ *
+ * 不支持的格式（ascii、非float32的顶点属性等）返回std::nullopt，
+ * 由调用者退回到tinyply
+ */
+std::optional<std::vector<triangle_t>> parse_binary_ply(
+    const unsigned char *data, size_t size);
+
+} // namespace agz::mesh::mesh_impl
@@ -0,0 +1,550 @@
+﻿#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+#include <agz-utils/thread/parallel_foreach.h>
+
+#include "./parse_mesh.h"
+
+namespace agz::mesh::mesh_impl
+{
+
+namespace
+{
+
+    // 小于该大小的块不值得单独占用一个线程
+    constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+
+    constexpr int64_t ABSENT_INDEX = (std::numeric_limits<int64_t>::min)();
+
+    /**
+     * @brief 面的一个角点在块内的原始索引
+     *
+     * index依次为位置、纹理坐标和法线的索引，ABSENT_INDEX表示缺省；
+     * 负数（相对）索引被转换为相对于块起点的偏移，合并时再加上块的基址
+     */
+    struct raw_corner_t
+    {
+        int64_t index[3];
+        uint8_t relative;
+    };
+
+    struct group_t
+    {
+        size_t first_triangle;
+        std::string name;
+    };
+
+    struct chunk_t
+    {
+        const char *beg = nullptr;
+        const char *end = nullptr;
+
+        std::vector<math::vec3f> positions;
+        std::vector<math::vec2f> tex_coords;
+        std::vector<math::vec3f> normals;
+
+        std::vector<raw_corner_t> corners;
+        std::vector<group_t>      groups;
+
+        size_t triangle_count() const noexcept
+        {
+            return corners.size() / 3;
+        }
+    };
+
+    bool is_line_continuation(const char *data, const char *newline) noexcept
+    {
+        const char *p = newline;
+        if(p > data && p[-1] == '\r')
+            --p;
+        return p > data && p[-1] == '\\';
+    }
+
+    /**
+     * @brief 从p开始寻找不是续行的换行符，找不到时返回end
+     */
+    const char *find_line_end(
+        const char *data, const char *p, const char *end) noexcept
+    {
+        while(p < end)
+        {
+            auto nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if(!nl)
+                return end;
+            if(!is_line_continuation(data, nl))
+                return nl;
+            p = nl + 1;
+        }
+        return end;
+    }
+
+    bool is_space(char c) noexcept
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    class line_parser_t
+    {
+        const char *data_;
+        const char *cur_;
+        const char *end_;
+
+    public:
+
+        line_parser_t(const char *data, const char *beg, const char *end) noexcept
+            : data_(data), cur_(beg), end_(end)
+        {
+
+        }
+
+        bool eof() const noexcept
+        {
+            return cur_ >= end_;
+        }
+
+        /**
+         * @brief 跳过行内空白，行尾的'\'视为空白
+         */
+        void skip_space() noexcept
+        {
+            while(cur_ < end_)
+            {
+                const char c = *cur_;
+                if(c == ' ' || c == '\t' || c == '\r')
+                {
+                    ++cur_;
+                    continue;
+                }
+
+                if(c == '\\')
+                {
+                    const char *p = cur_ + 1;
+                    if(p < end_ && *p == '\r')
+                        ++p;
+                    if(p < end_ && *p == '\n')
+                    {
+                        cur_ = p + 1;
+                        continue;
+                    }
+                }
+
+                break;
+            }
+        }
+
+        bool at_line_end() noexcept
+        {
+            skip_space();
+            return cur_ >= end_ || *cur_ == '\n';
+        }
+
+        void next_line() noexcept
+        {
+            const char *nl = find_line_end(data_, cur_, end_);
+            cur_ = nl < end_ ? nl + 1 : end_;
+        }
+
+        std::string_view token() noexcept
+        {
+            skip_space();
+            const char *beg = cur_;
+            while(cur_ < end_ && !is_space(*cur_))
+                ++cur_;
+            return std::string_view(beg, static_cast<size_t>(cur_ - beg));
+        }
+
+        std::string rest_of_line()
+        {
+            skip_space();
+            const char *beg = cur_;
+            const char *end = find_line_end(data_, cur_, end_);
+            while(end > beg && is_space(end[-1]))
+                --end;
+            cur_ = end;
+            return std::string(beg, end);
+        }
+
+        bool consume(char c) noexcept
+        {
+            if(cur_ < end_ && *cur_ == c)
+            {
+                ++cur_;
+                return true;
+            }
+            return false;
+        }
+
+        float read_float()
+        {
+            skip_space();
+            if(cur_ < end_ && *cur_ == '+')
+                ++cur_;
+
+            float ret;
+
+#if defined(__cpp_lib_to_chars)
+            const auto [ptr, ec] = std::from_chars(cur_, end_, ret);
+            if(ec != std::errc())
+                throw std::runtime_error("invalid obj number");
+            cur_ = ptr;
+#else
+            char buffer[64];
+            const size_t len = (std::min)(
+                sizeof(buffer) - 1, static_cast<size_t>(end_ - cur_));
+            std::memcpy(buffer, cur_, len);
+            buffer[len] = '\0';
+
+            char *ptr;
+            ret = std::strtof(buffer, &ptr);
+            if(ptr == buffer)
+                throw std::runtime_error("invalid obj number");
+            cur_ += ptr - buffer;
+#endif
+
+            return ret;
+        }
+
+        int64_t read_int()
+        {
+            if(cur_ < end_ && *cur_ == '+')
+                ++cur_;
+
+            int64_t ret;
+            const auto [ptr, ec] = std::from_chars(cur_, end_, ret);
+            if(ec != std::errc())
+                throw std::runtime_error("invalid obj index");
+            cur_ = ptr;
+            return ret;
+        }
+    };
+
+    void set_corner_index(
+        raw_corner_t &corner, int slot, int64_t index, size_t local_count)
+    {
+        if(index > 0)
+            corner.index[slot] = index - 1;
+        else if(index < 0)
+        {
+            corner.index[slot] = static_cast<int64_t>(local_count) + index;
+            corner.relative |= uint8_t(1u << slot);
+        }
+        else
+            throw std::runtime_error("invalid obj index: 0");
+    }
+
+    void parse_chunk(const char *data, chunk_t &chunk)
+    {
+        line_parser_t parser(data, chunk.beg, chunk.end);
+        std::vector<raw_corner_t> face;
+
+        while(!parser.eof())
+        {
+            const std::string_view keyword = parser.token();
+
+            if(keyword == "v")
+            {
+                const float x = parser.read_float();
+                const float y = parser.read_float();
+                const float z = parser.read_float();
+                chunk.positions.push_back({ x, y, z });
+            }
+            else if(keyword == "vt")
+            {
+                const float u = parser.read_float();
+                const float v = parser.at_line_end() ? 0.0f : parser.read_float();
+                chunk.tex_coords.push_back({ u, v });
+            }
+            else if(keyword == "vn")
+            {
+                const float x = parser.read_float();
+                const float y = parser.read_float();
+                const float z = parser.read_float();
+                chunk.normals.push_back({ x, y, z });
+            }
+            else if(keyword == "f")
+            {
+                face.clear();
+                while(!parser.at_line_end())
+                {
+                    raw_corner_t corner = {
+                        { ABSENT_INDEX, ABSENT_INDEX, ABSENT_INDEX }, 0 };
+
+                    set_corner_index(
+                        corner, 0, parser.read_int(), chunk.positions.size());
+                    if(parser.consume('/'))
+                    {
+                        if(!parser.consume('/'))
+                        {
+                            set_corner_index(
+                                corner, 1, parser.read_int(),
+                                chunk.tex_coords.size());
+                            if(parser.consume('/'))
+                            {
+                                set_corner_index(
+                                    corner, 2, parser.read_int(),
+                                    chunk.normals.size());
+                            }
+                        }
+                        else
+                        {
+                            set_corner_index(
+                                corner, 2, parser.read_int(),
+                                chunk.normals.size());
+                        }
+                    }
+
+                    face.push_back(corner);
+                }
+
+                if(face.size() < 3)
+                {
+                    throw std::runtime_error(
+                        "invalid obj face vertex count: " +
+                        std::to_string(face.size()));
+                }
+
+                for(size_t i = 1; i + 1 < face.size(); ++i)
+                {
+                    chunk.corners.push_back(face[0]);
+                    chunk.corners.push_back(face[i]);
+                    chunk.corners.push_back(face[i + 1]);
+                }
+            }
+            else if(keyword == "o" || keyword == "g")
+                chunk.groups.push_back({ chunk.triangle_count(), parser.rest_of_line() });
+
+            parser.next_line();
+        }
+    }
+
+    template<typename Func>
+    void for_each_chunk(std::vector<chunk_t> &chunks, int worker_count, Func &&func)
+    {
+        if(chunks.size() == 1)
+        {
+            func(chunks[0], size_t(0));
+            return;
+        }
+
+        thread::parallel_forrange(
+            size_t(0), chunks.size(), [&](int, size_t i)
+        {
+            func(chunks[i], i);
+        }, (std::min)(worker_count, static_cast<int>(chunks.size())));
+    }
+
+    struct parsed_obj_t
+    {
+        std::vector<triangle_t> triangles;
+        std::vector<group_t>    groups;
+    };
+
+    parsed_obj_t parse_obj(const char *data, size_t size, int worker_count)
+    {
+        worker_count = thread::actual_worker_count(worker_count);
+
+        // 在行边界上分块
+
+        const size_t chunk_count = (std::max)(size_t(1), (std::min)(
+            size / MIN_CHUNK_BYTES, static_cast<size_t>(worker_count) * 4));
+
+        std::vector<chunk_t> chunks(chunk_count);
+
+        const char *end = data + size;
+        const char *chunk_beg = data;
+        for(size_t i = 0; i < chunk_count; ++i)
+        {
+            const char *chunk_end = end;
+            if(i + 1 < chunk_count)
+            {
+                const char *target = data + size / chunk_count * (i + 1);
+                const char *search = (std::max)(chunk_beg, target - 1);
+                const char *nl = find_line_end(data, search, end);
+                chunk_end = nl < end ? nl + 1 : end;
+            }
+
+            chunks[i].beg = chunk_beg;
+            chunks[i].end = chunk_end;
+            chunk_beg = chunk_end;
+        }
+
+        // 并行解析各块
+
+        for_each_chunk(chunks, worker_count, [&](chunk_t &chunk, size_t)
+        {
+            parse_chunk(data, chunk);
+        });
+
+        // 合并各块的顶点属性
+
+        std::vector<size_t> position_base(chunk_count + 1, 0);
+        std::vector<size_t> tex_coord_base(chunk_count + 1, 0);
+        std::vector<size_t> normal_base(chunk_count + 1, 0);
+        std::vector<size_t> triangle_base(chunk_count + 1, 0);
+
+        for(size_t i = 0; i < chunk_count; ++i)
+        {
+            position_base[i + 1]  = position_base[i]  + chunks[i].positions.size();
+            tex_coord_base[i + 1] = tex_coord_base[i] + chunks[i].tex_coords.size();
+            normal_base[i + 1]    = normal_base[i]    + chunks[i].normals.size();
+            triangle_base[i + 1]  = triangle_base[i]  + chunks[i].triangle_count();
+        }
+
+        std::vector<math::vec3f> positions(position_base.back());
+        std::vector<math::vec2f> tex_coords(tex_coord_base.back());
+        std::vector<math::vec3f> normals(normal_base.back());
+
+        for_each_chunk(chunks, worker_count, [&](chunk_t &chunk, size_t i)
+        {
+            std::copy(chunk.positions.begin(), chunk.positions.end(),
+                      positions.begin() + position_base[i]);
+            std::copy(chunk.tex_coords.begin(), chunk.tex_coords.end(),
+                      tex_coords.begin() + tex_coord_base[i]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(),
+                      normals.begin() + normal_base[i]);
+
+            chunk.positions  = {};
+            chunk.tex_coords = {};
+            chunk.normals    = {};
+        });
+
+        // 将各块的索引映射到全局属性上，并生成三角形
+
+        parsed_obj_t ret;
+        ret.triangles.resize(triangle_base.back());
+
+        for_each_chunk(chunks, worker_count, [&](chunk_t &chunk, size_t i)
+        {
+            const size_t bases[3] = {
+                position_base[i], tex_coord_base[i], normal_base[i]
+            };
+            const size_t counts[3] = {
+                positions.size(), tex_coords.size(), normals.size()
+            };
+
+            auto resolve = [&](const raw_corner_t &corner, int slot) -> int64_t
+            {
+                int64_t index = corner.index[slot];
+                if(index == ABSENT_INDEX)
+                    return -1;
+
+                if(corner.relative & (1u << slot))
+                    index += static_cast<int64_t>(bases[slot]);
+
+                if(index < 0 || static_cast<size_t>(index) >= counts[slot])
+                {
+                    static const char *ERR_MSGS[3] = {
+                        "invalid obj vertex index: out of range",
+                        "invalid obj texcoord index: out of range",
+                        "invalid obj normal index: out of range"
+                    };
+                    throw std::runtime_error(ERR_MSGS[slot]);
+                }
+
+                return index;
+            };
+
+            triangle_t *output = ret.triangles.data() + triangle_base[i];
+            const size_t triangle_count = chunk.triangle_count();
+
+            for(size_t t = 0; t < triangle_count; ++t)
+            {
+                const raw_corner_t *corners = &chunk.corners[3 * t];
+                auto &vtx = output[t].vertices;
+
+                for(int k = 0; k < 3; ++k)
+                    vtx[k].position = positions[resolve(corners[k], 0)];
+
+                const math::vec3f face_normal = cross(
+                    vtx[1].position - vtx[0].position,
+                    vtx[2].position - vtx[0].position).normalize();
+
+                for(int k = 0; k < 3; ++k)
+                {
+                    const int64_t tex_coord_index = resolve(corners[k], 1);
+                    vtx[k].tex_coord = tex_coord_index < 0 ?
+                        math::vec2f() : tex_coords[tex_coord_index];
+
+                    const int64_t normal_index = resolve(corners[k], 2);
+                    vtx[k].normal = normal_index < 0 ?
+                        face_normal : normals[normal_index];
+                    if(!vtx[k].normal)
+                        vtx[k].normal = face_normal;
+                }
+            }
+
+            chunk.corners = {};
+        });
+
+        for(size_t i = 0; i < chunk_count; ++i)
+        {
+            for(auto &g : chunks[i].groups)
+            {
+                ret.groups.push_back(
+                    { triangle_base[i] + g.first_triangle, std::move(g.name) });
+            }
+        }
+
+        return ret;
+    }
+
+} // namespace anonymous
+
+std::vector<mesh_t> parse_obj_meshes(
+    const char *data, size_t size, int worker_count)
+{
+    auto obj = parse_obj(data, size, worker_count);
+
+    struct range_t
+    {
+        std::string name;
+        size_t beg;
+        size_t end;
+    };
+
+    std::vector<range_t> ranges;
+    std::string name;
+    size_t beg = 0;
+
+    for(auto &g : obj.groups)
+    {
+        if(beg < g.first_triangle)
+            ranges.push_back({ std::move(name), beg, g.first_triangle });
+        name = std::move(g.name);
+        beg = g.first_triangle;
+    }
+
+    if(beg < obj.triangles.size())
+        ranges.push_back({ std::move(name), beg, obj.triangles.size() });
+
+    std::vector<mesh_t> meshes;
+
+    if(ranges.size() == 1)
+    {
+        meshes.push_back({ std::move(ranges[0].name), std::move(obj.triangles) });
+        return meshes;
+    }
+
+    for(auto &r : ranges)
+    {
+        meshes.push_back({
+            std::move(r.name),
+            std::vector<triangle_t>(
+                obj.triangles.begin() + r.beg, obj.triangles.begin() + r.end)
+        });
+    }
+
+    return meshes;
+}
+
+std::vector<triangle_t> parse_obj_triangles(
+    const char *data, size_t size, int worker_count)
+{
+    return parse_obj(data, size, worker_count).triangles;
+}
+
+} // namespace agz::mesh::mesh_impl
@@ -0,0 +1,481 @@
+﻿#include <cstring>
+#include <string_view>
+
+#include <agz-utils/misc/binary_stream.h>
+#include <agz-utils/string/stdstr.h>
+
+#include "./parse_mesh.h"
+
+namespace agz::mesh::mesh_impl
+{
+
+namespace
+{
+
+    enum class scalar_t
+    {
+        int8, uint8, int16, uint16, int32, uint32, float32, float64, unknown
+    };
+
+    scalar_t parse_scalar_type(std::string_view name)
+    {
+        if(name == "char"   || name == "int8")    return scalar_t::int8;
+        if(name == "uchar"  || name == "uint8")   return scalar_t::uint8;
+        if(name == "short"  || name == "int16")   return scalar_t::int16;
+        if(name == "ushort" || name == "uint16")  return scalar_t::uint16;
+        if(name == "int"    || name == "int32")   return scalar_t::int32;
+        if(name == "uint"   || name == "uint32")  return scalar_t::uint32;
+        if(name == "float"  || name == "float32") return scalar_t::float32;
+        if(name == "double" || name == "float64") return scalar_t::float64;
+        return scalar_t::unknown;
+    }
+
+    size_t scalar_size(scalar_t type) noexcept
+    {
+        switch(type)
+        {
+        case scalar_t::int8:    case scalar_t::uint8:   return 1;
+        case scalar_t::int16:   case scalar_t::uint16:  return 2;
+        case scalar_t::int32:   case scalar_t::uint32:
+        case scalar_t::float32:                         return 4;
+        case scalar_t::float64:                         return 8;
+        default:                                        return 0;
+        }
+    }
+
+    bool is_integer_type(scalar_t type) noexcept
+    {
+        return type != scalar_t::float32 && type != scalar_t::float64 &&
+               type != scalar_t::unknown;
+    }
+
+    template<typename T>
+    int64_t load_integer(const unsigned char *p, misc::endian_type endian) noexcept
+    {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        if(endian != misc::endian_type::local)
+            v = misc::convert_endian<misc::endian_type::little, misc::endian_type::big>(v);
+        return v;
+    }
+
+    /**
+     * @brief 读取一个整数类型的标量，非整数类型返回false
+     */
+    bool read_integer(
+        scalar_t type, const unsigned char *p,
+        misc::endian_type endian, int64_t &out) noexcept
+    {
+        switch(type)
+        {
+        case scalar_t::int8:   out = load_integer<int8_t>  (p, endian); return true;
+        case scalar_t::uint8:  out = load_integer<uint8_t> (p, endian); return true;
+        case scalar_t::int16:  out = load_integer<int16_t> (p, endian); return true;
+        case scalar_t::uint16: out = load_integer<uint16_t>(p, endian); return true;
+        case scalar_t::int32:  out = load_integer<int32_t> (p, endian); return true;
+        case scalar_t::uint32: out = load_integer<uint32_t>(p, endian); return true;
+        default:
+            return false;
+        }
+    }
+
+    struct property_t
+    {
+        std::string name;
+        scalar_t type       = scalar_t::unknown;
+        bool     is_list    = false;
+        scalar_t count_type = scalar_t::unknown;
+    };
+
+    struct element_t
+    {
+        std::string name;
+        size_t count = 0;
+        std::vector<property_t> properties;
+
+        bool has_list() const noexcept
+        {
+            for(auto &p : properties)
+            {
+                if(p.is_list)
+                    return true;
+            }
+            return false;
+        }
+
+        // 仅对不含list属性的元素有意义
+        size_t stride() const noexcept
+        {
+            size_t ret = 0;
+            for(auto &p : properties)
+                ret += scalar_size(p.type);
+            return ret;
+        }
+
+        /**
+         * @brief 在不含list的元素中，查找一个float32属性的字节偏移，没有时返回-1
+         */
+        int float_offset(std::initializer_list<const char*> names) const noexcept
+        {
+            for(const char *name : names)
+            {
+                size_t offset = 0;
+                for(auto &p : properties)
+                {
+                    if(p.name == name)
+                        return p.type == scalar_t::float32 ? int(offset) : -2;
+                    offset += scalar_size(p.type);
+                }
+            }
+            return -1;
+        }
+    };
+
+    /**
+     * @brief 读取位于给定字节偏移处的N个float32，偏移连续时整块复制
+     */
+    template<int N>
+    void copy_floats(float *dst, const unsigned char *src, const int (&offsets)[N])
+    {
+        bool contiguous = true;
+        for(int i = 1; i < N; ++i)
+            contiguous &= offsets[i] == offsets[0] + 4 * i;
+
+        if(contiguous)
+            std::memcpy(dst, src + offsets[0], 4 * N);
+        else
+        {
+            for(int i = 0; i < N; ++i)
+                std::memcpy(dst + i, src + offsets[i], 4);
+        }
+    }
+
+    void fill_face_normal(triangle_t &tri) noexcept
+    {
+        auto &vtx = tri.vertices;
+        if(!vtx[0].normal || !vtx[1].normal || !vtx[2].normal)
+        {
+            const math::vec3f nor = cross(
+                vtx[1].position - vtx[0].position,
+                vtx[2].position - vtx[0].position).normalize();
+            for(int i = 0; i < 3; ++i)
+                vtx[i].normal = nor;
+        }
+    }
+
+} // namespace anonymous
+
+std::optional<std::vector<triangle_t>> parse_binary_ply(
+    const unsigned char *data, size_t size)
+{
+    // header
+
+    constexpr std::string_view END_HEADER = "end_header";
+
+    const char *text = reinterpret_cast<const char*>(data);
+    const size_t end_header_pos = std::string_view(text, size).find(END_HEADER);
+    if(end_header_pos == std::string_view::npos)
+        return std::nullopt;
+    const char *header_end = text + end_header_pos + END_HEADER.size();
+
+    const char *body_beg = static_cast<const char*>(
+        std::memchr(header_end, '\n', static_cast<size_t>(text + size - header_end)));
+    if(!body_beg)
+        return std::nullopt;
+    ++body_beg;
+
+    auto header_lines = stdstr::lines(
+        std::string_view(text, static_cast<size_t>(header_end - text)));
+    auto line_it = header_lines.begin();
+    if(line_it == header_lines.end() || !stdstr::starts_with(*line_it, "ply"))
+        return std::nullopt;
+
+    bool is_binary = false;
+    misc::endian_type endian = misc::endian_type::little;
+    std::vector<element_t> elements;
+
+    // 每行最多用到5个单词，多余的（如comment中的）忽略
+    constexpr size_t MAX_TOKENS = 5;
+
+    for(++line_it; line_it != header_lines.end(); ++line_it)
+    {
+        std::string_view tokens[MAX_TOKENS];
+        size_t token_count = 0;
+        for(std::string_view token : stdstr::split_any_view(*line_it, " \t\r"))
+        {
+            if(token_count == MAX_TOKENS)
+                break;
+            tokens[token_count++] = token;
+        }
+
+        const std::string_view keyword = tokens[0];
+
+        if(keyword == "format")
+        {
+            const std::string_view format = tokens[1];
+            if(format == "binary_little_endian")
+            {
+                is_binary = true;
+                endian = misc::endian_type::little;
+            }
+            else if(format == "binary_big_endian")
+            {
+                is_binary = true;
+                endian = misc::endian_type::big;
+            }
+            else
+                is_binary = false;
+        }
+        else if(keyword == "element")
+        {
+            element_t element;
+            if(token_count < 3 ||
+               !stdstr::try_parse_number(tokens[2], element.count))
+                return std::nullopt;
+            element.name = std::string(tokens[1]);
+            elements.push_back(std::move(element));
+        }
+        else if(keyword == "property")
+        {
+            if(elements.empty())
+                return std::nullopt;
+
+            property_t prop;
+
+            if(tokens[1] == "list")
+            {
+                if(token_count < 5)
+                    return std::nullopt;
+                prop.is_list    = true;
+                prop.count_type = parse_scalar_type(tokens[2]);
+                prop.type       = parse_scalar_type(tokens[3]);
+                prop.name       = std::string(tokens[4]);
+            }
+            else
+            {
+                if(token_count < 3)
+                    return std::nullopt;
+                prop.type = parse_scalar_type(tokens[1]);
+                prop.name = std::string(tokens[2]);
+            }
+
+            if(prop.type == scalar_t::unknown ||
+               (prop.is_list && prop.count_type == scalar_t::unknown))
+                return std::nullopt;
+
+            elements.back().properties.push_back(std::move(prop));
+        }
+    }
+
+    if(!is_binary)
+        return std::nullopt;
+
+    // 定位顶点属性
+
+    const element_t *vertex_element = nullptr;
+    const element_t *face_element   = nullptr;
+    for(auto &e : elements)
+    {
+        if(e.name == "vertex")
+            vertex_element = &e;
+        else if(e.name == "face")
+            face_element = &e;
+        else if(e.has_list())
+            return std::nullopt;
+    }
+
+    if(!vertex_element || vertex_element->has_list())
+        return std::nullopt;
+
+    const int position_offsets[3] = {
+        vertex_element->float_offset({ "x" }),
+        vertex_element->float_offset({ "y" }),
+        vertex_element->float_offset({ "z" })
+    };
+    const int normal_offsets[3] = {
+        vertex_element->float_offset({ "nx" }),
+        vertex_element->float_offset({ "ny" }),
+        vertex_element->float_offset({ "nz" })
+    };
+    const int tex_coord_offsets[2] = {
+        vertex_element->float_offset({ "s", "u", "texture_u" }),
+        vertex_element->float_offset({ "t", "v", "texture_v" })
+    };
+
+    for(int o : position_offsets)
+    {
+        if(o < 0)
+            return std::nullopt;
+    }
+
+    const bool has_normal = normal_offsets[0] >= 0 &&
+                            normal_offsets[1] >= 0 && normal_offsets[2] >= 0;
+    const bool has_tex_coord = tex_coord_offsets[0] >= 0 &&
+                               tex_coord_offsets[1] >= 0;
+
+    if(vertex_element->count == 0)
+        throw std::runtime_error("invalid vertex count in ply: 0");
+
+    // 面的索引列表
+
+    const property_t *index_prop = nullptr;
+    if(face_element)
+    {
+        for(auto &p : face_element->properties)
+        {
+            if(p.is_list && (p.name == "vertex_indices" || p.name == "vertex_index"))
+                index_prop = &p;
+            else if(p.is_list)
+                return std::nullopt;
+        }
+
+        if(!index_prop ||
+           !is_integer_type(index_prop->count_type) ||
+           !is_integer_type(index_prop->type))
+            return std::nullopt;
+    }
+
+    // body
+
+    const unsigned char *body = reinterpret_cast<const unsigned char*>(body_beg);
+    misc::binary_reader_t reader(
+        body, static_cast<size_t>(data + size - body), endian);
+
+    auto require = [&](size_t bytes)
+    {
+        if(reader.remaining() < bytes)
+            throw std::runtime_error("truncated ply data");
+    };
+
+    std::vector<vertex_t> vertices;
+    std::vector<triangle_t> triangles;
+
+    for(auto &e : elements)
+    {
+        if(&e == vertex_element)
+        {
+            const size_t stride = e.stride();
+            if(e.count > reader.remaining() / stride)
+                throw std::runtime_error("truncated ply data");
+
+            const unsigned char *cur = reader.read_bytes(e.count * stride);
+            vertices.resize(e.count);
+
+            // 与vertex_t布局完全相同时整块复制
+
+            const bool same_layout =
+                stride == sizeof(vertex_t) && has_normal && has_tex_coord &&
+                position_offsets[0] == 0  && position_offsets[1] == 4  &&
+                position_offsets[2] == 8  && normal_offsets[0]   == 12 &&
+                normal_offsets[1]   == 16 && normal_offsets[2]   == 20 &&
+                tex_coord_offsets[0] == 24 && tex_coord_offsets[1] == 28;
+
+            if(same_layout)
+                std::memcpy(vertices.data(), cur, e.count * stride);
+            else
+            {
+                for(size_t i = 0; i < e.count; ++i)
+                {
+                    const unsigned char *src = cur + i * stride;
+                    auto &v = vertices[i];
+
+                    copy_floats(&v.position.x, src, position_offsets);
+                    if(has_normal)
+                        copy_floats(&v.normal.x, src, normal_offsets);
+                    if(has_tex_coord)
+                        copy_floats(&v.tex_coord.x, src, tex_coord_offsets);
+                }
+            }
+
+            // 未读取的属性为0，不受字节序转换的影响
+
+            static_assert(sizeof(vertex_t) == 8 * sizeof(float));
+            misc::convert_endian_inplace(
+                misc::span<float>(&vertices[0].position.x, 8 * vertices.size()),
+                endian, misc::endian_type::local);
+        }
+        else if(&e == face_element)
+        {
+            triangles.reserve(e.count);
+
+            const size_t count_size = scalar_size(index_prop->count_type);
+            const size_t index_size = scalar_size(index_prop->type);
+
+            for(size_t f = 0; f < e.count; ++f)
+            {
+                for(auto &p : e.properties)
+                {
+                    if(&p != index_prop)
+                    {
+                        require(scalar_size(p.type));
+                        reader.skip(scalar_size(p.type));
+                        continue;
+                    }
+
+                    require(count_size);
+                    int64_t n = 0;
+                    if(!read_integer(
+                        p.count_type, reader.read_bytes(count_size), endian, n))
+                        throw std::runtime_error("invalid ply data");
+
+                    if(n < 0 || static_cast<size_t>(n) >
+                                reader.remaining() / index_size)
+                        throw std::runtime_error("truncated ply data");
+
+                    const unsigned char *cur = reader.read_bytes(n * index_size);
+
+                    auto index = [&](int64_t k)
+                    {
+                        int64_t i = 0;
+                        if(!read_integer(p.type, cur + k * index_size, endian, i))
+                            throw std::runtime_error("invalid ply data");
+                        if(i < 0 || static_cast<size_t>(i) >= vertices.size())
+                            throw std::runtime_error(
+                                "invalid ply vertex index: out of range");
+                        return static_cast<size_t>(i);
+                    };
+
+                    if(n >= 3)
+                    {
+                        const size_t i0 = index(0);
+                        for(int64_t k = 1; k + 1 < n; ++k)
+                        {
+                            triangle_t tri;
+                            tri.vertices[0] = vertices[i0];
+                            tri.vertices[1] = vertices[index(k)];
+                            tri.vertices[2] = vertices[index(k + 1)];
+                            fill_face_normal(tri);
+                            triangles.push_back(tri);
+                        }
+                    }
+                }
+            }
+        }
+        else
+        {
+            const size_t stride = e.stride();
+            if(stride && e.count > reader.remaining() / stride)
+                throw std::runtime_error("truncated ply data");
+            reader.skip(e.count * stride);
+        }
+    }
+
+    if(!face_element)
+    {
+        if(vertices.size() % 3 != 0)
+            throw std::runtime_error("vertex count % 3 != 0 in ply");
+
+        triangles.resize(vertices.size() / 3);
+        for(size_t i = 0; i < triangles.size(); ++i)
+        {
+            auto &tri = triangles[i];
+            for(int k = 0; k < 3; ++k)
+                tri.vertices[k] = vertices[3 * i + k];
+            fill_face_normal(tri);
+        }
+    }
+
+    return triangles;
+}
+
+} // namespace agz::mesh::mesh_impl
@@ -1,128 +1,623 @@
-#include <cctype>
+#include <array>
+#include <cstdint>
+#include <cstring>
 
 #include <agz-utils/misc/base64.h>
 
-// ref: http://www.adp-gmbh.ch/cpp/common/base64.html (restyled)
+#include "./cpu_features.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define AGZ_BASE64_X86
+#   define AGZ_BASE64_TARGET(X) __attribute__((target(X)))
+#   include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   define AGZ_BASE64_X86
+#   define AGZ_BASE64_TARGET(X)
+#   include <immintrin.h>
+#endif
+
+// 向量化的编解码参见：
+//   W. Muła, D. Lemire. Faster Base64 Encoding and Decoding Using AVX2 Instructions
+//   W. Muła, D. Lemire. Base64 encoding and decoding at almost the speed of a memory copy
 
 namespace agz::misc
 {
 
     namespace
     {
-        const std::string_view base64_chars =
+        constexpr char ENCODE_TABLE[] =
             "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
             "abcdefghijklmnopqrstuvwxyz"
             "0123456789+/";
 
-        bool is_base64(unsigned char c)
+        // 非base64字符映射为0xff
+        constexpr std::array<uint8_t, 256> DECODE_TABLE = []
         {
-            return (std::isalnum(c) || (c == '+') || (c == '/'));
+            std::array<uint8_t, 256> ret = {};
+            for(auto &v : ret)
+                v = 0xff;
+            for(int i = 0; i < 64; ++i)
+                ret[static_cast<uint8_t>(ENCODE_TABLE[i])] = static_cast<uint8_t>(i);
+            return ret;
+        }();
+
+        bool is_base64(char c) noexcept
+        {
+            return DECODE_TABLE[static_cast<uint8_t>(c)] != 0xff;
         }
-    }
 
-    std::string encode_base64(const void *data, size_t byte_size)
-    {
-        std::string ret;
+        void encode_triple(const uint8_t *in, char *out) noexcept
+        {
+            const uint32_t v = (uint32_t(in[0]) << 16) |
+                               (uint32_t(in[1]) << 8) | in[2];
+            out[0] = ENCODE_TABLE[(v >> 18) & 63];
+            out[1] = ENCODE_TABLE[(v >> 12) & 63];
+            out[2] = ENCODE_TABLE[(v >> 6)  & 63];
+            out[3] = ENCODE_TABLE[v         & 63];
+        }
+
+        /**
+         * @brief 编码最后不足3字节的1或2个字节，并补齐'='
+         */
+        void encode_tail(const uint8_t *in, size_t count, char *out) noexcept
+        {
+            uint8_t triple[3] = { in[0], count > 1 ? in[1] : uint8_t(0), 0 };
+            encode_triple(triple, out);
+            out[3] = '=';
+            if(count == 1)
+                out[2] = '=';
+        }
+
+        /**
+         * @brief 解码不完整的字符组，in中的count个字符均有效，写入count - 1个字节
+         */
+        size_t decode_partial(const char *in, size_t count, uint8_t *out) noexcept
+        {
+            if(count < 2)
+                return 0;
+
+            uint32_t v = 0;
+            for(size_t i = 0; i < 4; ++i)
+            {
+                v <<= 6;
+                if(i < count)
+                    v |= DECODE_TABLE[static_cast<uint8_t>(in[i])];
+            }
+
+            out[0] = static_cast<uint8_t>(v >> 16);
+            if(count > 2)
+                out[1] = static_cast<uint8_t>(v >> 8);
+            return count - 1;
+        }
+
+        void encode_blocks_scalar(
+            const uint8_t *in, size_t triple_count, char *out) noexcept
+        {
+            for(size_t i = 0; i < triple_count; ++i)
+                encode_triple(in + 3 * i, out + 4 * i);
+        }
+
+        /**
+         * @brief 解码in开头的完整字符组，在第一个含非base64字符的组前停止
+         *
+         * @return 写入的字节数，消耗的字符数为其4/3
+         */
+        size_t decode_blocks_scalar(
+            const char *in, size_t quad_count, uint8_t *out) noexcept
+        {
+            size_t i = 0;
+            for(; i < quad_count; ++i)
+            {
+                const char *q = in + 4 * i;
+                const uint32_t a = DECODE_TABLE[static_cast<uint8_t>(q[0])];
+                const uint32_t b = DECODE_TABLE[static_cast<uint8_t>(q[1])];
+                const uint32_t c = DECODE_TABLE[static_cast<uint8_t>(q[2])];
+                const uint32_t d = DECODE_TABLE[static_cast<uint8_t>(q[3])];
+                if((a | b | c | d) & 0x80)
+                    break;
+
+                const uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+                out[3 * i]     = static_cast<uint8_t>(v >> 16);
+                out[3 * i + 1] = static_cast<uint8_t>(v >> 8);
+                out[3 * i + 2] = static_cast<uint8_t>(v);
+            }
+            return 3 * i;
+        }
+
+#ifdef AGZ_BASE64_X86
+
+        // 以下的向量化函数都只处理整块，剩余部分由标量代码处理。
+        // 编码每次读取16/32字节但只消耗12/24字节，解码每次写入16/32字节但只产生12/24字节，
+        // 因此调用者需保证读写不越界
+
+        AGZ_BASE64_TARGET("ssse3")
+        __m128i encode_indices_ssse3(__m128i in) noexcept
+        {
+            // 将每3字节重排为4个16位的小端组，再用乘法把4个6位字段移到各字节的低位
+
+            in = _mm_shuffle_epi8(in, _mm_set_epi8(
+                10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+            const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+            const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+            const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+            const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+            return _mm_or_si128(t1, t3);
+        }
+
+        AGZ_BASE64_TARGET("ssse3")
+        __m128i encode_chars_ssse3(__m128i indices) noexcept
+        {
+            // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12，
+            // 再查表得到加到下标上的偏移
+
+            __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+            const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+            result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+            const __m128i shift_lut = _mm_setr_epi8(
+                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                '/' - 63, 'A', 0, 0);
 
-        unsigned char char_array_3[3];
-        unsigned char char_array_4[4];
+            result = _mm_shuffle_epi8(shift_lut, result);
+            return _mm_add_epi8(result, indices);
+        }
+
+        AGZ_BASE64_TARGET("ssse3")
+        size_t encode_blocks_ssse3(
+            const uint8_t *in, size_t triple_count, char *out) noexcept
+        {
+            size_t i = 0;
+            for(; i + 6 <= triple_count; i += 4)
+            {
+                const __m128i bytes = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(in + 3 * i));
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i *>(out + 4 * i),
+                    encode_chars_ssse3(encode_indices_ssse3(bytes)));
+            }
+            return i;
+        }
+
+        /**
+         * @brief 将16个字符转换为6位值，valid返回是否全部为base64字符
+         */
+        AGZ_BASE64_TARGET("ssse3")
+        __m128i decode_values_ssse3(__m128i in, bool &valid) noexcept
+        {
+            const __m128i hi = _mm_and_si128(
+                _mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+            const __m128i lo = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+
+            // 以高4位查偏移，'/'与'+'的高4位相同，单独处理
+            const __m128i shift_lut = _mm_setr_epi8(
+                0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+
+            // mask_lut[lo]的第hi位表示(hi << 4) | lo是否为base64字符
+            const __m128i mask_lut = _mm_setr_epi8(
+                char(0xa8), char(0xf8), char(0xf8), char(0xf8), char(0xf8),
+                char(0xf8), char(0xf8), char(0xf8), char(0xf8), char(0xf8),
+                char(0xf0), char(0x54), char(0x50), char(0x50), char(0x50),
+                char(0x54));
+            const __m128i bitpos_lut = _mm_setr_epi8(
+                0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, char(0x80),
+                0, 0, 0, 0, 0, 0, 0, 0);
 
-        auto buf = static_cast<const unsigned char *>(data);
+            const __m128i mask = _mm_shuffle_epi8(mask_lut, lo);
+            const __m128i bit  = _mm_shuffle_epi8(bitpos_lut, hi);
+            const __m128i invalid = _mm_cmpeq_epi8(
+                _mm_and_si128(mask, bit), _mm_setzero_si128());
+            valid = _mm_movemask_epi8(invalid) == 0;
 
-        int i = 0;
-        while(byte_size--)
+            const __m128i is_slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+            const __m128i shift = _mm_or_si128(
+                _mm_andnot_si128(is_slash, _mm_shuffle_epi8(shift_lut, hi)),
+                _mm_and_si128(is_slash, _mm_set1_epi8(16)));
+
+            return _mm_add_epi8(in, shift);
+        }
+
+        /**
+         * @brief 将16个6位值合并为12字节，位于结果的低12字节
+         */
+        AGZ_BASE64_TARGET("ssse3")
+        __m128i decode_pack_ssse3(__m128i values) noexcept
+        {
+            const __m128i ab_bc = _mm_maddubs_epi16(
+                values, _mm_set1_epi32(0x01400140));
+            const __m128i abcd = _mm_madd_epi16(
+                ab_bc, _mm_set1_epi32(0x00011000));
+            return _mm_shuffle_epi8(abcd, _mm_setr_epi8(
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        }
+
+        AGZ_BASE64_TARGET("ssse3")
+        size_t decode_blocks_ssse3(
+            const char *in, size_t quad_count, uint8_t *out) noexcept
         {
-            char_array_3[i++] = *buf++;
-            if(i == 3)
+            size_t i = 0;
+            for(; i + 6 <= quad_count; i += 4)
             {
-                char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-                char_array_4[1] = ((char_array_3[0] & 0x03) << 4) +
-                                  ((char_array_3[1] & 0xf0) >> 4);
-                char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) +
-                                  ((char_array_3[2] & 0xc0) >> 6);
-                char_array_4[3] = char_array_3[2] & 0x3f;
-
-                for(i = 0; i < 4; i++)
-                    ret += base64_chars[char_array_4[i]];
-                i = 0;
+                bool valid;
+                const __m128i values = decode_values_ssse3(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 4 * i)),
+                    valid);
+                if(!valid)
+                    break;
+
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i *>(out + 3 * i),
+                    decode_pack_ssse3(values));
             }
+            return i;
+        }
+
+        AGZ_BASE64_TARGET("avx2")
+        size_t encode_blocks_avx2(
+            const uint8_t *in, size_t triple_count, char *out) noexcept
+        {
+            const __m256i shuffle = _mm256_set_epi8(
+                10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+            const __m256i shift_lut = _mm256_setr_epi8(
+                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                '/' - 63, 'A', 0, 0,
+                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                '/' - 63, 'A', 0, 0);
+
+            size_t i = 0;
+            for(; i + 10 <= triple_count; i += 8)
+            {
+                // 两个128位通道分别处理12字节
+                const __m128i lo = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(in + 3 * i));
+                const __m128i hi = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(in + 3 * i + 12));
+                __m256i v = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(lo), hi, 1);
+
+                v = _mm256_shuffle_epi8(v, shuffle);
+                const __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+                const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+                const __m256i t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+                const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+                const __m256i indices = _mm256_or_si256(t1, t3);
+
+                __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+                const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+                result = _mm256_or_si256(
+                    result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+                result = _mm256_shuffle_epi8(shift_lut, result);
+
+                _mm256_storeu_si256(
+                    reinterpret_cast<__m256i *>(out + 4 * i),
+                    _mm256_add_epi8(result, indices));
+            }
+            return i;
+        }
+
+        AGZ_BASE64_TARGET("avx2")
+        size_t decode_blocks_avx2(
+            const char *in, size_t quad_count, uint8_t *out) noexcept
+        {
+            const __m256i shift_lut = _mm256_setr_epi8(
+                0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m256i mask_lut = _mm256_setr_epi8(
+                char(0xa8), char(0xf8), char(0xf8), char(0xf8), char(0xf8),
+                char(0xf8), char(0xf8), char(0xf8), char(0xf8), char(0xf8),
+                char(0xf0), char(0x54), char(0x50), char(0x50), char(0x50),
+                char(0x54),
+                char(0xa8), char(0xf8), char(0xf8), char(0xf8), char(0xf8),
+                char(0xf8), char(0xf8), char(0xf8), char(0xf8), char(0xf8),
+                char(0xf0), char(0x54), char(0x50), char(0x50), char(0x50),
+                char(0x54));
+            const __m256i bitpos_lut = _mm256_setr_epi8(
+                0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, char(0x80),
+                0, 0, 0, 0, 0, 0, 0, 0,
+                0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, char(0x80),
+                0, 0, 0, 0, 0, 0, 0, 0);
+            const __m256i pack_shuffle = _mm256_setr_epi8(
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+            size_t i = 0;
+            for(; i + 11 <= quad_count; i += 8)
+            {
+                const __m256i v = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(in + 4 * i));
+
+                const __m256i hi = _mm256_and_si256(
+                    _mm256_srli_epi32(v, 4), _mm256_set1_epi8(0x0f));
+                const __m256i lo = _mm256_and_si256(v, _mm256_set1_epi8(0x0f));
+
+                const __m256i mask = _mm256_shuffle_epi8(mask_lut, lo);
+                const __m256i bit  = _mm256_shuffle_epi8(bitpos_lut, hi);
+                const __m256i invalid = _mm256_cmpeq_epi8(
+                    _mm256_and_si256(mask, bit), _mm256_setzero_si256());
+                if(_mm256_movemask_epi8(invalid))
+                    break;
+
+                const __m256i is_slash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+                const __m256i shift = _mm256_blendv_epi8(
+                    _mm256_shuffle_epi8(shift_lut, hi), _mm256_set1_epi8(16), is_slash);
+                const __m256i values = _mm256_add_epi8(v, shift);
+
+                const __m256i ab_bc = _mm256_maddubs_epi16(
+                    values, _mm256_set1_epi32(0x01400140));
+                const __m256i abcd = _mm256_madd_epi16(
+                    ab_bc, _mm256_set1_epi32(0x00011000));
+                const __m256i packed = _mm256_permutevar8x32_epi32(
+                    _mm256_shuffle_epi8(abcd, pack_shuffle),
+                    _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 3 * i), packed);
+            }
+            return i;
+        }
+
+        enum class simd_level_t { none, ssse3, avx2 };
+
+        simd_level_t simd_level() noexcept
+        {
+            const auto &cpu = misc_impl::cpu_features();
+            if(cpu.avx2)
+                return simd_level_t::avx2;
+            if(cpu.ssse3)
+                return simd_level_t::ssse3;
+            return simd_level_t::none;
         }
 
-        if(i)
+#endif // #ifdef AGZ_BASE64_X86
+
+        void encode_blocks(
+            const uint8_t *in, size_t triple_count, char *out) noexcept
         {
-            for(int j = i; j < 3; j++)
-                char_array_3[j] = '\0';
+            size_t done = 0;
+
+#ifdef AGZ_BASE64_X86
+            switch(simd_level())
+            {
+            case simd_level_t::avx2:
+                done = encode_blocks_avx2(in, triple_count, out);
+                done += encode_blocks_ssse3(
+                    in + 3 * done, triple_count - done, out + 4 * done);
+                break;
+            case simd_level_t::ssse3:
+                done = encode_blocks_ssse3(in, triple_count, out);
+                break;
+            default:
+                break;
+            }
+#endif
 
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) +
-                              ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) +
-                              ((char_array_3[2] & 0xc0) >> 6);
-            char_array_4[3] = char_array_3[2] & 0x3f;
+            encode_blocks_scalar(
+                in + 3 * done, triple_count - done, out + 4 * done);
+        }
 
-            for(int j = 0; j < i + 1; j++)
-                ret += base64_chars[char_array_4[j]];
+        /**
+         * @return 写入的字节数
+         */
+        size_t decode_blocks(
+            const char *in, size_t quad_count, uint8_t *out) noexcept
+        {
+            size_t done = 0;
+
+#ifdef AGZ_BASE64_X86
+            switch(simd_level())
+            {
+            case simd_level_t::avx2:
+                done = decode_blocks_avx2(in, quad_count, out);
+                done += decode_blocks_ssse3(
+                    in + 4 * done, quad_count - done, out + 3 * done);
+                break;
+            case simd_level_t::ssse3:
+                done = decode_blocks_ssse3(in, quad_count, out);
+                break;
+            default:
+                break;
+            }
+#endif
 
-            while(i++ < 3)
-                ret += '=';
+            return 3 * done + decode_blocks_scalar(
+                in + 4 * done, quad_count - done, out + 3 * done);
         }
 
+    } // namespace anonymous
+
+    size_t encoded_base64_size(size_t byte_size) noexcept
+    {
+        return (byte_size + 2) / 3 * 4;
+    }
+
+    size_t encode_base64(const void *data, size_t byte_size, char *output) noexcept
+    {
+        auto in = static_cast<const uint8_t *>(data);
+
+        const size_t triple_count = byte_size / 3;
+        encode_blocks(in, triple_count, output);
+
+        if(const size_t rest = byte_size - 3 * triple_count)
+            encode_tail(in + 3 * triple_count, rest, output + 4 * triple_count);
+
+        return encoded_base64_size(byte_size);
+    }
+
+    std::string encode_base64(const void *data, size_t byte_size)
+    {
+        std::string ret(encoded_base64_size(byte_size), '\0');
+        encode_base64(data, byte_size, ret.data());
         return ret;
     }
 
+    size_t decoded_base64_max_size(size_t char_count) noexcept
+    {
+        return (char_count + 3) / 4 * 3;
+    }
+
+    size_t decode_base64(std::string_view str, void *output) noexcept
+    {
+        auto out = static_cast<uint8_t *>(output);
+
+        size_t written = decode_blocks(str.data(), str.size() / 4, out);
+
+        // 剩余的有效字符不足一组
+        const size_t consumed = written / 3 * 4;
+        size_t valid = 0;
+        while(consumed + valid < str.size() && valid < 4 &&
+              is_base64(str[consumed + valid]))
+            ++valid;
+
+        written += decode_partial(str.data() + consumed, valid, out + written);
+        return written;
+    }
+
     std::vector<unsigned char> decode_base64(std::string_view str)
     {
-        int in_len = static_cast<int>(str.size());
-        int in_ = 0;
+        std::vector<unsigned char> ret(decoded_base64_max_size(str.size()));
+        ret.resize(decode_base64(str, ret.data()));
+        return ret;
+    }
 
-        unsigned char char_array_4[4], char_array_3[3];
+    size_t base64_encoder_t::max_update_size(size_t byte_size) const noexcept
+    {
+        return (pending_count_ + byte_size) / 3 * 4;
+    }
 
-        std::vector<unsigned char> ret;
+    size_t base64_encoder_t::update(
+        const void *data, size_t byte_size, char *output) noexcept
+    {
+        auto in = static_cast<const uint8_t *>(data);
+        size_t written = 0;
 
-        int i = 0;
-        while(in_len-- && (str[in_] != '=') && is_base64(str[in_]))
+        if(pending_count_)
         {
-            char_array_4[i++] = str[in_]; in_++;
-            if(i == 4)
+            while(pending_count_ < 3 && byte_size)
             {
-                for(i = 0; i < 4; i++)
-                    char_array_4[i] = static_cast<unsigned char>(
-                        base64_chars.find(char_array_4[i]));
-
-                char_array_3[0] = (char_array_4[0] << 2) +
-                                  ((char_array_4[1] & 0x30) >> 4);
-                char_array_3[1] = ((char_array_4[1] & 0xf) << 4) +
-                                  ((char_array_4[2] & 0x3c) >> 2);
-                char_array_3[2] = ((char_array_4[2] & 0x3) << 6) +
-                                  char_array_4[3];
-
-                for(i = 0; (i < 3); i++)
-                    ret.push_back(char_array_3[i]);
-                i = 0;
+                pending_[pending_count_++] = *in++;
+                --byte_size;
             }
+            if(pending_count_ < 3)
+                return 0;
+
+            encode_triple(pending_, output);
+            pending_count_ = 0;
+            written = 4;
         }
 
-        if(i)
-        {
-            for(int j = i; j < 4; j++)
-                char_array_4[j] = 0;
+        const size_t triple_count = byte_size / 3;
+        encode_blocks(in, triple_count, output + written);
+        written += 4 * triple_count;
 
-            for(int j = 0; j < 4; j++)
-                char_array_4[j] = static_cast<unsigned char>(
-                    base64_chars.find(char_array_4[j]));
+        pending_count_ = byte_size - 3 * triple_count;
+        std::memcpy(pending_, in + 3 * triple_count, pending_count_);
 
-            char_array_3[0] = (char_array_4[0] << 2) +
-                              ((char_array_4[1] & 0x30) >> 4);
-            char_array_3[1] = ((char_array_4[1] & 0xf) << 4) +
-                              ((char_array_4[2] & 0x3c) >> 2);
-            char_array_3[2] = ((char_array_4[2] & 0x3) << 6) +
-                              char_array_4[3];
+        return written;
+    }
+
+    void base64_encoder_t::update(
+        const void *data, size_t byte_size, std::string &output)
+    {
+        const size_t old_size = output.size();
+        output.resize(old_size + max_update_size(byte_size));
+        update(data, byte_size, output.data() + old_size);
+    }
+
+    size_t base64_encoder_t::finish(char *output) noexcept
+    {
+        if(!pending_count_)
+            return 0;
+        encode_tail(pending_, pending_count_, output);
+        pending_count_ = 0;
+        return 4;
+    }
+
+    void base64_encoder_t::finish(std::string &output)
+    {
+        char buffer[4];
+        output.append(buffer, finish(buffer));
+    }
+
+    size_t base64_decoder_t::max_update_size(size_t char_count) const noexcept
+    {
+        return stopped_ ? 0 : (pending_count_ + char_count) / 4 * 3;
+    }
+
+    size_t base64_decoder_t::update(std::string_view str, void *output) noexcept
+    {
+        if(stopped_)
+            return 0;
+
+        auto out = static_cast<uint8_t *>(output);
+        size_t pos = 0, written = 0;
+
+        auto take = [&]
+        {
+            if(!is_base64(str[pos]))
+            {
+                stopped_ = true;
+                return false;
+            }
+            pending_[pending_count_++] = str[pos++];
+            return true;
+        };
 
-            for(int j = 0; (j < i - 1); j++)
-                ret.push_back(char_array_3[j]);
+        if(pending_count_)
+        {
+            while(pending_count_ < 4 && pos < str.size())
+            {
+                if(!take())
+                    return 0;
+            }
+            if(pending_count_ < 4)
+                return 0;
+
+            written = decode_blocks_scalar(pending_, 1, out);
+            pending_count_ = 0;
         }
 
-        return ret;
+        const size_t quad_count = (str.size() - pos) / 4;
+        const size_t bulk = decode_blocks(str.data() + pos, quad_count, out + written);
+        written += bulk;
+        pos += bulk / 3 * 4;
+
+        // 剩余字符不足一组，或者其所在的组中有非base64字符
+        while(pos < str.size() && take())
+            ;
+
+        return written;
+    }
+
+    void base64_decoder_t::update(
+        std::string_view str, std::vector<unsigned char> &output)
+    {
+        const size_t old_size = output.size();
+        output.resize(old_size + max_update_size(str.size()));
+        output.resize(old_size + update(str, output.data() + old_size));
+    }
+
+    size_t base64_decoder_t::finish(void *output) noexcept
+    {
+        const size_t written = decode_partial(
+            pending_, pending_count_, static_cast<uint8_t *>(output));
+        pending_count_ = 0;
+        stopped_ = false;
+        return written;
+    }
+
+    void base64_decoder_t::finish(std::vector<unsigned char> &output)
+    {
+        uint8_t buffer[3];
+        const size_t n = finish(buffer);
+        output.insert(output.end(), buffer, buffer + n);
+    }
+
+    bool base64_decoder_t::stopped() const noexcept
+    {
+        return stopped_;
     }
 
 } // namespace agz::misc
@@ -0,0 +1,66 @@
+#pragma once
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   include <intrin.h>
+#endif
+
+namespace agz::misc::misc_impl
+{
+
+    /**
+     * @brief 运行时检测到的SIMD指令集支持情况
+     *
+     * 非x86平台上各项均为false
+     */
+    struct cpu_features_t
+    {
+        bool sse2  = false;
+        bool ssse3 = false;
+        bool avx2  = false;
+    };
+
+    inline cpu_features_t detect_cpu_features() noexcept
+    {
+        cpu_features_t ret;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+        __builtin_cpu_init();
+        ret.sse2  = __builtin_cpu_supports("sse2");
+        ret.ssse3 = __builtin_cpu_supports("ssse3");
+        ret.avx2  = __builtin_cpu_supports("avx2");
+
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+
+        int info[4];
+        __cpuid(info, 0);
+        const int max_leaf = info[0];
+
+        __cpuid(info, 1);
+        ret.sse2  = (info[3] & (1 << 26)) != 0;
+        ret.ssse3 = (info[2] & (1 << 9)) != 0;
+
+        // avx2还要求操作系统保存ymm寄存器
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx     = (info[2] & (1 << 28)) != 0;
+        if(max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+        {
+            __cpuidex(info, 7, 0);
+            ret.avx2 = (info[1] & (1 << 5)) != 0;
+        }
+
+#endif
+
+        return ret;
+    }
+
+    /**
+     * @brief 当前处理器的SIMD指令集支持情况，只在第一次调用时检测
+     */
+    inline const cpu_features_t &cpu_features() noexcept
+    {
+        static const cpu_features_t features = detect_cpu_features();
+        return features;
+    }
+
+} // namespace agz::misc::misc_impl
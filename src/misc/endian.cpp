@@ -0,0 +1,246 @@
+#include <cstdint>
+#include <cstring>
+
+#include <agz-utils/misc/endian.h>
+
+#include "./cpu_features.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define AGZ_ENDIAN_X86
+#   define AGZ_ENDIAN_TARGET(X) __attribute__((target(X)))
+#   include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   define AGZ_ENDIAN_X86
+#   define AGZ_ENDIAN_TARGET(X)
+#   include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#   include <stdlib.h>
+#endif
+
+namespace agz::misc
+{
+
+    namespace
+    {
+        uint16_t bswap(uint16_t v) noexcept
+        {
+#if defined(__GNUC__)
+            return __builtin_bswap16(v);
+#elif defined(_MSC_VER)
+            return _byteswap_ushort(v);
+#else
+            return static_cast<uint16_t>((v >> 8) | (v << 8));
+#endif
+        }
+
+        uint32_t bswap(uint32_t v) noexcept
+        {
+#if defined(__GNUC__)
+            return __builtin_bswap32(v);
+#elif defined(_MSC_VER)
+            return _byteswap_ulong(v);
+#else
+            return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+#endif
+        }
+
+        uint64_t bswap(uint64_t v) noexcept
+        {
+#if defined(__GNUC__)
+            return __builtin_bswap64(v);
+#elif defined(_MSC_VER)
+            return _byteswap_uint64(v);
+#else
+            return (uint64_t(bswap(uint32_t(v))) << 32) | bswap(uint32_t(v >> 32));
+#endif
+        }
+
+        template<typename U>
+        void swap_scalar(
+            const unsigned char *src, unsigned char *dst, size_t count) noexcept
+        {
+            for(size_t i = 0; i < count; ++i)
+            {
+                U v;
+                std::memcpy(&v, src + i * sizeof(U), sizeof(U));
+                v = bswap(v);
+                std::memcpy(dst + i * sizeof(U), &v, sizeof(U));
+            }
+        }
+
+        void swap_scalar_any(
+            const unsigned char *src, unsigned char *dst,
+            size_t count, size_t elem_size) noexcept
+        {
+            for(size_t i = 0; i < count; ++i)
+            {
+                const unsigned char *s = src + i * elem_size;
+                unsigned char *d = dst + i * elem_size;
+                for(size_t lo = 0, hi = elem_size - 1; lo < hi; ++lo, --hi)
+                {
+                    const unsigned char a = s[lo], b = s[hi];
+                    d[lo] = b;
+                    d[hi] = a;
+                }
+                if(elem_size & 1)
+                    d[elem_size / 2] = s[elem_size / 2];
+            }
+        }
+
+#ifdef AGZ_ENDIAN_X86
+
+        /*
+         * 以pshufb在每个元素内部反转字节，dst == src时原地转换
+         * 返回值为已处理的字节数
+         */
+
+        template<size_t E>
+        __m128i shuffle_mask_128() noexcept
+        {
+            alignas(16) char mask[16];
+            for(size_t i = 0; i < 16; ++i)
+                mask[i] = static_cast<char>(i / E * E + (E - 1 - i % E));
+            return _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+        }
+
+        template<size_t E>
+        AGZ_ENDIAN_TARGET("ssse3")
+        size_t swap_ssse3(
+            const unsigned char *src, unsigned char *dst, size_t bytes) noexcept
+        {
+            const __m128i mask = shuffle_mask_128<E>();
+
+            size_t i = 0;
+            for(; i + 64 <= bytes; i += 64)
+            {
+                auto s = reinterpret_cast<const __m128i *>(src + i);
+                auto d = reinterpret_cast<__m128i *>(dst + i);
+                const __m128i a = _mm_loadu_si128(s + 0);
+                const __m128i b = _mm_loadu_si128(s + 1);
+                const __m128i c = _mm_loadu_si128(s + 2);
+                const __m128i e = _mm_loadu_si128(s + 3);
+                _mm_storeu_si128(d + 0, _mm_shuffle_epi8(a, mask));
+                _mm_storeu_si128(d + 1, _mm_shuffle_epi8(b, mask));
+                _mm_storeu_si128(d + 2, _mm_shuffle_epi8(c, mask));
+                _mm_storeu_si128(d + 3, _mm_shuffle_epi8(e, mask));
+            }
+            for(; i + 16 <= bytes; i += 16)
+            {
+                const __m128i a = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(src + i));
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(a, mask));
+            }
+            return i;
+        }
+
+        template<size_t E>
+        AGZ_ENDIAN_TARGET("avx2")
+        size_t swap_avx2(
+            const unsigned char *src, unsigned char *dst, size_t bytes) noexcept
+        {
+            const __m128i half = shuffle_mask_128<E>();
+            const __m256i mask = _mm256_broadcastsi128_si256(half);
+
+            size_t i = 0;
+            for(; i + 128 <= bytes; i += 128)
+            {
+                auto s = reinterpret_cast<const __m256i *>(src + i);
+                auto d = reinterpret_cast<__m256i *>(dst + i);
+                const __m256i a = _mm256_loadu_si256(s + 0);
+                const __m256i b = _mm256_loadu_si256(s + 1);
+                const __m256i c = _mm256_loadu_si256(s + 2);
+                const __m256i e = _mm256_loadu_si256(s + 3);
+                _mm256_storeu_si256(d + 0, _mm256_shuffle_epi8(a, mask));
+                _mm256_storeu_si256(d + 1, _mm256_shuffle_epi8(b, mask));
+                _mm256_storeu_si256(d + 2, _mm256_shuffle_epi8(c, mask));
+                _mm256_storeu_si256(d + 3, _mm256_shuffle_epi8(e, mask));
+            }
+            for(; i + 32 <= bytes; i += 32)
+            {
+                const __m256i a = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(src + i));
+                _mm256_storeu_si256(
+                    reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(a, mask));
+            }
+            return i;
+        }
+
+        enum class simd_level_t { none, ssse3, avx2 };
+
+        simd_level_t simd_level() noexcept
+        {
+            const auto &cpu = misc_impl::cpu_features();
+            if(cpu.avx2)
+                return simd_level_t::avx2;
+            if(cpu.ssse3)
+                return simd_level_t::ssse3;
+            return simd_level_t::none;
+        }
+
+#endif // #ifdef AGZ_ENDIAN_X86
+
+        template<typename U>
+        void swap_elements(
+            const unsigned char *src, unsigned char *dst, size_t count) noexcept
+        {
+            const size_t bytes = count * sizeof(U);
+            size_t done = 0;
+
+#ifdef AGZ_ENDIAN_X86
+            switch(simd_level())
+            {
+            case simd_level_t::avx2:
+                done = swap_avx2<sizeof(U)>(src, dst, bytes);
+                done += swap_ssse3<sizeof(U)>(src + done, dst + done, bytes - done);
+                break;
+            case simd_level_t::ssse3:
+                done = swap_ssse3<sizeof(U)>(src, dst, bytes);
+                break;
+            default:
+                break;
+            }
+#endif
+
+            swap_scalar<U>(src + done, dst + done, (bytes - done) / sizeof(U));
+        }
+
+    } // namespace anonymous
+
+    void copy_swap_bytes(
+        const void *src, void *dst, size_t count, size_t elem_size) noexcept
+    {
+        auto s = static_cast<const unsigned char *>(src);
+        auto d = static_cast<unsigned char *>(dst);
+
+        switch(elem_size)
+        {
+        case 0:
+            break;
+        case 1:
+            if(s != d)
+                std::memmove(d, s, count);
+            break;
+        case 2:
+            swap_elements<uint16_t>(s, d, count);
+            break;
+        case 4:
+            swap_elements<uint32_t>(s, d, count);
+            break;
+        case 8:
+            swap_elements<uint64_t>(s, d, count);
+            break;
+        default:
+            swap_scalar_any(s, d, count, elem_size);
+            break;
+        }
+    }
+
+    void swap_bytes_inplace(void *data, size_t count, size_t elem_size) noexcept
+    {
+        copy_swap_bytes(data, data, count, elem_size);
+    }
+
+} // namespace agz::misc
@@ -0,0 +1,370 @@
+#include <array>
+
+#include <agz-utils/misc/hash.h>
+
+#include "./cpu_features.h"
+
+// sse2内核不加target属性，只在编译器保证sse2可用时启用
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#   define AGZ_HASH_X86
+#   define AGZ_HASH_TARGET(X) __attribute__((target(X)))
+#   include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#   define AGZ_HASH_X86
+#   define AGZ_HASH_TARGET(X)
+#   include <immintrin.h>
+#endif
+
+// 短输入参见wyhash (https://github.com/wangyi-fudan/wyhash)，
+// 长输入的分条累加参见XXH3 (https://github.com/Cyan4973/xxHash)
+
+namespace agz::misc
+{
+
+    namespace
+    {
+        constexpr uint64_t WY_SECRET[4] =
+        {
+            0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+            0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull
+        };
+
+        constexpr uint64_t PRIME32_1 = 0x9E3779B1u;
+        constexpr uint64_t PRIME32_2 = 0x85EBCA77u;
+        constexpr uint64_t PRIME32_3 = 0xC2B2AE3Du;
+        constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+        constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+        constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+        // 长输入：每条64字节，第i条使用密钥字[i, i + 8)；每块16条后用密钥字[16, 24)扰乱累加器
+        constexpr size_t STRIPE_SIZE       = 64;
+        constexpr size_t SECRET_WORDS      = 24;
+        constexpr size_t STRIPES_PER_BLOCK = SECRET_WORDS - 8;
+        constexpr size_t BLOCK_SIZE        = STRIPE_SIZE * STRIPES_PER_BLOCK;
+        constexpr size_t LONG_THRESHOLD    = 256;
+
+        constexpr std::array<uint64_t, SECRET_WORDS> LONG_SECRET = []
+        {
+            // splitmix64
+            std::array<uint64_t, SECRET_WORDS> ret = {};
+            uint64_t state = 0x2545F4914F6CDD1Dull;
+            for(auto &word : ret)
+            {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                word = z ^ (z >> 31);
+            }
+            return ret;
+        }();
+
+        uint64_t read64(const uint8_t *p) noexcept
+        {
+            uint64_t v;
+            std::memcpy(&v, p, 8);
+            return v;
+        }
+
+        uint64_t read32(const uint8_t *p) noexcept
+        {
+            uint32_t v;
+            std::memcpy(&v, p, 4);
+            return v;
+        }
+
+        uint64_t read_small(const uint8_t *p, size_t k) noexcept
+        {
+            return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1];
+        }
+
+        uint64_t wymix(uint64_t a, uint64_t b) noexcept
+        {
+            hash_impl::mum(a, b);
+            return a ^ b;
+        }
+
+        uint64_t hash_short(const uint8_t *p, size_t len, uint64_t seed) noexcept
+        {
+            seed ^= wymix(seed ^ WY_SECRET[0], WY_SECRET[1]);
+
+            uint64_t a, b;
+            if(len <= 16)
+            {
+                if(len >= 4)
+                {
+                    const size_t off = (len >> 3) << 2;
+                    a = (read32(p) << 32) | read32(p + off);
+                    b = (read32(p + len - 4) << 32) | read32(p + len - 4 - off);
+                }
+                else if(len > 0)
+                {
+                    a = read_small(p, len);
+                    b = 0;
+                }
+                else
+                    a = b = 0;
+            }
+            else
+            {
+                size_t i = len;
+                if(i > 48)
+                {
+                    uint64_t see1 = seed, see2 = seed;
+                    do
+                    {
+                        seed = wymix(read64(p)      ^ WY_SECRET[1], read64(p + 8)  ^ seed);
+                        see1 = wymix(read64(p + 16) ^ WY_SECRET[2], read64(p + 24) ^ see1);
+                        see2 = wymix(read64(p + 32) ^ WY_SECRET[3], read64(p + 40) ^ see2);
+                        p += 48;
+                        i -= 48;
+                    } while(i > 48);
+                    seed ^= see1 ^ see2;
+                }
+
+                while(i > 16)
+                {
+                    seed = wymix(read64(p) ^ WY_SECRET[1], read64(p + 8) ^ seed);
+                    i -= 16;
+                    p += 16;
+                }
+
+                a = read64(p + i - 16);
+                b = read64(p + i - 8);
+            }
+
+            a ^= WY_SECRET[1];
+            b ^= seed;
+            hash_impl::mum(a, b);
+            return wymix(a ^ WY_SECRET[0] ^ len, b ^ WY_SECRET[1]);
+        }
+
+        // 累加与扰乱的各实现必须给出完全相同的结果
+
+        void accumulate_scalar(
+            uint64_t *acc, const uint8_t *p, size_t stripes,
+            const uint64_t *key) noexcept
+        {
+            for(size_t s = 0; s < stripes; ++s)
+            {
+                const uint8_t *stripe = p + s * STRIPE_SIZE;
+                const uint64_t *k = key + s;
+                for(int i = 0; i < 8; ++i)
+                {
+                    const uint64_t data = read64(stripe + 8 * i);
+                    const uint64_t mixed = data ^ k[i];
+                    acc[i ^ 1] += data;
+                    acc[i] += (mixed & 0xffffffff) * (mixed >> 32);
+                }
+            }
+        }
+
+        void scramble_scalar(uint64_t *acc, const uint64_t *key) noexcept
+        {
+            for(int i = 0; i < 8; ++i)
+            {
+                uint64_t a = acc[i];
+                a ^= a >> 47;
+                a ^= key[i];
+                acc[i] = a * PRIME32_1;
+            }
+        }
+
+#ifdef AGZ_HASH_X86
+
+        void accumulate_sse2(
+            uint64_t *acc, const uint8_t *p, size_t stripes,
+            const uint64_t *key) noexcept
+        {
+            __m128i a[4];
+            for(int j = 0; j < 4; ++j)
+                a[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc) + j);
+
+            for(size_t s = 0; s < stripes; ++s)
+            {
+                auto stripe = reinterpret_cast<const __m128i *>(p + s * STRIPE_SIZE);
+                auto k = reinterpret_cast<const __m128i *>(key + s);
+                for(int j = 0; j < 4; ++j)
+                {
+                    const __m128i data  = _mm_loadu_si128(stripe + j);
+                    const __m128i mixed = _mm_xor_si128(data, _mm_loadu_si128(k + j));
+                    const __m128i prod  = _mm_mul_epu32(mixed, _mm_srli_epi64(mixed, 32));
+                    const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                    a[j] = _mm_add_epi64(a[j], _mm_add_epi64(prod, swapped));
+                }
+            }
+
+            for(int j = 0; j < 4; ++j)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(acc) + j, a[j]);
+        }
+
+        void scramble_sse2(uint64_t *acc, const uint64_t *key) noexcept
+        {
+            const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+            for(int j = 0; j < 4; ++j)
+            {
+                auto pa = reinterpret_cast<__m128i *>(acc) + j;
+                __m128i a = _mm_loadu_si128(pa);
+                a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+                a = _mm_xor_si128(a, _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(key) + j));
+
+                const __m128i lo = _mm_mul_epu32(a, prime);
+                const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+                _mm_storeu_si128(pa, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+            }
+        }
+
+        AGZ_HASH_TARGET("avx2")
+        void accumulate_avx2(
+            uint64_t *acc, const uint8_t *p, size_t stripes,
+            const uint64_t *key) noexcept
+        {
+            __m256i a[2];
+            for(int j = 0; j < 2; ++j)
+                a[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc) + j);
+
+            for(size_t s = 0; s < stripes; ++s)
+            {
+                auto stripe = reinterpret_cast<const __m256i *>(p + s * STRIPE_SIZE);
+                auto k = reinterpret_cast<const __m256i *>(key + s);
+                for(int j = 0; j < 2; ++j)
+                {
+                    const __m256i data  = _mm256_loadu_si256(stripe + j);
+                    const __m256i mixed = _mm256_xor_si256(data, _mm256_loadu_si256(k + j));
+                    const __m256i prod  = _mm256_mul_epu32(mixed, _mm256_srli_epi64(mixed, 32));
+                    const __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                    a[j] = _mm256_add_epi64(a[j], _mm256_add_epi64(prod, swapped));
+                }
+            }
+
+            for(int j = 0; j < 2; ++j)
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc) + j, a[j]);
+        }
+
+#endif // #ifdef AGZ_HASH_X86
+
+        using accumulate_func_t = void(*)(
+            uint64_t *, const uint8_t *, size_t, const uint64_t *) noexcept;
+        using scramble_func_t = void(*)(uint64_t *, const uint64_t *) noexcept;
+
+        struct kernels_t
+        {
+            accumulate_func_t accumulate;
+            scramble_func_t   scramble;
+        };
+
+        const kernels_t &kernels() noexcept
+        {
+            static const kernels_t ret = []() -> kernels_t
+            {
+#ifdef AGZ_HASH_X86
+                const auto &cpu = misc_impl::cpu_features();
+                if(cpu.avx2)
+                    return { &accumulate_avx2, &scramble_sse2 };
+                if(cpu.sse2)
+                    return { &accumulate_sse2, &scramble_sse2 };
+#endif
+                return { &accumulate_scalar, &scramble_scalar };
+            }();
+            return ret;
+        }
+
+        /**
+         * @brief 长输入的累加阶段，len > LONG_THRESHOLD
+         */
+        void hash_long_accumulate(
+            const uint8_t *p, size_t len, const uint64_t *key, uint64_t *acc) noexcept
+        {
+            const kernels_t &k = kernels();
+
+            const size_t block_count = (len - 1) / BLOCK_SIZE;
+            for(size_t b = 0; b < block_count; ++b)
+            {
+                k.accumulate(acc, p + b * BLOCK_SIZE, STRIPES_PER_BLOCK, key);
+                k.scramble(acc, key + STRIPES_PER_BLOCK);
+            }
+
+            // 最后一块中的完整条，以及以输入末尾对齐的最后一条
+
+            const size_t tail_offset = block_count * BLOCK_SIZE;
+            const size_t stripes = (len - 1 - tail_offset) / STRIPE_SIZE;
+            k.accumulate(acc, p + tail_offset, stripes, key);
+            k.accumulate(acc, p + len - STRIPE_SIZE, 1, key + STRIPES_PER_BLOCK - 1);
+        }
+
+        uint64_t avalanche(uint64_t h) noexcept
+        {
+            h ^= h >> 37;
+            h *= 0x165667919E3779F9ull;
+            return h ^ (h >> 32);
+        }
+
+        uint64_t merge_accumulators(
+            const uint64_t *acc, const uint64_t *key, uint64_t start) noexcept
+        {
+            uint64_t result = start;
+            for(int i = 0; i < 4; ++i)
+            {
+                uint64_t a = acc[2 * i] ^ key[2 * i];
+                uint64_t b = acc[2 * i + 1] ^ key[2 * i + 1];
+                hash_impl::mum(a, b);
+                result += a ^ b;
+            }
+            return avalanche(result);
+        }
+
+        void init_long(
+            uint64_t seed, uint64_t *key, uint64_t *acc) noexcept
+        {
+            for(size_t i = 0; i < SECRET_WORDS; ++i)
+                key[i] = LONG_SECRET[i] + ((i & 1) ? 0 - seed : seed);
+
+            const uint64_t init[8] =
+            {
+                PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+                PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+            };
+            std::memcpy(acc, init, sizeof(init));
+        }
+
+    } // namespace anonymous
+
+    uint64_t hash_bytes(const void *data, size_t byte_size, uint64_t seed) noexcept
+    {
+        auto p = static_cast<const uint8_t *>(data);
+        if(byte_size <= LONG_THRESHOLD)
+            return hash_short(p, byte_size, seed);
+
+        alignas(32) uint64_t key[SECRET_WORDS];
+        alignas(32) uint64_t acc[8];
+        init_long(seed, key, acc);
+        hash_long_accumulate(p, byte_size, key, acc);
+        return merge_accumulators(acc, key + 11, byte_size * PRIME64_1);
+    }
+
+    hash128_t hash_bytes_128(
+        const void *data, size_t byte_size, uint64_t seed) noexcept
+    {
+        auto p = static_cast<const uint8_t *>(data);
+        if(byte_size <= LONG_THRESHOLD)
+        {
+            return {
+                hash_short(p, byte_size, seed),
+                hash_short(p, byte_size, seed ^ PRIME64_4)
+            };
+        }
+
+        alignas(32) uint64_t key[SECRET_WORDS];
+        alignas(32) uint64_t acc[8];
+        init_long(seed, key, acc);
+        hash_long_accumulate(p, byte_size, key, acc);
+        return {
+            merge_accumulators(acc, key + 11, byte_size * PRIME64_1),
+            merge_accumulators(acc, key + 3, ~(byte_size * PRIME64_2))
+        };
+    }
+
+} // namespace agz::misc
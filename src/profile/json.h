@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+namespace agz::profile::profile_impl
+{
+
+    inline void append_json_string(std::string &out, const std::string &str)
+    {
+        out += '"';
+        for(char c : str)
+        {
+            switch(c)
+            {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(
+                        buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+                    out += buf;
+                }
+                else
+                    out += c;
+                break;
+            }
+        }
+        out += '"';
+    }
+
+    /**
+     * @brief 非有限值输出为null
+     */
+    inline void append_json_number(std::string &out, double value)
+    {
+        if(!std::isfinite(value))
+        {
+            out += "null";
+            return;
+        }
+
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.17g", value);
+        out += buf;
+    }
+
+} // namespace agz::profile::profile_impl
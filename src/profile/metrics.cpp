@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <new>
+#include <stdexcept>
+
+#include <agz-utils/profile/metrics.h>
+
+#include "./json.h"
+
+namespace agz::profile
+{
+
+namespace metrics_impl
+{
+
+    size_t next_shard_index() noexcept
+    {
+        static std::atomic<size_t> next_index = { 0 };
+        return next_index.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    }
+
+} // namespace metrics_impl
+
+int64_t counter_t::value() const noexcept
+{
+    int64_t ret = 0;
+    for(auto &s : shards_)
+        ret += s.value.load(std::memory_order_relaxed);
+    return ret;
+}
+
+void counter_t::reset() noexcept
+{
+    for(auto &s : shards_)
+        s.value.store(0, std::memory_order_relaxed);
+}
+
+double histogram_snapshot_t::mean() const noexcept
+{
+    return count ? static_cast<double>(sum) / count : 0.0;
+}
+
+uint64_t histogram_snapshot_t::percentile(double p) const noexcept
+{
+    uint64_t total = 0;
+    for(uint64_t c : buckets)
+        total += c;
+    if(!total)
+        return 0;
+
+    p = (std::clamp)(p, 0.0, 100.0);
+    const uint64_t rank = (std::max<uint64_t>)(
+        1, static_cast<uint64_t>(std::ceil(p / 100 * static_cast<double>(total))));
+
+    uint64_t seen = 0;
+    for(size_t i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+        if(seen < rank)
+            continue;
+
+        // 与记录并发的快照中min/max可能尚未更新，此时不用它们修正桶的上界
+
+        const uint64_t upper = histogram_t::bucket_upper(i);
+        return min <= max ? (std::clamp)(upper, min, max) : upper;
+    }
+    return max;
+}
+
+histogram_t::shard_t::shard_t() noexcept
+{
+    reset();
+}
+
+void histogram_t::shard_t::reset() noexcept
+{
+    for(auto &b : buckets)
+        b.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    sum  .store(0, std::memory_order_relaxed);
+    min  .store((std::numeric_limits<uint64_t>::max)(), std::memory_order_relaxed);
+    max  .store(0, std::memory_order_relaxed);
+}
+
+histogram_t::histogram_t()
+{
+    for(auto &s : shards_)
+        s.store(nullptr, std::memory_order_relaxed);
+}
+
+histogram_t::~histogram_t()
+{
+    for(auto &s : shards_)
+        delete s.load(std::memory_order_relaxed);
+}
+
+histogram_t::shard_t *histogram_t::create_shard(
+    std::atomic<shard_t *> &slot) noexcept
+{
+    auto shard = new(std::nothrow) shard_t;
+    if(!shard)
+        return nullptr;
+
+    // 同一分片可能被多个线程同时创建，只保留一个
+
+    shard_t *expected = nullptr;
+    if(!slot.compare_exchange_strong(
+        expected, shard, std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+        delete shard;
+        return expected;
+    }
+    return shard;
+}
+
+histogram_snapshot_t histogram_t::snapshot() const
+{
+    histogram_snapshot_t ret;
+    ret.min = (std::numeric_limits<uint64_t>::max)();
+
+    for(auto &slot : shards_)
+    {
+        const shard_t *shard = slot.load(std::memory_order_acquire);
+        if(!shard)
+            continue;
+
+        if(ret.buckets.empty())
+            ret.buckets.resize(BUCKET_COUNT, 0);
+
+        for(size_t i = 0; i < BUCKET_COUNT; ++i)
+            ret.buckets[i] += shard->buckets[i].load(std::memory_order_relaxed);
+
+        ret.count += shard->count.load(std::memory_order_relaxed);
+        ret.sum   += shard->sum.load(std::memory_order_relaxed);
+        ret.min = (std::min)(ret.min, shard->min.load(std::memory_order_relaxed));
+        ret.max = (std::max)(ret.max, shard->max.load(std::memory_order_relaxed));
+    }
+
+    if(!ret.count)
+    {
+        ret.buckets.clear();
+        ret.min = 0;
+    }
+
+    return ret;
+}
+
+void histogram_t::reset() noexcept
+{
+    for(auto &slot : shards_)
+    {
+        if(shard_t *shard = slot.load(std::memory_order_acquire))
+            shard->reset();
+    }
+}
+
+uint64_t histogram_t::bucket_lower(size_t index) noexcept
+{
+    if(index < SUB_BUCKET_COUNT)
+        return index;
+
+    const size_t shift = index / SUB_BUCKET_COUNT - 1;
+    const uint64_t mantissa = SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT;
+    return mantissa << shift;
+}
+
+uint64_t histogram_t::bucket_upper(size_t index) noexcept
+{
+    if(index < SUB_BUCKET_COUNT)
+        return index;
+
+    const size_t shift = index / SUB_BUCKET_COUNT - 1;
+    return bucket_lower(index) + ((uint64_t(1) << shift) - 1);
+}
+
+distribution_t::computer_t distribution_t::snapshot() const
+{
+    computer_t ret;
+    for(auto &shard : shards_)
+    {
+        computer_t copy;
+        {
+            std::lock_guard lk(shard.lock);
+            copy = shard.computer;
+        }
+        ret.merge(copy);
+    }
+    return ret;
+}
+
+void distribution_t::reset() noexcept
+{
+    for(auto &shard : shards_)
+    {
+        std::lock_guard lk(shard.lock);
+        shard.computer.clear();
+    }
+}
+
+std::string metrics_snapshot_t::to_text() const
+{
+    std::string out;
+    char line[512];
+
+    for(auto &[name, value] : counters)
+    {
+        std::snprintf(
+            line, sizeof(line), "counter      %-32s %lld\n",
+            name.c_str(), static_cast<long long>(value));
+        out += line;
+    }
+
+    for(auto &[name, value] : gauges)
+    {
+        std::snprintf(
+            line, sizeof(line), "gauge        %-32s %g\n", name.c_str(), value);
+        out += line;
+    }
+
+    for(auto &[name, h] : histograms)
+    {
+        std::snprintf(
+            line, sizeof(line),
+            "histogram    %-32s count=%llu mean=%g min=%llu "
+            "p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu\n",
+            name.c_str(), static_cast<unsigned long long>(h.count), h.mean(),
+            static_cast<unsigned long long>(h.min),
+            static_cast<unsigned long long>(h.percentile(50)),
+            static_cast<unsigned long long>(h.percentile(90)),
+            static_cast<unsigned long long>(h.percentile(99)),
+            static_cast<unsigned long long>(h.percentile(99.9)),
+            static_cast<unsigned long long>(h.max));
+        out += line;
+    }
+
+    for(auto &[name, d] : distributions)
+    {
+        std::snprintf(
+            line, sizeof(line), "distribution %-32s count=%llu mean=%g stddev=%g\n",
+            name.c_str(), static_cast<unsigned long long>(d.value_count()),
+            d.mean(), std::sqrt(d.variance()));
+        out += line;
+    }
+
+    return out;
+}
+
+std::string metrics_snapshot_t::to_json() const
+{
+    using profile_impl::append_json_number;
+    using profile_impl::append_json_string;
+
+    std::string out = "{";
+
+    auto begin_group = [&](const char *group, bool first)
+    {
+        if(!first)
+            out += ',';
+        out += '"';
+        out += group;
+        out += "\":{";
+    };
+
+    auto begin_item = [&](const std::string &name, bool &first)
+    {
+        if(!first)
+            out += ',';
+        first = false;
+        append_json_string(out, name);
+        out += ':';
+    };
+
+    auto append_field = [&](const char *field, double value, bool last = false)
+    {
+        out += '"';
+        out += field;
+        out += "\":";
+        append_json_number(out, value);
+        if(!last)
+            out += ',';
+    };
+
+    begin_group("counters", true);
+    bool first = true;
+    for(auto &[name, value] : counters)
+    {
+        begin_item(name, first);
+        append_json_number(out, static_cast<double>(value));
+    }
+    out += '}';
+
+    begin_group("gauges", false);
+    first = true;
+    for(auto &[name, value] : gauges)
+    {
+        begin_item(name, first);
+        append_json_number(out, value);
+    }
+    out += '}';
+
+    begin_group("histograms", false);
+    first = true;
+    for(auto &[name, h] : histograms)
+    {
+        begin_item(name, first);
+        out += '{';
+        append_field("count", static_cast<double>(h.count));
+        append_field("sum",   static_cast<double>(h.sum));
+        append_field("min",   static_cast<double>(h.min));
+        append_field("max",   static_cast<double>(h.max));
+        append_field("mean",  h.mean());
+        append_field("p50",   static_cast<double>(h.percentile(50)));
+        append_field("p90",   static_cast<double>(h.percentile(90)));
+        append_field("p99",   static_cast<double>(h.percentile(99)));
+        append_field("p999",  static_cast<double>(h.percentile(99.9)), true);
+        out += '}';
+    }
+    out += '}';
+
+    begin_group("distributions", false);
+    first = true;
+    for(auto &[name, d] : distributions)
+    {
+        begin_item(name, first);
+        out += '{';
+        append_field("count",    static_cast<double>(d.value_count()));
+        append_field("mean",     d.mean());
+        append_field("variance", d.variance(), true);
+        out += '}';
+    }
+    out += "}}";
+
+    return out;
+}
+
+bool metrics_registry_t::contains(const std::string &name) const
+{
+    return counters_.count(name) || gauges_.count(name) ||
+           histograms_.count(name) || distributions_.count(name);
+}
+
+template<typename T>
+T &metrics_registry_t::get_or_create(
+    std::map<std::string, std::unique_ptr<T>> &metrics, const std::string &name)
+{
+    std::lock_guard lk(mutex_);
+
+    if(auto it = metrics.find(name); it != metrics.end())
+        return *it->second;
+
+    if(contains(name))
+    {
+        throw std::runtime_error(
+            "metric name is used by another kind of metric: " + name);
+    }
+
+    auto &ret = metrics[name];
+    ret = std::make_unique<T>();
+    return *ret;
+}
+
+counter_t &metrics_registry_t::counter(const std::string &name)
+{
+    return get_or_create(counters_, name);
+}
+
+gauge_t &metrics_registry_t::gauge(const std::string &name)
+{
+    return get_or_create(gauges_, name);
+}
+
+histogram_t &metrics_registry_t::histogram(const std::string &name)
+{
+    return get_or_create(histograms_, name);
+}
+
+distribution_t &metrics_registry_t::distribution(const std::string &name)
+{
+    return get_or_create(distributions_, name);
+}
+
+metrics_snapshot_t metrics_registry_t::snapshot() const
+{
+    std::lock_guard lk(mutex_);
+
+    metrics_snapshot_t ret;
+    for(auto &[name, c] : counters_)
+        ret.counters[name] = c->value();
+    for(auto &[name, g] : gauges_)
+        ret.gauges[name] = g->value();
+    for(auto &[name, h] : histograms_)
+        ret.histograms[name] = h->snapshot();
+    for(auto &[name, d] : distributions_)
+        ret.distributions[name] = d->snapshot();
+    return ret;
+}
+
+void metrics_registry_t::reset()
+{
+    std::lock_guard lk(mutex_);
+
+    for(auto &[name, c] : counters_)
+        c->reset();
+    for(auto &[name, h] : histograms_)
+        h->reset();
+    for(auto &[name, d] : distributions_)
+        d->reset();
+}
+
+} // namespace agz::profile
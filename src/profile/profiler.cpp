@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include <agz-utils/file/file_raw.h>
+#include <agz-utils/profile/profiler.h>
+
+#include "./json.h"
+
+namespace agz::profile
+{
+
+namespace
+{
+
+    using profile_impl::append_json_string;
+    using profile_impl::chunk_t;
+    using profile_impl::event_t;
+    using profile_impl::thread_buffer_t;
+
+    struct thread_record_t
+    {
+        std::unique_ptr<thread_buffer_t> buffer;
+        std::string name;
+        uint32_t id = 0;
+    };
+
+    struct registry_t
+    {
+        std::mutex mutex;
+        std::vector<thread_record_t> threads;
+        uint32_t next_thread_id = 0;
+
+        uint64_t                              epoch_ticks;
+        std::chrono::steady_clock::time_point epoch_time;
+
+        registry_t()
+        {
+            epoch_ticks = profile_impl::ticks();
+            epoch_time  = std::chrono::steady_clock::now();
+        }
+    };
+
+    // 不析构，以免其他线程在静态对象析构后仍在记录
+    registry_t &registry()
+    {
+        static registry_t *ret = new registry_t;
+        return *ret;
+    }
+
+    void free_chunks(chunk_t *chunk) noexcept
+    {
+        while(chunk)
+        {
+            chunk_t *next = chunk->next.load(std::memory_order_relaxed);
+            delete chunk;
+            chunk = next;
+        }
+    }
+
+    struct thread_events_t
+    {
+        uint32_t id = 0;
+        std::string name;
+        std::vector<event_t> events;
+    };
+
+    std::vector<thread_events_t> snapshot()
+    {
+        auto &reg = registry();
+        std::lock_guard lk(reg.mutex);
+
+        std::vector<thread_events_t> ret;
+        ret.reserve(reg.threads.size());
+
+        for(auto &t : reg.threads)
+        {
+            thread_events_t r;
+            r.id   = t.id;
+            r.name = t.name;
+
+            for(chunk_t *c = t.buffer->head; c;
+                c = c->next.load(std::memory_order_acquire))
+            {
+                const size_t n = c->count.load(std::memory_order_acquire);
+                r.events.insert(r.events.end(), c->events, c->events + n);
+            }
+
+            ret.push_back(std::move(r));
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief 每毫秒的tick数
+     */
+    double ticks_per_ms()
+    {
+#ifdef AGZ_PROFILE_RDTSC
+        // 以steady_clock校准时间戳计数器，要求处理器的计数器频率恒定
+
+        auto &reg = registry();
+
+        const auto min_elapsed = std::chrono::milliseconds(10);
+        const auto elapsed = std::chrono::steady_clock::now() - reg.epoch_time;
+        if(elapsed < min_elapsed)
+            std::this_thread::sleep_for(min_elapsed - elapsed);
+
+        const uint64_t ticks = profile_impl::ticks();
+        const auto     now   = std::chrono::steady_clock::now();
+
+        const double ms = std::chrono::duration<double, std::milli>(
+            now - reg.epoch_time).count();
+        return static_cast<double>(ticks - reg.epoch_ticks) / ms;
+#else
+        return 1e6;
+#endif
+    }
+
+    struct tree_builder_t
+    {
+        std::string name;
+        uint64_t call_count  = 0;
+        uint64_t total_ticks = 0;
+        std::vector<std::unique_ptr<tree_builder_t>> children;
+
+        tree_builder_t *child(const char *child_name)
+        {
+            for(auto &c : children)
+            {
+                if(c->name == child_name)
+                    return c.get();
+            }
+            children.push_back(std::make_unique<tree_builder_t>());
+            children.back()->name = child_name;
+            return children.back().get();
+        }
+
+        call_tree_node_t to_node(double ticks_per_ms) const
+        {
+            call_tree_node_t ret;
+            ret.name       = name;
+            ret.call_count = call_count;
+            ret.total_ms   = total_ticks / ticks_per_ms;
+            ret.self_ms    = ret.total_ms;
+
+            for(auto &c : children)
+            {
+                ret.children.push_back(c->to_node(ticks_per_ms));
+                ret.self_ms -= ret.children.back().total_ms;
+            }
+            ret.self_ms = (std::max)(ret.self_ms, 0.0);
+
+            std::sort(ret.children.begin(), ret.children.end(),
+                [](const call_tree_node_t &a, const call_tree_node_t &b)
+            {
+                return a.total_ms > b.total_ms;
+            });
+
+            return ret;
+        }
+    };
+
+    void append_summary(
+        std::string &out, const call_tree_node_t &node, int indent)
+    {
+        char line[256];
+        std::snprintf(
+            line, sizeof(line), "%*s%-*s %10llu %14.3f %14.3f\n",
+            indent, "", (std::max)(48 - indent, 1), node.name.c_str(),
+            static_cast<unsigned long long>(node.call_count),
+            node.total_ms, node.self_ms);
+        out += line;
+
+        for(auto &c : node.children)
+            append_summary(out, c, indent + 2);
+    }
+
+    /**
+     * @brief 线程退出时将其缓冲区标记为finished
+     */
+    struct buffer_owner_t
+    {
+        thread_buffer_t *buffer = nullptr;
+
+        ~buffer_owner_t()
+        {
+            if(!buffer)
+                return;
+            profile_impl::local_buffer   = nullptr;
+            profile_impl::local_finished = true;
+            buffer->finished.store(true, std::memory_order_release);
+        }
+    };
+
+} // namespace anonymous
+
+namespace profile_impl
+{
+
+    bool thread_buffer_t::grow() noexcept
+    {
+        auto chunk = new(std::nothrow) chunk_t;
+        if(!chunk)
+            return false;
+        tail->next.store(chunk, std::memory_order_release);
+        tail = chunk;
+        return true;
+    }
+
+    thread_buffer_t *register_thread()
+    {
+        auto buffer = std::make_unique<thread_buffer_t>();
+        buffer->head = buffer->tail = new chunk_t;
+
+        auto &reg = registry();
+        std::lock_guard lk(reg.mutex);
+
+        thread_record_t record;
+        record.buffer = std::move(buffer);
+        record.id     = reg.next_thread_id++;
+        record.name   = "thread " + std::to_string(record.id);
+        reg.threads.push_back(std::move(record));
+
+        static thread_local buffer_owner_t owner;
+        owner.buffer = reg.threads.back().buffer.get();
+        return owner.buffer;
+    }
+
+} // namespace profile_impl
+
+void set_enabled(bool enabled) noexcept
+{
+    profile_impl::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool is_enabled() noexcept
+{
+    return profile_impl::enabled.load(std::memory_order_relaxed);
+}
+
+void set_thread_name(std::string name)
+{
+    thread_buffer_t *buffer = profile_impl::get_local_buffer();
+    if(!buffer)
+        return;
+
+    auto &reg = registry();
+    std::lock_guard lk(reg.mutex);
+    for(auto &t : reg.threads)
+    {
+        if(t.buffer.get() == buffer)
+        {
+            t.name = std::move(name);
+            break;
+        }
+    }
+}
+
+void reset()
+{
+    auto &reg = registry();
+    std::lock_guard lk(reg.mutex);
+
+    auto finished_beg = std::stable_partition(
+        reg.threads.begin(), reg.threads.end(), [](const thread_record_t &t)
+    {
+        return !t.buffer->finished.load(std::memory_order_acquire);
+    });
+    for(auto it = finished_beg; it != reg.threads.end(); ++it)
+        free_chunks(it->buffer->head);
+    reg.threads.erase(finished_beg, reg.threads.end());
+
+    for(auto &t : reg.threads)
+    {
+        chunk_t *head = t.buffer->head;
+        free_chunks(head->next.load(std::memory_order_relaxed));
+        head->next.store(nullptr, std::memory_order_relaxed);
+        head->count.store(0, std::memory_order_relaxed);
+        t.buffer->tail = head;
+    }
+}
+
+call_tree_node_t build_call_tree()
+{
+    auto threads = snapshot();
+
+    tree_builder_t root;
+
+    struct open_zone_t
+    {
+        const event_t  *event;
+        tree_builder_t *node;
+    };
+    std::vector<open_zone_t> stack;
+
+    for(auto &t : threads)
+    {
+        // 父区域先于子区域开始，开始时刻相同时深度较小者为父区域
+
+        std::sort(t.events.begin(), t.events.end(),
+            [](const event_t &a, const event_t &b)
+        {
+            return a.begin != b.begin ? a.begin < b.begin : a.depth < b.depth;
+        });
+
+        // 父区域尚未结束时不在事件中，此时挂到最近的包含它的区域下
+
+        stack.clear();
+        for(auto &e : t.events)
+        {
+            while(!stack.empty() &&
+                  !(stack.back().event->begin <= e.begin &&
+                    e.end <= stack.back().event->end))
+                stack.pop_back();
+
+            tree_builder_t *parent = stack.empty() ? &root : stack.back().node;
+            tree_builder_t *node = parent->child(e.name);
+            node->call_count  += 1;
+            node->total_ticks += e.end - e.begin;
+
+            if(stack.empty())
+                root.total_ticks += e.end - e.begin;
+
+            stack.push_back({ &e, node });
+        }
+    }
+
+    root.name = "root";
+    return root.to_node(ticks_per_ms());
+}
+
+std::string to_chrome_trace()
+{
+    const auto threads = snapshot();
+    const double ticks_per_us = ticks_per_ms() / 1000;
+    const uint64_t epoch = registry().epoch_ticks;
+
+    std::string out = "{\"traceEvents\":[\n";
+    bool first = true;
+
+    auto begin_event = [&]
+    {
+        if(!first)
+            out += ",\n";
+        first = false;
+    };
+
+    char buf[128];
+    for(auto &t : threads)
+    {
+        begin_event();
+        std::snprintf(
+            buf, sizeof(buf),
+            "{\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":",
+            t.id);
+        out += buf;
+        append_json_string(out, t.name);
+        out += "}}";
+
+        for(auto &e : t.events)
+        {
+            const double ts =
+                (static_cast<double>(e.begin) - static_cast<double>(epoch)) / ticks_per_us;
+            const double dur = (e.end - e.begin) / ticks_per_us;
+
+            begin_event();
+            std::snprintf(
+                buf, sizeof(buf),
+                "{\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+                t.id, ts, dur);
+            out += buf;
+            append_json_string(out, e.name);
+            out += '}';
+        }
+    }
+
+    out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out;
+}
+
+void export_chrome_trace(const std::string &filename)
+{
+    const std::string trace = to_chrome_trace();
+    file::write_raw_file(filename, trace.data(), trace.size());
+}
+
+std::string summary()
+{
+    const call_tree_node_t root = build_call_tree();
+
+    char header[256];
+    std::snprintf(
+        header, sizeof(header), "%-48s %10s %14s %14s\n",
+        "zone", "calls", "total(ms)", "self(ms)");
+
+    std::string out = header;
+    out += std::string(std::strlen(header) - 1, '-');
+    out += '\n';
+
+    for(auto &c : root.children)
+        append_summary(out, c, 0);
+
+    return out;
+}
+
+} // namespace agz::profile
@@ -0,0 +1,194 @@
+#include <cstdint>
+
+#include <agz-utils/string/tokenize.h>
+
+#include "../misc/cpu_features.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define AGZ_TOKENIZE_X86
+#   define AGZ_TOKENIZE_TARGET(X) __attribute__((target(X)))
+#   include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#   define AGZ_TOKENIZE_X86
+#   define AGZ_TOKENIZE_TARGET(X)
+#   include <immintrin.h>
+#   include <intrin.h>
+#endif
+
+namespace agz::stdstr
+{
+
+    namespace
+    {
+        // 超过该数量的分隔符改用查表
+        constexpr size_t MAX_SIMD_CHARS = 8;
+
+        const char *find_first_of_table(
+            const char *beg, const char *end, std::string_view chars) noexcept
+        {
+            bool table[256] = {};
+            for(char c : chars)
+                table[static_cast<unsigned char>(c)] = true;
+
+            for(; beg < end; ++beg)
+            {
+                if(table[static_cast<unsigned char>(*beg)])
+                    return beg;
+            }
+            return end;
+        }
+
+        const char *find_first_of_scalar(
+            const char *beg, const char *end, std::string_view chars) noexcept
+        {
+            for(; beg < end; ++beg)
+            {
+                for(char c : chars)
+                {
+                    if(*beg == c)
+                        return beg;
+                }
+            }
+            return end;
+        }
+
+#ifdef AGZ_TOKENIZE_X86
+
+        int count_trailing_zeros(uint32_t mask) noexcept
+        {
+#if defined(__GNUC__)
+            return __builtin_ctz(mask);
+#else
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<int>(index);
+#endif
+        }
+
+        /**
+         * @brief 处理[beg, end)中完整的16字节块，返回找到的位置或第一个未处理的字节
+         */
+        AGZ_TOKENIZE_TARGET("sse2")
+        const char *find_first_of_sse2(
+            const char *beg, const char *end, std::string_view chars,
+            bool &found) noexcept
+        {
+            __m128i needles[MAX_SIMD_CHARS];
+            for(size_t i = 0; i < chars.size(); ++i)
+                needles[i] = _mm_set1_epi8(chars[i]);
+
+            for(; end - beg >= 16; beg += 16)
+            {
+                const __m128i block = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(beg));
+
+                __m128i eq = _mm_cmpeq_epi8(block, needles[0]);
+                for(size_t i = 1; i < chars.size(); ++i)
+                    eq = _mm_or_si128(eq, _mm_cmpeq_epi8(block, needles[i]));
+
+                const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(eq));
+                if(mask)
+                {
+                    found = true;
+                    return beg + count_trailing_zeros(mask);
+                }
+            }
+
+            found = false;
+            return beg;
+        }
+
+        /**
+         * @brief 同find_first_of_sse2，但处理32字节块
+         */
+        AGZ_TOKENIZE_TARGET("avx2")
+        const char *find_first_of_avx2(
+            const char *beg, const char *end, std::string_view chars,
+            bool &found) noexcept
+        {
+            __m256i needles[MAX_SIMD_CHARS];
+            for(size_t i = 0; i < chars.size(); ++i)
+                needles[i] = _mm256_set1_epi8(chars[i]);
+
+            for(; end - beg >= 32; beg += 32)
+            {
+                const __m256i block = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(beg));
+
+                __m256i eq = _mm256_cmpeq_epi8(block, needles[0]);
+                for(size_t i = 1; i < chars.size(); ++i)
+                    eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(block, needles[i]));
+
+                const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+                if(mask)
+                {
+                    found = true;
+                    return beg + count_trailing_zeros(mask);
+                }
+            }
+
+            found = false;
+            return beg;
+        }
+
+        enum class simd_level_t { none, sse2, avx2 };
+
+        simd_level_t simd_level() noexcept
+        {
+            const auto &cpu = misc::misc_impl::cpu_features();
+            if(cpu.avx2)
+                return simd_level_t::avx2;
+            if(cpu.sse2)
+                return simd_level_t::sse2;
+            return simd_level_t::none;
+        }
+
+#endif // #ifdef AGZ_TOKENIZE_X86
+
+    } // namespace anonymous
+
+    const char *find_first_of(
+        const char *beg, const char *end, std::string_view chars) noexcept
+    {
+        if(beg >= end || chars.empty())
+            return end;
+
+        if(chars.size() == 1)
+        {
+            auto ret = static_cast<const char*>(
+                std::memchr(beg, chars[0], static_cast<size_t>(end - beg)));
+            return ret ? ret : end;
+        }
+
+        if(chars.size() > MAX_SIMD_CHARS)
+            return find_first_of_table(beg, end, chars);
+
+#ifdef AGZ_TOKENIZE_X86
+        // 不足一个块时SIMD没有收益
+        if(end - beg < 16)
+            return find_first_of_scalar(beg, end, chars);
+
+
+        bool found = false;
+        switch(simd_level())
+        {
+        case simd_level_t::avx2:
+            beg = find_first_of_avx2(beg, end, chars, found);
+            if(found)
+                return beg;
+            beg = find_first_of_sse2(beg, end, chars, found);
+            break;
+        case simd_level_t::sse2:
+            beg = find_first_of_sse2(beg, end, chars, found);
+            break;
+        default:
+            break;
+        }
+        if(found)
+            return beg;
+#endif
+
+        return find_first_of_scalar(beg, end, chars);
+    }
+
+} // namespace agz::stdstr